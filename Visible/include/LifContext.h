@@ -14,6 +14,7 @@
 #include <atomic>
 #include "OnImagePlotUtils.h"
 #include "imGuiCustom/imgui_plot.h"
+#include "time_series/signal_lod.hpp"
 #include <map>
 
 using namespace boost;
@@ -142,6 +143,10 @@ public:
     
 private:
 	timeDataDict_t<float> m_timeFloatDict;
+	// Decimation pyramids of m_timeFloatDict tracks, rebuilt when a track is replaced
+	std::map<result_index_channel_t, signal_lod<float>> m_timeFloatLod;
+	mutable std::mutex m_lod_mutex;
+	mutable std::vector<float> m_plot_xs, m_plot_ys;
 	
 		// utility structure for realtime plot
 	struct RollingBuffer {
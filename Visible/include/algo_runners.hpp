@@ -3,11 +3,13 @@
 
 #include <iostream>
 #include <string>
+#include <array>
 #include <Eigen/StdVector>
 #include "timed_types.h"
 #include "core/core.hpp"
 #define float16_t opencv_broken_float16_t
 #include "vision/histo.h"
+#include "vision/histogram_engine.hpp"
 #include "vision/opencv_utils.hpp"
 #undef float16_t
 #include "vision/pixel_traits.h"
@@ -127,18 +129,19 @@ struct SequenceAccumulator
     {
         done = false;
         image_count = 0;
-        for (const roiWindow<P8U>& ir : channel_images){
+        // Local variance of all frames, computed in parallel, normalized to 8 bit
+        channel_images_t spatial;
+        if (spatial_x > 0 && spatial_y > 0){
+            localVarianceEngine lv (iPair(spatial_x, spatial_y));
+            lv.process(channel_images, 0, channel_images.size(), spatial);
+        }
+        const channel_images_t& frames = spatial.empty() ? channel_images : spatial;
+        for (const roiWindow<P8U>& ir : frames){
             cv::Mat im (ir.height(), ir.width(), CV_8UC(1), ir.pelPointer(0,0), size_t(ir.rowUpdate()));
             if( image_count == 0 ) {
                 m_sum = cv::Mat::zeros( im.size().height, im.size().width, CV_32FC(im.channels()) );
                 m_sqsum = cv::Mat::zeros( im.size().height, im.size().width, CV_32FC(im.channels()) );
             }
-            if (spatial_x > 0 && spatial_y > 0){
-                cv::Mat result;
-                localVAR lv(cv::Size(spatial_x, spatial_y));
-                lv.process (im, result);
-                cv::normalize(result, im, 0, 255, NORM_MINMAX, CV_8UC1);
-            }
             cv::accumulate( im, m_sum );
             cv::accumulateSquare( im, m_sqsum );
             image_count++;
@@ -178,30 +181,101 @@ struct IntensityStatisticsPartialRunner
                     std::vector< std::tuple<uint8_t, uint8_t> >& ranges )
     {
         results.clear();
-        for (auto ii = 0; ii < channel.size(); ii++)
+        // All frames' histograms in one batched, multi bank pass
+        std::vector<std::vector<uint32_t>> histograms;
+        svl::histogramEngine ().compute(channel, histograms);
+        for (const auto& hist : histograms)
         {
-            roiWindow<P8U>& image = channel[ii];
-            histoStats hh;
-            hh.from_image(image);
-            int64_t s = hh.sum();
-            int64_t ss = hh.sumSquared();
-            uint8_t mi = hh.min();
-            uint8_t ma = hh.max();
-            uint32_t nn = hh.n();
+            int64_t s = 0, ss = 0;
+            uint32_t nn = 0;
+            int mi = -1, ma = 0;
+            for (int bin = 0; bin < int(hist.size()); bin++)
+            {
+                if (hist[bin] == 0) continue;
+                if (mi < 0) mi = bin;
+                ma = bin;
+                nn += hist[bin];
+                s += int64_t(bin) * hist[bin];
+                ss += int64_t(bin) * bin * hist[bin];
+            }
             results.emplace_back(s,ss,nn);
-            ranges.emplace_back(mi,ma);
+            ranges.emplace_back(uint8_t(std::max(mi, 0)),uint8_t(ma));
         }
     }
 };
 
 
-class voxel_processor {
-public:
-    voxel_processor();
-
-    bool generate_voxel_space (const std::vector<roiWindow<P8U>>& images, const std::vector<int>& indicies = std::vector<int> ());
-    bool generate_voxel_surface (const std::vector<float>&);
+/*
+struct VolumeAccumulator
+ Fused single pass over a channel. Produces in one scan of the frames:
+    per frame histogram, (sum, sumsq, count) and (min, max) as IntensityStatisticsPartialRunner
+    volume stats
+    per pixel sum and sum of squares as SequenceAccumulator ( without spatial variance )
+    optionally the time major series of a sampled voxel lattice for voxel_processor
+ Frames are split in contiguous chunks, one per thread, each accumulating per pixel sums in integer
+ buffers. Partial per pixel sums are merged with a pairwise tree reduction.
+ Frames are hashed in the same pass: content_hash() identifies the serie the results belong to and
+ equals content_hash(images) for the same frames.
+*/
+struct VolumeAccumulator
+{
+    typedef std::vector<roiWindow<P8U>> channel_images_t;
+    typedef std::array<uint32_t, 256> histogram_t;
+    
+    VolumeAccumulator (unsigned int threads = 0);
+    
+    // Gather the voxel lattice, see voxel_processor::sample and voxel_processor::image_size
+    void lattice (const uiPair& sample);
+    
+    bool operator()(const channel_images_t& images);
     
+    // Hash of the content of the frames, computed without accumulating
+    static uint64_t content_hash (const channel_images_t& images, unsigned int threads = 0);
+    
+    size_t frame_count () const { return m_frame_count; }
+    uint64_t content_hash () const;
+    const iPair& frame_size () const { return m_frame_size; }
+    const std::vector<histogram_t>& histograms () const { return m_histograms; }
+    const std::vector< std::tuple<int64_t, int64_t, uint32_t> >& moments () const { return m_moments; }
+    const std::vector< std::tuple<uint8_t, uint8_t> >& ranges () const { return m_ranges; }
+    svl::stats<int64_t> volume_stats () const;
+    
+    // Per pixel sum and sum of squares as CV_32F, ready for SequenceAccumulator::computeStdev etc.
+    void sums (cv::Mat& m_sum, cv::Mat& m_sqsum) const;
+    
+    bool has_lattice () const { return ! m_lattice_series.empty(); }
+    const uiPair& lattice_sample () const { return m_lattice_sample; }
+    const iPair& lattice_size () const { return m_lattice_size; }
+    // One row of lattice_size().first * lattice_size().second values per frame
+    const std::vector<uint8_t>& lattice_series () const { return m_lattice_series; }
+    
+private:
+    void accumulate_chunk (const channel_images_t& images, size_t first, size_t last, size_t partial);
+    static uint64_t combine (const std::vector<uint64_t>& frame_hashes);
+    
+    unsigned int m_threads;
+    size_t m_frame_count;
+    iPair m_frame_size;
+    uiPair m_lattice_sample;
+    uiPair m_lattice_offset;
+    iPair m_lattice_size;
+    std::vector<histogram_t> m_histograms;
+    std::vector< std::tuple<int64_t, int64_t, uint32_t> > m_moments;
+    std::vector< std::tuple<uint8_t, uint8_t> > m_ranges;
+    std::vector<uint64_t> m_frame_hashes;
+    std::vector<std::vector<uint32_t>> m_pixel_sums;
+    std::vector<std::vector<uint64_t>> m_pixel_sqsums;
+    std::vector<uint8_t> m_lattice_series;
+};
+
+
+/*
+ voxel_lattice
+ Sampled voxel grid shared by voxel_processor and voxel_feature_processor:
+ one voxel every sample pixels, starting half a sample in
+ */
+class voxel_lattice {
+public:
     const uiPair &sample() { return m_voxel_sample; }
     const uiPair &half_offet() { return m_half_offset; }
     void sample(uint32_t x, uint32_t y = 0) {
@@ -216,6 +290,24 @@ public:
         m_expected_segmented_size.second = m_image_size.second / m_voxel_sample.second;
     }
     
+    const iPair& segmented_size () const { return m_expected_segmented_size; }
+    
+protected:
+    uiPair m_voxel_sample;
+    uiPair m_half_offset;
+    uiPair m_image_size;
+    iPair m_expected_segmented_size;
+};
+
+class voxel_processor : public voxel_lattice {
+public:
+    voxel_processor();
+
+    bool generate_voxel_space (const std::vector<roiWindow<P8U>>& images, const std::vector<int>& indicies = std::vector<int> ());
+    // Uses the voxel lattice gathered by a VolumeAccumulator with the same sample
+    bool generate_voxel_space (const VolumeAccumulator& volume);
+    bool generate_voxel_surface (const std::vector<float>&);
+    
     const Rectf& measured_area () { return m_measured_area; }
     const cv::Mat& temporal_ss () { return m_temporal_ss; }
     const std::vector<float>& entropies () { return m_voxel_entropies; }
@@ -231,12 +323,8 @@ private:
                 uint32_t sample_y = 0, const std::vector<int>& indicies = std::vector<int> ()); 
     
     std::vector<Eigen::Vector3d> m_cloud;
-    uiPair m_voxel_sample;
-    uiPair m_half_offset;
-    iPair m_expected_segmented_size;
     mutable std::vector<roiWindow<P8U>> m_voxels;
     size_t m_voxel_length;
-    uiPair m_image_size;
     vector<float> m_voxel_entropies;
     mutable smProducerRef m_sm_producer;
     Rectf m_measured_area;
@@ -244,6 +332,61 @@ private:
     std::vector<uint32_t> m_hist;
 };
 
+
+/*
+ voxel_feature_processor
+ Per-voxel temporal features computed in one pass over a serie, on the same sampled voxel grid as voxel_processor:
+    permutation entropy of orders 3 to 6 ( normalized to [0,1] by log(order!) )
+    dominant frequency ( cycles per frame ) and the fraction of AC power at that frequency
+ Ordinal patterns are updated incrementally: with i_l(t) = #{ r < l : x(t-l) > x(t-r) },
+ i_l(t) = i_(l-1)(t-1) + [x(t-l) > x(t)], so each frame costs one comparison per order over a block of voxels.
+ Ties are ordered by time: of two equal values the earlier one ranks lower, as in the insertion step of
+ permutation_entropy::permutation_entropy_array_stats.
+ Voxel blocks are processed in parallel, each thread with its own pattern histograms.
+ surface() returns a map that is high where voxels move and can be passed to voxel_processor::generate_voxel_surface
+ in place of the voxel self-similarity entropies.
+*/
+class voxel_feature_processor : public voxel_lattice {
+public:
+    enum class feature : int {
+        permutation_entropy = 0,
+        dominant_power = 1
+    };
+    static const int min_order = 3;
+    static const int max_order = 6;
+    
+    voxel_feature_processor(int order = 4, unsigned int threads = 0);
+    
+    bool generate_voxel_features (const std::vector<roiWindow<P8U>>& images, const std::vector<int>& indicies = std::vector<int> ());
+    
+    int order () const { return m_order; }
+    void order (int oo) { m_order = std::max(min_order, std::min(max_order, oo)); }
+    
+    // Normalized permutation entropy for orders min_order ... max_order. Empty vector for other orders
+    const std::vector<float>& permutation_entropies (int order) const;
+    const std::vector<float>& permutation_entropies () const { return permutation_entropies(m_order); }
+    const std::vector<float>& dominant_frequencies () const { return m_dominant_frequency; }
+    const std::vector<float>& dominant_powers () const { return m_dominant_power; }
+    
+    // Feature map oriented for segmentation ( moving voxels high )
+    std::vector<float> surface (feature ff = feature::permutation_entropy) const;
+    
+private:
+    bool m_gather (const std::vector<roiWindow<P8U>>& images, const std::vector<int>& indicies);
+    void m_permutation_entropy_block (size_t first, size_t last);
+    void m_spectrum_block (size_t first, size_t last);
+    
+    int m_order;
+    unsigned int m_threads;
+    size_t m_voxel_count;
+    size_t m_voxel_length;
+    // time major: one row of m_voxel_count sampled pixels per frame
+    std::vector<uint8_t> m_series;
+    std::array<std::vector<float>, max_order - min_order + 1> m_entropies;
+    std::vector<float> m_dominant_frequency;
+    std::vector<float> m_dominant_power;
+};
+
  
  /*   Scale Space Processing  for cardiomyocyte detection and processing
       
@@ -4,6 +4,10 @@
 #include <vector>
 #include <cmath>
 #include <map>
+#include <tuple>
+#include <atomic>
+#include <memory>
+#include <cstdint>
 
 #define UNCLASSIFIED -1
 #define CORE_POINT 1
@@ -52,4 +56,60 @@ private:
     float m_epsilon;
 };
 
+/*
+ gridDBSCAN
+ Drop-in replacement for DBSCAN on large clouds ( voxel surfaces ).
+ Points are bucketed in a uniform grid with cell size equal to the search radius, so a
+ radius query only visits the 27 neighbouring cells. Core points are detected in parallel
+ and clusters are formed by merging core points with a lock-free union-find.
+ Labels ( and therefore cluster_hist ) match DBSCAN::run:
+    cluster ids are ordered by the first core point of each cluster,
+    noise points are left UNCLASSIFIED,
+    border points follow the serial assignment order.
+ Note: as in DBSCAN, epsilon is compared against the squared distance.
+*/
+class gridDBSCAN {
+public:
+    typedef DBSCAN::Point Point;
+    typedef DBSCAN::dbHist_t dbHist_t;
+    
+    gridDBSCAN(unsigned int minPts, float eps, vector<Point> points, unsigned int threads = 0);
+    ~gridDBSCAN(){}
+    
+    int run();
+    
+    /* indices of all points within epsilon of point at index */
+    vector<int> calculateCluster(int index) const;
+    
+    size_t getTotalPointSize() {return m_points.size();}
+    int getMinimumClusterSize() {return m_minPoints;}
+    int getEpsilonSize() {return m_epsilon;}
+    const vector<Point>& points () { return m_points; }
+    const dbHist_t& cluster_hist ();
+    
+private:
+    typedef std::tuple<int64_t,int64_t,int64_t> cell_t;
+    
+    void build_grid ();
+    cell_t cell_of (const Point& pt) const;
+    template<typename F> void for_each_neighbour (int index, F&& func) const;
+    template<typename F> void parallel_range (size_t count, F&& func) const;
+    int find (int index) const;
+    void unite (int a, int b);
+    
+    dbHist_t m_hist;
+    vector<Point> m_points;
+    unsigned int m_minPoints;
+    float m_epsilon;
+    double m_cell_size;
+    unsigned int m_threads;
+    
+    // Points sorted by cell, and the [begin,end) range of each occupied cell
+    vector<int> m_order;
+    vector<cell_t> m_cells;
+    vector<std::pair<int,int>> m_cell_ranges;
+    vector<uint8_t> m_core;
+    std::unique_ptr<std::atomic<int>[]> m_parent;
+};
+
 #endif // DBSCAN_H
@@ -0,0 +1,317 @@
+//
+//  frame_cache.hpp
+//  Visible
+//
+//  Byte budgeted LRU cache of decoded frames, with read-ahead around the play cursor.
+//
+//  Frames are identified by index. Time stamps are strictly increasing, so index -> time is a dense array and
+//  time -> index an interpolated guess into it, corrected by a short walk. index -> slot is a dense array as well:
+//  a lookup is two array reads under a shared lock, and readers never wait on each other. Slots carry an atomic
+//  use stamp that readers bump without the exclusive lock; eviction drops the resident frame with the oldest stamp.
+//
+//  Each get() moves the play cursor. Its direction is taken from the previous get(). A prefetch thread decodes
+//  read_ahead frames past the cursor in that direction and read_behind before it, so playback in either direction
+//  and scrubbing around a point are served from memory. Prefetch never evicts frames used since the cursor last
+//  moved, so a window larger than the budget is trimmed rather than thrashed.
+//
+
+#ifndef frame_cache_hpp
+#define frame_cache_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+
+template<typename F>
+class lru_frame_cache {
+public:
+    // Decodes frame index in to frame, returns false if it can not. Never called concurrently
+    typedef std::function<bool (int64_t index, F& frame)> decode_fn_t;
+    // Memory held by a frame
+    typedef std::function<size_t (const F& frame)> bytes_fn_t;
+
+    /*
+     budget: bytes of frames kept resident
+     decode: loads missing frames, on the caller's thread on a miss and on the prefetch thread. Without it,
+     frames are only those inserted and there is no prefetch
+     frames: number of frames, 0 for the number of time stamps added
+     */
+    lru_frame_cache (size_t budget, const bytes_fn_t& bytes, const decode_fn_t& decode = decode_fn_t (),
+                     int64_t frames = 0, int read_ahead = 8, int read_behind = 2) :
+    m_budget (budget), m_bytes_fn (bytes), m_decode (decode), m_frames (frames),
+    m_read_ahead (std::max(0, read_ahead)), m_read_behind (std::max(0, read_behind)),
+    m_bytes (0), m_tick (0), m_hits (0), m_misses (0),
+    m_cursor (-1), m_direction (1), m_cursor_stamp (0), m_generation (0), m_closing (false) {
+        if (m_decode && (m_read_ahead + m_read_behind) > 0)
+            m_prefetcher = std::thread(&lru_frame_cache::prefetch, this);
+    }
+
+    ~lru_frame_cache () {
+        {
+            std::lock_guard<std::mutex> lock(m_cursor_mutex);
+            m_closing = true;
+        }
+        m_cursor_moved.notify_all();
+        if (m_prefetcher.joinable()) m_prefetcher.join();
+    }
+
+    lru_frame_cache (const lru_frame_cache&) = delete;
+    lru_frame_cache& operator= (const lru_frame_cache&) = delete;
+
+    /*
+     add_time
+     Appends the time stamp of the next frame. Returns false, and leaves index alone, if secs is not past the last one.
+     */
+    bool add_time (double secs, int64_t& index) {
+        std::unique_lock<std::shared_timed_mutex> lock(m_mutex);
+        if (! m_times.empty() && ! (secs > m_times.back())) return false;
+        index = static_cast<int64_t>(m_times.size());
+        m_times.push_back(secs);
+        return true;
+    }
+
+    // Index of the frame nearest to secs, -1 if there are no time stamps or secs is past the last one
+    int64_t index_of (double secs) const {
+        std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+        const int64_t count = static_cast<int64_t>(m_times.size());
+        if (count == 0 || secs > m_times.back()) return -1;
+        if (count == 1 || secs <= m_times.front()) return 0;
+
+        // Frame rates are near constant: start from the interpolated index
+        const double span = m_times.back() - m_times.front();
+        int64_t ii = static_cast<int64_t>((secs - m_times.front()) / span * double(count - 1));
+        ii = std::max(int64_t(0), std::min(count - 2, ii));
+        while (ii > 0 && m_times[size_t(ii)] > secs) ii--;
+        while (ii < count - 2 && m_times[size_t(ii + 1)] < secs) ii++;
+        // m_times[ii] <= secs <= m_times[ii + 1]
+        return (secs - m_times[size_t(ii)]) < (m_times[size_t(ii + 1)] - secs) ? ii : ii + 1;
+    }
+
+    double time_of (int64_t index) const {
+        std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+        return index >= 0 && index < int64_t(m_times.size()) ? m_times[size_t(index)] : -1.0;
+    }
+
+    bool contains (int64_t index) const {
+        std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+        return slot_of(index) >= 0;
+    }
+
+    /*
+     insert
+     Adds frame at index, evicting least recently used frames to stay within budget.
+     Returns false if a frame is already cached at index.
+     */
+    bool insert (int64_t index, const F& frame) {
+        std::unique_lock<std::shared_timed_mutex> lock(m_mutex);
+        return store(index, frame, std::numeric_limits<uint64_t>::max());
+    }
+
+    /*
+     get
+     Frame at index, decoding it on a miss. Moves the play cursor to index.
+     Returns false if the frame is not cached and can not be decoded.
+     */
+    bool get (int64_t index, F& frame) {
+        if (index < 0) return false;
+        const uint64_t stamp = ++m_tick;
+        bool hit = false;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+            const int32_t slot = slot_of(index);
+            if (slot >= 0) {
+                frame = m_slots[size_t(slot)].frame;
+                m_stamps[size_t(slot)].store(stamp, std::memory_order_relaxed);
+                hit = true;
+            }
+        }
+        if (hit) m_hits++; else m_misses++;
+        move_cursor(index, stamp);
+        if (hit) return true;
+        if (! m_decode) return false;
+
+        std::lock_guard<std::mutex> decoding(m_decode_mutex);
+        {
+            // The prefetcher may have decoded it meanwhile
+            std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+            const int32_t slot = slot_of(index);
+            if (slot >= 0) {
+                frame = m_slots[size_t(slot)].frame;
+                return true;
+            }
+        }
+        if (! m_decode(index, frame)) return false;
+        std::unique_lock<std::shared_timed_mutex> lock(m_mutex);
+        store(index, frame, std::numeric_limits<uint64_t>::max());
+        return true;
+    }
+
+    // Drops all frames, keeps the time stamps
+    void clear () {
+        std::unique_lock<std::shared_timed_mutex> lock(m_mutex);
+        m_slots.clear();
+        m_stamps.clear();
+        m_free.clear();
+        m_slot_of.clear();
+        m_bytes = 0;
+    }
+
+    size_t budget () const { return m_budget; }
+    size_t bytes () const { std::shared_lock<std::shared_timed_mutex> lock(m_mutex); return m_bytes; }
+    size_t resident () const { std::shared_lock<std::shared_timed_mutex> lock(m_mutex); return m_slots.size() - m_free.size(); }
+    int64_t frames () const {
+        std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+        return m_frames > 0 ? m_frames : static_cast<int64_t>(m_times.size());
+    }
+    size_t hits () const { return m_hits; }
+    size_t misses () const { return m_misses; }
+    int direction () const { std::lock_guard<std::mutex> lock(m_cursor_mutex); return m_direction; }
+
+private:
+    struct slot_t {
+        F frame;
+        int64_t index;
+        size_t bytes;
+    };
+
+    // Requires a lock on m_mutex
+    int32_t slot_of (int64_t index) const {
+        return index >= 0 && index < int64_t(m_slot_of.size()) ? m_slot_of[size_t(index)] : -1;
+    }
+
+    /*
+     Requires the exclusive lock. Only frames last used before protect are evicted; returns false, without
+     storing, if the budget can not be met that way
+     */
+    bool store (int64_t index, const F& frame, uint64_t protect) {
+        if (slot_of(index) >= 0) return false;
+        const size_t bytes = m_bytes_fn(frame);
+        while (m_bytes + bytes > m_budget && m_free.size() < m_slots.size()) {
+            int32_t victim = -1;
+            uint64_t oldest = std::numeric_limits<uint64_t>::max();
+            for (size_t ss = 0; ss < m_slots.size(); ss++) {
+                if (m_slots[ss].index < 0) continue;
+                const uint64_t used = m_stamps[ss].load(std::memory_order_relaxed);
+                if (used < oldest) { oldest = used; victim = int32_t(ss); }
+            }
+            if (victim < 0 || oldest >= protect) return false;
+            slot_t& vv = m_slots[size_t(victim)];
+            m_slot_of[size_t(vv.index)] = -1;
+            m_bytes -= vv.bytes;
+            vv = slot_t {F (), -1, 0};
+            m_free.push_back(victim);
+        }
+
+        int32_t slot;
+        if (! m_free.empty()) {
+            slot = m_free.back();
+            m_free.pop_back();
+        }
+        else {
+            slot = static_cast<int32_t>(m_slots.size());
+            m_slots.emplace_back();
+            m_stamps.emplace_back(0);
+        }
+        m_slots[size_t(slot)] = slot_t {frame, index, bytes};
+        m_stamps[size_t(slot)].store(++m_tick, std::memory_order_relaxed);
+        if (index >= int64_t(m_slot_of.size())) m_slot_of.resize(size_t(index) + 1, -1);
+        m_slot_of[size_t(index)] = slot;
+        m_bytes += bytes;
+        return true;
+    }
+
+    void move_cursor (int64_t index, uint64_t stamp) {
+        {
+            std::lock_guard<std::mutex> lock(m_cursor_mutex);
+            if (index == m_cursor) return;
+            if (m_cursor >= 0) m_direction = index > m_cursor ? 1 : -1;
+            m_cursor = index;
+            m_cursor_stamp = stamp;
+            m_generation++;
+        }
+        m_cursor_moved.notify_one();
+    }
+
+    void prefetch () {
+        uint64_t seen = 0;
+        while (true) {
+            int64_t cursor;
+            int direction;
+            uint64_t protect;
+            {
+                std::unique_lock<std::mutex> lock(m_cursor_mutex);
+                m_cursor_moved.wait(lock, [&](){ return m_closing || m_generation != seen; });
+                if (m_closing) return;
+                seen = m_generation;
+                cursor = m_cursor;
+                direction = m_direction;
+                protect = m_cursor_stamp;
+            }
+
+            // Nearest first: alternate ahead and behind, ahead first
+            std::vector<int64_t> wanted;
+            for (int kk = 1; kk <= std::max(m_read_ahead, m_read_behind); kk++) {
+                if (kk <= m_read_ahead) wanted.push_back(cursor + direction * kk);
+                if (kk <= m_read_behind) wanted.push_back(cursor - direction * kk);
+            }
+            const int64_t count = frames();
+            for (auto index : wanted) {
+                if (index < 0 || (count > 0 && index >= count)) continue;
+                {
+                    std::lock_guard<std::mutex> lock(m_cursor_mutex);
+                    if (m_closing || m_generation != seen) break;
+                }
+                if (contains(index)) continue;
+                F frame;
+                bool stored;
+                {
+                    std::lock_guard<std::mutex> decoding(m_decode_mutex);
+                    if (! m_decode(index, frame)) continue;
+                    std::unique_lock<std::shared_timed_mutex> lock(m_mutex);
+                    stored = store(index, frame, protect) || slot_of(index) >= 0;
+                }
+                // Out of budget for this window
+                if (! stored) break;
+            }
+        }
+    }
+
+    const size_t m_budget;
+    bytes_fn_t m_bytes_fn;
+    decode_fn_t m_decode;
+    const int64_t m_frames;
+    const int m_read_ahead;
+    const int m_read_behind;
+
+    mutable std::shared_timed_mutex m_mutex;
+    std::vector<double> m_times;
+    std::vector<int32_t> m_slot_of;           // index -> slot, -1 if not resident
+    std::vector<slot_t> m_slots;
+    std::deque<std::atomic<uint64_t>> m_stamps; // last use of each slot, bumped under the shared lock
+    std::vector<int32_t> m_free;
+    size_t m_bytes;
+    std::atomic<uint64_t> m_tick;
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+
+    std::mutex m_decode_mutex;
+    mutable std::mutex m_cursor_mutex;
+    std::condition_variable m_cursor_moved;
+    int64_t m_cursor;
+    int m_direction;
+    uint64_t m_cursor_stamp;
+    uint64_t m_generation;
+    bool m_closing;
+    std::thread m_prefetcher;
+};
+
+#endif /* frame_cache_hpp */
@@ -0,0 +1,255 @@
+//
+//  image_ingest.hpp
+//  Visible
+//
+//  Image directory ingestion.
+//
+//  image_header_size  width and height of a PNG or JPEG file from its header, without decoding
+//  ordered_ingest     bounded pool of decoder threads. Results are delivered on the calling thread in index order
+//  thumbnail_cache    persistent downscaled copies of images keyed by path, modification time and size
+//
+
+#ifndef image_ingest_hpp
+#define image_ingest_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include "core/pair.hpp"
+#include "result_cache.hpp"
+
+
+/*
+ image_header_size
+ Reads the PNG IHDR chunk or the JPEG start of frame segment. File type is taken from the content, not the
+ extension, so anonymous ( extension less ) files are handled. Returns false for other formats or corrupt headers.
+ */
+inline bool image_header_size (const bfs::path& pp, iPair& size){
+    std::ifstream file (pp.string(), std::ios::binary);
+    if (! file) return false;
+    auto u8 = [&file](){ return static_cast<uint32_t>(static_cast<uint8_t>(file.get())); };
+    auto be16 = [&u8](){ uint32_t hi = u8(); return (hi << 8) | u8(); };
+    auto be32 = [&be16](){ uint32_t hi = be16(); return (hi << 16) | be16(); };
+
+    uint8_t sig[8];
+    if (! file.read(reinterpret_cast<char*>(sig), 8)) return false;
+
+    static const uint8_t png_sig[8] = {0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a};
+    if (std::equal(sig, sig + 8, png_sig)){
+        be32(); // chunk length
+        char type[4];
+        if (! file.read(type, 4) || std::string(type, 4) != "IHDR") return false;
+        uint32_t width = be32(), height = be32();
+        if (! file || width == 0 || height == 0) return false;
+        size = iPair(static_cast<int>(width), static_cast<int>(height));
+        return true;
+    }
+
+    if (sig[0] != 0xff || sig[1] != 0xd8) return false;
+    file.seekg(2, std::ios::beg);
+    while (file){
+        if (u8() != 0xff) return false;
+        uint32_t marker = u8();
+        while (marker == 0xff && file) marker = u8(); // fill bytes
+        if (marker == 0xd8 || marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) continue; // no payload
+        if (marker == 0xd9 || marker == 0xda) return false; // end of image or start of scan before a frame header
+        uint32_t length = be16();
+        if (length < 2) return false;
+        bool sof = marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc;
+        if (sof){
+            u8(); // sample precision
+            uint32_t height = be16(), width = be16();
+            if (! file || width == 0 || height == 0) return false;
+            size = iPair(static_cast<int>(width), static_cast<int>(height));
+            return true;
+        }
+        file.seekg(length - 2, std::ios::cur);
+    }
+    return false;
+}
+
+
+/*
+ ordered_ingest
+ Runs decode(index) for index in [0, count) on a pool of threads. deliver(index, result) is called on the calling
+ thread in index order. At most window results are decoded ahead of delivery, which bounds memory use
+ regardless of directory size. Returning false from deliver stops the run.
+ Returns number of results delivered.
+ */
+template<typename R>
+class ordered_ingest {
+public:
+    typedef std::function<R (size_t index)> decode_fn_t;
+    typedef std::function<bool (size_t index, R& result)> deliver_fn_t;
+
+    explicit ordered_ingest (unsigned threads = 0, size_t window = 0) :
+    m_threads (threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+    m_window (window ? window : 4 * size_t(m_threads)) {}
+
+    unsigned threads () const { return m_threads; }
+    size_t window () const { return m_window; }
+
+    size_t run (size_t count, const decode_fn_t& decode, const deliver_fn_t& deliver) const {
+        if (count == 0) return 0;
+        std::vector<std::unique_ptr<R>> slots (m_window); // result of index lands in slot index % window
+        std::mutex mutex;
+        std::condition_variable produced, consumed;
+        size_t next = 0, delivered = 0;
+        bool stop = false;
+
+        auto worker = [&](){
+            while (true){
+                size_t index;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    consumed.wait(lock, [&](){ return stop || next >= count || next < delivered + m_window; });
+                    if (stop || next >= count) return;
+                    index = next++;
+                }
+                std::unique_ptr<R> result;
+                try{
+                    result.reset(new R (decode(index)));
+                }
+                catch (...){
+                    result.reset(new R ());
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    slots[index % m_window] = std::move(result);
+                }
+                produced.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        unsigned nthreads = static_cast<unsigned>(std::min(size_t(m_threads), count));
+        for (unsigned tt = 0; tt < nthreads; tt++)
+            threads.emplace_back(worker);
+
+        while (delivered < count){
+            std::unique_ptr<R> result;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                produced.wait(lock, [&](){ return bool(slots[delivered % m_window]); });
+                result = std::move(slots[delivered % m_window]);
+            }
+            bool go_on = deliver(delivered, *result);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                delivered++;
+                stop = ! go_on;
+            }
+            consumed.notify_all();
+            if (! go_on) break;
+        }
+
+        std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+        return delivered;
+    }
+
+private:
+    unsigned m_threads;
+    size_t m_window;
+};
+
+
+/*
+ thumbnail_cache
+ 8 bit BGR thumbnails, 1 / reduction of the image in each dimension. JPEGs are decoded at a reduced scale.
+ Thumbnails are kept as mappedResultCache files in folder, keyed by the image's absolute path, size and modification
+ time, so re-opening a folder only maps the cached thumbnails. Safe to use from decoder threads.
+ */
+class thumbnail_cache {
+public:
+    static const uint32_t c_version = 1;
+    static const uintmax_t c_default_budget = uintmax_t(512) << 20;
+
+    thumbnail_cache (const bfs::path& folder, int reduction = 3, uintmax_t budget = c_default_budget) :
+    m_folder (folder), m_reduction (std::max(1, reduction)), m_budget (budget), m_hits (0), m_misses (0) {
+        boost::system::error_code ec;
+        bfs::create_directories(m_folder, ec);
+    }
+
+    const bfs::path& folder () const { return m_folder; }
+    int reduction () const { return m_reduction; }
+    size_t hits () const { return m_hits; }
+    size_t misses () const { return m_misses; }
+
+    /*
+     get
+     Thumbnail of image, from the cache or decoded and added to it. Empty if image can not be decoded.
+     */
+    cv::Mat get (const bfs::path& image) const {
+        boost::system::error_code ec;
+        auto file_size = bfs::file_size(image, ec);
+        if (ec) return cv::Mat ();
+        auto mtime = bfs::last_write_time(image, ec);
+        if (ec) return cv::Mat ();
+
+        content_hasher ch;
+        const std::string name = bfs::absolute(image).string();
+        ch.update(name.data(), name.size());
+        ch.update_value(uint64_t(file_size));
+        ch.update_value(int64_t(mtime));
+        content_hasher ph;
+        ph.update_value(c_version);
+        ph.update_value(m_reduction);
+        mappedResultCache::key_t key (ch.digest(), ph.digest());
+
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key.content_hash));
+        bfs::path cache_path = m_folder / (std::string(hex) + mappedResultCache::extension());
+
+        auto cached = mappedResultCache::open<uint8_t>(cache_path, key);
+        if (cached && cached->cols() % 3 == 0){
+            m_hits++;
+            cv::Mat mapped (static_cast<int>(cached->rows()), static_cast<int>(cached->cols() / 3), CV_8UC3,
+                            const_cast<uint8_t*>(cached->data<uint8_t>()));
+            return mapped.clone();
+        }
+
+        int scale = m_reduction >= 8 ? 8 : m_reduction >= 4 ? 4 : m_reduction >= 2 ? 2 : 1;
+        int flag = scale == 8 ? cv::IMREAD_REDUCED_COLOR_8 : scale == 4 ? cv::IMREAD_REDUCED_COLOR_4 :
+        scale == 2 ? cv::IMREAD_REDUCED_COLOR_2 : cv::IMREAD_COLOR;
+        cv::Mat reduced = cv::imread(image.string(), flag);
+        if (reduced.empty()) return cv::Mat ();
+
+        iPair full;
+        if (! image_header_size(image, full))
+            full = iPair(reduced.cols * scale, reduced.rows * scale);
+        cv::Size target (std::max(1, full.x() / m_reduction), std::max(1, full.y() / m_reduction));
+        cv::Mat thumb;
+        if (reduced.size() == target) thumb = reduced;
+        else cv::resize(reduced, thumb, target, 0, 0, cv::INTER_AREA);
+        if (! thumb.isContinuous()) thumb = thumb.clone();
+
+        m_misses++;
+        mappedResultCache::store<uint8_t>(cache_path, key, thumb.rows, uint64_t(thumb.cols) * 3, thumb.ptr<uint8_t>(0));
+        return thumb;
+    }
+
+    /* Removes least recently used thumbnails until the folder is within budget */
+    uintmax_t evict () const { return mappedResultCache::evict(m_folder, m_budget); }
+
+private:
+    bfs::path m_folder;
+    int m_reduction;
+    uintmax_t m_budget;
+    mutable std::atomic<size_t> m_hits;
+    mutable std::atomic<size_t> m_misses;
+};
+
+
+#endif /* image_ingest_hpp */
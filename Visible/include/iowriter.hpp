@@ -8,8 +8,14 @@
 #ifndef iowriter_h
 #define iowriter_h
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <opencv2/imgcodecs.hpp>
 #include "timed_types.h"
 #include "core/core.hpp"
 #include "vision/histo.h"
@@ -163,4 +169,261 @@ private:
 };
 
 
+/*
+ ioWriteBehind
+ Write behind counterpart of ioImageWriter. A call queues the frames and returns; a pool of encoder threads
+ writes them. Frames are queued as shallow copies, sharing pixels with the caller's roiWindows and Mats, which
+ must not be written to until their frames are on disk. At most capacity frames are queued or being written:
+ a caller only waits when the encoders fall that far behind, which bounds memory.
+ signal_write_info is called on an encoder thread for every frame written, with true once every frame of
+ that call is written.
+ 
+ codec  png_fast        one PNG per frame, zlib level 1
+        tiff_raw        one uncompressed TIFF per frame
+        tiff_container  all frames of a call in one multi page uncompressed TIFF, image_name.tif
+ Signals ( results ) are written as csv files, one per signal, whatever the codec.
+ */
+class ioWriteBehind : public ioWriterBase
+{
+public:
+    enum class codec { png_fast, tiff_raw, tiff_container };
+    
+    typedef ioImageWriter::file_naming_fn_t file_naming_fn_t;
+    typedef ioImageWriter::writer_info_delegate writer_info_delegate;
+    typedef ioImageWriter::channel_images_t channel_images_t;
+    typedef ioImageWriter::channel_mats_t channel_mats_t;
+    
+    ioWriteBehind(codec format = codec::png_fast, unsigned threads = 0, size_t capacity = 256,
+                  const std::string& image_name = "image",
+                  const file_naming_fn_t namer = ioImageWriter::default_namer,
+                  const std::string& file_sep = "/"):
+    m_codec(format), m_capacity(std::max(size_t(1), capacity)), m_name(image_name), m_sep(file_sep), m_namer(namer),
+    m_queued(0), m_closing(false), m_written(0), m_failed(0)
+    {
+        // Signals we provide
+        signal_write_info = createSignal<ioWriteBehind::writer_info_delegate>();
+        
+        // Encoders default to half the cores, analysis keeps the rest
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+        for (unsigned tt = 0; tt < threads; tt++)
+            m_encoders.emplace_back(&ioWriteBehind::encoder, this);
+    }
+    
+    // Writes everything queued, then stops the encoders
+    ~ioWriteBehind()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closing = true;
+        }
+        m_not_empty.notify_all();
+        std::for_each(m_encoders.begin(), m_encoders.end(), std::mem_fn(&std::thread::join));
+    }
+    
+    virtual std::string getName () const { return "ioWriteBehind"; }
+    
+    codec format () const { return m_codec; }
+    size_t capacity () const { return m_capacity; }
+    unsigned threads () const { return static_cast<unsigned>(m_encoders.size()); }
+    
+    // Returns false, after signalling (0, true), if dir_fqfn is not a directory
+    bool operator()(const std::string& dir_fqfn, const channel_images_t& channel)
+    {
+        std::vector<cv::Mat> mats;
+        mats.reserve(channel.size());
+        for (const auto& rw : channel)
+            mats.emplace_back(rw.height(), rw.width(), CV_8UC(1), rw.rowPointer(0), size_t(rw.rowUpdate()));
+        return queue_frames(dir_fqfn, mats, channel);
+    }
+    
+    bool operator()(const std::string& dir_fqfn, const channel_mats_t& channel)
+    {
+        return queue_frames(dir_fqfn, channel, channel_images_t ());
+    }
+    
+    bool operator()(const std::string& dir_fqfn, const std::vector<std::vector<float>>& signals)
+    {
+        if (! is_directory(dir_fqfn)) return false;
+        if (signals.empty()) return true;
+        const std::string prefix = dir_fqfn + m_sep + m_name;
+        const uint32_t fw = field_width(signals.size());
+        auto owner = std::make_shared<batch>(signals.size());
+        for (uint32_t ii = 0; ii < signals.size(); ii++)
+        {
+            job jj;
+            jj.fqfn = prefix + m_namer(ii, fw, '0') + ".csv";
+            jj.signal = signals[ii];
+            jj.index = ii;
+            jj.owner = owner;
+            push(std::move(jj));
+        }
+        return true;
+    }
+    
+    // Blocks until every frame queued so far is written
+    void wait () const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this](){ return m_queued == 0; });
+    }
+    
+    size_t pending () const { std::lock_guard<std::mutex> lock(m_mutex); return m_queued; }
+    size_t written () const { return m_written; }
+    size_t failed () const { return m_failed; }
+    
+protected:
+    boost::signals2::signal<ioWriteBehind::writer_info_delegate>* signal_write_info;
+    
+private:
+    // Frames of one call, for the completion signal
+    struct batch
+    {
+        explicit batch (size_t frames) : total (static_cast<uint32_t>(frames)), done (0) {}
+        const uint32_t total;
+        std::atomic<uint32_t> done;
+    };
+    
+    struct job
+    {
+        std::string fqfn;
+        std::vector<cv::Mat> frames; // one frame, or all frames of a container
+        channel_images_t windows;    // owners of the pixels of frames, if any
+        std::vector<float> signal;
+        uint32_t index = 0;          // of the first frame in its call
+        std::shared_ptr<batch> owner;
+        size_t weight () const { return std::max(size_t(1), frames.size()); }
+    };
+    
+    bool is_directory (const std::string& dir_fqfn)
+    {
+        bool valid = boost::filesystem::exists(dir_fqfn) && boost::filesystem::is_directory(dir_fqfn);
+        if (! valid && signal_write_info && signal_write_info->num_slots() > 0)
+            signal_write_info->operator()(0, true);
+        return valid;
+    }
+    
+    static uint32_t field_width (size_t count) { return 1 + static_cast<uint32_t>(std::log10(count)); }
+    
+    bool queue_frames (const std::string& dir_fqfn, const std::vector<cv::Mat>& mats, const channel_images_t& windows)
+    {
+        if (! is_directory(dir_fqfn)) return false;
+        if (mats.empty()) return true;
+        const std::string prefix = dir_fqfn + m_sep + m_name;
+        auto owner = std::make_shared<batch>(mats.size());
+        if (m_codec == codec::tiff_container)
+        {
+            job jj;
+            jj.fqfn = prefix + ".tif";
+            jj.frames = mats;
+            jj.windows = windows;
+            jj.owner = owner;
+            push(std::move(jj));
+            return true;
+        }
+        const uint32_t fw = field_width(mats.size());
+        const std::string extension = m_codec == codec::png_fast ? ".png" : ".tif";
+        for (uint32_t ii = 0; ii < mats.size(); ii++)
+        {
+            job jj;
+            jj.fqfn = prefix + m_namer(ii, fw, '0') + extension;
+            jj.frames.push_back(mats[ii]);
+            if (! windows.empty()) jj.windows.push_back(windows[ii]);
+            jj.index = ii;
+            jj.owner = owner;
+            push(std::move(jj));
+        }
+        return true;
+    }
+    
+    // Waits for room unless the queue is empty, so a container larger than capacity still goes through
+    void push (job&& jj)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_full.wait(lock, [&](){ return m_queued == 0 || m_queued + jj.weight() <= m_capacity; });
+            m_queued += jj.weight();
+            m_jobs.push_back(std::move(jj));
+        }
+        m_not_empty.notify_one();
+    }
+    
+    void encoder ()
+    {
+        while (true)
+        {
+            job jj;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_not_empty.wait(lock, [this](){ return m_closing || ! m_jobs.empty(); });
+                if (m_jobs.empty()) return;
+                jj = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            
+            const bool ok = write(jj);
+            const size_t frames = jj.weight();
+            (ok ? m_written : m_failed) += frames;
+            
+            // Signal to listeners
+            if (signal_write_info && signal_write_info->num_slots() > 0)
+            {
+                for (uint32_t ff = 0; ff < frames; ff++)
+                {
+                    const uint32_t done = ++jj.owner->done;
+                    signal_write_info->operator()(int(jj.index + ff), done == jj.owner->total);
+                }
+            }
+            
+            jj = job (); // release pixels before making room
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queued -= frames;
+            }
+            m_not_full.notify_all();
+            m_idle.notify_all();
+        }
+    }
+    
+    bool write (const job& jj) const
+    {
+        if (jj.frames.empty())
+        {
+            stl_utils::save_csv(jj.signal, jj.fqfn);
+            return boost::filesystem::exists(jj.fqfn);
+        }
+        std::vector<int> params;
+        if (m_codec == codec::png_fast)
+            params = {cv::IMWRITE_PNG_COMPRESSION, 1};
+        else
+            params = {cv::IMWRITE_TIFF_COMPRESSION, 1}; // libtiff COMPRESSION_NONE
+        try
+        {
+            if (jj.frames.size() == 1) return cv::imwrite(jj.fqfn, jj.frames[0], params);
+            return cv::imwrite(jj.fqfn, jj.frames, params);
+        }
+        catch (const cv::Exception&)
+        {
+            return false;
+        }
+    }
+    
+    codec m_codec;
+    size_t m_capacity;
+    std::string m_name;
+    std::string m_sep;
+    file_naming_fn_t m_namer;
+    
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_not_empty;
+    mutable std::condition_variable m_not_full;
+    mutable std::condition_variable m_idle;
+    std::deque<job> m_jobs;
+    size_t m_queued;   // frames queued or being written
+    bool m_closing;
+    std::atomic<size_t> m_written;
+    std::atomic<size_t> m_failed;
+    std::vector<std::thread> m_encoders;
+};
+
+
 #endif /* iowriter_h */
@@ -10,6 +10,9 @@
 #include <sstream>
 #include <typeindex>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <functional>
 #include "timed_types.h"
 #include "core/signaler.h"
 #include "vision/opencv_utils.hpp"
@@ -76,7 +79,7 @@ public:
     int index () const { return m_index; }
     const std::string name () const { return m_name; }
    
-    float seconds () const { return m_length_in_seconds; }
+    float seconds () const;
     uint32_t timesteps () const { return m_timesteps; }
     uint32_t pixelsInOneTimestep () const { return m_pixelsInOneTimestep; }
     uint32_t channelCount () const { return m_channelCount; }
@@ -84,7 +87,7 @@ public:
     const std::vector<size_t>& buffer2d_dimensions () const { return m_buffer2d_dimensions; }
 //    const std::vector<lifIO::ChannelData>& channels () const { return m_channels; }
     const std::vector<std::string>& channel_names () const { return m_channel_names; }
-    const std::vector<time_spec_t>& timeSpecs () const { return  m_timeSpecs; }
+    const std::vector<time_spec_t>& timeSpecs () const;
 //    const lifIO::LifReader::weak_ref_t& readerWeakRef () const;
     const cv::Mat& poster () const { return m_poster; }
     const std::vector<cv::Rect2f>& ROIs2d () const { return m_rois_2d; }
@@ -102,11 +105,19 @@ private:
     std::vector<size_t> m_buffer2d_dimensions;
 //    std::vector<lifIO::ChannelData> m_channels;
     std::vector<std::string> m_channel_names;
-    std::vector<time_spec_t> m_timeSpecs;
     cv::Mat m_poster;
 //    mutable lifIO::LifReader::weak_ref_t m_lifWeakRef;
     
-    mutable float  m_length_in_seconds;
+    // Time specs and length are loaded on first access, so listing series does not decode their timestamps.
+    // Shared by copies as series are held by value
+    struct time_specs_t
+    {
+        std::function<void (std::vector<time_spec_t>&, float&)> load;
+        std::once_flag once;
+        std::vector<time_spec_t> specs;
+        float seconds = -1.0f;
+    };
+    std::shared_ptr<time_specs_t> m_time_specs;
     
     
     friend std::ostream& operator<< (std::ostream& out, const lif_serie_data& se)
@@ -0,0 +1,210 @@
+//
+//  movie_segments.hpp
+//  Visible
+//
+//  Concurrent movie decode.
+//
+//  The movie is split in contiguous frame ranges, one per decoder thread, each with its own cv::VideoCapture.
+//  A decoder seeks once, to the start of its range, and then reads sequentially. The backend lands on the
+//  preceding keyframe and decodes forward, so a range costs at most one extra GOP of decode. Frames are
+//  converted straight from the decoded BGR frame to a single channel roiWindow<P8U> and handed to the caller,
+//  in frame order, through bounded per range queues.
+//
+
+#ifndef movie_segments_hpp
+#define movie_segments_hpp
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+#include "vision/roiWindow.h"
+#include "core/pair.hpp"
+
+namespace bfs=boost::filesystem;
+
+
+class segmented_movie_reader {
+public:
+    typedef roiWindow<P8U> image_t;
+    typedef std::pair<int64_t, int64_t> range_t; // first, one past last
+    typedef std::function<bool (size_t index, image_t& frame)> deliver_fn_t;
+
+    // Shorter ranges are not worth a decoder and its seek
+    static const int64_t c_min_segment_frames = 64;
+
+    /*
+     segments: number of concurrent decoders, 0 for one per core
+     queue_depth: frames each decoder may run ahead of delivery
+     */
+    explicit segmented_movie_reader (const bfs::path& movie, unsigned segments = 0, size_t queue_depth = 8) :
+    m_movie (movie), m_queue_depth (std::max(size_t(1), queue_depth)), m_frame_count (0), m_frame_rate (0), m_valid (false) {
+        cv::VideoCapture cap (m_movie.string());
+        if (! cap.isOpened()) return;
+        m_frame_count = static_cast<int64_t>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+        m_frame_rate = cap.get(cv::CAP_PROP_FPS);
+        m_size = iPair(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+        m_valid = m_size.x() > 0 && m_size.y() > 0;
+        if (! m_valid) return;
+
+        // Without a frame count the movie is read in one pass to its end
+        if (m_frame_count <= 0){
+            m_ranges.emplace_back(0, std::numeric_limits<int64_t>::max());
+            return;
+        }
+        int64_t cores = segments ? segments : std::max(1u, std::thread::hardware_concurrency());
+        int64_t count = std::max(int64_t(1), std::min(cores, m_frame_count / c_min_segment_frames));
+        for (int64_t ss = 0; ss < count; ss++)
+            m_ranges.emplace_back((ss * m_frame_count) / count, ((ss + 1) * m_frame_count) / count);
+        // The reported count can be an estimate, the last range reads to the end
+        m_ranges.back().second = std::numeric_limits<int64_t>::max();
+    }
+
+    bool isValid () const { return m_valid; }
+    int64_t frame_count () const { return m_frame_count; }
+    double frame_rate () const { return m_frame_rate; }
+    const iPair& size () const { return m_size; }
+    const std::vector<range_t>& segments () const { return m_ranges; }
+
+    /*
+     run
+     Decodes all frames keeping channel ( 2 is red in OpenCV's BGR order ) and calls deliver for each, in frame
+     order, on the calling thread. Returning false from deliver stops decoding.
+     delivered is set to the number of frames delivered.
+     Returns false if the movie is not valid or a decoder failed before the end of its range. Frames past
+     the failure are not delivered.
+     */
+    bool run (const deliver_fn_t& deliver, size_t& delivered, int channel = 2) const {
+        delivered = 0;
+        if (! m_valid) return false;
+        std::vector<segment_t> segs (m_ranges.size());
+        std::mutex mutex;
+        std::condition_variable produced, consumed;
+        bool stop = false;
+
+        auto decode = [&](size_t ss){
+            auto& seg = segs[ss];
+            // Only the last range reads to the end of the movie, others have to decode all of their frames
+            const bool open_ended = m_ranges[ss].second == std::numeric_limits<int64_t>::max();
+            bool complete = false;
+            try{
+                cv::VideoCapture cap (m_movie.string());
+                if (cap.isOpened() && seek(cap, m_movie, m_ranges[ss].first)){
+                    cv::Mat frame;
+                    for (int64_t ff = m_ranges[ss].first; ; ff++){
+                        if (ff == m_ranges[ss].second) { complete = true; break; }
+                        if (! cap.read(frame) || frame.empty()) { complete = open_ended; break; }
+                        image_t rw (frame.cols, frame.rows);
+                        if (! to_channel(frame, rw, channel)) break;
+                        std::unique_lock<std::mutex> lock(mutex);
+                        consumed.wait(lock, [&](){ return stop || seg.frames.size() < m_queue_depth; });
+                        if (stop) break;
+                        seg.frames.push_back(rw);
+                        produced.notify_all();
+                    }
+                }
+            }
+            catch (...){
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            seg.done = true;
+            seg.failed = ! complete;
+            produced.notify_all();
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t ss = 0; ss < segs.size(); ss++)
+            threads.emplace_back(decode, ss);
+
+        bool failed = false;
+        for (size_t ss = 0; ss < segs.size() && ! stop; ss++){
+            auto& seg = segs[ss];
+            while (true){
+                image_t rw;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    produced.wait(lock, [&](){ return seg.done || ! seg.frames.empty(); });
+                    if (seg.frames.empty()){
+                        // A gap: later segments would be delivered at the wrong frame index
+                        if (seg.failed && ! stop) { failed = true; stop = true; }
+                        break;
+                    }
+                    rw = seg.frames.front();
+                    seg.frames.pop_front();
+                }
+                consumed.notify_all();
+                if (! deliver(delivered++, rw)){
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stop = true;
+                    break;
+                }
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        consumed.notify_all();
+        std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+        return ! failed;
+    }
+
+private:
+    struct segment_t {
+        std::deque<image_t> frames;
+        bool done = false;
+        bool failed = false;
+    };
+
+    // Positions cap so that the next read returns frame. Falls back to reading forward from the start
+    // if the backend can not seek accurately
+    static bool seek (cv::VideoCapture& cap, const bfs::path& movie, int64_t frame){
+        if (frame == 0) return true;
+        int64_t pos = -1;
+        if (cap.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(frame)))
+            pos = static_cast<int64_t>(cap.get(cv::CAP_PROP_POS_FRAMES));
+        if (pos < 0 || pos > frame){
+            cap.release();
+            if (! cap.open(movie.string())) return false;
+            pos = 0;
+        }
+        for (; pos < frame; pos++)
+            if (! cap.grab()) return false;
+        return true;
+    }
+
+    // Copies one channel of frame into rw, without an intermediate image
+    static bool to_channel (const cv::Mat& frame, image_t& rw, int channel){
+        if (frame.depth() != CV_8U) return false;
+        cv::Mat dst (rw.height(), rw.width(), CV_8UC1, rw.rowPointer(0), size_t(rw.rowUpdate()));
+        if (frame.channels() == 1){
+            frame.copyTo(dst);
+            return true;
+        }
+        if (channel < 0 || channel >= frame.channels()) return false;
+        int from_to[] = {channel, 0};
+        cv::mixChannels(&frame, 1, &dst, 1, from_to, 1);
+        return true;
+    }
+
+    bfs::path m_movie;
+    size_t m_queue_depth;
+    int64_t m_frame_count;
+    double m_frame_rate;
+    iPair m_size;
+    bool m_valid;
+    std::vector<range_t> m_ranges;
+};
+
+
+#endif /* movie_segments_hpp */
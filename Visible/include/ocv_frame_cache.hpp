@@ -10,6 +10,7 @@
 #include <functional>
 #include <map>
 #include "timestamp.h"
+#include "frame_cache.hpp"
 #include "base_signaler.h"
 #include "CinderOpenCV.h"
 #include "opencv2/highgui.hpp"
@@ -61,20 +62,21 @@ typedef std::function<SurfaceRef ()> getSurfaceCb_t;
 class qTimeFrameCache : general_movie_info, public base_signaler
 {
 public:
-    typedef std::map<time_spec_t, int64_t> timeToIndex;
-    typedef std::map<int64_t, time_spec_t> indexToTime;
-    typedef std::vector<SurTiIndexRef_t> container_t;
-    typedef typename container_t::size_type container_index_t;
+    // Default frame budget
+    static const size_t c_default_budget = size_t(1) << 30;
+    // Frame at a time stamp in seconds, null if it can not be decoded. Called on the cache's prefetch thread,
+    // so it has to read from its own source rather than the movie being played
+    typedef std::function<Surface8uRef (double secs)> decodeSurfaceCb_t;
     
-    typedef std::map<int64_t, container_index_t > indexToContainer;
-    
-    static std::shared_ptr<qTimeFrameCache> create (const ci::qtime::MovieSurfaceRef& movie);
-    static std::shared_ptr<qTimeFrameCache> create (const ci::qtime::MovieGlRef& movie);
+    static std::shared_ptr<qTimeFrameCache> create (const ci::qtime::MovieSurfaceRef& movie, const decodeSurfaceCb_t& decode = decodeSurfaceCb_t ());
+    static std::shared_ptr<qTimeFrameCache> create (const ci::qtime::MovieGlRef& movie, const decodeSurfaceCb_t& decode = decodeSurfaceCb_t ());
 
     // Initializes for the movie. Frame indices are generated for unique increasing time stamps.
     // time-stamped Frames are copied and cached at the first load. Further references to the frame
-    // by time stamp or index is from cache.
-    qTimeFrameCache ( const general_movie_info& );
+    // by time stamp or index is from cache, until least recently used frames are evicted to stay in budget bytes.
+    // With decode, evicted frames are decoded again on access and frames around the last one accessed are
+    // read ahead. Without it, evicted frames come back when they are loaded again.
+    qTimeFrameCache ( const general_movie_info&, size_t budget = c_default_budget, const decodeSurfaceCb_t& decode = decodeSurfaceCb_t () );
     bool isValid () const;
     
     general_movie_info movie_info ();
@@ -83,7 +85,7 @@ public:
 
     // Load a frame at the time stamp indicated.
     // If a frame at that time stamp is already cached, it will return false
-    // If the frame is loaded in, it will return true.
+    // If the frame is loaded in, it will return true. A frame evicted from the cache is loaded back at its index.
     bool loadFrame (const Surface8uRef frame, const time_spec_t& tic );
     
     const Surface8uRef  getFrame (const int64_t) const;
@@ -101,20 +103,11 @@ public:
 
     
 private:
-    bool loadFrame (const Surface8uRef, const index_time_t&);
-    indexToContainer::const_iterator _checkFrame (const int64_t) const;
-    indexToContainer::const_iterator _checkFrame (const time_spec_t&) const;
-    bool make_unique_increasing_time_indices (const time_spec_t&, index_time_t&);
-    mutable bool                mValid;
-    mutable container_t      mFrames;
-    mutable index_time_t     mCurrentTime;
-    timeToIndex m_tti;
-    indexToTime m_itt;
-    indexToContainer m_itIter;
-    std::vector<time_spec_t> m_time_hist;
+    // Declared before m_cache, whose prefetch thread calls it
+    decodeSurfaceCb_t m_decode;
+    // Frames by index, time stamps in a dense index to time array
+    mutable lru_frame_cache<Surface8uRef> m_cache;
     getSurfaceCb_t m_getSurface_cb;
-    mutable std::pair<uint32_t,uint32_t> m_stats;
-    mutable std::mutex			mMutex;
 };
 
 
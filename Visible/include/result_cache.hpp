@@ -0,0 +1,311 @@
+//
+//  result_cache.hpp
+//  Visible
+//
+//  Versioned, memory mappable result cache.
+//
+//  File layout:
+//      header_t ( magic, version, element size, content hash, parameter hash, dimensions )
+//      padding to a 64 byte boundary
+//      rows x cols elements ( float or double ), row major, no per element encoding
+//
+//  A cache file is only a hit if its header matches the version, element type, dimensions and the
+//  key computed from the input frames and the parameters that produced it. Files are written to a
+//  temporary file and renamed into place so readers never see a partial file. Opening a file touches
+//  its modification time, which evict() uses for LRU ordering across series cache folders.
+//
+
+#ifndef result_cache_hpp
+#define result_cache_hpp
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace bfs=boost::filesystem;
+
+
+/*
+ content_hasher
+ Streaming 64 bit hash ( MurmurHash64A mixing ) over frames and parameters.
+ Fast enough to key caches on the full content of a serie.
+ */
+class content_hasher {
+public:
+    explicit content_hasher (uint64_t seed = 0x5ca1ab1e) : m_hash(seed ^ 0x9e3779b97f4a7c15ULL), m_length(0) {}
+
+    void update (const void* data, size_t bytes){
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        const uint8_t* end = src + (bytes & ~size_t(7));
+        for (; src < end; src += 8){
+            uint64_t kk;
+            std::memcpy(&kk, src, 8);
+            mix(kk);
+        }
+        if (bytes & 7){
+            uint64_t kk = 0;
+            std::memcpy(&kk, src, bytes & 7);
+            mix(kk);
+        }
+        m_length += bytes;
+    }
+
+    template<typename T>
+    void update_value (const T& value){
+        static_assert(std::is_trivially_copyable<T>::value, "hash of non trivial type");
+        update(&value, sizeof(T));
+    }
+
+    // Image types with width(), height(), rowPointer() and a pixel_t ( roiWindow )
+    template<typename I>
+    void update_image (const I& image){
+        update_value(image.width());
+        update_value(image.height());
+        const size_t row_bytes = size_t(image.width()) * sizeof(typename I::pixel_t);
+        for (int32_t row = 0; row < image.height(); row++)
+            update(image.rowPointer(row), row_bytes);
+    }
+
+    template<typename I>
+    void update_images (const std::vector<I>& images){
+        update_value(images.size());
+        for (const auto& image : images) update_image(image);
+    }
+
+    uint64_t digest () const {
+        uint64_t hh = m_hash ^ (m_length * c_m);
+        hh ^= hh >> c_r;
+        hh *= c_m;
+        hh ^= hh >> c_r;
+        return hh;
+    }
+
+private:
+    static const uint64_t c_m = 0xc6a4a7935bd1e995ULL;
+    static const int c_r = 47;
+
+    void mix (uint64_t kk){
+        kk *= c_m;
+        kk ^= kk >> c_r;
+        kk *= c_m;
+        m_hash ^= kk;
+        m_hash *= c_m;
+    }
+
+    uint64_t m_hash;
+    uint64_t m_length;
+};
+
+
+class mappedResultCache {
+public:
+    static const uint32_t c_version = 1;
+    static const size_t c_alignment = 64;
+    static const std::string& extension () {
+        static std::string s_extension = ".vrc";
+        return s_extension;
+    }
+    // Default total size of cache files kept under the Visible cache folder
+    static const uintmax_t c_default_budget = uintmax_t(4) << 30;
+
+    struct key_t {
+        key_t (uint64_t content = 0, uint64_t params = 0) : content_hash(content), params_hash(params) {}
+        uint64_t content_hash;
+        uint64_t params_hash;
+    };
+
+    struct header_t {
+        char magic[8];
+        uint32_t version;
+        uint32_t element_size;
+        uint64_t content_hash;
+        uint64_t params_hash;
+        uint64_t rows;
+        uint64_t cols;
+        uint64_t payload_offset;
+        uint64_t payload_bytes;
+        uint64_t header_hash;
+    };
+
+    typedef std::shared_ptr<mappedResultCache> ref_t;
+
+    /*
+     open
+     Maps the cache file at filepath. Returns nullptr if the file is missing, truncated, of another
+     version or element type, or was produced from different content or parameters.
+     rows and cols are checked if non zero.
+     */
+    template<typename T>
+    static ref_t open (const bfs::path& filepath, const key_t& key, uint64_t rows = 0, uint64_t cols = 0){
+        namespace bip = boost::interprocess;
+        boost::system::error_code ec;
+        if (! bfs::exists(filepath, ec)) return ref_t();
+        auto file_size = bfs::file_size(filepath, ec);
+        if (ec || file_size < sizeof(header_t)) return ref_t();
+
+        try{
+            ref_t cache (new mappedResultCache ());
+            cache->m_file = bip::file_mapping(filepath.c_str(), bip::read_only);
+            cache->m_region = bip::mapped_region(cache->m_file, bip::read_only);
+            const header_t* hdr = static_cast<const header_t*>(cache->m_region.get_address());
+            if (! valid(*hdr, sizeof(T), file_size)) return ref_t();
+            if (hdr->content_hash != key.content_hash || hdr->params_hash != key.params_hash) return ref_t();
+            if ((rows && hdr->rows != rows) || (cols && hdr->cols != cols)) return ref_t();
+            cache->m_header = *hdr;
+            cache->m_payload = static_cast<const uint8_t*>(cache->m_region.get_address()) + hdr->payload_offset;
+
+            // Mark as recently used for eviction
+            bfs::last_write_time(filepath, std::time(nullptr), ec);
+            return cache;
+        }
+        catch (const bip::interprocess_exception&){
+            return ref_t();
+        }
+    }
+
+    /*
+     store
+     Writes rows x cols elements fetched one row at a time from row_fn
+     to a temporary file next to filepath and renames it in place.
+     */
+    template<typename T>
+    static bool store (const bfs::path& filepath, const key_t& key, uint64_t rows, uint64_t cols,
+                       const std::function<const T* (uint64_t row)>& row_fn){
+        header_t hdr;
+        std::memset(&hdr, 0, sizeof(hdr));
+        std::memcpy(hdr.magic, magic(), sizeof(hdr.magic));
+        hdr.version = c_version;
+        hdr.element_size = sizeof(T);
+        hdr.content_hash = key.content_hash;
+        hdr.params_hash = key.params_hash;
+        hdr.rows = rows;
+        hdr.cols = cols;
+        hdr.payload_offset = ((sizeof(header_t) + c_alignment - 1) / c_alignment) * c_alignment;
+        hdr.payload_bytes = rows * cols * sizeof(T);
+        hdr.header_hash = header_hash(hdr);
+
+        boost::system::error_code ec;
+        bfs::path temp_path = filepath;
+        temp_path += bfs::unique_path(".%%%%-%%%%.tmp", ec);
+        if (ec) return false;
+
+        bool ok = false;
+        {
+            std::ofstream file(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+            if (file){
+                static const char zeros[c_alignment] = {0};
+                file.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+                file.write(zeros, hdr.payload_offset - sizeof(hdr));
+                for (uint64_t row = 0; row < rows && file; row++)
+                    file.write(reinterpret_cast<const char*>(row_fn(row)), cols * sizeof(T));
+                file.flush();
+                ok = bool(file);
+            }
+        }
+        if (ok){
+            bfs::rename(temp_path, filepath, ec);
+            ok = ! ec;
+        }
+        if (! ok) bfs::remove(temp_path, ec);
+        return ok;
+    }
+
+    template<typename T>
+    static bool store (const bfs::path& filepath, const key_t& key, uint64_t rows, uint64_t cols, const T* data){
+        return store<T>(filepath, key, rows, cols, [data, cols](uint64_t row){ return data + row * cols; });
+    }
+
+    /*
+     evict
+     Removes least recently used cache files found under root ( i.e. across all series cache folders )
+     until their total size is within budget. Leftover temporary files are removed as well.
+     Returns number of bytes removed.
+     */
+    static uintmax_t evict (const bfs::path& root, uintmax_t budget = c_default_budget){
+        struct entry_t { bfs::path path; uintmax_t size; std::time_t time; };
+        std::vector<entry_t> entries;
+        uintmax_t total = 0, removed = 0;
+        boost::system::error_code ec;
+        if (! bfs::is_directory(root, ec)) return 0;
+
+        for (bfs::recursive_directory_iterator it (root, ec), end; it != end; it.increment(ec)){
+            if (ec) break;
+            if (! bfs::is_regular_file(it->path(), ec)) continue;
+            const std::string& ext = it->path().extension().string();
+            if (ext == ".tmp" && it->path().filename().string().find(extension() + ".") != std::string::npos){
+                auto size = bfs::file_size(it->path(), ec);
+                if (! ec && std::difftime(std::time(nullptr), bfs::last_write_time(it->path(), ec)) > 3600 && bfs::remove(it->path(), ec))
+                    removed += size;
+                continue;
+            }
+            if (ext != extension()) continue;
+            entry_t entry { it->path(), bfs::file_size(it->path(), ec), bfs::last_write_time(it->path(), ec) };
+            if (ec) continue;
+            total += entry.size;
+            entries.push_back(entry);
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const entry_t& a, const entry_t& b){ return a.time < b.time; });
+        for (const auto& entry : entries){
+            if (total <= budget) break;
+            if (bfs::remove(entry.path, ec)){
+                total -= entry.size;
+                removed += entry.size;
+            }
+        }
+        return removed;
+    }
+
+    uint64_t rows () const { return m_header.rows; }
+    uint64_t cols () const { return m_header.cols; }
+    const key_t key () const { return key_t(m_header.content_hash, m_header.params_hash); }
+
+    // Typed views into the mapped payload. Valid while this object is alive
+    template<typename T>
+    const T* data () const {
+        assert(sizeof(T) == m_header.element_size);
+        return reinterpret_cast<const T*>(m_payload);
+    }
+    template<typename T>
+    const T* row (uint64_t rr) const { return data<T>() + rr * m_header.cols; }
+
+private:
+    mappedResultCache () : m_payload(nullptr) { std::memset(&m_header, 0, sizeof(m_header)); }
+
+    static const char* magic () { return "VISRCACH"; }
+
+    static uint64_t header_hash (const header_t& hdr){
+        content_hasher hh;
+        hh.update(&hdr, offsetof(header_t, header_hash));
+        return hh.digest();
+    }
+
+    static bool valid (const header_t& hdr, size_t element_size, uintmax_t file_size){
+        if (std::memcmp(hdr.magic, magic(), sizeof(hdr.magic)) != 0) return false;
+        if (hdr.version != c_version || hdr.element_size != element_size) return false;
+        if (hdr.header_hash != header_hash(hdr)) return false;
+        if (hdr.payload_offset % c_alignment != 0) return false;
+        if (hdr.payload_bytes != hdr.rows * hdr.cols * element_size) return false;
+        return hdr.payload_offset + hdr.payload_bytes <= file_size;
+    }
+
+    header_t m_header;
+    boost::interprocess::file_mapping m_file;
+    boost::interprocess::mapped_region m_region;
+    const uint8_t* m_payload;
+};
+
+
+#endif /* result_cache_hpp */
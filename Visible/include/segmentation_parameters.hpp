@@ -12,22 +12,36 @@
 
 class fynSegmenter{
 public:
+    // Per voxel temporal signal used to build the segmentation surface
+    enum class voxel_feature : int {
+        self_similarity = 0,
+        permutation_entropy = 1,
+        dominant_power = 2
+    };
+    
     class params{
     public:
         params ():m_voxel_sample(3,3), m_min_segmentation_area(1000),
-            m_half(m_voxel_sample.first / 2,m_voxel_sample.second / 2) {}
+            m_half(m_voxel_sample.first / 2,m_voxel_sample.second / 2),
+            m_feature(voxel_feature::self_similarity), m_permutation_order(4) {}
         
         const std::pair<uint32_t,uint32_t>& voxel_sample ()const {return m_voxel_sample; }
         const std::pair<uint32_t,uint32_t>& voxel_sample_half ()const { return m_half; }
         const iPair& expected_segmented_size () const{return m_expected_segmented_size; }
         const uint32_t& min_segmentation_area ()const {return m_min_segmentation_area; }
         
+        voxel_feature feature () const { return m_feature; }
+        void feature (voxel_feature ff) { m_feature = ff; }
+        int permutation_order () const { return m_permutation_order; }
+        void permutation_order (int order) { m_permutation_order = order; }
 
     private:
         std::pair<uint32_t,uint32_t> m_voxel_sample;
         std::pair<uint32_t,uint32_t> m_half;
         iPair m_expected_segmented_size;
         uint32_t m_min_segmentation_area;
+        voxel_feature m_feature;
+        int m_permutation_order;
     };
     
 private:
@@ -57,7 +57,6 @@ public:
         m_source_type = Unknown;
     }
     
- //   bool load_content_file (const std::string& movie_fqfn);
     int loadImageDirectory (const std::string& image_dir, sm_producer::sizeMappingOption szmap,
                             const std::vector<std::string>& supported_extensions = { ".jpg", ".png", ".JPG", ".jpeg"});
     
@@ -64,7 +64,7 @@ public:
     public:
 
         params (const TypeDesc ct = TypeUInt8, const voxel_params_t voxel_params = voxel_params_t()):
-		m_type(ct), m_vparams(voxel_params), m_channel_to_use(0), m_channel_root(-1,m_channel_to_use){}
+		m_type(ct), m_vparams(voxel_params), m_channel_to_use(0), m_channel_root(-1,m_channel_to_use), m_temporal_rank_window(1){}
         
         const TypeDesc& content_type () { return m_type; }
         
@@ -72,6 +72,13 @@ public:
         const std::pair<uint32_t,uint32_t>& voxel_pad () const {return m_vparams.voxel_sample_half(); }
         const iPair& expected_segmented_size () {return m_vparams.expected_segmented_size(); }
         const uint32_t& min_seqmentation_area () {return m_vparams.min_segmentation_area(); }
+        fynSegmenter::voxel_feature voxel_feature () const { return m_vparams.feature(); }
+        void voxel_feature (fynSegmenter::voxel_feature ff) const { m_vparams.feature(ff); }
+        int permutation_order () const { return m_vparams.permutation_order(); }
+        void permutation_order (int order) const { m_vparams.permutation_order(order); }
+        // Frames in the temporal median applied to a channel before volume stats and voxel processing, 1 for none
+        unsigned temporal_rank_window () const { return m_temporal_rank_window; }
+        void temporal_rank_window (unsigned window) const { m_temporal_rank_window = window; }
         
         const std::string& image_cache_name () {
             static std::string s_image_cache_name = "voxel_ss_.png";
@@ -102,6 +109,7 @@ public:
         mutable TypeDesc m_type;
 		mutable int m_channel_to_use;
 		mutable result_index_channel_t m_channel_root;
+		mutable unsigned m_temporal_rank_window;
 		
     };
     
@@ -191,6 +199,8 @@ public:
 //    void generateVoxelsOfSampled (const std::vector<roiWindow<P8U>>&);
 //
     void generateVoxelsAndSelfSimilarities (const std::vector<roiWindow<P8U>>& images);
+    // Alternative to voxel self-similarity selected by params::voxel_feature
+    void generateVoxelFeatures (const std::vector<roiWindow<P8U>>& images);
     
     void finalize_segmentation (cv::Mat& mono, cv::Mat& label);
     const channel_vec_t& content () const;
@@ -229,6 +239,9 @@ private:
     // Internal use
     // Vector of 8bit roiWindows API for IDLab custom organization
     svl::stats<int64_t> run_volume_stats (std::vector<roiWindow<P8U>>&);
+    // Frames of a channel, temporal median filtered once if params::temporal_rank_window() is above 1.
+    // Returned by value, so a later call filtering again does not change the frames a caller holds
+    std::shared_ptr<channel_images_t> staged_channel (const int channel_index);
     void internal_find_moving_regions (std::vector<roiWindow<P8U>>& );
     
     
@@ -257,7 +270,7 @@ private:
     void sm_content_loaded ();
     void signal_geometry_done (int, const result_index_channel_t&);
     
-//    std::shared_ptr<ioImageWriter>& get_image_writer ();
+//    std::shared_ptr<ioWriteBehind>& get_image_writer ();
 //    std::shared_ptr<ioImageWriter>& get_csv_writer ();
 //    int save_channel_images (const input_section_selector_t& in,  const std::string& dir_fqfn);
 
@@ -299,16 +312,25 @@ private:
     
     channel_images_t m_images;
     channel_vec_t m_all_by_channel;
+    // Temporal rank filtered channels, with the filter window and rank they were produced with
+    struct rank_filtered_t {
+        unsigned window = 0;
+        int rank = -1;
+        std::shared_ptr<channel_images_t> frames;
+    };
+    std::map<int, rank_filtered_t> m_rank_filtered;
     
     int64_t m_frameCount;
     Rectf m_measured_area;
     Rectf m_all;
     
-    std::shared_ptr<ioImageWriter> m_image_writer;
+    std::shared_ptr<ioWriteBehind> m_image_writer;
     std::shared_ptr<ioImageWriter> m_csv_writer;
     
     
     mutable svl::stats<int64_t> m_volume_stats;
+    // Fused volume pass of the last run_volume_stats, matched to frames by content hash
+    std::shared_ptr<VolumeAccumulator> m_volume;
     std::atomic<bool> m_variance_peak_detection_done;
     mutable cv::Mat m_temporal_ss;
     mutable cv::Mat m_var_image;
@@ -377,6 +399,7 @@ private:
     ssmt_result (const moving_region&,const result_index_channel_t& in);
     void signal_sm1d_ready (vector<float>&, const result_index_channel_t&);
     void contraction_ready (contractionLocator::contractionContainer_t& contractions, const result_index_channel_t&);
+    void leveled_settled (const std::vector<float>& leveled, const result_index_channel_t&, const uint32_t&, const float&);
     bool get_channels (int channel) const ;
     result_index_channel_t m_input;
     
@@ -384,6 +407,9 @@ private:
     std::vector<std::vector<double>> m_smat;
     
     std::shared_ptr<contractionLocator> m_caRef;
+	// Guards m_caRef, used by process() and on the settle thread of the processor's leveler
+	std::mutex m_locator_mutex;
+	boost::signals2::scoped_connection m_settle_connection;
 	medianLevelSet m_leveler;
     
     mutable std::vector<cv::Mat> m_affine_windows;
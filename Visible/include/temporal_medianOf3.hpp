@@ -16,7 +16,7 @@
  ((a) > (b) ? ((a) < (c) ? (a) : ((b) < (c) ? (c) : (b))) :    \
  ((a) > (c) ? (a) : ((b) < (c) ? (b) : (c))))
 */
-// @todo can easily made a template function using cv::Mat_
+// Whole volumes of roiWindows: svl::temporalRankFilter in vision/temporal_rank.hpp
 inline bool temporal_medianOf3 (const cv::Mat& _a, const cv::Mat& _b, const cv::Mat& _c, cv::Mat& dst){
 
     
@@ -27,17 +27,12 @@ inline bool temporal_medianOf3 (const cv::Mat& _a, const cv::Mat& _b, const cv::
     if (dst.empty())
         dst = Mat::zeros(_a.rows,_a.cols, CV_8U);
     
-    auto A = _a > _b;
-    auto B = _a < _c;
-    auto C = _b < _c;
-
-
-    _a.copyTo(dst, A & B);
-    _c.copyTo(dst, A & ~B & C);
-    _b.copyTo(dst,  A & ~B & ~C);
-    _a.copyTo(dst, ~A & ~B);
-    _b.copyTo(dst, ~A & B & C);
-    _c.copyTo(dst,  ~A & B & ~C);
+    // Branch free: max( min(a,b), min( max(a,b), c ) ), four full frame passes
+    cv::Mat lo, hi;
+    cv::min(_a, _b, lo);
+    cv::max(_a, _b, hi);
+    cv::min(hi, _c, hi);
+    cv::max(lo, hi, dst);
     
     return true;
 }
@@ -29,6 +29,7 @@
 #include "vision/histo.h"
 #undef float16_t
 #include "vision/opencv_utils.hpp"
+#include "vision/translation_tracker.hpp"
 #include "ssmt.hpp"
 #include "logger/logger.hpp"
 #include "result_serialization.h"
@@ -43,7 +44,10 @@ const Rectf& ssmt_processor::measuredArea () const { return m_measured_area; }
 
 void ssmt_processor::internal_find_moving_regions (std::vector<roiWindow<P8U>>& images){
     std::lock_guard<std::mutex> lock(m_mutex);
-    generateVoxelsAndSelfSimilarities (images);
+    if (m_params.voxel_feature() == fynSegmenter::voxel_feature::self_similarity)
+        generateVoxelsAndSelfSimilarities (images);
+    else
+        generateVoxelFeatures (images);
 
 }
 
@@ -53,7 +57,7 @@ void ssmt_processor::find_moving_regions (const int channel_index){
 //    volume_variance_peak_promotion(m_all_by_channel[channel_index]);
 //    while(!m_variance_peak_detection_done){ std::this_thread::yield();}
     m_instant_input = result_index_channel_t(-1, channel_index);
-    return internal_find_moving_regions(m_all_by_channel[channel_index]);
+    return internal_find_moving_regions(*staged_channel(channel_index));
 }
 
 
@@ -197,9 +201,7 @@ void ssmt_processor::internal_generate_affine_windows (const std::vector<roiWind
     vector<roiWindow<P8U> >::const_iterator vitr = rws.begin();
     do
     {
-        cv::Mat affine = affineCrop(vitr, m_motion_mass);
-        auto clone = affine.clone();
-        m_affine_windows.push_back(clone);
+        m_affine_windows.push_back(affineCrop(vitr, m_motion_mass));
         count++;
     }
     while (++vitr != rws.end());
@@ -231,7 +233,7 @@ void ssmt_processor::save_affine_windows (){
             }
         } // tried creatring it if was not already
         if(bfs::exists(save_path)){
-            std::lock_guard<std::mutex> process_lock(m_io_mutex);
+            // Queued, written behind by the writer's encoders
             auto writer = get_image_writer();
             writer->operator()(save_path.string(), m_affine_windows);
         }
@@ -243,42 +245,10 @@ void ssmt_processor::save_affine_windows (){
 void ssmt_processor::internal_generate_affine_translations (){
     if(m_affine_windows.empty()) return;
     
-    auto trans = [] (const cv::Mat& minus, const cv::Mat& plus){
-        auto tw = minus.cols / 3;
-        auto th = minus.rows / 3;
-        auto width = minus.cols;
-        auto height = minus.rows;
-        auto cw = (width - tw)/2;
-        auto ch = (height-th)/2;
-        auto left = cv::Mat(minus, cv::Rect(tw,ch,tw,th));
-        auto right = cv::Mat(minus, cv::Rect(cw,ch,tw,th));
-        auto plus_left = cv::Mat(plus, cv::Rect(0,0,plus.cols/2, plus.rows));
-        auto plus_right = cv::Mat(plus, cv::Rect(plus.cols/2,0,plus.cols/2, plus.rows));
-        
-        cv::Mat norm_xcorr_img;
-        std::pair<cv::Point,cv::Point> max_loc;
-        dPair max_val;
-        cv::matchTemplate(plus_left,left, norm_xcorr_img, cv::TM_CCORR_NORMED, left);
-        cv::minMaxLoc(norm_xcorr_img, NULL, &max_val.first, NULL, &max_loc.first);
-        cv::matchTemplate(plus_right,right, norm_xcorr_img, cv::TM_CCORR_NORMED, right);
-        cv::minMaxLoc(norm_xcorr_img, NULL, &max_val.second, NULL, &max_loc.second);
-        fVector_2d lv(max_loc.first.x,max_loc.first.y);
-        fVector_2d rv(max_loc.second.x+plus.cols/2.0f,max_loc.second.y);
-        return lv.distance(rv);
-    };
-    
-    std::vector<float> translations;
-    auto d0 = trans(m_affine_windows[0],m_affine_windows[0]);
-    translations.push_back(static_cast<float>(d0));
-    auto iter = m_affine_windows.begin();
-    while (++iter < m_affine_windows.end()){
-        auto tt = trans(*iter,*(iter-1));
-        translations.push_back(static_cast<float>(tt));
-    }
-    assert(translations.size() == m_affine_windows.size());
-    m_affine_translations = translations;
-    m_affine_translations[0] = m_affine_translations[1];
-    
+    // Pairs of consecutive windows are tracked in parallel, to sub pixel
+    svl::translationTracker tracker;
+    m_affine_translations = tracker.lengths(m_affine_windows);
+    assert(m_affine_translations.size() == m_affine_windows.size());
 }
 void ssmt_processor::internal_generate_affine_profiles(){
     
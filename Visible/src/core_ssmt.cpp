@@ -30,9 +30,11 @@
 #include "sm_producer.h"
 #include "vision/histo.h"
 #include "vision/opencv_utils.hpp"
+#include "vision/temporal_rank.hpp"
 #include "ssmt.hpp"
 #include "logger/logger.hpp"
 #include "result_serialization.h"
+#include "result_cache.hpp"
 
 
 /**
@@ -44,6 +46,7 @@
 ssmt_processor::ssmt_processor (const mediaSpec& ms, const bfs::path& serie_cache_folder,  const ssmt_processor::params& params):
 mCurrentCachePath(serie_cache_folder), m_params(params), m_media_spec(ms)
 {
+    
     // Signals we provide
     signal_content_loaded = createSignal<ssmt_processor::sig_cb_content_loaded>();
     intensity_over_time_ready = createSignal<ssmt_processor::sig_intensity_over_time_ready>();
@@ -202,6 +205,7 @@ void ssmt_processor::internal_load_channels_from_lif_buffer2d (const std::shared
 {
     m_frameCount = 0;
     m_all_by_channel.clear();
+    m_rank_filtered.clear();
     m_channel_count = mspec.getSectionCount();
     m_all_by_channel.resize (m_channel_count);
     
@@ -214,8 +218,7 @@ void ssmt_processor::internal_load_channels_from_lif_buffer2d (const std::shared
             for (auto ii = 0; ii < nsubs; ii++){
                 auto cvb = getRootFrame(frames, contentName, ii);
                 assert(cvb.type() == CV_8U);
-                roiWindow<P8U> r8;
-                cpCvMatToRoiWindow8U (cvb, r8);
+                roiWindow<P8U> r8 = adoptCvMat8U (cvb);
                 
                 for (auto cc = 0; cc < mspec.getSectionCount(); cc++){
                     auto tl_f_x = mspec.getROIxRanges()[cc][0];
@@ -231,8 +234,7 @@ void ssmt_processor::internal_load_channels_from_lif_buffer2d (const std::shared
                 assert(cvb.type() == CV_16U);
                 cv::Mat cvb8 (cvb.rows, cvb.cols, CV_8U);
                 cv::normalize(cvb, cvb8, 0, 255, NORM_MINMAX, CV_8UC1);
-                roiWindow<P8U> r8;
-                cpCvMatToRoiWindow8U (cvb8, r8);
+                roiWindow<P8U> r8 = adoptCvMat8U (cvb8);
                 
                 for (auto cc = 0; cc < mspec.getSectionCount(); cc++){
                     auto tl_f_x = mspec.getROIxRanges()[cc][0];
@@ -255,14 +257,12 @@ void ssmt_processor::internal_load_channels_from_lif_buffer2d (const std::shared
 svl::stats<int64_t> ssmt_processor::run_volume_stats (std::vector<roiWindow<P8U>>& images){
     std::lock_guard<std::mutex> lock(m_mutex);
     
-    std::vector<std::tuple<int64_t,int64_t,uint32_t>> cts;
-    std::vector<std::tuple<uint8_t,uint8_t>> rts;
-    std::vector<std::thread> threads(1);
-    threads[0] = std::thread(IntensityStatisticsPartialRunner(),std::ref(images), std::ref(cts), std::ref(rts));
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
-    auto res = std::accumulate(cts.begin(), cts.end(), std::make_tuple(int64_t(0),int64_t(0), uint32_t(0)), stl_utils::tuple_sum<int64_t,uint32_t>());
-    auto mes = std::accumulate(rts.begin(), rts.end(), std::make_tuple(uint8_t(255),uint8_t(0)), stl_utils::tuple_minmax<uint8_t, uint8_t>());
-    m_volume_stats = svl::stats<int64_t> (std::get<0>(res), std::get<1>(res), std::get<2>(res), int64_t(std::get<0>(mes)), int64_t(std::get<1>(mes)));
+    // One pass for volume stats, per pixel sums and the voxel lattice
+    auto volume = std::make_shared<VolumeAccumulator>();
+    volume->lattice(m_voxel_sample);
+    (*volume)(images);
+    m_volume = volume;
+    m_volume_stats = volume->volume_stats();
     
     // Signal to listeners
     if (signal_volume_ready && signal_volume_ready->num_slots() > 0)
@@ -273,7 +273,34 @@ svl::stats<int64_t> ssmt_processor::run_volume_stats (std::vector<roiWindow<P8U>
 
 
 svl::stats<int64_t> ssmt_processor::run_volume_stats (const int channel_index){
-    return run_volume_stats(m_all_by_channel[channel_index]);
+    return run_volume_stats(*staged_channel(channel_index));
+}
+
+/*
+ * Optional pre-stage: temporal median of each pixel over params::temporal_rank_window() frames
+ * The filtered channel is kept, so volume stats and voxel processing run on, and share, the same frames
+ */
+std::shared_ptr<ssmt_processor::channel_images_t> ssmt_processor::staged_channel (const int channel_index){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto& frames = m_all_by_channel[channel_index];
+    svl::temporalRankFilter filter (m_params.temporal_rank_window());
+    // roiWindows share their pixels, the copy is of the vector only
+    if (filter.window() <= 1 || ! filter.isValid()) return std::make_shared<channel_images_t>(frames);
+    // Reused only if filtered with the current window and rank
+    auto found = m_rank_filtered.find(channel_index);
+    if (found != m_rank_filtered.end() && found->second.window == filter.window() && found->second.rank == filter.rank() &&
+        found->second.frames->size() == frames.size()) return found->second.frames;
+    // Filtered into new frames, callers holding the previous ones keep them
+    auto filtered = std::make_shared<channel_images_t>();
+    if (! filter.process(frames, *filtered)){
+        m_rank_filtered.erase(channel_index);
+        return std::make_shared<channel_images_t>(frames);
+    }
+    rank_filtered_t& entry = m_rank_filtered[channel_index];
+    entry.window = filter.window();
+    entry.rank = filter.rank();
+    entry.frames = filtered;
+    return filtered;
 }
 
 
@@ -319,16 +346,30 @@ void ssmt_processor::internal_run_selfsimilarity_on_selected_input (const std::v
                                                                     const result_index_channel_t& in,
                                                                     const progress_fn_t& reporter)
 {
-    bool cache_ok = false;
     size_t dim = images.size();
     std::string ss = " internal run ss started " + toString(in.region());
     vlogger::instance().console()->info(ss);
-    std::shared_ptr<ssResultContainer> ssref;
+    
+    // Cache is keyed on the content of the frames and the input they were selected for
+    content_hasher chash, phash;
+    chash.update_images(images);
+    phash.update_value(dim);
+    phash.update_value(in.section());
+    phash.update_value(in.region());
+    mappedResultCache::key_t key (chash.digest(), phash.digest());
     auto cache_path = get_cache_location(in.section(), in.region());
-    if(bfs::exists(cache_path)){
-        ssref = ssResultContainer::create(cache_path);
-    }
-    cache_ok = ssref && ssref->size_check(dim);
+    // An empty location ( bad channel or region ) would otherwise resolve to a file in the working directory
+    bool cache_usable = ! cache_path.empty() && bfs::exists(cache_path.parent_path());
+    if (cache_usable)
+        cache_path += mappedResultCache::extension();
+    else
+        vlogger::instance().console()->info(" SS result container cache : no cache location ");
+    
+    // Layout: row 0 holds the entropies, rows 1 ... dim the similarity matrix
+    mappedResultCache::ref_t ssref;
+    if (cache_usable)
+        ssref = mappedResultCache::open<double>(cache_path, key, dim + 1, dim);
+    bool cache_ok = ssref != nullptr;
     
     // Create a contraction object for entire view processing.
     // @todo: add params
@@ -338,12 +379,12 @@ void ssmt_processor::internal_run_selfsimilarity_on_selected_input (const std::v
     
     if(cache_ok){
         vlogger::instance().console()->info(" SS result container cache : Hit ");
-		m_entropies.insert(m_entropies.end(), ssref->entropies().begin(), ssref->entropies().end());
-		for (auto row : ssref->smatrix()){
-			vector<double> rowv;
-			rowv.insert(rowv.end(), row.begin(), row.end());
-			m_smat.push_back(rowv);
+		m_entropies.insert(m_entropies.end(), ssref->row<double>(0), ssref->row<double>(0) + dim);
+		for (auto rr = 0; rr < dim; rr++){
+			const double* row = ssref->row<double>(rr + 1);
+			m_smat.emplace_back(row, row + dim);
 		}
+        ssref.reset();
     }else{
         auto sp =  similarity_producer();
         sp->load_images (images);
@@ -362,11 +403,19 @@ void ssmt_processor::internal_run_selfsimilarity_on_selected_input (const std::v
     m_entropies_F.insert(m_entropies_F.end(), m_entropies.begin(), m_entropies.end());
 	m_leveler.load(m_entropies, m_smat);
 	
-	bool ok = ssResultContainer::store(cache_path,m_entropies , m_smat );
-	if(ok)
-		vlogger::instance().console()->info(" SS result container cache : filled ");
-	else
-		vlogger::instance().console()->info(" SS result container cache : failed ");
+	bool complete = m_entropies.size() == dim && m_smat.size() == dim &&
+		std::all_of(m_smat.begin(), m_smat.end(), [dim](const vector<double>& row){ return row.size() == dim; });
+	if (cache_usable && ! cache_ok && complete){
+		bool ok = mappedResultCache::store<double>(cache_path, key, dim + 1, dim, [this](uint64_t row){
+			return row == 0 ? m_entropies.data() : m_smat[row - 1].data(); });
+		if(ok){
+			vlogger::instance().console()->info(" SS result container cache : filled ");
+			if (bfs::exists(mCurrentCachePath))
+				mappedResultCache::evict(mCurrentCachePath.parent_path());
+		}
+		else
+			vlogger::instance().console()->info(" SS result container cache : failed ");
+	}
 	
     assert(images.size() == m_entropies.size() && m_smat.size() == images.size());
     for (auto row : m_smat) assert(row.size() == images.size());
@@ -405,11 +454,20 @@ void ssmt_processor::volume_variance_peak_promotion (std::vector<roiWindow<P8U>>
     
     cv::Mat m_sum, m_sqsum;
     int image_count = 0;
-    std::vector<std::thread> threads(1);
-    threads[0] = std::thread(SequenceAccumulator(),std::ref(images),
-                             std::ref(m_sum), std::ref(m_sqsum), std::ref(image_count), std::ref(m_variance_peak_detection_done));
-    
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+    // Reuse per pixel sums of run_volume_stats on the same frames if available
+    if (m_volume && m_volume->frame_count() == images.size() &&
+        m_volume->content_hash() == VolumeAccumulator::content_hash(images)){
+        m_volume->sums(m_sum, m_sqsum);
+        image_count = static_cast<int>(images.size());
+        m_variance_peak_detection_done = true;
+    }
+    else{
+        std::vector<std::thread> threads(1);
+        threads[0] = std::thread(SequenceAccumulator(),std::ref(images),
+                                 std::ref(m_sum), std::ref(m_sqsum), std::ref(image_count), std::ref(m_variance_peak_detection_done));
+        
+        std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+    }
     SequenceAccumulator::computeStdev(m_sum, m_sqsum, image_count, m_var_image);
     /*
      * Save Only local maximas in the var field
@@ -497,9 +555,9 @@ const ssmt_processor::channel_vec_t& ssmt_processor::content () const{
 
 #ifdef notYet
 
-std::shared_ptr<ioImageWriter>& ssmt_processor::get_image_writer (){
+std::shared_ptr<ioWriteBehind>& ssmt_processor::get_image_writer (){
     if (! m_image_writer){
-        m_image_writer = std::make_shared<ioImageWriter>();
+        m_image_writer = std::make_shared<ioWriteBehind>();
     }
     return m_image_writer;
 }
@@ -1,4 +1,7 @@
 #include "dbscan.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
 
 int DBSCAN::run()
 {
@@ -99,3 +102,178 @@ const DBSCAN::dbHist_t& DBSCAN::cluster_hist (){
     }
     return m_hist;
 }
+
+
+/*
+ gridDBSCAN
+*/
+
+gridDBSCAN::gridDBSCAN(unsigned int minPts, float eps, vector<Point> points, unsigned int threads)
+: m_points(std::move(points)), m_minPoints(minPts), m_epsilon(eps), m_threads(threads)
+{
+    // epsilon is a squared distance. Any cell size at least the search radius keeps all neighbours
+    // within the 3x3x3 block of cells around a point.
+    m_cell_size = m_epsilon > 0 ? std::sqrt(double(m_epsilon)) : 1.0;
+    if (m_threads == 0) m_threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+gridDBSCAN::cell_t gridDBSCAN::cell_of (const Point& pt) const {
+    return cell_t(int64_t(std::floor(pt.x / m_cell_size)),
+                  int64_t(std::floor(pt.y / m_cell_size)),
+                  int64_t(std::floor(pt.z / m_cell_size)));
+}
+
+void gridDBSCAN::build_grid (){
+    const int count = static_cast<int>(m_points.size());
+    vector<cell_t> keys (count);
+    for (int ii = 0; ii < count; ii++) keys[ii] = cell_of(m_points[ii]);
+    
+    m_order.resize(count);
+    for (int ii = 0; ii < count; ii++) m_order[ii] = ii;
+    std::stable_sort(m_order.begin(), m_order.end(), [&keys](int a, int b){ return keys[a] < keys[b]; });
+    
+    m_cells.clear();
+    m_cell_ranges.clear();
+    for (int ii = 0; ii < count; ){
+        int jj = ii + 1;
+        while (jj < count && keys[m_order[jj]] == keys[m_order[ii]]) jj++;
+        m_cells.push_back(keys[m_order[ii]]);
+        m_cell_ranges.emplace_back(ii, jj);
+        ii = jj;
+    }
+}
+
+template<typename F>
+void gridDBSCAN::for_each_neighbour (int index, F&& func) const {
+    const Point& pt = m_points[index];
+    const cell_t cc = cell_of(pt);
+    for (int64_t dz = -1; dz <= 1; dz++)
+        for (int64_t dy = -1; dy <= 1; dy++)
+            for (int64_t dx = -1; dx <= 1; dx++){
+                cell_t nc (std::get<0>(cc) + dx, std::get<1>(cc) + dy, std::get<2>(cc) + dz);
+                auto cell = std::lower_bound(m_cells.begin(), m_cells.end(), nc);
+                if (cell == m_cells.end() || *cell != nc) continue;
+                const auto& range = m_cell_ranges[std::distance(m_cells.begin(), cell)];
+                for (int kk = range.first; kk < range.second; kk++){
+                    const Point& other = m_points[m_order[kk]];
+                    // Same arithmetic as DBSCAN::calculateDistance
+                    double ddx = pt.x - other.x;
+                    double ddy = pt.y - other.y;
+                    double ddz = pt.z - other.z;
+                    if (ddx * ddx + ddy * ddy + ddz * ddz <= m_epsilon)
+                        func(m_order[kk]);
+                }
+            }
+}
+
+template<typename F>
+void gridDBSCAN::parallel_range (size_t count, F&& func) const {
+    const size_t nthreads = std::min(size_t(m_threads), std::max(size_t(1), count));
+    if (nthreads <= 1){
+        for (size_t ii = 0; ii < count; ii++) func(ii);
+        return;
+    }
+    std::atomic<size_t> next (0);
+    const size_t grain = 256;
+    std::vector<std::thread> threads;
+    for (size_t tt = 0; tt < nthreads; tt++)
+        threads.emplace_back([&](){
+            for (size_t start = next.fetch_add(grain); start < count; start = next.fetch_add(grain)){
+                size_t end = std::min(count, start + grain);
+                for (size_t ii = start; ii < end; ii++) func(ii);
+            }
+        });
+    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+}
+
+// Roots always point to the smallest index in their set, so the root of a cluster is its first core point
+int gridDBSCAN::find (int index) const {
+    int parent = m_parent[index].load(std::memory_order_relaxed);
+    while (parent != index){
+        int grand = m_parent[parent].load(std::memory_order_relaxed);
+        if (grand != parent) m_parent[index].compare_exchange_weak(parent, grand, std::memory_order_relaxed);
+        index = parent;
+        parent = m_parent[index].load(std::memory_order_relaxed);
+    }
+    return index;
+}
+
+void gridDBSCAN::unite (int a, int b){
+    while (true){
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (a < b) std::swap(a, b);
+        // Link the larger root under the smaller one. Retry if a got linked meanwhile
+        int expected = a;
+        if (m_parent[a].compare_exchange_strong(expected, b)) return;
+    }
+}
+
+vector<int> gridDBSCAN::calculateCluster(int index) const {
+    vector<int> clusterIndex;
+    for_each_neighbour(index, [&clusterIndex](int other){ clusterIndex.push_back(other); });
+    std::sort(clusterIndex.begin(), clusterIndex.end());
+    return clusterIndex;
+}
+
+int gridDBSCAN::run()
+{
+    m_hist.clear();
+    const int count = static_cast<int>(m_points.size());
+    for (auto& pt : m_points) pt.clusterID = UNCLASSIFIED;
+    if (count == 0) return 0;
+    
+    build_grid();
+    
+    // Core point detection
+    m_core.assign(count, 0);
+    parallel_range(count, [this](size_t ii){
+        unsigned int neighbours = 0;
+        for_each_neighbour(int(ii), [&neighbours](int){ neighbours++; });
+        m_core[ii] = neighbours >= m_minPoints;
+    });
+    
+    // Merge core points within epsilon of each other
+    m_parent.reset(new std::atomic<int>[count]);
+    for (int ii = 0; ii < count; ii++) m_parent[ii].store(ii, std::memory_order_relaxed);
+    parallel_range(count, [this](size_t ii){
+        if (! m_core[ii]) return;
+        for_each_neighbour(int(ii), [this, ii](int other){
+            if (other < int(ii) && m_core[other]) unite(int(ii), other);
+        });
+    });
+    
+    // Cluster ids in order of each cluster's first core point, as the serial scan assigns them
+    int clusterID = 1;
+    for (int ii = 0; ii < count; ii++){
+        if (! m_core[ii]) continue;
+        int root = find(ii);
+        if (root == ii) m_points[ii].clusterID = clusterID++;
+        else m_points[ii].clusterID = m_points[root].clusterID;
+    }
+    
+    // Border points. The serial expansion labels a border point with the first cluster that reaches it,
+    // except that the seed ( first core point ) of a later cluster relabels all of its direct neighbours.
+    parallel_range(count, [this](size_t ii){
+        if (m_core[ii]) return;
+        int first = 0, seeded = 0;
+        for_each_neighbour(int(ii), [this, &first, &seeded](int other){
+            if (! m_core[other]) return;
+            int id = m_points[other].clusterID;
+            if (first == 0 || id < first) first = id;
+            if (find(other) == other) seeded = std::max(seeded, id);
+        });
+        if (seeded != 0) m_points[ii].clusterID = seeded;
+        else if (first != 0) m_points[ii].clusterID = first;
+    });
+    
+    return 0;
+}
+
+const gridDBSCAN::dbHist_t& gridDBSCAN::cluster_hist (){
+    m_hist.clear();
+    for(const auto & pp : m_points)
+        m_hist[pp.clusterID] += 1;
+    return m_hist;
+}
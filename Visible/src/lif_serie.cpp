@@ -34,10 +34,10 @@ using namespace std;
  
  ****/
 
-lif_serie_data:: lif_serie_data () : m_index (-1) {}
+lif_serie_data:: lif_serie_data () : m_index (-1), m_time_specs (std::make_shared<time_specs_t>()) {}
 
 
-lif_serie_data::lif_serie_data (const std::unique_ptr<OIIO::ImageInput>& m_in): m_index(-1){
+lif_serie_data::lif_serie_data (const std::unique_ptr<OIIO::ImageInput>& m_in): m_index(-1), m_time_specs (std::make_shared<time_specs_t>()){
     if (! m_in) return;
 
     const ImageSpec spec = m_in->spec();
@@ -60,7 +60,7 @@ lif_serie_data::lif_serie_data (const std::unique_ptr<OIIO::ImageInput>& m_in):
 
  */
 lif_serie_data:: lif_serie_data (const lifIO::LifReader::ref& m_lifRef, const unsigned index):
-m_index(-1) {
+m_index(-1), m_time_specs (std::make_shared<time_specs_t>()) {
     
     if (index >= m_lifRef->getNbSeries()) return;
     
@@ -77,11 +77,17 @@ m_index(-1) {
         m_channels.emplace_back(cda);
     }
     
-    // Get timestamps in to time_spec_t and store it in info
-    m_timeSpecs.resize (m_lifRef->getSerie(m_index).getTimestamps().size());
-    std::transform(m_lifRef->getSerie(m_index).getTimestamps().begin(), m_lifRef->getSerie(m_index).getTimestamps().end(),
-                   m_timeSpecs.begin(), [](lifIO::LifSerie::timestamp_t ts) { return time_spec_t ( ts / 10000.0); });
-    m_length_in_seconds = m_lifRef->getSerie(m_index).total_duration ();
+    // Timestamps are decoded and converted to time_spec_t on first access, see timeSpecs ()
+    lifIO::LifReader::weak_ref_t weak = m_lifRef;
+    m_time_specs->load = [weak, index] (std::vector<time_spec_t>& specs, float& seconds){
+        auto lif = weak.lock();
+        if (! lif) return;
+        const lifIO::LifSerie& serie = lif->getSerie(index);
+        specs.resize (serie.getTimestamps().size());
+        std::transform(serie.getTimestamps().begin(), serie.getTimestamps().end(),
+                       specs.begin(), [](lifIO::LifSerie::timestamp_t ts) { return time_spec_t ( ts / 10000.0); });
+        seconds = serie.total_duration ();
+    };
     auto serie_ref = std::shared_ptr<lifIO::LifSerie>(&m_lifRef->getSerie(m_index), stl_utils::null_deleter());
     
     // Fill in channel number of image for posters
@@ -111,6 +117,27 @@ m_index(-1) {
 }
 
 
+/**
+ timeSpecs
+ @note Loads the serie's timestamps on first call
+ @return time of each timestep
+ */
+const std::vector<time_spec_t>& lif_serie_data::timeSpecs () const{
+    std::call_once(m_time_specs->once, [this](){
+        if (m_time_specs->load) m_time_specs->load(m_time_specs->specs, m_time_specs->seconds);
+    });
+    return m_time_specs->specs;
+}
+
+/**
+ seconds
+ @return length of the serie in seconds, -1 if not known
+ */
+float lif_serie_data::seconds () const{
+    timeSpecs ();
+    return m_time_specs->seconds;
+}
+
 /**
  readerWeakRef
  @note Check if the returned has expired
@@ -16,18 +16,36 @@ using namespace boost;
 namespace anonymous
 {
 	recursive_mutex mls_mutex;
+	
+		// Number of running sum checkpoints across all ranks
+	const size_t c_checkpoints = 32;
+	
+		// Contiguous row accumulation. Kept as a plain loop so that it vectorizes
+	inline void add_row (const double* row, double* sum, size_t n){
+		for (size_t ii = 0; ii < n; ii++) sum[ii] += row[ii];
+	}
+}
+
+medianLevelSet::~medianLevelSet(){
+	{
+		std::lock_guard<std::mutex> lock(m_settle_mutex);
+		m_settle_stop = true;
+	}
+	m_settle_cv.notify_all();
+	if (m_settler.joinable()) m_settler.join();
 }
 
 
-void medianLevelSet::set_median_levelset_pct (float frac) const {
+void medianLevelSet::set_median_levelset_pct (float frac, bool settle) const {
 	m_median_levelset_frac= clampValue(frac, parameters().range().first, parameters().range().second);
-	update(); }
+	update(settle); }
 
 
 void medianLevelSet::initialize(const result_index_channel_t& in,  const uint32_t& body_id , const medianLevelSet::params& params){
 
 	m_cached= false;
 	mValidInput = false;
+	mValidOutput = false;
 	m_in = in;
 	m_params = params;
 	m_id = body_id;
@@ -36,6 +54,7 @@ void medianLevelSet::initialize(const result_index_channel_t& in,  const uint32_
 	m_in = in;
 		// Signals we provide
 	med_levelset_pci_ready = createSignal<medianLevelSet::sig_cb_mls_pci_ready> ();
+	med_levelset_settled = createSignal<medianLevelSet::sig_cb_mls_settled> ();
 }
 
 void medianLevelSet::load(const vector<double>& entropies, const vector<vector<double>>& mmatrix)
@@ -48,17 +67,59 @@ void medianLevelSet::load(const vector<double>& entropies, const vector<vector<d
 	m_ranks.resize (m_entsize);
 	m_signal.resize (m_entsize);
 
+		// New content: ranks and running sums have to be recomputed
+	m_cached = false;
+	mValidOutput = false;
 
 	mValidInput = verify_input ();
 }
 
+/*
+ * Ranks entropies and, if there is a self-similarity matrix, fills the running sum
+ * checkpoints up to the largest fraction the parameters allow.
+ */
 void medianLevelSet::compute_median_levelsets () const
 {
 	if (m_cached) return;
 	m_median_value = medianLevelSet::Median_levelsets (m_entropies, m_ranks);
+	
+	m_checkpoint_stride = std::max(size_t(1), (m_entsize + anonymous::c_checkpoints - 1) / anonymous::c_checkpoints);
+	m_checkpoints.clear();
+	m_checkpoints.resize(m_entsize / m_checkpoint_stride + 1);
+	m_checkpoints[0].assign(m_entsize, 0.0);
+	m_sum = m_checkpoints[0];
+	m_sum_count = 0;
+	if (! mNoSMatrix)
+		advance_running_sum (std::floor (m_entsize * parameters().range().second));
 	m_cached = true;
 }
 
+/*
+ * Brings the running sum to the first count ranks.
+ * Sums are only ever extended by adding rows in rank order, from the running sum or from the
+ * closest checkpoint below count, so each element is accumulated exactly as a full recompute would.
+ */
+void medianLevelSet::advance_running_sum (size_t count) const
+{
+	count = std::min(count, m_entsize);
+	size_t kk = std::min(count / m_checkpoint_stride, m_checkpoints.size() - 1);
+	while (kk > 0 && m_checkpoints[kk].empty()) kk--;
+	size_t from = kk * m_checkpoint_stride;
+	if (m_sum_count > count || from > m_sum_count){
+		m_sum = m_checkpoints[kk];
+		m_sum_count = from;
+	}
+	
+	for (; m_sum_count < count; m_sum_count++){
+		anonymous::add_row (m_SMatrix[m_ranks[m_sum_count]].data(), m_sum.data(), m_entsize);
+		if ((m_sum_count + 1) % m_checkpoint_stride == 0){
+			size_t cp = (m_sum_count + 1) / m_checkpoint_stride;
+			if (cp < m_checkpoints.size() && m_checkpoints[cp].empty())
+				m_checkpoints[cp] = m_sum;
+		}
+	}
+}
+
 /* Compute rank for all entropies
  * Steps:
  * 1. Copy and Calculate Median Entropy
@@ -85,40 +146,96 @@ double medianLevelSet::Median_levelsets (const vector<double>& entropies,  std::
 	return median_value;
 }
 
+/*
+ * Signal is the average of the self-similarity rows of the count entropies closest to the median.
+ * Moving the cutoff only adds the rows between the closest checkpoint ( or the last cutoff ) and the new one.
+ */
 size_t medianLevelSet::recompute_signal () const
 {
 	
 	size_t count = std::floor (m_entropies.size () * m_median_levelset_frac);
 	assert(count < m_ranks.size());
 	m_signal.resize(m_entropies.size (), 0.0);
-	for (auto ii = 0; ii < m_signal.size(); ii++)
-	{
-	double val = 0;
-	for (int index = 0; index < count; index++)
-		{
-		auto jj = m_ranks[index]; // get the actual index from rank
-		val += m_SMatrix[jj][ii]; // fetch the cross match value for
-		}
-	val = val / count;
-	m_signal[ii] = val;
+		// Without a self-similarity matrix, entropies are used directly
+	if (mNoSMatrix){
+		m_signal = m_entropies;
+		return count;
 	}
+	advance_running_sum (count);
+	for (auto ii = 0; ii < m_signal.size(); ii++)
+		m_signal[ii] = m_sum[ii] / count;
 	
 	return count;
 }
-void medianLevelSet::update() const{
+void medianLevelSet::update(bool settle) const{
 	if (m_entropies.empty()) return;
 	
 		// Cache Rank Calculations
 	compute_median_levelsets ();
+	
+		// UI calls this on every frame. Nothing to do if the cutoff still selects the same entropies
+	size_t count = std::floor (m_entropies.size () * m_median_levelset_frac);
+	if (mValidOutput && count == m_last_count) return;
+	
 		// If the fraction of entropies values expected is zero, then just find the minimum and call it contraction
-	size_t count = recompute_signal();
+	count = recompute_signal();
 	if (count == 0) m_signal = m_entropies;
 	m_signal_F.resize(m_entropies.size());
 	std::transform(m_signal.begin(), m_signal.end(), m_signal_F.begin(), [] (const double d){ return float(d); });
+	m_last_count = count;
+	mValidOutput = true;
 	
 	if (med_levelset_pci_ready && med_levelset_pci_ready->num_slots() > 0)
 		med_levelset_pci_ready->operator()(m_signal_F, m_in, m_id);
 	
+	schedule_settled (settle);
+}
+
+/*
+ * Restarts the settle timer with the current signal. The settle thread is started on first use.
+ * A programmatic change only drops a pending settle, whose signal is now stale.
+ */
+void medianLevelSet::schedule_settled (bool settle) const{
+	if (! med_levelset_settled || med_levelset_settled->num_slots() == 0) return;
+	{
+		std::lock_guard<std::mutex> lock(m_settle_mutex);
+		if (! settle){
+			m_settle_pending = false;
+			m_settle_signal.clear();
+			return;
+		}
+		m_settle_signal = m_signal_F;
+		m_settle_frac = m_median_levelset_frac;
+		m_settle_deadline = std::chrono::steady_clock::now() + parameters().settle_time();
+		m_settle_pending = true;
+		if (! m_settler.joinable())
+			m_settler = std::thread(&medianLevelSet::settle_loop, this);
+	}
+	m_settle_cv.notify_one();
+}
+
+/*
+ * Settle thread: signals the last level set once it has not changed for settle_time
+ */
+void medianLevelSet::settle_loop () const{
+	std::unique_lock<std::mutex> lock(m_settle_mutex);
+	while (! m_settle_stop){
+		if (! m_settle_pending){
+			m_settle_cv.wait(lock);
+			continue;
+		}
+		if (std::chrono::steady_clock::now() < m_settle_deadline){
+			m_settle_cv.wait_until(lock, m_settle_deadline);
+			continue;
+		}
+		vector<float> signal;
+		signal.swap(m_settle_signal);
+		float frac = m_settle_frac;
+		m_settle_pending = false;
+		lock.unlock();
+		med_levelset_settled->operator()(signal, m_in, m_id, frac);
+		lock.lock();
+	}
 }
 
 bool medianLevelSet::verify_input () const
@@ -143,3 +260,4 @@ bool medianLevelSet::verify_input () const
 
 
 template boost::signals2::connection medianLevelSet::registerCallback(const std::function<medianLevelSet::sig_cb_mls_pci_ready>&);
+template boost::signals2::connection medianLevelSet::registerCallback(const std::function<medianLevelSet::sig_cb_mls_settled>&);
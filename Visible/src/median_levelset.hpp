@@ -18,6 +18,10 @@
 #include <chrono>
 #include <numeric>
 #include <iterator>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include "core/pair.hpp"
 #include "core/stats.hpp"
 #include "core/stl_utils.hpp"
@@ -48,13 +52,17 @@ public:
 	
 	class params{
 	public:
-		params (float low=0.01, float high=0.50):m_median_levelset_fraction_range(low, high) {
+		params (float low=0.01, float high=0.50, int settle_ms = 250):m_median_levelset_fraction_range(low, high),
+		m_settle_ms(settle_ms) {
 		}
 		const fPair& range ()const {return m_median_levelset_fraction_range; }
+			// Time without a change in the level set before settled is signaled
+		std::chrono::milliseconds settle_time () const { return std::chrono::milliseconds(m_settle_ms); }
 
 
 	private:
 		mutable fPair m_median_levelset_fraction_range;
+		int m_settle_ms;
 	};
 	
 	typedef std::shared_ptr<medianLevelSet> Ref_t;
@@ -63,8 +71,11 @@ public:
 		// Signals we provide
 		// signal pci is median level processed
 	typedef void (sig_cb_mls_pci_ready) (std::vector<float>&, const result_index_channel_t&,  uint32_t& body_id );
+		// signal level set has not changed for settle_time. Delivered on a background thread
+	typedef void (sig_cb_mls_settled) (const std::vector<float>&, const result_index_channel_t&, const uint32_t& body_id, const float& fraction );
 
-	medianLevelSet() {}
+	medianLevelSet() : m_settle_pending(false), m_settle_stop(false), med_levelset_pci_ready(nullptr), med_levelset_settled(nullptr) {}
+	~medianLevelSet();
 	
 	void initialize (const result_index_channel_t&,    const uint32_t& body_id = std::numeric_limits<uint32_t>::max() , const medianLevelSet::params& params = medianLevelSet::params ());
 
@@ -75,7 +86,8 @@ public:
 		// // input selector -1 entire index mobj index
 	void load (const vector<double>& entropies, const vector<vector<double>>& mmatrix = vector<vector<double>>());
 	
-	void update () const;
+		// settle: false for programmatic changes, which are not signaled as settled and cancel a pending one
+	void update (bool settle = true) const;
 	
 	
 		// Original
@@ -97,7 +109,7 @@ public:
 	 * 3. Sort according to distance to Median
 	 * 4. Fill up rank vector
 	 */
-	void set_median_levelset_pct (float frac) const;
+	void set_median_levelset_pct (float frac, bool settle = true) const;
 	float get_median_levelset_pct () const { return m_median_levelset_frac; }
 	
 		// Static public functions. Enabling testing @todo move out of here
@@ -115,6 +127,9 @@ private:
 	
 	void compute_median_levelsets () const;
 	size_t recompute_signal () const;
+	void advance_running_sum (size_t count) const;
+	void schedule_settled (bool settle) const;
+	void settle_loop () const;
 	void clear_outputs () const;
 	bool verify_input () const;
 	bool savgol_filter () const;
@@ -130,6 +145,24 @@ private:
 	mutable std::atomic<bool> m_cached;
 	mutable result_index_channel_t m_in;
 	mutable std::vector<int>            m_ranks;
+	
+		// Sum of the rows of m_SMatrix in rank order, for the first m_sum_count ranks.
+		// Checkpoint k holds the sum of the first k * m_checkpoint_stride ranks
+	mutable vector<double>               m_sum;
+	mutable size_t                       m_sum_count;
+	mutable vector<vector<double>>       m_checkpoints;
+	mutable size_t                       m_checkpoint_stride;
+	mutable size_t                       m_last_count;
+	
+	mutable std::thread                  m_settler;
+	mutable std::mutex                   m_settle_mutex;
+	mutable std::condition_variable      m_settle_cv;
+	mutable std::chrono::steady_clock::time_point m_settle_deadline;
+	mutable vector<float>                m_settle_signal;
+	mutable float                        m_settle_frac;
+	mutable bool                         m_settle_pending;
+	mutable bool                         m_settle_stop;
+	
 	size_t m_entsize;
 	mutable bool mValidInput;
 	mutable bool mValidOutput;
@@ -139,6 +172,7 @@ private:
 protected:
 	
 	boost::signals2::signal<medianLevelSet::sig_cb_mls_pci_ready>* med_levelset_pci_ready;
+	boost::signals2::signal<medianLevelSet::sig_cb_mls_settled>* med_levelset_settled;
 	
 };
 
@@ -1,5 +1,5 @@
 
-#include "seq_frame_container.hpp"
+#include "ocv_frame_cache.hpp"
 #include <iterator>
 #include "core/stl_utils.hpp"
 #include <algorithm>
@@ -7,17 +7,17 @@
  *  Concepte:
  *  Movie consisting of M frames identified by time and index in the movie context
  *  qTimeFrameCache is a container of frames identified by time and index 
- *                access is done through the following maps
- *                movie time <-> movie index
- *                movie index -> container index ( or iterator )
+ *                access is done through dense arrays ( lru_frame_cache )
+ *                movie index -> movie time, movie time -> movie index by interpolation
+ *                movie index -> cache slot
  *
- *  If the container is large enough for all frames in the movie, after initial load, all frame fetches are nearly free
- *  To Do: If the container is smaller then number of frames in the movie, a least used stack will be used to refresh
+ *  If the budget is large enough for all frames in the movie, after initial load, all frame fetches are nearly free
+ *  If it is smaller, least recently used frames are dropped to make room
  */
 
 std::string qTimeFrameCache::getName () const { return "qTimeFrameCache"; }
 
-std::shared_ptr<qTimeFrameCache> qTimeFrameCache::create (const ci::qtime::MovieSurfaceRef& mMovie)
+std::shared_ptr<qTimeFrameCache> qTimeFrameCache::create (const ci::qtime::MovieSurfaceRef& mMovie, const decodeSurfaceCb_t& decode)
 {
     general_movie_info minfo;
     minfo.mWidth = mMovie->getWidth();
@@ -26,11 +26,11 @@ std::shared_ptr<qTimeFrameCache> qTimeFrameCache::create (const ci::qtime::Movie
     minfo.count = mMovie->getNumFrames ();
     minfo.duration = mMovie->getDuration();
     minfo.mTscale = 1.0;
-   return std::make_shared<qTimeFrameCache>( minfo);
+   return std::make_shared<qTimeFrameCache>( minfo, c_default_budget, decode);
     
 }
 
-std::shared_ptr<qTimeFrameCache> qTimeFrameCache::create (const ci::qtime::MovieGlRef& mMovie)
+std::shared_ptr<qTimeFrameCache> qTimeFrameCache::create (const ci::qtime::MovieGlRef& mMovie, const decodeSurfaceCb_t& decode)
 {
     general_movie_info minfo;
     minfo.mWidth = mMovie->getWidth();
@@ -39,64 +39,57 @@ std::shared_ptr<qTimeFrameCache> qTimeFrameCache::create (const ci::qtime::Movie
     minfo.count = mMovie->getNumFrames ();
     minfo.duration = mMovie->getDuration();
     minfo.mTscale = 1.0;
-    return std::make_shared<qTimeFrameCache>( minfo);
+    return std::make_shared<qTimeFrameCache>( minfo, c_default_budget, decode);
    
 }
 
 
-qTimeFrameCache::qTimeFrameCache ( const general_movie_info& info ) : general_movie_info(info)
+qTimeFrameCache::qTimeFrameCache ( const general_movie_info& info, size_t budget, const decodeSurfaceCb_t& decode ) : general_movie_info(info),
+m_decode (decode),
+m_cache (budget, [] (const Surface8uRef& frame) { return frame ? size_t(frame->getRowBytes()) * frame->getHeight() : size_t(0); },
+         ! decode ? lru_frame_cache<Surface8uRef>::decode_fn_t () : [this] (int64_t index, Surface8uRef& frame) {
+             // Only frames whose time stamp has been loaded once can be decoded again
+             const double secs = m_cache.time_of(index);
+             if (secs < 0) return false;
+             frame = m_decode(secs);
+             return bool(frame);
+         })
 {
-    m_time_hist.resize (0);
-    m_stats.first = m_stats.second = 0;
 }
 
 /*
  * Get the frame at offset from current. 
- * Updates currentIndex only if successful and consistent 
  * Returns a shared_ptr to frame. Valid until that frame is still alive.
  */
 
 const Surface8uRef  qTimeFrameCache::getFrame (int64_t offset) const
 {
-    std::unique_lock<std::mutex> lock( mMutex );
     Surface8uRef s8;
-    indexToContainer::const_iterator p = _checkFrame(offset);
-    if (p == m_itIter.end()) return s8;
-
-    assert(p->second > 0 && p->second <= mFrames.size());
-    return mFrames[p->second-1].first;
+    m_cache.get(offset, s8);
+    return s8;
 }
 
 const Surface8uRef qTimeFrameCache::getFrame(const time_spec_t& dtime) const
 {
-    std::unique_lock<std::mutex> lock( mMutex );
-    Surface8uRef s8;
-    indexToContainer::const_iterator fc = _checkFrame (dtime);
-    if (fc == m_itIter.end())
-        return s8;
-
-    assert(fc->second > 0 && fc->second <= mFrames.size());
-    return mFrames[fc->second-1].first;
-
+    return getFrame(m_cache.index_of(dtime.secs()));
 }
 
 
 
 bool qTimeFrameCache::checkFrame (const time_spec_t& dtime) const
 {
-    return _checkFrame(dtime) != m_itIter.end();
+    return m_cache.contains(m_cache.index_of(dtime.secs()));
 }
 
 
 bool qTimeFrameCache::checkFrame (int64_t offset) const
 {
-    return _checkFrame(offset) != m_itIter.end();
+    return m_cache.contains(offset);
 }
 
 bool qTimeFrameCache::isValid () const
 {
-    mValid = !mFrames.empty();
-    return mValid;
+    return m_cache.resident() > 0;
 }
 
 general_movie_info qTimeFrameCache::movie_info ()
@@ -108,102 +101,36 @@ general_movie_info qTimeFrameCache::movie_info ()
 const std::ostream& qTimeFrameCache::print_to_ (std::ostream& std_stream)
 {
     std_stream << (general_movie_info*)this << std::endl;
-    std_stream << "Hits:    " << m_stats.first << std::endl;
-    std_stream << "Misses: " << m_stats.second << std::endl;
+    std_stream << "Hits:    " << m_cache.hits() << std::endl;
+    std_stream << "Misses: " << m_cache.misses() << std::endl;
+    std_stream << "Bytes:  " << m_cache.bytes() << " of " << m_cache.budget() << std::endl;
     return std_stream;
 }
 
 
-
-/*
- * Increment the time histogram if the new time stamp is increasing.
- */
-bool qTimeFrameCache::make_unique_increasing_time_indices (const time_spec_t& tic, index_time_t& outi)
-{
-    bool check = m_time_hist.empty() || tic > m_time_hist.back();
-    if (!check) return check;
-    auto pre_size = m_time_hist.size();
-    outi = make_pair((int64_t)m_time_hist.size(), tic);
-    m_time_hist.push_back(tic);
-    return (m_time_hist.size() == (pre_size+1) && outi.second == tic);
-}
-
-
-bool qTimeFrameCache::loadFrame (const Surface8uRef frame, const index_time_t& tid )
-{
-    assert (frame );
-    index_time_t ltid (tid);
-//    SurTiIndexRef_t pp (std::make_shared<Surface8u>(frame->clone(true)), ltid);
-    mFrames.emplace_back(std::make_shared<Surface8u>(frame->clone(true)), ltid);
-    m_tti[tid.second] = tid.first;
-    m_itt[tid.first] = tid.second;
-    m_itIter[tid.first] = mFrames.size();
-    mCurrentTime = tid;
-    m_stats.first += 1;
-    return true;
-}
-
 /*
  * Return true of frame was loaded, false if it was already in cache
+ * or its time stamp is new and not past the last one
  */
 
 bool qTimeFrameCache::loadFrame (const Surface8uRef frame, const time_spec_t& tic )
 {
     assert(frame );
-
-    std::unique_lock <std::mutex> lock( mMutex );
-    if (!mFrames.empty())
-    {
-        // Check to see if it exists
-        auto pp = _checkFrame (tic);
-        if (pp != m_itIter.end()) return false;
+    
+    // A known time stamp keeps its index: its frame is either cached or was evicted and is loaded back
+    int64_t index = m_cache.index_of(tic.secs());
+    if (index >= 0 && m_cache.time_of(index) == tic.secs()){
+        if (m_cache.contains(index)) return false;
     }
-    // It is not in the cache. 
-    // Get a time_index for it and load it
-    index_time_t ti;
-    return make_unique_increasing_time_indices (tic, ti) && loadFrame(frame, ti);
+    // Otherwise get a time_index for it
+    else if (! m_cache.add_time(tic.secs(), index))
+        return false;
+    return m_cache.insert(index, std::make_shared<Surface8u>(frame->clone(true)));
 }
 
-/*
- * Returns an iterator to the container of <TimeIndex,SurfaceRef> 
- * The end iterator is returned if entry is not found.
- */
-
 int64_t qTimeFrameCache::currentIndex (const time_spec_t& time) const
 {
-    indexToContainer::const_iterator ci = _checkFrame(time);
-    if(ci == m_itIter.end()) return -1;
-    if(ci == m_itIter.begin()) return 0;
-    return std::distance(m_itIter.begin(), ci);
-}
-
-qTimeFrameCache::indexToContainer::const_iterator qTimeFrameCache::_checkFrame (const time_spec_t& query_time) const
-{
-//    std::lock_guard<std::mutex> lock( mMutex );
-    // First see if this time exist in time index maps
-    timeToIndex::const_iterator low, prev;
-    low = m_tti.lower_bound(query_time);
-    if (low == m_tti.end()) {
-        return m_itIter.end();
-    }
-    m_stats.second += 1;
-    
-    if (low == m_tti.begin())
-        return m_itIter.begin();
-
-    prev = low;
-    --prev;
-    if ((query_time - prev->first) < (low->first - query_time))
-        return m_itIter.find(prev->second);
-    else
-        return m_itIter.find(low->second);
-
-
-}
-
-qTimeFrameCache::indexToContainer::const_iterator qTimeFrameCache::_checkFrame (const int64_t query_index) const
-{
-    return m_itIter.find(query_index);
+    return m_cache.index_of(time.secs());
 }
 
 
@@ -49,6 +49,14 @@ const ssmt_result::ref_t ssmt_result::create (std::shared_ptr<ssmt_processor>& p
     ssmt_result::ref_t this_child (new ssmt_result(child, in ));
     this_child->m_weak_parent = parent;
 	this_child->m_magnification_x = parent->parameters().magnification();
+	
+	// Locate contractions again once the median level set cutoff the UI drives settles.
+	// The slot outlives neither the connection nor, while it runs, the result
+	ssmt_result::weak_ref_t weak_child = this_child;
+	std::function<medianLevelSet::sig_cb_mls_settled> settled_cb =
+		[weak_child](const std::vector<float>& leveled, const result_index_channel_t& in, const uint32_t& id, const float& fraction){
+			if (auto shared_child = weak_child.lock()) shared_child->leveled_settled(leveled, in, id, fraction); };
+	this_child->m_settle_connection = parent->medianLeveler().registerCallback(settled_cb);
     return this_child;
 }
 
@@ -86,6 +94,16 @@ void ssmt_result::contraction_ready (contractionLocator::contractionContainer_t&
     vlogger::instance().console()->info(" Contractions Analyzed: ");
 }
 
+// Called on the settle thread of the processor's leveler. Re-runs the locator on the leveled signal
+void ssmt_result::leveled_settled (const std::vector<float>& leveled, const result_index_channel_t&, const uint32_t&, const float& fraction)
+{
+    std::lock_guard<std::mutex> lock(m_locator_mutex);
+    m_leveled = leveled;
+    m_caRef->load(m_leveled);
+    m_caRef->locate_contractions();
+    vlogger::instance().console()->info(" Contractions Relocated at Median LevelSet " + to_string(fraction));
+}
+
 const result_index_channel_t& ssmt_result::input() const { return m_input; }
 
 const vector<float>& ssmt_result::entropies () const { return m_entropies; }
@@ -124,8 +142,11 @@ bool ssmt_result::process (){
 	auto parent = m_weak_parent.lock();
 	if (parent.get() == 0) return false;
 	
-	m_caRef->load(parent->entropies_F(), parent->ssMatrix());
-    m_caRef->locate_contractions();
+	{
+		std::lock_guard<std::mutex> lock(m_locator_mutex);
+		m_caRef->load(parent->entropies_F(), parent->ssMatrix());
+		m_caRef->locate_contractions();
+	}
 
 	auto ss_done = run_scale_space(m_all_by_channel[m_input.section()]);
 	if(ss_done){
@@ -133,6 +154,7 @@ bool ssmt_result::process (){
 		m_scale_space.process_motion_peaks(0, motion_surface().boundingRect());
 	}
 	if(m_pci_done && ss_done){
+		std::lock_guard<std::mutex> lock(m_locator_mutex);
 		m_caRef->profile_contractions(m_scale_space.lengths());
 		return true;
 	}
@@ -167,9 +189,7 @@ bool ssmt_result::get_channels (int channel) const {
             Mat cropped;
             getRectSubPix(rotated, size, box.center, cropped);
             copyMakeBorder(cropped,cropped,0,0,0,0,BORDER_CONSTANT,Scalar(0));
-            roiWindow<P8U> r8(cropped.cols, cropped.rows);
-            cpCvMatToRoiWindow8U (cropped, r8);
-            return r8;
+            return adoptCvMat8U (cropped);
         };
         
         cvMatRefroiP8U(*rw_src, src, CV_8UC1);
@@ -242,7 +262,7 @@ bool ssmt_result::run_selfsimilarity_on_region (const std::vector<roiWindow<P8U>
 	
 		
 		m_leveler.load(entropies_D, m_smat);
-		m_leveler.set_median_levelset_pct((m_leveler.parameters().range().first+m_leveler.parameters().range().second)/2.0f);
+		m_leveler.set_median_levelset_pct((m_leveler.parameters().range().first+m_leveler.parameters().range().second)/2.0f, false);
 		
 		
 	
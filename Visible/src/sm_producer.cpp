@@ -20,6 +20,9 @@
 #include "core/simple_timing.hpp"
 #include "vision/opencv_utils.hpp"
 #include "vision/histo.h"
+#include "image_ingest.hpp"
+#include "movie_segments.hpp"
+#include "logger/logger.hpp"
 
 
 
@@ -41,6 +44,24 @@ namespace anonymous
         return extension.length() == 0 && pp.filename().string().length() == check_size;
     }
     
+    // Red channel of a color image file or the only channel of a gray one, 8 bit only.
+    // Unbound if the file can not be decoded.
+    roiWindow<P8U> read_red_8U (const boost::filesystem::path& pp)
+    {
+        roiWindow<P8U> rw;
+        cv::Mat image = cv::imread(pp.string(), cv::IMREAD_UNCHANGED);
+        if (image.empty() || image.depth() != CV_8U) return rw;
+        if (image.channels() == 1)
+            rw = adoptCvMat8U(image);
+        else if (image.channels() >= 3)
+        {
+            cv::Mat red;
+            cv::extractChannel(image, red, 2);
+            rw = adoptCvMat8U(red);
+        }
+        return rw;
+    }
+    
     struct greaterScore {
         bool operator () (const sm_producer::outuple_t& left, const sm_producer::outuple_t& right)
         { // Score is at Index 1
@@ -72,17 +93,14 @@ sm_producer::sm_producer ()
     _impl = std::shared_ptr<sm_producer::spImpl> (new sm_producer::spImpl);
 }
 
-#if OIIO_INTEGRATED
 bool sm_producer::load_content_file (const std::string& movie_fqfn)
 {
     if (_impl){
         auto cnt =  _impl->loadMovie(movie_fqfn);
-        std::cout << " Frames in Movie " << cnt << std::endl;
-        return cnt == _impl->m_frameCount;
+        return cnt > 0 && cnt == _impl->m_frameCount;
     }
     return false;
 }
-#endif
 
 bool sm_producer::load_image_directory (const std::string& dir_fqfn, sm_producer::sizeMappingOption szmap)
 {
@@ -191,41 +209,28 @@ void sm_producer::spImpl::asset_reader_done_cb ()
 
 /*
  * Load all the frames
- * Could be producer / consumer for file fetching, Use shared memory, etc
+ * Sizes are read from the file headers first, so a size mismatch is reported, or the odd sizes dropped,
+ * before anything is decoded. Decoding runs on a bounded pool of threads and frames are collected in
+ * directory order.
  */
 int sm_producer::spImpl::loadImageDirectory( const std::string& imageDir,  sm_producer::sizeMappingOption szmap, const std::vector<std::string>& supported_extensions)
 {
-#ifdef CINDER_GHC_ISSUE_FIXED
     m_source_type = imageFileDirectory;
     
     paths_vector_t tmp_framePaths;
     
     // make a list of all image files in the directory
     // in to the tmp vector
-    filesystem::directory_iterator end_itr;
-    for( filesystem::directory_iterator i( imageDir ); i != end_itr; ++i )
+    bfs::directory_iterator end_itr;
+    for( bfs::directory_iterator i( imageDir ); i != end_itr; ++i )
     {
-        std::unique_lock <std::mutex> lock(m_mutex, std::try_to_lock);
         // skip if not a file
-        if( !filesystem::is_regular_file( i->status() ) ) continue;
-        
-        std::cout << "Checking " << i->path().string();
+        if( !bfs::is_regular_file( i->status() ) ) continue;
         
         if (std::find( supported_extensions.begin(), supported_extensions.end(), i->path().extension()  ) != supported_extensions.end())
-        {
-            std::cout << "  Extension matches " << std::endl;
-            tmp_framePaths.push_back( i->path().string() );
-        }
+            tmp_framePaths.push_back( i->path() );
         else if (anonymous::is_anaonymous_name(i->path()))
-        {
-            std::cout << "  Anonymous rule matches " << std::endl;
-            tmp_framePaths.push_back( i->path().string() );
-        }
-        else
-        {
-            std::cout << "Skipped " << i->path().string() << std::endl;
-            continue;
-        }
+            tmp_framePaths.push_back( i->path() );
     }
     
     if (tmp_framePaths.empty()) return -1;
@@ -233,44 +238,64 @@ int sm_producer::spImpl::loadImageDirectory( const std::string& imageDir,  sm_pr
     m_framePaths.clear();
     m_loaded_ref.resize(0);
     
-    std::cout << m_framePaths.size () << " Files "  << std::endl;
+    // Bucket by header sizes. Files whose header can not be read are kept and sorted out after decoding
+    std::map<iPair, int32_t> header_map;
+    std::vector<iPair> header_sizes (tmp_framePaths.size());
+    std::vector<bool> header_known (tmp_framePaths.size(), false);
+    for (auto counter = 0; counter < tmp_framePaths.size(); counter++)
+    {
+        header_known[counter] = image_header_size(tmp_framePaths[counter], header_sizes[counter]);
+        if (header_known[counter]) header_map[header_sizes[counter]] += 1;
+    }
     
-    // Paths and Image vectors will be
-    // Get a map of the sizes
-    std::map<iPair, int32_t> size_map;
-    images_vector_t                 tmp_loaded_ref;
-    std::vector<size_t>             tmp_paths_index;
+    // All different size, expected to be the same, report by failing
+    if (header_map.size() > 1 &&  szmap == reportFail)
+        return -1;
     
-    // Read data into memory buffer
-    // Using tmp path vector
-    for (boost::filesystem::path& pp : tmp_framePaths)
+    // All different size, decode the most common only
+    if (header_map.size() > 1 &&  szmap == mostCommon)
     {
-        std::unique_lock<std::mutex> lock( m_mutex, std::try_to_lock );
-        
-        auto ipair = svl::image_io_read_surface (pp.string());
-        roiWindow<P8U> rw;
-        if (ipair.first)
-        {
-            rw = NewRedFromSurface(ipair.first);
-        }
-        else if (ipair.second)
-        {
-            rw = NewFromChannel(*ipair.second, 0);
-        }
-        else
-        {
-            std::cout << __FILE__ << " Unexpected error ";
-            return -1;
-        }
-        
-        size_map[rw.size()] +=1;
-        
-        tmp_loaded_ref.emplace_back(rw);
-        
-        std::cout << tmp_loaded_ref.size() << " Out of " << tmp_framePaths.size () << " Files "  << std::endl;
+        using pair_type = decltype(header_map)::value_type;
+        auto pr = std::max_element
+        (
+         std::begin(header_map), std::end(header_map),
+         [] (const pair_type & p1, const pair_type & p2) {
+             return p1.second < p2.second;
+         }
+         );
         
+        paths_vector_t common_paths;
+        for (auto counter = 0; counter < tmp_framePaths.size(); counter++)
+            if (! header_known[counter] || header_sizes[counter] == pr->first)
+                common_paths.push_back(tmp_framePaths[counter]);
+        tmp_framePaths.swap(common_paths);
     }
     
+    // Paths and Image vectors will be
+    // Get a map of the sizes
+    std::map<iPair, int32_t> size_map;
+    images_vector_t                 tmp_loaded_ref;
+    tmp_loaded_ref.reserve(tmp_framePaths.size());
+    
+    // Decode in parallel, collect in order
+    bool decode_failed = false;
+    ordered_ingest<roiWindow<P8U>> ingest;
+    ingest.run(tmp_framePaths.size(),
+               [&tmp_framePaths] (size_t index) { return anonymous::read_red_8U(tmp_framePaths[index]); },
+               [&] (size_t index, roiWindow<P8U>& rw)
+               {
+                   if (! rw.isBound())
+                   {
+                       vlogger::instance().console()->info(" Unexpected error decoding " + tmp_framePaths[index].string());
+                       decode_failed = true;
+                       return false;
+                   }
+                   size_map[rw.size()] +=1;
+                   tmp_loaded_ref.emplace_back(rw);
+                   return true;
+               });
+    if (decode_failed) return -1;
+    
     // All same size, or our pairwise compare function does not care
     if (size_map.size() == 1 || (size_map.size() > 1 &&  szmap == dontCare))
     {
@@ -294,13 +319,12 @@ int sm_producer::spImpl::loadImageDirectory( const std::string& imageDir,  sm_pr
          }
          );
         
-        std::cout << "Size map contains " << size_map.size() << " most Common " << pr->first << std::endl;
         assert(tmp_framePaths.size() == tmp_loaded_ref.size());
         
         for (auto counter = 0; counter < tmp_loaded_ref.size(); counter++)
         {
             const roiWindow<P8U>& rr = tmp_loaded_ref[counter];
-            const boost::filesystem::path& pp = tmp_framePaths[counter];
+            const bfs::path& pp = tmp_framePaths[counter];
             if (rr.size() == pr->first)
             {
                 m_loaded_ref.emplace_back(rr);
@@ -310,66 +334,69 @@ int sm_producer::spImpl::loadImageDirectory( const std::string& imageDir,  sm_pr
     }
     else
     {
-        std::cout << __FILE__ << " Unexpected error ";
+        vlogger::instance().console()->info(std::string(__FILE__) + " Unexpected error ");
         return -1;
     }
     
     if (m_loaded_ref.empty()) return -1;
     
     m_frameCount = m_loaded_ref.size ();
+    vlogger::instance().console()->info(" Loaded " + std::to_string(m_frameCount) + " frames from " + imageDir +
+                                        " ( " + std::to_string(size_map.size()) + " sizes, " + std::to_string(ingest.threads()) + " decoders ) ");
     
     // Call the content loaded cb if any
     if (signal_content_loaded && signal_content_loaded->num_slots() > 0)
         signal_content_loaded->operator()();
     
-    
-    
     return (int) m_frameCount;
-#endif
-    return -1;
 }
 
-#if OIIO_INTEGRATED
 /*
  * Load all the frames in the movie
+ * Decoded concurrently in keyframe seeked segments, red channel only, delivered in frame order
  */
 int sm_producer::spImpl::loadMovie( const std::string& movieFile )
 {
     std::unique_lock <std::mutex> lock(m_mutex);
     m_source_type = movie;
     
-    {
-        m_grabberRef = cvVideoPlayer::create(movieFile);
-    }
+    segmented_movie_reader reader (movieFile);
+    if (! reader.isValid()) return -1;
     
-    bool m_valid = m_grabberRef->isLoaded();
-    int rtn_val = -1;
-    if (m_valid)
-    {
+    m_loaded_ref.resize(0);
+    m_framePaths.clear();
+    m_frameRate = static_cast<int64_t>(reader.frame_rate());
+    if (reader.frame_count() > 0) m_loaded_ref.reserve(reader.frame_count());
+    
+    double expected = reader.frame_count() > 0 ? static_cast<double>(reader.frame_count()) : 0.0;
+    size_t delivered = 0;
+    bool decoded = reader.run([this, expected] (size_t index, roiWindow<P8U>& rw)
+               {
+                   m_loaded_ref.emplace_back(rw);
+                   int count = static_cast<int>(m_loaded_ref.size());
+                   double done_pc = expected > 0.0 ? std::min(100.0, (100.0 * count) / expected) : 0.0;
+                   if (signal_frame_loaded  && signal_frame_loaded->num_slots() > 0)
+                       signal_frame_loaded->operator()(count, done_pc);
+                   return true;
+               }, delivered);
+    
+    // A partially decoded movie would silently shift or drop frames
+    if (! decoded){
+        vlogger::instance().console()->error(" Failed decoding " + movieFile + " after " + std::to_string(delivered) + " frames ");
         m_loaded_ref.resize(0);
-        m_frameContainer_ref = seqFrameContainer::create (m_grabberRef);
-        if (! m_frameContainer_ref || ! m_frameContainer_ref->isValid())
-            return -1;
-        
-        for(int64_t ff = 0; ff < m_grabberRef->getNumFrames(); ff++){
-            auto mSurface = m_frameContainer_ref->getFrame(ff);
-            auto rw = NewRedFromSurface(mSurface);
-            m_loaded_ref.emplace_back(rw);
-        }
-        
-        m_frameCount = m_loaded_ref.size ();
-        
-        rtn_val = (int) m_frameCount;
-        
-        // Call the content loaded cb if any
-        if (signal_content_loaded && signal_content_loaded->num_slots() > 0)
-            signal_content_loaded->operator()();
+        return -1;
     }
+    if (m_loaded_ref.empty()) return -1;
+    m_frameCount = m_loaded_ref.size ();
+    vlogger::instance().console()->info(" Loaded " + std::to_string(m_frameCount) + " frames from " + movieFile +
+                                        " ( " + std::to_string(reader.segments().size()) + " decoders ) ");
     
-    return rtn_val;
+    // Call the content loaded cb if any
+    if (signal_content_loaded && signal_content_loaded->num_slots() > 0)
+        signal_content_loaded->operator()();
     
+    return (int) m_frameCount;
 }
-#endif
 
 void sm_producer::spImpl::loadImages (const images_vector_t& images)
 {
@@ -304,6 +304,10 @@ void visibleContext::signal_root_pci_ready (std::vector<float> & signal, const r
 	// Always the last one
 	auto copyy = signal;
 	svl::norm_min_max (copyy.begin(), copyy.end(), true);
+	{
+		std::lock_guard<std::mutex> guard(m_lod_mutex);
+		m_timeFloatLod[dummy].load(copyy);
+	}
 	m_timeFloatDict[dummy] = copyy;
 
     stringstream ss;
@@ -320,6 +324,10 @@ void visibleContext::signal_root_mls_ready (std::vector<float> &signal, const re
 	
 	auto copyy = signal;
 	svl::norm_min_max (copyy.begin(), copyy.end(), true);
+	{
+		std::lock_guard<std::mutex> guard(m_lod_mutex);
+		m_timeFloatLod[dummy2].load(copyy);
+	}
 	m_timeFloatDict[dummy2] = copyy;
 	
     stringstream ss;
@@ -939,12 +947,6 @@ void visibleContext::add_result_sequencer (){
 	
 	if (ImGui::CollapsingHeader(" Entire View PCI ") && ! m_timeFloatDict.empty()) {
 		int count = getNumFrames();
-		float xs1[count], ys1[count];
-		for (int i = 0; i < count; ++i) {
-			xs1[i] = i / float(count);
-			auto idx = i % getNumFrames();
-			ys1[i] = m_timeFloatDict[entire][idx];
-		}
 
 		static double xs2[11], ys2[11];
 		for (int i = 0; i < 11; ++i) {
@@ -970,7 +972,20 @@ void visibleContext::add_result_sequencer (){
 		if (ImPlot::BeginPlot(" PCI ")) {
 			ImPlot::SetupAxis(ImAxis_X1, "time/frame");
 			ImPlot::SetupAxis(ImAxis_Y1, " pci (t) ");
-			ImPlot::PlotLine(" Entire ", xs1, ys1, count);
+			// Draw at most 2 points per pixel of the visible range. Frame i is at i / count
+			ImPlotRect limits = ImPlot::GetPlotLimits();
+			size_t pixels = static_cast<size_t>(std::max(1.0f, ImPlot::GetPlotSize().x));
+			{
+				std::lock_guard<std::mutex> guard(m_lod_mutex);
+				auto lod = m_timeFloatLod.find(entire);
+				if (lod != m_timeFloatLod.end())
+					lod->second.query_range(limits.X.Min, limits.X.Max, pixels, m_plot_xs, m_plot_ys, 0.0, 1.0 / count);
+				else{
+					m_plot_xs.clear();
+					m_plot_ys.clear();
+				}
+			}
+			ImPlot::PlotLine(" Entire ", m_plot_xs.data(), m_plot_ys.data(), static_cast<int>(m_plot_xs.size()));
 			ImPlot::SetNextMarkerStyle(ImPlotMarker_Plus);
 			ImPlot::PlotLine(" Instant ", xs2, ys2, 11);
 			ImPlot::EndPlot();
@@ -982,12 +997,6 @@ void visibleContext::add_result_sequencer (){
 	static result_index_channel_t first (0,0);
 	if (ImGui::CollapsingHeader(" Cell Area PCI ") && m_timeFloatDict.size() > 1) {
 		int count = getNumFrames();
-		float xs1[count], ys1[count];
-		for (int i = 0; i < count; ++i) {
-			xs1[i] = i / float(count);
-			auto idx = i % getNumFrames();
-			ys1[i] = m_timeFloatDict[first][idx];
-		}
 		
 		static double xs2[11], ys2[11];
 		for (int i = 0; i < 11; ++i) {
@@ -1009,7 +1018,13 @@ void visibleContext::add_result_sequencer (){
 		
 		ImGui::BulletText(" Temporal Self-Similarity ");
 		if (ImPlot::BeginPlot(" PCI ", "time/frame", " pci (t) ")) {
-			ImPlot::PlotLine(" Entire ", xs1, ys1, count);
+			ImPlotRect limits = ImPlot::GetPlotLimits();
+			size_t pixels = static_cast<size_t>(std::max(1.0f, ImPlot::GetPlotSize().x));
+			{
+				std::lock_guard<std::mutex> guard(m_lod_mutex);
+				m_timeFloatLod[first].query_range(limits.X.Min, limits.X.Max, pixels, m_plot_xs, m_plot_ys, 0.0, 1.0 / count);
+			}
+			ImPlot::PlotLine(" Entire ", m_plot_xs.data(), m_plot_ys.data(), static_cast<int>(m_plot_xs.size()));
 			ImPlot::SetNextMarkerStyle(ImPlotMarker_Plus);
 			ImPlot::PlotLine(" Instant ", xs2, ys2, 11);
 			ImPlot::EndPlot();
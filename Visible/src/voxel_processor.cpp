@@ -12,7 +12,13 @@
 #include "cinder_xchg.hpp"  // For Rectf @todo remove dependency on cinder
 #include <future>
 #include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <numeric>
 #include "algo_runners.hpp"
+#include "result_cache.hpp"
+#include "vision/frame_threads.hpp"
 #include "nms.hpp"
 #include "core/stl_utils.hpp"
 #include "core/fit.hpp"
@@ -27,8 +33,7 @@ using namespace stl_utils;
 bool lengthFromMotion::generate(const std::vector<roiWindow<P8U>> &images, float start_sigma, float end_sigma, float step, float magX){
     std::vector<cv::Mat> mats;
     for (auto& rw : images){
-        cvMatRefroiP8U(rw,cvmat,CV_8U);
-        mats.push_back(cvmat);
+        mats.push_back(cvMatShare(rw));
     }
     return generate(mats, start_sigma, end_sigma, step, magX);
 }
@@ -85,7 +90,6 @@ bool lengthFromMotion::detect_moving_profile(const cv::Mat& mof){
 		cv::Point(e_size.first, e_size.second));
 	
 	cv::erode(mof, eroded_input_image, element);
-	m_motion_field_minimas = mof.clone();
 	cv::compare(mof, eroded_input_image, m_motion_field_minimas, cv::CMP_EQ);
 
 	m_profile_threshold = cv::threshold(mof, thresholded_input_image, 0, 255,
@@ -216,7 +220,7 @@ bool lengthFromMotion::generate(const std::vector<cv::Mat>& images,
     int steps = (end_sigma - start_sigma)/step;
     if (steps < 4) return false;
 
-    // make a cv::mat clone of input images
+    // inputs are shared, not copied. Mats on user data have to outlive this
     cv::Size isize(images[0].cols, images[0].rows);
 	m_voxel_range = cv::Mat(isize.height, isize.width, CV_8U);
 	cv::Mat imin = cv::Mat(isize.height, isize.width, CV_8U);
@@ -226,11 +230,10 @@ bool lengthFromMotion::generate(const std::vector<cv::Mat>& images,
 	
     for (const auto& rw : images){
         if(rw.cols != isize.width || rw.rows != isize.height) return false;
-        auto clone = rw.clone();
-        clone.convertTo(clone, CV_64F);
-        m_filtered.push_back(clone);
-		clone = rw.clone();
-		m_inputs.push_back(clone);
+        cv::Mat filtered;
+        rw.convertTo(filtered, CV_64F);
+        m_filtered.push_back(filtered);
+		m_inputs.push_back(rw);
 		cv::min(m_inputs.back(), imin, imin);
 		cv::max(m_inputs.back(), imax, imax);
     }
@@ -247,8 +250,8 @@ bool lengthFromMotion::generate(const std::vector<cv::Mat>& images,
         sum = 0;
         sumsq = 0;
         for (auto ii = 0; ii < m_filtered.size(); ii++){
-            auto mm = m_filtered[ii].clone();
-            cv::GaussianBlur(mm, mm, cv::Size(0,0), scale );
+            cv::Mat mm;
+            cv::GaussianBlur(m_filtered[ii], mm, cv::Size(0,0), scale );
             // Sum
             sum += mm;
             // square at Sum Squared
@@ -271,6 +274,201 @@ bool lengthFromMotion::generate(const std::vector<cv::Mat>& images,
     
 }
 
+/*
+ VolumeAccumulator
+*/
+
+VolumeAccumulator::VolumeAccumulator (unsigned int threads) :
+m_threads(threads), m_frame_count(0), m_frame_size(0,0), m_lattice_sample(0,0), m_lattice_offset(0,0), m_lattice_size(0,0) {
+    if (m_threads == 0) m_threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+void VolumeAccumulator::lattice (const uiPair& sample){
+    m_lattice_sample = sample;
+    m_lattice_offset = (m_lattice_sample - 1) / 2;
+}
+
+svl::stats<int64_t> VolumeAccumulator::volume_stats () const {
+    auto res = std::accumulate(m_moments.begin(), m_moments.end(), std::make_tuple(int64_t(0),int64_t(0), uint32_t(0)), stl_utils::tuple_sum<int64_t,uint32_t>());
+    auto mes = std::accumulate(m_ranges.begin(), m_ranges.end(), std::make_tuple(uint8_t(255),uint8_t(0)), stl_utils::tuple_minmax<uint8_t, uint8_t>());
+    return svl::stats<int64_t> (std::get<0>(res), std::get<1>(res), std::get<2>(res), int64_t(std::get<0>(mes)), int64_t(std::get<1>(mes)));
+}
+
+void VolumeAccumulator::sums (cv::Mat& m_sum, cv::Mat& m_sqsum) const {
+    m_sum = cv::Mat(m_frame_size.second, m_frame_size.first, CV_32F);
+    m_sqsum = cv::Mat(m_frame_size.second, m_frame_size.first, CV_32F);
+    if (m_pixel_sums.empty()) { m_sum = 0; m_sqsum = 0; return; }
+    const uint32_t* ps = m_pixel_sums[0].data();
+    const uint64_t* pq = m_pixel_sqsums[0].data();
+    for (auto row = 0; row < m_frame_size.second; row++){
+        float* fs = m_sum.ptr<float>(row);
+        float* fq = m_sqsum.ptr<float>(row);
+        for (auto col = 0; col < m_frame_size.first; col++){
+            *fs++ = float(*ps++);
+            *fq++ = float(*pq++);
+        }
+    }
+}
+
+uint64_t VolumeAccumulator::combine (const std::vector<uint64_t>& frame_hashes){
+    content_hasher hasher;
+    hasher.update_value(frame_hashes.size());
+    for (auto hh : frame_hashes) hasher.update_value(hh);
+    return hasher.digest();
+}
+
+uint64_t VolumeAccumulator::content_hash () const {
+    return combine(m_frame_hashes);
+}
+
+uint64_t VolumeAccumulator::content_hash (const channel_images_t& images, unsigned int threads){
+    std::vector<uint64_t> frame_hashes (images.size());
+    svl::for_each_frame(images.size(), [&](size_t ff){
+        content_hasher hasher;
+        hasher.update_image(images[ff]);
+        frame_hashes[ff] = hasher.digest();
+    }, threads);
+    return combine(frame_hashes);
+}
+
+void VolumeAccumulator::accumulate_chunk (const channel_images_t& images, size_t first, size_t last, size_t partial){
+    const int width = m_frame_size.first;
+    const int height = m_frame_size.second;
+    uint32_t* sums = m_pixel_sums[partial].data();
+    uint64_t* sqsums = m_pixel_sqsums[partial].data();
+    const size_t lattice_count = size_t(m_lattice_size.first) * m_lattice_size.second;
+    // Chunks already run in parallel
+    const svl::histogramEngine engine (0, 0, 1);
+    std::vector<uint32_t> counts, banks;
+    
+    for (size_t ff = first; ff < last; ff++){
+        const roiWindow<P8U>& image = images[ff];
+        engine.compute(image, counts, banks);
+        
+        // The frame is still in cache. Hash it as content_hasher::update_image does
+        content_hasher hasher;
+        hasher.update_value(image.width());
+        hasher.update_value(image.height());
+        for (int row = 0; row < height; row++){
+            const uint8_t* src = image.rowPointer(row);
+            hasher.update(src, size_t(width));
+            
+            // Integer per pixel accumulation vectorizes
+            uint32_t* ps = sums + size_t(row) * width;
+            uint64_t* pq = sqsums + size_t(row) * width;
+            for (int col = 0; col < width; col++){
+                const uint32_t val = src[col];
+                ps[col] += val;
+                pq[col] += val * val;
+            }
+        }
+        m_frame_hashes[ff] = hasher.digest();
+        
+        if (lattice_count){
+            uint8_t* dst = &m_lattice_series[ff * lattice_count];
+            for (int row = 0; row < m_lattice_size.second; row++){
+                const uint8_t* src = image.rowPointer(m_lattice_offset.second + row * m_lattice_sample.second) + m_lattice_offset.first;
+                for (int col = 0; col < m_lattice_size.first; col++, src += m_lattice_sample.first)
+                    *dst++ = *src;
+            }
+        }
+        
+        histogram_t& hist = m_histograms[ff];
+        int64_t sum = 0, sumsq = 0;
+        uint32_t count = 0;
+        int minv = -1, maxv = 0;
+        for (int bin = 0; bin < 256; bin++){
+            hist[bin] = counts[bin];
+            if (hist[bin] == 0) continue;
+            if (minv < 0) minv = bin;
+            maxv = bin;
+            count += hist[bin];
+            sum += int64_t(bin) * hist[bin];
+            sumsq += int64_t(bin) * bin * hist[bin];
+        }
+        m_moments[ff] = std::make_tuple(sum, sumsq, count);
+        m_ranges[ff] = std::make_tuple(uint8_t(std::max(minv, 0)), uint8_t(maxv));
+    }
+}
+
+bool VolumeAccumulator::operator()(const channel_images_t& images){
+    m_frame_count = images.size();
+    m_frame_hashes.clear();
+    if (m_frame_count == 0) return false;
+    m_frame_size = iPair(images[0].width(), images[0].height());
+    for (const auto& image : images)
+        if (image.width() != m_frame_size.first || image.height() != m_frame_size.second) return false;
+    
+    const size_t pixels = size_t(m_frame_size.first) * m_frame_size.second;
+    m_histograms.resize(m_frame_count);
+    m_moments.resize(m_frame_count);
+    m_ranges.resize(m_frame_count);
+    m_frame_hashes.resize(m_frame_count);
+    
+    m_lattice_series.clear();
+    m_lattice_size = iPair(0,0);
+    if (m_lattice_sample.first > 0 && m_lattice_sample.second > 0){
+        m_lattice_size.first = (m_frame_size.first - m_lattice_offset.first) / m_lattice_sample.first;
+        m_lattice_size.second = (m_frame_size.second - m_lattice_offset.second) / m_lattice_sample.second;
+        m_lattice_series.resize(m_frame_count * m_lattice_size.first * m_lattice_size.second);
+    }
+    
+    // One partial per pixel accumulator per chunk. Bound their total footprint to ~256MB
+    const size_t partial_bytes = pixels * (sizeof(uint32_t) + sizeof(uint64_t));
+    size_t partials = std::min(size_t(m_threads), m_frame_count);
+    partials = std::max(size_t(1), std::min(partials, (size_t(256) << 20) / std::max(size_t(1), partial_bytes)));
+    m_pixel_sums.assign(partials, std::vector<uint32_t>(pixels, 0));
+    m_pixel_sqsums.assign(partials, std::vector<uint64_t>(pixels, 0));
+    
+    std::vector<std::thread> threads;
+    for (size_t pp = 0; pp < partials; pp++){
+        size_t first = (m_frame_count * pp) / partials;
+        size_t last = (m_frame_count * (pp + 1)) / partials;
+        threads.emplace_back(&VolumeAccumulator::accumulate_chunk, this, std::cref(images), first, last, pp);
+    }
+    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+    
+    // Pairwise tree reduction into partial 0
+    for (size_t stride = 1; stride < partials; stride *= 2){
+        threads.clear();
+        for (size_t pp = 0; pp + stride < partials; pp += 2 * stride){
+            threads.emplace_back([this, pp, stride, pixels](){
+                uint32_t* ds = m_pixel_sums[pp].data();
+                uint64_t* dq = m_pixel_sqsums[pp].data();
+                const uint32_t* ss = m_pixel_sums[pp + stride].data();
+                const uint64_t* sq = m_pixel_sqsums[pp + stride].data();
+                for (size_t ii = 0; ii < pixels; ii++){
+                    ds[ii] += ss[ii];
+                    dq[ii] += sq[ii];
+                }
+            });
+        }
+        std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+    }
+    m_pixel_sums.resize(1);
+    m_pixel_sqsums.resize(1);
+    return true;
+}
+
+bool voxel_processor::generate_voxel_space (const VolumeAccumulator& volume){
+    if (! volume.has_lattice() || volume.frame_count() == 0) return false;
+    sample(volume.lattice_sample().first, volume.lattice_sample().second);
+    image_size(volume.frame_size().first, volume.frame_size().second);
+    if (m_expected_segmented_size != volume.lattice_size()) return false;
+    
+    m_voxel_length = volume.frame_count();
+    const size_t count = size_t(volume.lattice_size().first) * volume.lattice_size().second;
+    const std::vector<uint8_t>& series = volume.lattice_series();
+    m_voxels.resize(0);
+    std::vector<uint8_t> voxel(m_voxel_length);
+    for (size_t vv = 0; vv < count; vv++){
+        for (size_t tt = 0; tt < m_voxel_length; tt++)
+            voxel[tt] = series[tt * count + vv];
+        m_voxels.emplace_back(voxel);
+    }
+    return m_internal_generate();
+}
+
 bool voxel_processor::generate_voxel_space (const std::vector<roiWindow<P8U>>& images,
                                             const std::vector<int>& indicies){
     if (m_load(images, m_voxel_sample.first, m_voxel_sample.second, indicies))
@@ -401,5 +599,204 @@ bool  voxel_processor::m_load(const std::vector<roiWindow<P8U>> &images,
     return ok;
 }
 
+/*
+ voxel_feature_processor
+*/
+
+namespace {
+    // Runs func(first, last) over blocks of [0, count) on up to nthreads threads
+    template<typename F>
+    void run_blocks (size_t count, size_t block, unsigned int nthreads, F&& func){
+        std::atomic<size_t> next (0);
+        auto worker = [&](){
+            for (size_t first = next.fetch_add(block); first < count; first = next.fetch_add(block))
+                func(first, std::min(count, first + block));
+        };
+        size_t blocks = (count + block - 1) / block;
+        nthreads = static_cast<unsigned int>(std::max(size_t(1), std::min(size_t(nthreads), blocks)));
+        std::vector<std::thread> threads;
+        for (unsigned int tt = 1; tt < nthreads; tt++) threads.emplace_back(worker);
+        worker();
+        std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+    }
+}
+
+voxel_feature_processor::voxel_feature_processor(int order, unsigned int threads) :
+m_threads(threads), m_voxel_count(0), m_voxel_length(0) {
+    this->order(order);
+    sample(1);
+    if (m_threads == 0) m_threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+const std::vector<float>& voxel_feature_processor::permutation_entropies (int order) const {
+    static std::vector<float> s_empty;
+    if (order < min_order || order > max_order) return s_empty;
+    return m_entropies[order - min_order];
+}
+
+bool voxel_feature_processor::m_gather (const std::vector<roiWindow<P8U>>& images, const std::vector<int>& indicies){
+    m_voxel_length = indicies.empty() ? images.size() : indicies.size();
+    if (m_voxel_length == 0) return false;
+    int first_index = indicies.empty() ? 0 : indicies[0];
+    image_size(images[first_index].width(), images[first_index].height());
+    uint32_t expected_width = m_expected_segmented_size.first;
+    uint32_t expected_height = m_expected_segmented_size.second;
+    m_voxel_count = size_t(expected_width) * expected_height;
+    m_series.resize(m_voxel_count * m_voxel_length);
+    
+    // One pass over the frames. Each frame fills one contiguous row of the time major buffer
+    for (auto tt = 0; tt < m_voxel_length; tt++){
+        const roiWindow<P8U>& image = images[indicies.empty() ? tt : indicies[tt]];
+        if (image.width() != images[first_index].width() || image.height() != images[first_index].height())
+            return false;
+        uint8_t* dst = &m_series[tt * m_voxel_count];
+        for (int row = 0; row < expected_height; row++){
+            const uint8_t* src = image.rowPointer(m_half_offset.second + row * m_voxel_sample.second) + m_half_offset.first;
+            for (int col = 0; col < expected_width; col++, src += m_voxel_sample.first)
+                *dst++ = *src;
+        }
+    }
+    return true;
+}
+
+void voxel_feature_processor::m_permutation_entropy_block (size_t first, size_t last){
+    const int orders = max_order - min_order + 1;
+    const int max_lag = max_order - 1;
+    const size_t length = m_voxel_length;
+    const size_t bsize = last - first;
+    static const std::array<uint16_t, max_order> factorials = {{ 1, 1, 2, 6, 24, 120 }};
+    
+    // Per thread histograms, one per voxel in the block and per order, laid out back to back
+    std::array<size_t, max_order - min_order + 2> offsets;
+    offsets[0] = 0;
+    for (int oo = 0; oo < orders; oo++)
+        offsets[oo+1] = offsets[oo] + factorials[min_order + oo - 1] * (min_order + oo);
+    std::vector<uint32_t> hist (offsets[orders] * bsize, 0);
+    
+    // ranks[l][b] holds i_l for voxel b. codes[b] is the mixed radix ordinal pattern
+    std::vector<uint8_t> ranks ((max_lag + 1) * bsize, 0);
+    std::vector<uint16_t> codes (bsize);
+    
+    for (size_t tt = 1; tt < length; tt++){
+        const uint8_t* current = &m_series[tt * m_voxel_count + first];
+        const int lags = static_cast<int>(std::min(size_t(max_lag), tt));
+        // descending so that ranks[l-1] still holds the value at t-1
+        for (int ll = lags; ll >= 1; ll--){
+            const uint8_t* past = &m_series[(tt - ll) * m_voxel_count + first];
+            uint8_t* rl = &ranks[ll * bsize];
+            const uint8_t* rp = &ranks[(ll - 1) * bsize];
+            for (size_t bb = 0; bb < bsize; bb++)
+                rl[bb] = rp[bb] + (past[bb] > current[bb]);
+        }
+        if (tt + 1 < min_order) continue;
+        std::fill(codes.begin(), codes.end(), 0);
+        for (int ll = 1; ll < min_order - 1; ll++){
+            const uint8_t* rl = &ranks[ll * bsize];
+            for (size_t bb = 0; bb < bsize; bb++) codes[bb] += rl[bb] * factorials[ll];
+        }
+        for (int oo = 0; oo < orders; oo++){
+            const int order = min_order + oo;
+            if (tt + 1 < order) break;
+            const uint8_t* rl = &ranks[(order - 1) * bsize];
+            const uint16_t ff = factorials[order - 1];
+            const size_t hsize = offsets[oo+1] - offsets[oo];
+            uint32_t* hh = &hist[offsets[oo] * bsize];
+            for (size_t bb = 0; bb < bsize; bb++){
+                codes[bb] += rl[bb] * ff;
+                hh[bb * hsize + codes[bb]]++;
+            }
+        }
+    }
+    
+    for (int oo = 0; oo < orders; oo++){
+        const int order = min_order + oo;
+        const size_t hsize = offsets[oo+1] - offsets[oo];
+        const double windows = double(length) - order + 1;
+        const double norm = std::log(double(hsize));
+        for (size_t bb = 0; bb < bsize; bb++){
+            float& entropy = m_entropies[oo][first + bb];
+            if (windows < 1) { entropy = 0; continue; }
+            const uint32_t* hh = &hist[offsets[oo] * bsize + bb * hsize];
+            double ee = 0;
+            for (size_t kk = 0; kk < hsize; kk++){
+                if (hh[kk] == 0) continue;
+                double pp = hh[kk] / windows;
+                ee -= pp * std::log(pp);
+            }
+            entropy = static_cast<float>(ee / norm);
+        }
+    }
+}
+
+void voxel_feature_processor::m_spectrum_block (size_t first, size_t last){
+    const int length = static_cast<int>(m_voxel_length);
+    const int padded = cv::getOptimalDFTSize(length);
+    const int rows = static_cast<int>(last - first);
+    cv::Mat series = cv::Mat::zeros(rows, padded, CV_32F);
+    for (int tt = 0; tt < length; tt++){
+        const uint8_t* src = &m_series[tt * m_voxel_count + first];
+        for (int bb = 0; bb < rows; bb++) series.at<float>(bb, tt) = src[bb];
+    }
+    for (int bb = 0; bb < rows; bb++){
+        cv::Mat row = series.row(bb).colRange(0, length);
+        row -= cv::mean(row)[0];
+    }
+    cv::Mat spectrum;
+    cv::dft(series, spectrum, cv::DFT_ROWS | cv::DFT_COMPLEX_OUTPUT);
+    
+    for (int bb = 0; bb < rows; bb++){
+        const cv::Vec2f* bins = spectrum.ptr<cv::Vec2f>(bb);
+        double total = 0, peak = 0;
+        int peak_bin = 0;
+        for (int kk = 1; kk <= padded / 2; kk++){
+            double pp = bins[kk][0] * bins[kk][0] + bins[kk][1] * bins[kk][1];
+            total += pp;
+            if (pp > peak) { peak = pp; peak_bin = kk; }
+        }
+        m_dominant_frequency[first + bb] = float(peak_bin) / padded;
+        m_dominant_power[first + bb] = total > 0 ? float(peak / total) : 0.0f;
+    }
+}
+
+bool voxel_feature_processor::generate_voxel_features (const std::vector<roiWindow<P8U>>& images,
+                                                       const std::vector<int>& indicies){
+    if (images.empty() || ! m_gather(images, indicies)) return false;
+    
+    for (auto& ee : m_entropies) ee.assign(m_voxel_count, 0.0f);
+    m_dominant_frequency.assign(m_voxel_count, 0.0f);
+    m_dominant_power.assign(m_voxel_count, 0.0f);
+    
+    std::string msg = " Generating Voxel Features @ (" + to_string(m_voxel_sample.first) + "," +
+    to_string(m_voxel_sample.second) + ") over " + to_string(m_voxel_length) + " frames";
+    vlogger::instance().console()->info("starting " + msg);
+    
+    // Blocks of voxels are wide enough for the comparison loops to vectorize
+    run_blocks(m_voxel_count, 64, m_threads, [this](size_t first, size_t last){
+        m_permutation_entropy_block(first, last);
+        m_spectrum_block(first, last);
+    });
+    
+    vlogger::instance().console()->info("finished voxel features");
+    return true;
+}
+
+std::vector<float> voxel_feature_processor::surface (feature ff) const {
+    std::vector<float> out;
+    switch (ff){
+        case feature::permutation_entropy:
+        {
+            // Random ( still ) voxels approach an entropy of 1, periodic motion lowers it
+            const std::vector<float>& pe = permutation_entropies();
+            out.resize(pe.size());
+            std::transform(pe.begin(), pe.end(), out.begin(), [](float ee){ return 1.0f - ee; });
+            break;
+        }
+        case feature::dominant_power:
+            out = m_dominant_power;
+            break;
+    }
+    return out;
+}
+
 #pragma GCC diagnostic pop
 
@@ -26,6 +26,7 @@
 #include "ssmt.hpp"
 #include "logger/logger.hpp"
 #include "result_serialization.h"
+#include "result_cache.hpp"
 #include "segmentation_parameters.hpp"
 #include <OpenImageIO/imageio.h>
 #include "algo_runners.hpp"
@@ -57,47 +58,73 @@ using namespace OIIO;
 
 // Return 2D latice of pixels over time
 void ssmt_processor::generateVoxels_on_channel (const int channel_index){
-    generateVoxelsAndSelfSimilarities(m_all_by_channel[channel_index]);
+    generateVoxelsAndSelfSimilarities(*staged_channel(channel_index));
 }
 
 
 // Generate latice of voxel self-similarity
 /*
  * parameters: m_voxel_sample, m_expected_segmented_size,
+ * Results are cached keyed on the content of the frames and the voxel lattice. Every entropy is a projection of a
+ * voxel's similarity to all other voxels, so a cached lattice is reused whole or not at all. Lattices of different
+ * samplings are kept side by side.
  */
 
 void ssmt_processor::generateVoxelsAndSelfSimilarities (const std::vector<roiWindow<P8U>>& images){
     
     bool cache_ok = false;
-    std::shared_ptr<internalContainer> ssref;
-
     voxel_processor vp;
     vp.sample(m_voxel_sample.first, m_voxel_sample.second);
     vp.image_size(m_loaded_spec.getSectionSize().first, m_loaded_spec.getSectionSize().second);
+    const uint64_t rows = uint64_t(std::max(0, vp.segmented_size().second));
+    const uint64_t cols = uint64_t(std::max(0, vp.segmented_size().first));
+    
+    // Same content hash as the volume pass keeps, so its voxel lattice can be matched to these frames
+    const uint64_t content = VolumeAccumulator::content_hash(images);
+    content_hasher phash;
+    const std::string& name = m_params.internal_container_cache_name();
+    phash.update(name.data(), name.size());
+    phash.update_value(m_voxel_sample.first);
+    phash.update_value(m_voxel_sample.second);
+    phash.update_value(m_loaded_spec.getSectionSize().first);
+    phash.update_value(m_loaded_spec.getSectionSize().second);
+    phash.update_value(images.size());
+    mappedResultCache::key_t key (content, phash.digest());
+    
+    // Named by the parameters: a re-export of the serie replaces its entry, other samplings keep theirs
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key.params_hash));
+    auto cache_path = mCurrentCachePath / (name + hex + mappedResultCache::extension());
     
-    if(bfs::exists(mCurrentCachePath)){
-        auto cache_path = mCurrentCachePath / m_params.internal_container_cache_name ();
-        if(bfs::exists(cache_path)){
-            ssref = internalContainer::create(cache_path);
+    if(bfs::exists(mCurrentCachePath) && rows * cols > 0){
+        auto ssref = mappedResultCache::open<float>(cache_path, key, rows, cols);
+        if (ssref){
+            cache_ok = true;
+            m_voxel_entropies.assign(ssref->data<float>(), ssref->data<float>() + rows * cols);
         }
-        cache_ok = ssref && ssref->size_check(m_expected_segmented_size.first*m_expected_segmented_size.second);
     }
     
     if(cache_ok){
         vlogger::instance().console()->info(" IC container cache : Hit ");
-        m_voxel_entropies.insert(m_voxel_entropies.end(), ssref->data().begin(),
-                                 ssref->data().end());
             // Call the voxel ready cb if any
         if (signal_ss_voxel_ready && signal_ss_voxel_ready->num_slots() > 0)
             signal_ss_voxel_ready->operator()(m_voxel_entropies);
         
     }else{ // Fill Cache
         
-        auto cache_path = mCurrentCachePath / m_params.internal_container_cache_name ();
-        
         vlogger::instance().console()->info("starting generating voxel self-similarity");
    
-        if (vp.generate_voxel_space(images)){
+        // Voxels gathered by run_volume_stats on the same frames avoid another pass over them.
+        // Its lattice follows the frame size, fall back to the frames if it does not match this one
+        bool have_lattice = m_volume && m_volume->frame_count() == images.size() &&
+            m_volume->content_hash() == content && m_volume->lattice_sample() == m_voxel_sample;
+        bool generated = have_lattice && vp.generate_voxel_space(*m_volume);
+        if (! generated){
+            vp.sample(m_voxel_sample.first, m_voxel_sample.second);
+            vp.image_size(m_loaded_spec.getSectionSize().first, m_loaded_spec.getSectionSize().second);
+            generated = vp.generate_voxel_space(images);
+        }
+        if (generated){
             
             vlogger::instance().console()->info("copying results of voxel self-similarity");
             m_voxel_entropies = vp.entropies();
@@ -107,16 +134,41 @@ void ssmt_processor::generateVoxelsAndSelfSimilarities (const std::vector<roiWin
                 signal_ss_voxel_ready->operator()(m_voxel_entropies);
             
                 // Fill the Cache
-            bool ok = internalContainer::store(cache_path, m_voxel_entropies);
-            if(ok)
-                vlogger::instance().console()->info(" SS result container cache : filled ");
-            else
-                vlogger::instance().console()->info(" SS result container cache : failed ");
+            if (bfs::exists(mCurrentCachePath) && m_voxel_entropies.size() == rows * cols){
+                bool ok = mappedResultCache::store<float>(cache_path, key, rows, cols, m_voxel_entropies.data());
+                if(ok){
+                    vlogger::instance().console()->info(" SS result container cache : filled ");
+                    mappedResultCache::evict(mCurrentCachePath.parent_path());
+                }
+                else
+                    vlogger::instance().console()->info(" SS result container cache : failed ");
+            }
         }
     }
     assert(m_voxel_entropies.empty() == false);
 }
     
+// Generate latice of per voxel temporal features ( permutation entropy or dominant frequency power )
+// The feature surface replaces the voxel self-similarity entropies and is delivered through signal_ss_voxel_ready
+void ssmt_processor::generateVoxelFeatures (const std::vector<roiWindow<P8U>>& images){
+    voxel_feature_processor vfp (m_params.permutation_order());
+    vfp.sample(m_voxel_sample.first, m_voxel_sample.second);
+    
+    vlogger::instance().console()->info("starting generating voxel features");
+    if (! vfp.generate_voxel_features(images)){
+        vlogger::instance().console()->error("voxel features failed");
+        return;
+    }
+    auto feature = m_params.voxel_feature() == fynSegmenter::voxel_feature::dominant_power ?
+        voxel_feature_processor::feature::dominant_power : voxel_feature_processor::feature::permutation_entropy;
+    m_voxel_entropies = vfp.surface(feature);
+    
+    // Call the voxel ready cb if any
+    if (signal_ss_voxel_ready && signal_ss_voxel_ready->num_slots() > 0)
+        signal_ss_voxel_ready->operator()(m_voxel_entropies);
+    assert(m_voxel_entropies.empty() == false);
+}
+
 void ssmt_processor::create_voxel_surface (std::vector<float>& env){
     voxel_processor vp;
     vp.sample(m_voxel_sample.first, m_voxel_sample.second);
@@ -24,6 +24,7 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <random>
 #include "gtest/gtest.h"
 #include <memory>
 #include <thread>
@@ -58,6 +59,10 @@
 #include "ut_localvar.hpp"
 #include "vision/labelBlob.hpp"
 #include "result_serialization.h"
+#include "result_cache.hpp"
+#include "image_ingest.hpp"
+#include "movie_segments.hpp"
+#include "frame_cache.hpp"
 #include <cereal/cereal.hpp>
 #include <cereal/types/memory.hpp>
 #include <cereal/types/utility.hpp>
@@ -67,6 +72,7 @@
 #include "result_serialization.h"
 #include "cvplot/cvplot.h"
 #include "time_series/persistence1d.hpp"
+#include "time_series/signal_lod.hpp"
 #include "timed_types.h"
 #include "cinder/CinderImGui.h"
 #include "logger/logger.hpp"
@@ -93,6 +99,7 @@
 #include "vision/ellipse.hpp"
 #include <cmath>
 #include "nr_support.hpp"
+#include "dbscan.h"
 
 
 
@@ -1134,6 +1141,26 @@ TEST(cluster, basic){
     
 }
 
+TEST(cluster_dbscan, grid){
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> uni(0.0f, 60.0f);
+    std::vector<DBSCAN::Point> points;
+    for (auto ii = 0; ii < 3000; ii++)
+        points.push_back(DBSCAN::Point{uni(gen), uni(gen), float(int(uni(gen)) % 3), UNCLASSIFIED});
+    
+    DBSCAN serial(4, 1.2f, points);
+    serial.run();
+    gridDBSCAN indexed(4, 1.2f, points);
+    indexed.run();
+    
+    EXPECT_EQ(serial.points().size(), indexed.points().size());
+    for (auto ii = 0; ii < points.size(); ii++)
+        EXPECT_EQ(serial.points()[ii].clusterID, indexed.points()[ii].clusterID);
+    auto serial_hist = serial.cluster_hist();
+    EXPECT_TRUE(serial_hist == indexed.cluster_hist());
+    EXPECT_TRUE(serial_hist.size() > 1);
+}
+
 TEST(chull, basic){
     typedef bg::model::point<float, 2, bg::cs::cartesian> point_2d;
     typedef bg::model::box<point_2d> box_2d;
@@ -1817,6 +1844,101 @@ TEST(ut_permutation_entropy, n_2){
     }
 }
 
+TEST(ut_permutation_entropy, voxel_features){
+    // Noise everywhere except a 16x16 patch oscillating with a period of 8 frames
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> noise(0, 255);
+    std::vector<roiWindow<P8U>> frames;
+    const int count = 256;
+    for (auto tt = 0; tt < count; tt++){
+        roiWindow<P8U> frame (32, 32);
+        // Noise has no ties within a window, the reference implementation does not handle them
+        for (auto row = 0; row < 32; row++)
+            for (auto col = 0; col < 32; col++){
+                uint8_t val = noise(gen);
+                for (auto back = 1; back < 6 && back <= tt; back++)
+                    if (frames[tt - back].getPixel(col, row) == val) { val = noise(gen); back = 0; }
+                frame.setPixel(col, row, val);
+            }
+        uint8_t val = uint8_t(128 + 100 * std::sin(2 * svl::constants::pi * tt / 8.0));
+        for (auto row = 8; row < 24; row++)
+            for (auto col = 8; col < 24; col++)
+                frame.setPixel(col, row, val);
+        frames.push_back(frame);
+    }
+    
+    voxel_feature_processor vfp (4, 2);
+    vfp.sample(1);
+    EXPECT_TRUE(vfp.generate_voxel_features(frames));
+    EXPECT_EQ(vfp.segmented_size(), iPair(32,32));
+    
+    for (auto order = voxel_feature_processor::min_order; order <= voxel_feature_processor::max_order; order++){
+        const auto& pe = vfp.permutation_entropies(order);
+        EXPECT_EQ(pe.size(), 32*32);
+        // Compare against the reference implementation ( un-normalized, in bits )
+        for (auto idx : {0, 5 * 32 + 3, 30 * 32 + 31}){
+            std::vector<double> series;
+            for (const auto& ff : frames) series.push_back(ff.getPixel(idx % 32, idx / 32));
+            auto ref = permutation_entropy::permutation_entropy_dictionary_stats(series, order);
+            EXPECT_NEAR(pe[idx] * std::log2(double(permutation_entropy::factorial(order))), ref, 1.e-4);
+        }
+    }
+    
+    const auto& pe = vfp.permutation_entropies();
+    // 8 equally likely patterns: log(8) / log(4!)
+    EXPECT_TRUE(pe[16 * 32 + 16] < 0.7f);
+    EXPECT_TRUE(pe[2 * 32 + 2] > 0.9f);
+    EXPECT_NEAR(vfp.dominant_frequencies()[16 * 32 + 16], 1.0 / 8.0, 1.e-3);
+    auto surface = vfp.surface(voxel_feature_processor::feature::dominant_power);
+    EXPECT_TRUE(surface[16 * 32 + 16] > surface[2 * 32 + 2]);
+}
+
+TEST(ut_permutation_entropy, voxel_feature_ties){
+    // Few grey levels and constant runs: most windows have ties
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> levels(0, 2);
+    std::vector<roiWindow<P8U>> frames;
+    const int count = 96;
+    for (auto tt = 0; tt < count; tt++){
+        roiWindow<P8U> frame (8, 8);
+        for (auto row = 0; row < 8; row++)
+            for (auto col = 0; col < 8; col++)
+                frame.setPixel(col, row, uint8_t(row == 0 ? 17 : 10 * levels(gen)));
+        frames.push_back(frame);
+    }
+    
+    voxel_feature_processor vfp (4, 2);
+    vfp.sample(1);
+    EXPECT_TRUE(vfp.generate_voxel_features(frames));
+    
+    // Brute force: pattern of a window is its stable sort order, i.e. of two equal values the earlier ranks lower
+    auto stable_pe = [](const std::vector<int>& series, int order){
+        std::map<std::vector<int>, int> counts;
+        for (size_t ss = 0; ss + order <= series.size(); ss++){
+            std::vector<int> pattern (order);
+            std::iota(pattern.begin(), pattern.end(), 0);
+            std::stable_sort(pattern.begin(), pattern.end(), [&](int a, int b){ return series[ss + a] < series[ss + b]; });
+            counts[pattern]++;
+        }
+        double total = series.size() - order + 1;
+        double pe = 0;
+        for (const auto& cc : counts) { double p = cc.second / total; pe -= p * std::log(p); }
+        return pe / std::log(double(permutation_entropy::factorial(order)));
+    };
+    
+    for (auto order = voxel_feature_processor::min_order; order <= voxel_feature_processor::max_order; order++){
+        const auto& pe = vfp.permutation_entropies(order);
+        EXPECT_EQ(pe.size(), 8*8);
+        for (auto idx = 0; idx < 8 * 8; idx++){
+            std::vector<int> series;
+            for (const auto& ff : frames) series.push_back(ff.getPixel(idx % 8, idx / 8));
+            EXPECT_NEAR(pe[idx], stable_pe(series, order), 1.e-4);
+        }
+        // Constant voxels have a single pattern
+        EXPECT_NEAR(pe[3], 0.0, 1.e-6);
+    }
+}
+
 TEST(ut_serialization, ssResultContainer){
     uint32_t cols = 21;
     uint32_t rows = 21;
@@ -1849,6 +1971,64 @@ TEST(ut_serialization, ssResultContainer){
     
 }
 
+TEST(ut_serialization, mappedResultCache){
+    uint32_t dim = 21;
+    std::vector<double> entropy (dim);
+    std::vector<std::vector<double>> sm (dim, std::vector<double> (dim));
+    for (auto j = 0; j < dim; j++){
+        entropy[j] = sin(j * 3.14159 / dim);
+        for (auto i = 0; i < dim; i++)
+            sm[j][i] = 1.0 / (i + j + 1);
+    }
+    
+    std::vector<roiWindow<P8U>> frames;
+    for (auto tt = 0; tt < 4; tt++){
+        frames.emplace_back(32, 32);
+        frames.back().set(tt * 10);
+    }
+    content_hasher chash;
+    chash.update_images(frames);
+    mappedResultCache::key_t key (chash.digest(), dim);
+    
+    auto tempDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir / "serie_a");
+    boost::filesystem::create_directories(tempDir / "serie_b");
+    auto cache_path = tempDir / "serie_a" / ("container_ss_" + mappedResultCache::extension());
+    bool ok = mappedResultCache::store<double>(cache_path, key, dim + 1, dim, [&](uint64_t row){
+        return row == 0 ? entropy.data() : sm[row - 1].data(); });
+    EXPECT_TRUE(ok);
+    
+    auto mapped = mappedResultCache::open<double>(cache_path, key, dim + 1, dim);
+    EXPECT_TRUE(mapped != nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(mapped->data<double>()) % mappedResultCache::c_alignment, 0);
+    for (auto i = 0; i < dim; i++) EXPECT_EQ(entropy[i], mapped->row<double>(0)[i]);
+    for (auto j = 0; j < dim; j++)
+        for (auto i = 0; i < dim; i++)
+            EXPECT_EQ(sm[j][i], mapped->row<double>(j + 1)[i]);
+    mapped.reset();
+    
+    // Changed content, parameters, dimensions or element type are misses
+    frames[2].setPixel(3, 3, 255);
+    content_hasher changed;
+    changed.update_images(frames);
+    EXPECT_TRUE(changed.digest() != key.content_hash);
+    EXPECT_TRUE(mappedResultCache::open<double>(cache_path, mappedResultCache::key_t(changed.digest(), dim)) == nullptr);
+    EXPECT_TRUE(mappedResultCache::open<double>(cache_path, mappedResultCache::key_t(key.content_hash, dim + 1)) == nullptr);
+    EXPECT_TRUE(mappedResultCache::open<double>(cache_path, key, dim, dim) == nullptr);
+    EXPECT_TRUE(mappedResultCache::open<float>(cache_path, key) == nullptr);
+    
+    // LRU eviction across serie folders keeps the most recently used file
+    auto other_path = tempDir / "serie_b" / ("container_ss_" + mappedResultCache::extension());
+    EXPECT_TRUE(mappedResultCache::store<double>(other_path, key, dim + 1, dim, [&](uint64_t row){
+        return row == 0 ? entropy.data() : sm[row - 1].data(); }));
+    boost::filesystem::last_write_time(cache_path, std::time(nullptr) - 100);
+    auto removed = mappedResultCache::evict(tempDir, boost::filesystem::file_size(other_path));
+    EXPECT_TRUE(removed > 0);
+    EXPECT_FALSE(boost::filesystem::exists(cache_path));
+    EXPECT_TRUE(boost::filesystem::exists(other_path));
+    boost::filesystem::remove_all(tempDir);
+}
+
 TEST (ut_dm, basic){
     roiWindow<P8U> p0 (320, 240);
     roiWindow<P8U> pw(p0, 80, 60, 160, 120);
@@ -1992,6 +2172,361 @@ TEST(ut_median, basic){
     
 }
 
+TEST(ut_median_levelset, incremental){
+    const size_t dim = 301;
+    std::mt19937 gen(31);
+    std::uniform_real_distribution<double> dis(0.0, 1.0);
+    vector<double> entropies(dim);
+    for (auto& ee : entropies) ee = dis(gen);
+    vector<vector<double>> smat(dim, vector<double>(dim));
+    for (auto rr = 0; rr < dim; rr++)
+        for (auto cc = rr; cc < dim; cc++)
+            smat[rr][cc] = smat[cc][rr] = rr == cc ? 1.0 : dis(gen);
+    
+    // Full recompute of the signal as column gathers over ranked rows
+    vector<int> ranks;
+    medianLevelSet::Median_levelsets(entropies, ranks);
+    auto reference = [&](float frac){
+        size_t count = std::floor (dim * frac);
+        vector<double> signal(dim);
+        for (auto ii = 0; ii < dim; ii++){
+            double val = 0;
+            for (auto index = 0; index < count; index++)
+                val += smat[ranks[index]][ii];
+            signal[ii] = val / count;
+        }
+        return signal;
+    };
+    
+    medianLevelSet mls;
+    mls.initialize(result_index_channel_t(), 0, medianLevelSet::params(0.01, 0.50, 20));
+    int ready = 0, settled = 0;
+    float settled_frac = -1.0f;
+    std::function<medianLevelSet::sig_cb_mls_pci_ready> ready_cb =
+        [&ready](std::vector<float>&, const result_index_channel_t&, uint32_t&){ ready++; };
+    std::function<medianLevelSet::sig_cb_mls_settled> settled_cb =
+        [&settled, &settled_frac](const std::vector<float>&, const result_index_channel_t&, const uint32_t&, const float& frac){
+            settled++; settled_frac = frac; };
+    mls.registerCallback(ready_cb);
+    mls.registerCallback(settled_cb);
+    mls.load(entropies, smat);
+    
+    // Forward, backward and far jumps all match the full recompute exactly
+    std::vector<float> cutoffs {0.2f, 0.25f, 0.1f, 0.45f, 0.03f, 0.31f, 0.5f, 0.01f};
+    for (auto frac : cutoffs){
+        mls.set_median_levelset_pct(frac);
+        EXPECT_TRUE(mls.leveled() == reference(frac));
+    }
+    EXPECT_EQ(cutoffs.size(), ready);
+    
+    // Same cutoff selects the same entropies: nothing recomputed or signaled
+    mls.set_median_levelset_pct(0.01f);
+    EXPECT_EQ(cutoffs.size(), ready);
+    
+    // Only the last of a quick series of changes is signaled as settled
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(1, settled);
+    EXPECT_FLOAT_EQ(0.01f, settled_frac);
+    
+    // Programmatic changes are not signaled as settled and drop a pending one
+    mls.set_median_levelset_pct(0.2f);
+    mls.set_median_levelset_pct(0.3f, false);
+    EXPECT_TRUE(mls.leveled() == reference(0.3f));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(1, settled);
+}
+
+TEST(ut_signal_lod, decimation){
+    std::mt19937 gen(32);
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+    vector<float> signal(20000);
+    for (auto& val : signal) val = dis(gen);
+    signal[12345] = 2.0f;
+    signal[777] = -1.0f;
+    
+    // Built at once and built sample by sample are the same
+    signal_lod<float> lod (signal);
+    signal_lod<float> grown;
+    for (auto val : signal) grown.append(val);
+    EXPECT_EQ(signal.size(), lod.size());
+    EXPECT_EQ(lod.levels(), grown.levels());
+    
+    // Range extremes against a linear scan
+    for (auto trial = 0; trial < 100; trial++){
+        size_t lo = gen() % signal.size();
+        size_t hi = lo + 1 + gen() % (signal.size() - lo);
+        auto nn = lod.range(lo, hi);
+        auto gg = grown.range(lo, hi);
+        EXPECT_EQ(*std::min_element(signal.begin() + lo, signal.begin() + hi), nn.min_val);
+        EXPECT_EQ(*std::max_element(signal.begin() + lo, signal.begin() + hi), nn.max_val);
+        EXPECT_EQ(nn.min_val, gg.min_val);
+        EXPECT_EQ(nn.max_val, gg.max_val);
+        EXPECT_EQ(signal[nn.min_idx], nn.min_val);
+        EXPECT_EQ(signal[nn.max_idx], nn.max_val);
+    }
+    
+    // At most 2 points per pixel, in order, keeping the extremes
+    vector<float> xs, ys;
+    size_t points = lod.query(0, signal.size() - 1, 500, xs, ys, 0.0, 1.0 / signal.size());
+    EXPECT_LE(points, 1000);
+    EXPECT_EQ(xs.size(), ys.size());
+    EXPECT_TRUE(std::is_sorted(xs.begin(), xs.end()));
+    EXPECT_EQ(2.0f, *std::max_element(ys.begin(), ys.end()));
+    EXPECT_EQ(-1.0f, *std::min_element(ys.begin(), ys.end()));
+    
+    // Zoomed in to fewer samples than pixels: every sample
+    points = lod.query_range(0.5, 0.5 + 100.0 / signal.size(), 500, xs, ys, 0.0, 1.0 / signal.size());
+    EXPECT_EQ(101, points);
+    EXPECT_EQ(signal[10000], ys[0]);
+    
+    // Updates propagate
+    lod.update(5, 3.0f);
+    EXPECT_EQ(3.0f, lod.range(0, signal.size()).max_val);
+    EXPECT_EQ(5, lod.range(0, signal.size()).max_idx);
+}
+
+TEST(ut_image_ingest, headers_order_thumbnails){
+    auto tempDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir);
+    
+    // Sizes from headers, without decoding
+    cv::Mat image (120, 200, CV_8UC3, cv::Scalar(10, 128, 250));
+    cv::circle(image, cv::Point(100, 60), 30, cv::Scalar(255, 255, 255), -1);
+    auto png = tempDir / "frame.png";
+    auto jpg = tempDir / "frame.jpg";
+    auto anonymous = tempDir / "0123456789abcdef0123456789abcdef0123";
+    EXPECT_TRUE(cv::imwrite(png.string(), image));
+    EXPECT_TRUE(cv::imwrite(jpg.string(), image));
+    boost::filesystem::copy_file(jpg, anonymous);
+    iPair size;
+    EXPECT_TRUE(image_header_size(png, size));
+    EXPECT_EQ(iPair(200, 120), size);
+    EXPECT_TRUE(image_header_size(jpg, size));
+    EXPECT_EQ(iPair(200, 120), size);
+    EXPECT_TRUE(image_header_size(anonymous, size));
+    EXPECT_EQ(iPair(200, 120), size);
+    {
+        std::ofstream junk ((tempDir / "junk.png").string(), std::ios::binary);
+        junk << "not an image";
+    }
+    EXPECT_FALSE(image_header_size(tempDir / "junk.png", size));
+    
+    // Delivered in order, never more than window decoded ahead
+    ordered_ingest<size_t> ingest (4, 6);
+    std::atomic<size_t> decoded (0);
+    vector<size_t> delivered;
+    size_t max_ahead = 0;
+    auto count = ingest.run(200,
+                            [&decoded] (size_t index) {
+                                decoded++;
+                                std::this_thread::sleep_for(std::chrono::microseconds(200 * (index % 7)));
+                                return index * index;
+                            },
+                            [&] (size_t index, size_t& result) {
+                                max_ahead = std::max(max_ahead, decoded.load() - delivered.size());
+                                EXPECT_EQ(index * index, result);
+                                delivered.push_back(index);
+                                return true;
+                            });
+    EXPECT_EQ(200, count);
+    EXPECT_TRUE(std::is_sorted(delivered.begin(), delivered.end()));
+    EXPECT_LE(max_ahead, ingest.window());
+    
+    // Stopping early
+    count = ingest.run(200, [] (size_t index) { return index; }, [] (size_t index, size_t&) { return index < 9; });
+    EXPECT_EQ(10, count);
+    
+    // Thumbnails: decoded once, mapped afterwards
+    thumbnail_cache thumbs (tempDir / "thumbnails", 4);
+    cv::Mat first = thumbs.get(jpg);
+    EXPECT_EQ(50, first.cols);
+    EXPECT_EQ(30, first.rows);
+    EXPECT_EQ(CV_8UC3, first.type());
+    EXPECT_EQ(0, thumbs.hits());
+    EXPECT_EQ(1, thumbs.misses());
+    cv::Mat second = thumbs.get(jpg);
+    EXPECT_EQ(1, thumbs.hits());
+    EXPECT_EQ(0, cv::norm(first, second, cv::NORM_INF));
+    thumbnail_cache reopened (tempDir / "thumbnails", 4);
+    EXPECT_FALSE(reopened.get(png).empty());
+    EXPECT_FALSE(reopened.get(jpg).empty());
+    EXPECT_EQ(1, reopened.hits());
+    EXPECT_TRUE(thumbs.get(tempDir / "junk.png").empty());
+    
+    boost::filesystem::remove_all(tempDir);
+}
+
+TEST(ut_movie_segments, ordered_concurrent_decode){
+    auto tempDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir);
+    auto movie = tempDir / "segments.avi";
+    {
+        cv::VideoWriter writer (movie.string(), cv::VideoWriter::fourcc('M','J','P','G'), 30.0, cv::Size(64, 48));
+        ASSERT_TRUE(writer.isOpened());
+        for (auto ff = 0; ff < 300; ff++){
+            cv::Mat frame (48, 64, CV_8UC3, cv::Scalar(20, 40, ff % 200));
+            cv::putText(frame, to_string(ff), cv::Point(2, 30), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(255, 255, 255));
+            writer << frame;
+        }
+    }
+    
+    // One decoder is the sequential reference
+    segmented_movie_reader sequential (movie, 1);
+    ASSERT_TRUE(sequential.isValid());
+    EXPECT_EQ(iPair(64, 48), sequential.size());
+    EXPECT_EQ(1, sequential.segments().size());
+    vector<roiWindow<P8U>> reference;
+    size_t count = 0;
+    EXPECT_TRUE(sequential.run([&reference] (size_t, roiWindow<P8U>& rw) { reference.push_back(rw); return true; }, count));
+    EXPECT_EQ(300, count);
+    
+    // Concurrent decoders deliver the same frames in the same order
+    segmented_movie_reader concurrent (movie, 4, 2);
+    EXPECT_EQ(4, concurrent.segments().size());
+    size_t mismatches = 0;
+    EXPECT_TRUE(concurrent.run([&] (size_t index, roiWindow<P8U>& rw) {
+        if (index >= reference.size() || rw.size() != reference[index].size()) { mismatches++; return true; }
+        for (auto row = 0; row < rw.height(); row++)
+            if (std::memcmp(rw.rowPointer(row), reference[index].rowPointer(row), rw.width()) != 0) { mismatches++; break; }
+        return true;
+    }, count));
+    EXPECT_EQ(300, count);
+    EXPECT_EQ(0, mismatches);
+    
+    // Red channel
+    EXPECT_NEAR(150, reference[150].getPixel(60, 45), 3);
+    
+    boost::filesystem::remove_all(tempDir);
+}
+
+TEST(ut_iowriter, write_behind){
+    auto tempDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir);
+    vector<roiWindow<P8U>> frames;
+    for (auto ff = 0; ff < 40; ff++){
+        frames.emplace_back(64, 48);
+        frames.back().set(uint8_t(ff * 5));
+    }
+    std::atomic<int> written (0), completed (0);
+    std::function<ioWriteBehind::writer_info_delegate> info_cb = [&] (int, bool last) {
+        written++;
+        if (last) completed++;
+    };
+    
+    // Frames, then signals, queued without waiting for the encoders. Never more than capacity queued
+    {
+        ioWriteBehind writer (ioWriteBehind::codec::png_fast, 3, 8);
+        writer.registerCallback(info_cb);
+        EXPECT_TRUE(writer(tempDir.string(), frames));
+        EXPECT_LE(writer.pending(), writer.capacity());
+        vector<vector<float>> signals (3, vector<float> {1.0f, 2.0f, 3.0f});
+        EXPECT_TRUE(writer(tempDir.string(), signals));
+        writer.wait();
+        EXPECT_EQ(43, writer.written());
+        EXPECT_EQ(0, writer.failed());
+        EXPECT_EQ(43, written.load());
+        EXPECT_EQ(2, completed.load());
+        EXPECT_FALSE(writer((tempDir / "missing").string(), frames));
+        EXPECT_EQ(3, completed.load());
+    }
+    cv::Mat png = cv::imread((tempDir / "image17.png").string(), cv::IMREAD_GRAYSCALE);
+    ASSERT_FALSE(png.empty());
+    EXPECT_EQ(48, png.rows);
+    EXPECT_EQ(17 * 5, png.at<uint8_t>(20, 30));
+    EXPECT_TRUE(boost::filesystem::exists(tempDir / "image2.csv"));
+    
+    // One container per channel, written by the destructor at the latest
+    auto container = tempDir / "container";
+    boost::filesystem::create_directories(container);
+    {
+        ioWriteBehind writer (ioWriteBehind::codec::tiff_container, 2, 8);
+        EXPECT_TRUE(writer(container.string(), frames));
+    }
+    vector<cv::Mat> pages;
+    EXPECT_TRUE(cv::imreadmulti((container / "image.tif").string(), pages, cv::IMREAD_GRAYSCALE));
+    ASSERT_EQ(40, pages.size());
+    EXPECT_EQ(39 * 5, pages[39].at<uint8_t>(0, 0));
+    
+    boost::filesystem::remove_all(tempDir);
+}
+
+TEST(ut_frame_cache, budget_lru_read_ahead){
+    typedef roiWindow<P8U> frame_t;
+    std::atomic<int> decodes (0);
+    auto decode = [&decodes] (int64_t index, frame_t& frame) {
+        if (index >= 200) return false;
+        decodes++;
+        frame = frame_t (64, 48);
+        frame.set(uint8_t(index));
+        return true;
+    };
+    auto bytes = [] (const frame_t& frame) { return size_t(frame.width()) * frame.height(); };
+    
+    // Room for 16 frames, 6 read ahead and 2 behind
+    lru_frame_cache<frame_t> cache (16 * 64 * 48, bytes, decode, 200, 6, 2);
+    frame_t frame;
+    for (int64_t ff = 0; ff < 200; ff++){
+        ASSERT_TRUE(cache.get(ff, frame));
+        EXPECT_EQ(ff, frame.getPixel(10, 10));
+        EXPECT_LE(cache.bytes(), cache.budget());
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    EXPECT_EQ(1, cache.direction());
+    EXPECT_GT(cache.hits(), 150);
+    
+    // Playing backwards reads ahead backwards
+    auto hits = cache.hits();
+    for (int64_t ff = 199; ff >= 100; ff--){
+        ASSERT_TRUE(cache.get(ff, frame));
+        EXPECT_EQ(ff, frame.getPixel(10, 10));
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    EXPECT_EQ(-1, cache.direction());
+    EXPECT_GT(cache.hits() - hits, 75);
+    EXPECT_FALSE(cache.get(200, frame));
+    EXPECT_LE(cache.resident(), 16);
+    
+    // Readers share the cache
+    std::atomic<int> wrong (0);
+    std::vector<std::thread> readers;
+    for (auto tt = 0; tt < 4; tt++)
+        readers.emplace_back([&cache, &wrong, tt] () {
+            frame_t ff;
+            for (auto ii = 0; ii < 400; ii++){
+                int64_t index = (ii * 7 + tt * 31) % 200;
+                if (! cache.get(index, ff) || ff.getPixel(0, 0) != index) wrong++;
+            }
+        });
+    std::for_each(readers.begin(), readers.end(), std::mem_fn(&std::thread::join));
+    EXPECT_EQ(0, wrong.load());
+    EXPECT_LE(cache.bytes(), cache.budget());
+    
+    // Time stamps: strictly increasing, nearest frame
+    lru_frame_cache<frame_t> timed (2 * 64 * 48, bytes);
+    int64_t index;
+    for (auto ff = 0; ff < 60; ff++){
+        EXPECT_TRUE(timed.add_time(ff / 30.0 + (ff == 20 ? 0.01 : 0.0), index));
+        EXPECT_EQ(ff, index);
+    }
+    EXPECT_FALSE(timed.add_time(1.0, index));
+    EXPECT_EQ(0, timed.index_of(-1.0));
+    EXPECT_EQ(20, timed.index_of(20 / 30.0 + 0.006));
+    EXPECT_EQ(-1, timed.index_of(3.0));
+    for (auto ff = 0; ff < 60; ff++)
+        EXPECT_EQ(ff, timed.index_of(timed.time_of(ff)));
+    
+    // Least recently used goes first
+    EXPECT_TRUE(timed.insert(0, frame_t (64, 48)));
+    EXPECT_TRUE(timed.insert(1, frame_t (64, 48)));
+    EXPECT_FALSE(timed.insert(1, frame_t (64, 48)));
+    EXPECT_TRUE(timed.get(0, frame));
+    EXPECT_TRUE(timed.insert(2, frame_t (64, 48)));
+    EXPECT_TRUE(timed.contains(0));
+    EXPECT_FALSE(timed.contains(1));
+    EXPECT_TRUE(timed.contains(2));
+    EXPECT_FALSE(timed.get(1, frame));
+}
+
 void done_callback (void)
 {
     std::cout << "Done"  << std::endl;
@@ -2128,6 +2663,63 @@ TEST (ut_3d_per_element, standard_dev)
 }
 
 
+TEST (ut_3d_per_element, fused_volume)
+{
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> pels(0, 255);
+    vector<roiWindow<P8U>> frames;
+    for (auto tt = 0; tt < 37; tt++){
+        roiWindow<P8U> frame (33, 21);
+        for (auto row = 0; row < frame.height(); row++)
+            for (auto col = 0; col < frame.width(); col++)
+                frame.setPixel(col, row, pels(gen));
+        frames.push_back(frame);
+    }
+    
+    // Reference: per frame histoStats and SequenceAccumulator
+    std::vector<std::tuple<int64_t,int64_t,uint32_t>> cts;
+    std::vector<std::tuple<uint8_t,uint8_t>> rts;
+    IntensityStatisticsPartialRunner()(frames, cts, rts);
+    cv::Mat ref_sum, ref_sqsum;
+    int image_count = 0;
+    std::atomic<bool> done;
+    SequenceAccumulator()(frames, ref_sum, ref_sqsum, image_count, done);
+    
+    VolumeAccumulator volume (4);
+    volume.lattice(uiPair(3,3));
+    EXPECT_TRUE(volume(frames));
+    EXPECT_EQ(volume.frame_count(), frames.size());
+    EXPECT_TRUE(volume.moments() == cts);
+    EXPECT_TRUE(volume.ranges() == rts);
+    for (auto ff = 0; ff < frames.size(); ff++){
+        histoStats hh;
+        hh.from_image(frames[ff]);
+        for (auto bin = 0; bin < 256; bin++)
+            EXPECT_EQ(hh.histogram()[bin], volume.histograms()[ff][bin]);
+    }
+    
+    cv::Mat m_sum, m_sqsum;
+    volume.sums(m_sum, m_sqsum);
+    EXPECT_EQ(cv::norm(m_sum, ref_sum, NORM_INF), 0.0);
+    EXPECT_EQ(cv::norm(m_sqsum, ref_sqsum, NORM_INF), 0.0);
+    
+    // Lattice matches voxel_processor sampling: 3x3 sample has a half offset of 1
+    EXPECT_EQ(volume.lattice_size(), iPair(32 / 3, 20 / 3));
+    const auto& series = volume.lattice_series();
+    size_t count = volume.lattice_size().first * volume.lattice_size().second;
+    for (auto tt = 0; tt < frames.size(); tt++)
+        for (auto row = 0; row < volume.lattice_size().second; row++)
+            for (auto col = 0; col < volume.lattice_size().first; col++)
+                EXPECT_EQ(series[tt * count + row * volume.lattice_size().first + col], frames[tt].getPixel(1 + col * 3, 1 + row * 3));
+    
+    // Reuse is keyed on content: a copy of the frames matches, a changed pixel does not
+    vector<roiWindow<P8U>> copies;
+    for (const auto& frame : frames) copies.push_back(frame.clone());
+    EXPECT_EQ(volume.content_hash(), VolumeAccumulator::content_hash(copies, 3));
+    copies[20].setPixel(5, 5, uint8_t(copies[20].getPixel(5, 5) + 1));
+    EXPECT_NE(volume.content_hash(), VolumeAccumulator::content_hash(copies, 3));
+}
+
 TEST (ut_ss_voxel, basic){
     
     // Create N X M 1 dimentional roiWindows sized 1 x 64. Containing sin s
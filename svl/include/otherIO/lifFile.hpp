@@ -32,6 +32,8 @@
 #include <map>
 #include <stdexcept>
 #include <memory>
+#include <mutex>
+#include <atomic>
 #include <boost/utility.hpp>
 #include <boost/noncopyable.hpp>
 
@@ -44,12 +46,24 @@ namespace lifIO
     struct DimensionData;
     struct ScannerSettingRecord;
     struct FilterSettingRecord;
+    class LifIndex;
+
+    /**
+     \brief Location of a TimeStampList payload left in the file by the header scan.
+     offset is the file position of the UTF-16 text, chars its length in characters.
+     */
+    struct TimeStampBlock
+    {
+        unsigned long long offset;
+        unsigned long long chars;
+    };
 
     class LifSerieHeader
     {
         
     public:
-        explicit LifSerieHeader(TiXmlElement *root);
+        explicit LifSerieHeader(TiXmlElement *root, const std::string& filename = std::string(),
+                                const std::vector<TimeStampBlock>* deferred = nullptr);
         
         typedef unsigned long long timestamp_t;
         
@@ -64,12 +78,14 @@ namespace lifIO
         bool hasTimeChannel () const;
         const std::map<std::string, DimensionData>& getDimensionsData() const {return dimensions;};
         const std::vector<ChannelData>& getChannels() const {return channels;};
-        const std::vector<timestamp_t>& getTimestamps () const { return timeStamps; }
+        // Timestamps left in the file by the header scan are decoded on first call
+        const std::vector<timestamp_t>& getTimestamps () const;
+        bool timestampsDecoded () const;
         const std::vector<timestamp_t>& getDurations () const { return m_frame_durations; }
         float total_duration () const
         {
-            if (timeStamps.size() < 2) return -1.0f;
-            auto timeL = (timeStamps.end() - timeStamps.begin()) / 10000.0;
+            if (getTimestamps().size() < 2) return -1.0f;
+            auto timeL = (getTimestamps().end() - getTimestamps().begin()) / 10000.0;
             if (std::signbit(timeL)) return -1.0f;
             return timeL;
         }
@@ -89,9 +105,24 @@ namespace lifIO
         mutable std::pair<bool, float> m_cached_frame_duration;
         
     private:
-        void parseImage(TiXmlNode *elementImage);
+        friend class LifIndex;
+        LifSerieHeader();
+        
+        // Shared by copies so a serie's timestamps are decoded at most once
+        struct lazy_timestamps
+        {
+            std::string path;
+            TimeStampBlock block;
+            size_t count;
+            std::once_flag once;
+            std::atomic<bool> decoded {false};
+            std::vector<timestamp_t> values;
+        };
+        std::shared_ptr<lazy_timestamps> m_lazy_timestamps;
+        
+        void parseImage(TiXmlNode *elementImage, const std::string& filename, const std::vector<TimeStampBlock>* deferred);
         void parseImageDescription(TiXmlNode *elementImageDescription);
-        void parseTimeStampList(TiXmlNode *elementTimeStampList);
+        void parseTimeStampList(TiXmlNode *elementTimeStampList, const std::string& filename, const std::vector<TimeStampBlock>* deferred);
         void parseHardwareSettingList(TiXmlNode *elementHardwareSettingList);
         void parseScannerSetting(TiXmlNode *elementScannerSetting);
         
@@ -111,9 +142,15 @@ namespace lifIO
         std::streampos tellg(){return fileRef->tellg();}
         unsigned long long getOffset(size_t t=0) const;
     private:
+        friend class LifIndex;
+        // File is opened on first access. Files with hundreds of series would otherwise hold as many handles
+        std::ifstream& stream() const;
+        
+        std::string filename;
         unsigned long long offset;
         unsigned long long memorySize;
-        std::shared_ptr<std::ifstream> fileRef;
+        mutable std::shared_ptr<std::ifstream> fileRef;
+        mutable std::once_flag fileOnce;
         std::streampos fileSize;
     };
     
@@ -123,6 +160,7 @@ namespace lifIO
     public:
         explicit LifHeader(TiXmlDocument &);
         explicit LifHeader(std::string &);
+        LifHeader(std::string &, const std::string& filename, const std::vector<TimeStampBlock>& deferred);
         
         const TiXmlDocument& getXMLHeader() const{return this->m_xmldoc;};
         std::string getName() const {return this->name;};
@@ -138,7 +176,9 @@ namespace lifIO
         std::vector<std::unique_ptr<LifSerieHeader>> m_series;
         
     private:
-        void parseHeader();
+        friend class LifIndex;
+        LifHeader() : lifVersion(0) {}
+        void parseHeader(const std::string& filename = std::string(), const std::vector<TimeStampBlock>* deferred = nullptr);
         int lifVersion;
         std::string name;
         
@@ -151,10 +191,17 @@ namespace lifIO
         typedef std::shared_ptr<LifReader> ref;
         typedef std::weak_ptr<LifReader> weak_ref_t;
         
-        static LifReader::ref create (const std::string&  fqfn_path){
-            return LifReader::ref ( new LifReader (fqfn_path));
+        /**
+         * @param use_index reuse ( or write ) the sidecar index next to the file. Index is ignored if the
+         * file has changed since it was written.
+         */
+        static LifReader::ref create (const std::string&  fqfn_path, bool use_index = true){
+            return LifReader::ref ( new LifReader (fqfn_path, use_index));
         }
         
+        /** @brief path of the sidecar index of a lif file */
+        static std::string index_path (const std::string& fqfn_path) { return fqfn_path + ".lifidx"; }
+        
         const LifHeader& getLifHeader() const {return *this->m_header;};
         const TiXmlDocument& getXMLHeader() const{return getLifHeader().getXMLHeader();};
         std::string getName() const {return getLifHeader().getName();};
@@ -169,6 +216,8 @@ namespace lifIO
         
         void close_file ();
         bool isValid () const { return m_Valid; }
+        // True if series were built from the sidecar index rather than the XML header
+        bool fromIndex () const { return m_from_index; }
         
     private:
         /**
@@ -178,10 +227,12 @@ namespace lifIO
          */
   
         // @todo move ctor to private
-        LifReader(const std::string &filename);
+        LifReader(const std::string &filename, bool use_index = true);
+        friend class LifIndex;
         int readInt();
         unsigned int readUnsignedInt();
         unsigned long long readUnsignedLongLong();
+        std::string readXmlHeader(unsigned int xmlChars, std::vector<TimeStampBlock>& deferred);
         std::shared_ptr<LifHeader> m_header;
         std::shared_ptr<std::ifstream> m_fileRef;
         std::streampos fileSize;
@@ -190,6 +241,7 @@ namespace lifIO
         mutable std::mutex m_mutex;
         std::string m_path;
         size_t m_lif_file_size;
+        bool m_from_index;
     };
     
     
@@ -208,6 +260,7 @@ namespace lifIO
         unsigned long long bytesInc; // Distance from the first channel in Bytes
         int bitInc;
         
+        ChannelData() = default;
         explicit ChannelData(TiXmlElement *element);
         inline const std::string getName() const
         {
@@ -240,6 +293,7 @@ namespace lifIO
         unsigned long long bytesInc; // Distance from the one element to the next in this dimension
         int bitInc;
         
+        DimensionData() = default;
         explicit DimensionData(TiXmlElement *element);
         inline const std::string getName() const
         {
@@ -278,6 +332,7 @@ namespace lifIO
         std::string variant;
         int variantType;
         
+        ScannerSettingRecord() = default;
         explicit ScannerSettingRecord(TiXmlElement *element);
     };
     
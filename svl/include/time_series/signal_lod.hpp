@@ -0,0 +1,204 @@
+/*! \file signal_lod.hpp
+    Min / Max decimation pyramid for plotting long signals.
+*/
+
+#ifndef SIGNAL_LOD_H
+#define SIGNAL_LOD_H
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Level of detail for 1D signals.
+
+	Level 0 holds the samples. Each node of level L+1 holds the minimum and maximum, and where they occur,
+	of two adjacent nodes of level L. Memory is about twice the signal.
+
+	Given a visible range of samples and a pixel width, query returns at most 2 points per pixel: the minimum
+	and the maximum of the samples falling in the pixel, in sample order. Peaks and valleys are kept and
+	drawing cost is bounded by the pixel width, not the length of the signal.
+
+	Samples can be appended or changed in O(log n).
+*/
+template<typename T = float>
+class signal_lod
+{
+public:
+	typedef T data_t;
+
+	struct node_t
+	{
+		T min_val;
+		T max_val;
+		uint32_t min_idx;
+		uint32_t max_idx;
+	};
+
+	signal_lod () {}
+
+	template<typename C>
+	explicit signal_lod (const C& samples) { load (samples.begin(), samples.end()); }
+
+	/** Build the pyramid from samples in [first, last) */
+	template<typename I>
+	void load (I first, I last)
+	{
+		m_levels.clear();
+		m_levels.emplace_back();
+		auto& base = m_levels.back();
+		base.reserve(std::distance(first, last));
+		uint32_t idx = 0;
+		for (; first != last; ++first, ++idx)
+			base.push_back(leaf(*first, idx));
+		while (m_levels.back().size() > 1)
+		{
+			const auto& below = m_levels.back();
+			std::vector<node_t> above ((below.size() + 1) / 2);
+			for (size_t ii = 0; ii < above.size(); ii++)
+				above[ii] = parent_of(below, ii);
+			m_levels.push_back(std::move(above));
+		}
+	}
+
+	template<typename C>
+	void load (const C& samples) { load (samples.begin(), samples.end()); }
+
+	/** Add a sample at the end */
+	void append (const T& value)
+	{
+		if (m_levels.empty()) m_levels.emplace_back();
+		m_levels[0].push_back(leaf(value, static_cast<uint32_t>(m_levels[0].size())));
+		update_parents (m_levels[0].size() - 1);
+	}
+
+	/** Change sample at index */
+	void update (size_t index, const T& value)
+	{
+		assert(index < size());
+		m_levels[0][index] = leaf(value, static_cast<uint32_t>(index));
+		update_parents (index);
+	}
+
+	void clear () { m_levels.clear(); }
+	size_t size () const { return m_levels.empty() ? 0 : m_levels[0].size(); }
+	bool empty () const { return size() == 0; }
+	size_t levels () const { return m_levels.size(); }
+	const T& operator[] (size_t index) const { return m_levels[0][index].min_val; }
+
+	/** Minimum and maximum of samples in [lo, hi). Visits O(log n) nodes */
+	node_t range (size_t lo, size_t hi) const
+	{
+		assert(lo < hi && hi <= size());
+		node_t acc = m_levels[0][lo];
+		for (size_t level = 0; lo < hi && level < m_levels.size(); level++, lo >>= 1, hi >>= 1)
+		{
+			if (lo & 1) acc = merge (acc, m_levels[level][lo++]);
+			if (hi & 1) acc = merge (acc, m_levels[level][--hi]);
+		}
+		return acc;
+	}
+
+	/** Decimate samples [first, last] for a plot pixels wide.
+		Fills xs and ys with at most 2 * pixels points, or every sample if there are fewer than that.
+		x of sample i is x_origin + i * x_step.
+		Returns number of points.
+	*/
+	template<typename X, typename Y>
+	size_t query (size_t first, size_t last, size_t pixels, std::vector<X>& xs, std::vector<Y>& ys,
+				  double x_origin = 0.0, double x_step = 1.0) const
+	{
+		xs.clear();
+		ys.clear();
+		if (empty() || pixels == 0) return 0;
+		last = std::min(last, size() - 1);
+		if (first > last) return 0;
+		size_t count = last - first + 1;
+		auto emit = [&xs, &ys, x_origin, x_step](uint32_t idx, const T& val){
+			xs.push_back(static_cast<X>(x_origin + idx * x_step));
+			ys.push_back(static_cast<Y>(val));
+		};
+
+		if (count <= 2 * pixels)
+		{
+			xs.reserve(count);
+			ys.reserve(count);
+			for (size_t ii = first; ii <= last; ii++)
+				emit (static_cast<uint32_t>(ii), m_levels[0][ii].min_val);
+			return xs.size();
+		}
+
+		xs.reserve(2 * pixels);
+		ys.reserve(2 * pixels);
+		for (size_t px = 0; px < pixels; px++)
+		{
+			size_t lo = first + (px * count) / pixels;
+			size_t hi = first + ((px + 1) * count) / pixels;
+			if (lo >= hi) continue;
+			node_t nn = range (lo, hi);
+			if (nn.min_idx == nn.max_idx)
+				emit (nn.min_idx, nn.min_val);
+			else if (nn.min_idx < nn.max_idx)
+			{
+				emit (nn.min_idx, nn.min_val);
+				emit (nn.max_idx, nn.max_val);
+			}
+			else
+			{
+				emit (nn.max_idx, nn.max_val);
+				emit (nn.min_idx, nn.min_val);
+			}
+		}
+		return xs.size();
+	}
+
+	/** query over a visible x range, with the same mapping from sample index to x */
+	template<typename X, typename Y>
+	size_t query_range (double x_min, double x_max, size_t pixels, std::vector<X>& xs, std::vector<Y>& ys,
+						double x_origin = 0.0, double x_step = 1.0) const
+	{
+		if (empty() || x_step <= 0.0 || x_max < x_min) { xs.clear(); ys.clear(); return 0; }
+		double ifirst = std::floor ((x_min - x_origin) / x_step);
+		double ilast = std::ceil ((x_max - x_origin) / x_step);
+		double top = static_cast<double>(size() - 1);
+		if (ilast < 0.0 || ifirst > top) { xs.clear(); ys.clear(); return 0; }
+		size_t first = static_cast<size_t>(std::max(0.0, ifirst));
+		size_t last = static_cast<size_t>(std::min(top, ilast));
+		return query (first, last, pixels, xs, ys, x_origin, x_step);
+	}
+
+private:
+	static node_t leaf (const T& value, uint32_t idx) { return node_t {value, value, idx, idx}; }
+
+	static node_t merge (const node_t& a, const node_t& b)
+	{
+		node_t nn = a;
+		if (b.min_val < nn.min_val) { nn.min_val = b.min_val; nn.min_idx = b.min_idx; }
+		if (b.max_val > nn.max_val) { nn.max_val = b.max_val; nn.max_idx = b.max_idx; }
+		return nn;
+	}
+
+	static node_t parent_of (const std::vector<node_t>& below, size_t ii)
+	{
+		size_t left = 2 * ii;
+		return left + 1 < below.size() ? merge (below[left], below[left + 1]) : below[left];
+	}
+
+	void update_parents (size_t index)
+	{
+		for (size_t level = 0; m_levels[level].size() > 1; level++, index >>= 1)
+		{
+			if (level + 1 == m_levels.size()) m_levels.emplace_back();
+			auto& above = m_levels[level + 1];
+			size_t pp = index >> 1;
+			if (pp == above.size()) above.push_back(parent_of (m_levels[level], pp));
+			else above[pp] = parent_of (m_levels[level], pp);
+		}
+	}
+
+	std::vector<std::vector<node_t>> m_levels;
+};
+
+#endif
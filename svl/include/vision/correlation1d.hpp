@@ -12,6 +12,7 @@
 #include "core/fit.hpp"
 #include "core/stats.hpp"
 #include "core/core.hpp"
+#include "vision/correlation1d_engine.hpp"
 
 using namespace std;
 
@@ -88,64 +89,24 @@ double f1dCrossCorr (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me)
 
 
 // 1D auto-correlation: Normalized Correlation
-//
+// Circular: lag i pairs element j with element (i + j) mod n
 template <class Iterator>
-void f1dAutoCorr (Iterator Ib, Iterator Ie, Iterator acb, bool op = true)
+void f1dAutoCorr (Iterator Ib, Iterator Ie, vector<double>& acb, bool op = true)
 {
-    // Get container value type
-    typedef typename std::iterator_traits<Iterator>::value_type value_type;
-    
-    int32_t n = distance (Ib, Ie);
-    vector<value_type> ring (n + n);
-    Iterator ip = Ib;
-    int32_t i;
-    for (i = 0; i < n; i++) ring[i] = *ip++;
-    ip = Ib;
-    for (; i < (int32_t) ring.size(); i++) ring[i] = *ip++;
-    
-    ip = ring.begin();
-    Iterator cp = acb;
-    
-    if (op)
-    {
-        for (int32_t i = 0; i < n; i++, ip++)
-            *cp++ = f1dNormalizedCorr (Ib, Ie, ip, ip + n);
-    }
-    else
-    {
-        for (int32_t i = 0; i < n; i++, ip++)
-            *cp++ = f1dCrossCorr (Ib, Ie, ip, ip + n);
-    }
+    // The signal against itself repeated, over the lags of a full overlap
+    const vector<double> signal (Ib, Ie);
+    vector<double> ring (signal);
+    ring.insert (ring.end(), signal.begin(), signal.end());
+    correlation1dEngine engine (op ? correlation1dEngine::measure::normalized : correlation1dEngine::measure::cross);
+    engine.correlate (signal, ring, 0, static_cast<int>(signal.size()) - 1, acb);
 }
 
 template <class Iterator>
-void f1dAutoCorr (Iterator Ib, Iterator Ie, vector<double>& acb, bool op = true)
+void f1dAutoCorr (Iterator Ib, Iterator Ie, Iterator acb, bool op = true)
 {
-    // Get container value type
-    typedef typename std::iterator_traits<Iterator>::value_type value_type;
-    
-    auto n = std::distance (Ib, Ie);
-    vector<value_type> ring (n + n);
-    Iterator ip = Ib;
-    uint32_t i;
-    for (i = 0; i < (uint32_t) n; i++) ring[i] = *ip++;
-    ip = Ib;
-    for (; i < ring.size(); i++) ring[i] = *ip++;
-    
-    ip = ring.begin();
-    acb.resize(n);
-    vector<double>::iterator cp = acb.begin();
-    
-    if (op)
-    {
-        for (uint32_t i = 0; i < (uint32_t) n; i++, ip++)
-            *cp++ = f1dNormalizedCorr (Ib, Ie, ip, ip + n);
-    }
-    else
-    {
-        for (uint32_t i = 0; i < (uint32_t) n; i++, ip++)
-            *cp++ = f1dCrossCorr (Ib, Ie, ip, ip + n);
-    }
+    vector<double> ac;
+    f1dAutoCorr (Ib, Ie, ac, op);
+    std::copy (ac.begin(), ac.end(), acb);
 }
 
 // 1D Signal Registration:
@@ -154,30 +115,16 @@ void f1dAutoCorr (Iterator Ib, Iterator Ie, vector<double>& acb, bool op = true)
 // Slide has to be greater or equal to 1. Mb is lined up with (Ib+slide) with 0 passed in for
 // slide number of bins on the other end (and reduced count in calculation of correlation). Similarly
 // (Mb+slide) is matched with Ib with first slide model bins treated as 0s and reduction of count accordingly
-// @todo: constant time implementation
+// Scores come from correlation1dEngine: all lags in one FFT when there are many
 
 template <class Iterator>
 double f1dRegister (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me, uint32_t slide, double& pose)
 {
     
     assert (slide >= 1);
-    vector<double> space (slide + slide + 1);
-    vector<double>::iterator orgItr = space.begin() + slide;
-    vector<double>::iterator slidItr;
-    
-    // Sliding I to the right
-    slidItr = orgItr;
-    for (uint32_t i = 0; i < (slide + 1); i++)
-    {
-        *slidItr-- = f1dNormalizedCorr (Ib + i, Ie, Mb, Me - i);
-    }
-    
-    // Sliding I to the left (orgin already done)
-    slidItr = orgItr+1;
-    for (uint32_t i = 1; i < (slide + 1); i++)
-    {
-        *slidItr++ = f1dNormalizedCorr (Ib, Ie - i, Mb + i, Me);
-    }
+    // I slid to the right, then to the left: lags -slide to slide of M on I
+    vector<double> space;
+    correlation1dEngine ().correlate (vector<double> (Ib, Ie), vector<double> (Mb, Me), -int32_t(slide), int32_t(slide), space);
     
     vector<double>::iterator endd = space.end();
     std::advance (endd, -1); // The last guy
@@ -211,23 +158,9 @@ double f1dRegister (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me, uint32_t
 {
     
     assert (slide >= 1);
-    vector<double> space (slide + slide + 1);
-    vector<double>::iterator orgItr = space.begin() + slide;
-    vector<double>::iterator slidItr;
-    
-    // Sliding I to the right
-    slidItr = orgItr;
-    for (uint32_t i = 0; i < (slide + 1); i++)
-    {
-        *slidItr-- = f1dNormalizedCorr (Ib + i, Ie, Mb, Me - i);
-    }
-    
-    // Sliding I to the left (orgin already done)
-    slidItr = orgItr+1;
-    for (uint32_t i = 1; i < (slide + 1); i++)
-    {
-        *slidItr++ = f1dNormalizedCorr (Ib, Ie - i, Mb + i, Me);
-    }
+    // I slid to the right, then to the left: lags -slide to slide of M on I
+    vector<double> space;
+    correlation1dEngine ().correlate (vector<double> (Ib, Ie), vector<double> (Mb, Me), -int32_t(slide), int32_t(slide), space);
     
     vector<double>::iterator endd = space.end();
     std::advance (endd, -1); // The last guy
@@ -271,23 +204,9 @@ double f1dRegister (Iterator Ib, Iterator Ie, Iterator Mb, Iterator Me,
 {
     uint32_t slide = slideLeft + slideRight;
     assert (slide >= 1);
-    vector<double> space (slideLeft + slideRight + 1);
-    vector<double>::iterator orgItr = space.begin() + slideRight;
-    vector<double>::iterator slidItr;
-    
-    // Sliding I to the right
-    slidItr = orgItr;
-    for (auto i = 0; i < (slideRight + 1); i++)
-    {
-        *slidItr-- = f1dNormalizedCorr (Ib + i, Ie, Mb, Me - i);
-    }
-    
-    // Sliding I to the left (orgin already done)
-    slidItr = orgItr+1;
-    for (auto i = 1; i < (slideLeft + 1); i++)
-    {
-        *slidItr++ = f1dNormalizedCorr (Ib, Ie - i, Mb + i, Me);
-    }
+    // I slid slideRight to the right, then slideLeft to the left
+    vector<double> space;
+    correlation1dEngine ().correlate (vector<double> (Ib, Ie), vector<double> (Mb, Me), -int32_t(slideRight), int32_t(slideLeft), space);
     
     vector<double>::iterator endd = space.end();
     std::advance (endd, -1); // The last guy
@@ -0,0 +1,376 @@
+//
+//  correlation1d_engine.hpp
+//  svl
+//
+//  Sliding 1D correlation of a signal and a model over a range of lags.
+//
+//  At lag d, signal[a] is paired with model[a + d] wherever both exist. The normalized measure is the r2 of
+//  f1dNormalizedCorr over those pairs, the cross measure the sum of products, as f1dCrossCorr.
+//  For short signals or few lags all five sums of a lag are accumulated in one read of its overlap. For many
+//  lags the sums of products of every lag come from one FFT of signal + i model and one inverse FFT, whose
+//  cost does not depend on the number of lags, and the sums of each side from prefix sums, in constant time
+//  per lag. Signals are then centred on their means first, which keeps prefix sum differences accurate.
+//
+//  Batches of pairs, e.g. the length, PCI and force profiles of every cell, run one pair per thread.
+//
+
+#ifndef correlation1d_engine_hpp
+#define correlation1d_engine_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "core/fit.hpp"
+#include "vision/frame_threads.hpp"
+
+namespace svl
+{
+    class correlation1dEngine
+    {
+    public:
+        enum class measure { normalized, cross };
+        enum class method { automatic, direct, fft };
+
+        // Best lag of a pair: position is interpolated around an inner peak, peak is its value
+        struct alignment
+        {
+            double position = 0.0;
+            double peak = 0.0;
+        };
+
+        /*
+         threads: for batches, 0 for one per core. A single pair runs on the calling thread
+         */
+        explicit correlation1dEngine (measure what = measure::normalized, method how = method::automatic,
+                                      unsigned threads = 0) :
+        m_measure (what), m_method (how), m_threads (threads) {}
+
+        measure what () const { return m_measure; }
+        method how () const { return m_method; }
+
+        /*
+         Correlation of signal and model at lags min_lag to max_lag in to out, out[k] at lag min_lag + k.
+         Lags without overlap are 0. f1dRegister ( signal, model, left, right ) scores lags -right to left
+         */
+        template <typename T>
+        void correlate (const std::vector<T>& signal, const std::vector<T>& model, int min_lag, int max_lag,
+                        std::vector<double>& out) const
+        {
+            scratch space;
+            run(signal, model, min_lag, max_lag, out, space);
+        }
+
+        // Correlations of each pair signals[i], models[i], pairs in parallel
+        template <typename T>
+        void correlate (const std::vector<std::vector<T>>& signals, const std::vector<std::vector<T>>& models,
+                        int min_lag, int max_lag, std::vector<std::vector<double>>& out) const
+        {
+            const size_t pairs = std::min(signals.size(), models.size());
+            out.resize(pairs);
+            for_each_frame_scratch<scratch>(pairs, [&](size_t index, scratch& space){
+                run(signals[index], models[index], min_lag, max_lag, out[index], space);
+            }, m_threads);
+        }
+
+        // Lag of the best correlation of signal and model, as f1dRegister
+        template <typename T>
+        alignment align (const std::vector<T>& signal, const std::vector<T>& model, int min_lag, int max_lag) const
+        {
+            scratch space;
+            std::vector<double> scores;
+            run(signal, model, min_lag, max_lag, scores, space);
+            return best(scores, min_lag);
+        }
+
+        // Best lags of each pair signals[i], models[i], pairs in parallel
+        template <typename T>
+        void align (const std::vector<std::vector<T>>& signals, const std::vector<std::vector<T>>& models,
+                    int min_lag, int max_lag, std::vector<alignment>& out) const
+        {
+            const size_t pairs = std::min(signals.size(), models.size());
+            out.resize(pairs);
+            for_each_frame_scratch<scratch>(pairs, [&](size_t index, scratch& space){
+                run(signals[index], models[index], min_lag, max_lag, space.scores, space);
+                out[index] = best(space.scores, min_lag);
+            }, m_threads);
+        }
+
+        // True if the sums of products of n and m sample signals at lags min_lag to max_lag are cheaper by FFT
+        static bool prefer_fft (size_t n, size_t m, int min_lag, int max_lag)
+        {
+            if (n == 0 || m == 0 || max_lag < min_lag) return false;
+            // Multiply adds of the direct sums against an estimate of the two transforms and the product
+            double direct = 0.0;
+            for (int64_t d = std::max<int64_t>(min_lag, 1 - int64_t(n)); d <= std::min<int64_t>(max_lag, int64_t(m) - 1); d++)
+                direct += double(overlap(n, m, d));
+            const size_t size = fft_size(n + m - 1);
+            return direct > c_fft_cost * double(size) * std::log2(double(size));
+        }
+
+    private:
+        // Multiply adds per element per radix 2 stage, measured against the direct sums
+        static constexpr double c_fft_cost = 3.0;
+        // Energies below this fraction of the sum of squares are rounding of a constant overlap
+        static constexpr double c_flat = 1e-12;
+
+        struct scratch
+        {
+            std::vector<double> signal, model;
+            std::vector<double> signal_sum, signal_sq, model_sum, model_sq;
+            std::vector<double> products;
+            std::vector<double> re, im;
+            std::vector<double> cos_table, sin_table;
+            std::vector<uint32_t> reversed;
+            std::vector<double> scores;
+        };
+
+        static size_t fft_size (size_t n)
+        {
+            size_t size = 1;
+            while (size < n) size <<= 1;
+            return size;
+        }
+
+        static int64_t overlap (size_t n, size_t m, int64_t d)
+        {
+            const int64_t lo = std::max<int64_t>(0, -d);
+            const int64_t hi = std::min<int64_t>(int64_t(n), int64_t(m) - d);
+            return std::max<int64_t>(0, hi - lo);
+        }
+
+        alignment best (const std::vector<double>& scores, int min_lag) const
+        {
+            alignment result;
+            if (scores.empty()) return result;
+            const auto maxd = std::max_element(scores.begin(), scores.end());
+            const size_t at = size_t(std::distance(scores.begin(), maxd));
+            result.peak = *maxd;
+            result.position = double(at) + min_lag;
+            // If the middle is a peak, interpolate around it
+            if (at > 0 && at + 1 < scores.size())
+            {
+                double peak = *maxd;
+                const double shift = parabolicFit(scores[at - 1], *maxd, scores[at + 1], &peak);
+                if (std::isfinite(shift))
+                {
+                    result.position += shift;
+                    result.peak = peak;
+                }
+            }
+            return result;
+        }
+
+        // Centres values on their mean, with prefix sums of the centred values and their squares
+        static void load (std::vector<double>& dst, std::vector<double>& sum, std::vector<double>& sq)
+        {
+            double mean = 0.0;
+            for (double v : dst) mean += v;
+            mean /= double(dst.size());
+            sum.resize(dst.size() + 1);
+            sq.resize(dst.size() + 1);
+            sum[0] = sq[0] = 0.0;
+            for (size_t ii = 0; ii < dst.size(); ii++)
+            {
+                const double v = dst[ii] - mean;
+                dst[ii] = v;
+                sum[ii + 1] = sum[ii] + v;
+                sq[ii + 1] = sq[ii] + v * v;
+            }
+        }
+
+        template <typename T>
+        void run (const std::vector<T>& signal, const std::vector<T>& model, int min_lag, int max_lag,
+                  std::vector<double>& out, scratch& space) const
+        {
+            out.assign(size_t(std::max(0, max_lag - min_lag + 1)), 0.0);
+            const size_t n = signal.size(), m = model.size();
+            if (out.empty() || n == 0 || m == 0) return;
+
+            const bool normalized = m_measure == measure::normalized;
+            space.signal.assign(signal.begin(), signal.end());
+            space.model.assign(model.begin(), model.end());
+            const bool fft = m_method == method::fft ||
+            (m_method == method::automatic && prefer_fft(n, m, min_lag, max_lag));
+            if (! fft)
+            {
+                scores_direct(space, min_lag, max_lag, normalized, out);
+                return;
+            }
+
+            if (normalized)
+            {
+                load(space.signal, space.signal_sum, space.signal_sq);
+                load(space.model, space.model_sum, space.model_sq);
+            }
+            products_fft(space, min_lag, max_lag);
+            for (int d = min_lag; d <= max_lag; d++)
+            {
+                const size_t k = size_t(d - min_lag);
+                const int64_t count = overlap(n, m, d);
+                if (count <= 0) continue;
+                if (! normalized)
+                {
+                    out[k] = space.products[k];
+                    continue;
+                }
+                const size_t s0 = size_t(std::max(0, -d)), s1 = s0 + size_t(count);
+                const size_t m0 = s0 + size_t(d), m1 = m0 + size_t(count);
+                out[k] = score(double(count), space.signal_sum[s1] - space.signal_sum[s0],
+                               space.signal_sq[s1] - space.signal_sq[s0], space.model_sum[m1] - space.model_sum[m0],
+                               space.model_sq[m1] - space.model_sq[m0], space.products[k]);
+            }
+        }
+
+        // r2 from the sums over an overlap of nn pairs
+        static double score (double nn, double si, double sii, double sm, double smm, double sim)
+        {
+            const double cross = nn * sim - si * sm;
+            const double energy_a = nn * sii - si * si;
+            const double energy_b = nn * smm - sm * sm;
+            if (energy_a <= c_flat * nn * sii || energy_b <= c_flat * nn * smm) return 0.0;
+            return std::min(1.0, (cross * cross) / (energy_a * energy_b));
+        }
+
+        // All sums of each lag over its overlap, in one read, as f1dNormalizedCorr. The loads of the product
+        // are shared by the other sums, so this beats prefix sums when there are few lags
+        static void scores_direct (const scratch& space, int min_lag, int max_lag, bool normalized, std::vector<double>& out)
+        {
+            const size_t n = space.signal.size(), m = space.model.size();
+            const double* sig = space.signal.data();
+            const double* mod = space.model.data();
+            for (int d = min_lag; d <= max_lag; d++)
+            {
+                const int64_t count = overlap(n, m, d);
+                if (count <= 0) continue;
+                const double* ip = sig + std::max(0, -d);
+                const double* mp = mod + std::max(0, d);
+                double si = 0.0, sii = 0.0, sm = 0.0, smm = 0.0, sim = 0.0;
+                if (normalized)
+                    for (int64_t a = 0; a < count; a++)
+                    {
+                        const double iv = ip[a], mv = mp[a];
+                        si += iv; sii += iv * iv;
+                        sm += mv; smm += mv * mv;
+                        sim += iv * mv;
+                    }
+                else
+                    for (int64_t a = 0; a < count; a++) sim += ip[a] * mp[a];
+                out[size_t(d - min_lag)] = normalized ? score(double(count), si, sii, sm, smm, sim) : sim;
+            }
+        }
+
+        // Sums of products of all lags, from the transform of signal + i model
+        static void products_fft (scratch& space, int min_lag, int max_lag)
+        {
+            const size_t n = space.signal.size(), m = space.model.size();
+            const size_t size = fft_size(n + m - 1);
+            prepare_fft(space, size);
+            std::vector<double>& re = space.re;
+            std::vector<double>& im = space.im;
+            re.assign(size, 0.0);
+            im.assign(size, 0.0);
+            std::copy(space.signal.begin(), space.signal.end(), re.begin());
+            std::copy(space.model.begin(), space.model.end(), im.begin());
+            fft(space, re, im);
+
+            // With Z the transform of z = s + i m: S = ( Z[k] + conj Z[-k] ) / 2, M = ( Z[k] - conj Z[-k] ) / 2i.
+            // conj(S) M is the transform of the correlation. Its conjugate is transformed forward again, as the
+            // inverse transform, in place: k and -k are updated together
+            for (size_t k = 0; k <= size / 2; k++)
+            {
+                const size_t j = (size - k) & (size - 1);
+                const double zr = re[k], zi = im[k], wr = re[j], wi = im[j];
+                // S[k], M[k] and S[j] = conj S[k], M[j] = conj M[k]
+                const double sr = 0.5 * (zr + wr), si = 0.5 * (zi - wi);
+                const double mr = 0.5 * (zi + wi), mi = 0.5 * (wr - zr);
+                // conj(S) M, then conjugated
+                const double pr = sr * mr + si * mi;
+                const double pi = sr * mi - si * mr;
+                re[k] = pr; im[k] = -pi;
+                re[j] = pr; im[j] = pi;
+            }
+            fft(space, re, im);
+
+            space.products.assign(size_t(max_lag - min_lag + 1), 0.0);
+            const double scale = 1.0 / double(size);
+            for (int d = min_lag; d <= max_lag; d++)
+            {
+                if (overlap(n, m, d) <= 0) continue;
+                const size_t at = size_t((int64_t(size) + d) % int64_t(size));
+                space.products[size_t(d - min_lag)] = re[at] * scale;
+            }
+        }
+
+        // Bit reversed order and twiddles of a size point transform. The twiddles of each stage are stored
+        // contiguously, stage of half h at [h - 1, 2h - 1), so butterflies read them in order
+        static void prepare_fft (scratch& space, size_t size)
+        {
+            if (space.reversed.size() == size) return;
+            unsigned bits = 0;
+            while ((size_t(1) << bits) < size) bits++;
+            space.reversed.assign(size, 0);
+            for (size_t ii = 1; ii < size; ii++)
+                space.reversed[ii] = (space.reversed[ii >> 1] >> 1) | (uint32_t(ii & 1) << (bits - 1));
+
+            // e^-2pi i k / size for k below size / 2, from the first eighth of the circle by symmetry
+            const size_t half = size / 2, quarter = size / 4, eighth = size / 8;
+            std::vector<double> cs (half), sn (half);
+            const double step = 2.0 * 3.14159265358979323846 / double(size);
+            for (size_t kk = 0; kk < half; kk++)
+            {
+                if (kk <= eighth) { cs[kk] = std::cos(step * double(kk)); sn[kk] = std::sin(step * double(kk)); }
+                else if (kk <= quarter) { cs[kk] = sn[quarter - kk]; sn[kk] = cs[quarter - kk]; }
+                else { cs[kk] = -sn[kk - quarter]; sn[kk] = cs[kk - quarter]; }
+            }
+            space.cos_table.resize(size);
+            space.sin_table.resize(size);
+            for (size_t hh = 1; hh < size; hh <<= 1)
+                for (size_t kk = 0; kk < hh; kk++)
+                {
+                    space.cos_table[hh - 1 + kk] = cs[kk * (half / hh)];
+                    space.sin_table[hh - 1 + kk] = -sn[kk * (half / hh)];
+                }
+        }
+
+        // In place radix 2 forward transform, e^-i
+        static void fft (const scratch& space, std::vector<double>& re, std::vector<double>& im)
+        {
+            const size_t size = re.size();
+            for (size_t ii = 0; ii < size; ii++)
+            {
+                const size_t jj = space.reversed[ii];
+                if (ii < jj) { std::swap(re[ii], re[jj]); std::swap(im[ii], im[jj]); }
+            }
+            double* xr = re.data();
+            double* xi = im.data();
+            for (size_t half = 1; half < size; half <<= 1)
+            {
+                const double* wr = space.cos_table.data() + half - 1;
+                const double* wi = space.sin_table.data() + half - 1;
+                for (size_t block = 0; block < size; block += 2 * half)
+                {
+                    double* tr_ = xr + block;
+                    double* ti_ = xi + block;
+                    double* br = tr_ + half;
+                    double* bi = ti_ + half;
+                    for (size_t kk = 0; kk < half; kk++)
+                    {
+                        const double tr = br[kk] * wr[kk] - bi[kk] * wi[kk];
+                        const double ti = br[kk] * wi[kk] + bi[kk] * wr[kk];
+                        br[kk] = tr_[kk] - tr;
+                        bi[kk] = ti_[kk] - ti;
+                        tr_[kk] += tr;
+                        ti_[kk] += ti;
+                    }
+                }
+            }
+        }
+
+        measure m_measure;
+        method m_method;
+        unsigned m_threads;
+    };
+}
+
+#endif /* correlation1d_engine_hpp */
@@ -0,0 +1,368 @@
+//
+//  edge_pipeline.hpp
+//  svl
+//
+//  Fused Sobel gradient, non maximum suppression and hysteresis for 8 bit images.
+//
+//  Produces the images of Gradient, SpatialEdge and hystheresisThreshold::U8, pixel for pixel, in one pass over
+//  bands of rows. A band computes the gradient of its rows straight into the output, plus one row above and
+//  below into scratch, and suppresses non maxima while those rows are still in cache. Bands run in parallel.
+//  The per row loops work on contiguous buffers without branches so the compiler vectorizes them; the 8 bit
+//  angle is a lookup in the EdgeTables arc tangent table, indexed by a vectorized division.
+//
+//  Hysteresis labels 8 connected peaks at or above low with a union find forest, each band over its own pixels
+//  in parallel, then joins bands along their borders. A component is an edge if any of its peaks is at or
+//  above high.
+//
+
+#ifndef edge_pipeline_hpp
+#define edge_pipeline_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "vision/roiWindow.h"
+#include "vision/frame_threads.hpp"
+#include "core/angle_units.h"
+
+namespace svl
+{
+    class edgePipeline
+    {
+    public:
+        static const int c_band_rows = 32;
+        static const uint8_t c_edge_label = 128; // as hystheresisThreshold::U8
+
+        struct frame_edges
+        {
+            roiWindow<P8U> magnitudes; // as Gradient
+            roiWindow<P8U> angles;     // as Gradient
+            roiWindow<P8U> peaks;      // as SpatialEdge at threshold low: magnitude at peaks, 0 elsewhere
+            // as hystheresisThreshold::U8 of peaks: c_edge_label on edges, 0 elsewhere. Aligned with peaks,
+            // where U8 writes each label one pixel down and right of its peak
+            roiWindow<P8U> edges;
+            uint32_t peak_count = 0;
+            uint32_t edge_count = 0;
+        };
+
+        /*
+         low: peak threshold, and lower hysteresis threshold
+         high: upper hysteresis threshold, at least low
+         threads: 0 for one per core
+         */
+        explicit edgePipeline (uint8_t low = 1, uint8_t high = 1, unsigned threads = 0) :
+        m_low (std::max(uint8_t(1), low)), m_high (std::max(m_low, high)), m_threads (threads) {}
+
+        uint8_t low () const { return m_low; }
+        uint8_t high () const { return m_high; }
+
+        // Edges of image, bands in parallel. Images in out are reused if they match in size
+        void process (const roiWindow<P8U>& image, frame_edges& out) const
+        {
+            run(image, out, m_threads);
+        }
+
+        // Edges of every frame, frames in parallel
+        void process (const std::vector<roiWindow<P8U>>& frames, std::vector<frame_edges>& out) const
+        {
+            out.resize(frames.size());
+            for_each_frame(frames.size(), [&](size_t index){
+                run(frames[index], out[index], 1);
+            }, m_threads);
+        }
+
+        // 8 bit angle of ( x, y ), as EdgeTables::binAtan ( y, x )
+        static uint8_t bin_atan (int y, int x)
+        {
+            const uint8_t* theta = theta_table();
+            const int ay = std::abs(y), ax = std::abs(x);
+            if (y >= 0)
+            {
+                if (x >= 0)
+                {
+                    if (x == 0 && y == 0) return 0;
+                    return ay <= ax ? theta[(ay << c_atan_precision) / ax] : uint8_t(64 - theta[(ax << c_atan_precision) / ay]);
+                }
+                return ay <= ax ? uint8_t(128 - theta[(ay << c_atan_precision) / ax]) : uint8_t(64 + theta[(ax << c_atan_precision) / ay]);
+            }
+            if (x >= 0)
+                return ay <= ax ? uint8_t(-theta[(ay << c_atan_precision) / ax]) : uint8_t(192 + theta[(ax << c_atan_precision) / ay]);
+            return ay <= ax ? uint8_t(128 + theta[(ay << c_atan_precision) / ax]) : uint8_t(192 - theta[(ax << c_atan_precision) / ay]);
+        }
+
+    private:
+        static const int c_atan_precision = 16;
+        static const int c_norm_bits = 3; // 8 bit magnitudes, as Gradient
+
+        // atan of [0, 1] in 1 / 65536 steps, in 8 bit angle units, as EdgeTables
+        static const uint8_t* theta_table ()
+        {
+            static const std::vector<uint8_t> table = [](){
+                std::vector<uint8_t> tt ((1 << c_atan_precision) + 1);
+                for (size_t ii = 0; ii < tt.size(); ii++)
+                    tt[ii] = uAngle8(uRadian(std::atan(double(ii) / (1 << c_atan_precision)))).basic();
+                return tt;
+            }();
+            return table.data();
+        }
+
+        static void prepare (roiWindow<P8U>& image, int width, int height)
+        {
+            if (! image.isBound() || image.width() != width || image.height() != height)
+                image = roiWindow<P8U> (width, height, image_memory_alignment_policy::align_every_row,
+                                        image_memory_allocation_policy::pooled_allocation);
+        }
+
+        // Row buffers of a band
+        struct row_scratch
+        {
+            explicit row_scratch (int width) : sums (size_t(width)), diffs (size_t(width)), gx (size_t(width)),
+            gy (size_t(width)), ratio (size_t(width)) {}
+            std::vector<int16_t> sums, diffs, gx, gy;
+            std::vector<int32_t> ratio;
+        };
+
+        // Gradient of row y, 1 <= y < height - 1, in to mag ( and ang if not null ), columns 1 to width - 2
+        static void gradient_row (const roiWindow<P8U>& image, int y, uint8_t* mag, uint8_t* ang, row_scratch& scratch)
+        {
+            const int width = image.width();
+            int16_t* sums = scratch.sums.data();
+            int16_t* diffs = scratch.diffs.data();
+            int16_t* gx = scratch.gx.data();
+            int16_t* gy = scratch.gy.data();
+            const uint8_t* above = image.rowPointer(y - 1);
+            const uint8_t* here = image.rowPointer(y);
+            const uint8_t* below = image.rowPointer(y + 1);
+            for (int x = 0; x < width; x++)
+            {
+                sums[x] = int16_t(above[x] + 2 * here[x] + below[x]);
+                diffs[x] = int16_t(below[x] - above[x]);
+            }
+            const float scale = 255.0f / 256.0f;
+            for (int x = 1; x < width - 1; x++)
+            {
+                const int dx = sums[x + 1] - sums[x - 1];
+                const int dy = diffs[x - 1] + 2 * diffs[x] + diffs[x + 1];
+                gx[x] = int16_t(dx);
+                gy[x] = int16_t(dy);
+                const int ax = std::abs(dx) >> c_norm_bits;
+                const int ay = std::abs(dy) >> c_norm_bits;
+                // At most 127 * sqrt(2): the EdgeTables magnitude table never clips
+                mag[x] = uint8_t(std::sqrt(float(ax * ax + ay * ay)) * scale + 0.5f);
+            }
+            mag[0] = mag[width - 1] = 0;
+            if (! ang) return;
+
+            // bin_atan without branches. Table index of the smaller over the larger component: the quotient
+            // is exact in double for these magnitudes, and double division vectorizes where integer does not
+            int32_t* ratio = scratch.ratio.data();
+            for (int x = 1; x < width - 1; x++)
+            {
+                const int ax = std::abs(int(gx[x])), ay = std::abs(int(gy[x]));
+                const int lo = std::min(ax, ay), hi = std::max(ax, std::max(ay, 1));
+                ratio[x] = int32_t(double(lo << c_atan_precision) / double(hi));
+            }
+            // Angle in the first quadrant, then reflected in to the quadrant of the signs
+            const uint8_t* theta = theta_table();
+            for (int x = 1; x < width - 1; x++)
+            {
+                const int tt = theta[ratio[x]];
+                int angle = std::abs(int(gy[x])) > std::abs(int(gx[x])) ? 64 - tt : tt;
+                angle = gx[x] < 0 ? 128 - angle : angle;
+                angle = gy[x] < 0 ? -angle : angle;
+                ang[x] = uint8_t(angle);
+            }
+            ang[0] = ang[width - 1] = 0;
+        }
+
+        // Peaks of row y, 2 <= y < height - 2, from magnitude rows above, here, below
+        uint32_t suppress_row (const uint8_t* above, const uint8_t* here, const uint8_t* below, const uint8_t* ang,
+                               uint8_t* peaks, int width) const
+        {
+            // A local threshold: stores through peaks could alias m_low and stop vectorization
+            const uint8_t low = m_low;
+            uint32_t count = 0;
+            peaks[0] = peaks[1] = 0;
+            for (int x = 2; x < width - 2; x++)
+            {
+                const uint8_t ctr = here[x];
+                // Neighbours across the edge, along the gradient axis, as SpatialEdge
+                const int axis = ((ang[x] + 16) >> 5) & 3;
+                const uint8_t m1 = axis == 0 ? here[x - 1] : axis == 1 ? above[x - 1] : axis == 2 ? above[x] : above[x + 1];
+                const uint8_t m2 = axis == 0 ? here[x + 1] : axis == 1 ? below[x + 1] : axis == 2 ? below[x] : below[x - 1];
+                const bool peak = ctr >= low && ((ctr > m1 && ctr >= m2) || (ctr >= m1 && ctr > m2));
+                peaks[x] = peak ? ctr : 0;
+                count += peak;
+            }
+            peaks[width - 2] = peaks[width - 1] = 0;
+            return count;
+        }
+
+        static int32_t find (std::vector<int32_t>& parent, int32_t x)
+        {
+            while (parent[size_t(x)] != x)
+            {
+                parent[size_t(x)] = parent[size_t(parent[size_t(x)])];
+                x = parent[size_t(x)];
+            }
+            return x;
+        }
+
+        // Joins the sets of a and b under the smaller root, which inherits strength
+        static void join (std::vector<int32_t>& parent, std::vector<uint8_t>& strong, int32_t a, int32_t b)
+        {
+            a = find(parent, a);
+            b = find(parent, b);
+            if (a == b) return;
+            if (b < a) std::swap(a, b);
+            parent[size_t(b)] = a;
+            strong[size_t(a)] |= strong[size_t(b)];
+        }
+
+        void run (const roiWindow<P8U>& image, frame_edges& out, unsigned threads) const
+        {
+            const int width = image.width();
+            const int height = image.height();
+            prepare(out.magnitudes, width, height);
+            prepare(out.angles, width, height);
+            prepare(out.peaks, width, height);
+            prepare(out.edges, width, height);
+            out.peak_count = out.edge_count = 0;
+            if (width < 3 || height < 3)
+            {
+                out.magnitudes.set(0);
+                out.angles.set(0);
+                out.peaks.set(0);
+                out.edges.set(0);
+                return;
+            }
+
+            const size_t bands = size_t((height + c_band_rows - 1) / c_band_rows);
+            std::vector<uint32_t> peak_counts (bands, 0), edge_counts (bands, 0);
+            std::vector<int32_t> parent (size_t(width) * size_t(height));
+            std::vector<uint8_t> strong (parent.size());
+
+            // Gradient, suppression and hysteresis within each band
+            for_each_frame(bands, [&](size_t band){
+                const int r0 = int(band) * c_band_rows;
+                const int r1 = std::min(height, r0 + c_band_rows);
+                row_scratch scratch (width);
+                std::vector<uint8_t> halo_above (size_t(width), 0), halo_below (size_t(width), 0);
+
+                for (int y = r0; y < r1; y++)
+                {
+                    if (y == 0 || y == height - 1)
+                    {
+                        std::fill(out.magnitudes.rowPointer(y), out.magnitudes.rowPointer(y) + width, 0);
+                        std::fill(out.angles.rowPointer(y), out.angles.rowPointer(y) + width, 0);
+                    }
+                    else
+                        gradient_row(image, y, out.magnitudes.rowPointer(y), out.angles.rowPointer(y), scratch);
+                }
+                if (r0 - 1 >= 1) gradient_row(image, r0 - 1, halo_above.data(), nullptr, scratch);
+                if (r1 <= height - 2) gradient_row(image, r1, halo_below.data(), nullptr, scratch);
+                auto mag_row = [&](int y) -> const uint8_t* {
+                    if (y < r0) return halo_above.data();
+                    if (y >= r1) return halo_below.data();
+                    return out.magnitudes.rowPointer(y);
+                };
+
+                uint32_t peaks = 0;
+                for (int y = r0; y < r1; y++)
+                {
+                    uint8_t* dst = out.peaks.rowPointer(y);
+                    if (y < 2 || y >= height - 2 || width < 5)
+                        std::fill(dst, dst + width, 0);
+                    else
+                        peaks += suppress_row(mag_row(y - 1), mag_row(y), mag_row(y + 1), out.angles.rowPointer(y), dst, width);
+                }
+                peak_counts[band] = peaks;
+
+                for (int y = r0; y < r1; y++)
+                {
+                    const uint8_t* here = out.peaks.rowPointer(y);
+                    const uint8_t* above = y > r0 ? out.peaks.rowPointer(y - 1) : nullptr;
+                    const int32_t index = y * width;
+                    // Peaks are 0 on the two outer columns, so x - 1 and x + 1 stay in the row
+                    for (int x = 2; x < width - 2; x++)
+                    {
+                        if (! here[x]) continue;
+                        const int32_t p = index + x;
+                        strong[size_t(p)] = here[x] >= m_high;
+                        // Neighbours of the left neighbour, or of the one above, are already joined to it
+                        const int32_t first = here[x - 1] ? p - 1 : above && above[x] ? p - width : -1;
+                        if (first >= 0)
+                        {
+                            const int32_t root = find(parent, first);
+                            parent[size_t(p)] = root;
+                            strong[size_t(root)] |= strong[size_t(p)];
+                        }
+                        else
+                        {
+                            parent[size_t(p)] = p;
+                            if (above && above[x - 1]) join(parent, strong, p, p - width - 1);
+                        }
+                        if (above && above[x + 1] && ! above[x]) join(parent, strong, p, p - width + 1);
+                    }
+                }
+            }, threads);
+
+            // Components across band borders
+            for (size_t band = 1; band < bands; band++)
+            {
+                const int y = int(band) * c_band_rows;
+                const uint8_t* here = out.peaks.rowPointer(y);
+                const uint8_t* above = out.peaks.rowPointer(y - 1);
+                for (int x = 0; x < width; x++)
+                {
+                    if (! here[x]) continue;
+                    const int32_t p = y * width + x;
+                    for (int dx = -1; dx <= 1; dx++)
+                        if (x + dx >= 0 && x + dx < width && above[x + dx]) join(parent, strong, p, p - width + dx);
+                }
+            }
+
+            // Roots are the smallest index of their set, so parents precede children: one raster pass flattens
+            for (int y = 2; y < height - 2; y++)
+            {
+                const uint8_t* here = out.peaks.rowPointer(y);
+                const int32_t index = y * width;
+                for (int x = 2; x < width - 2; x++)
+                    if (here[x]) parent[size_t(index + x)] = parent[size_t(parent[size_t(index + x)])];
+            }
+
+            for_each_frame(bands, [&](size_t band){
+                const int r0 = int(band) * c_band_rows;
+                const int r1 = std::min(height, r0 + c_band_rows);
+                uint32_t edges = 0;
+                for (int y = r0; y < r1; y++)
+                {
+                    const uint8_t* here = out.peaks.rowPointer(y);
+                    uint8_t* dst = out.edges.rowPointer(y);
+                    const size_t index = size_t(y) * size_t(width);
+                    for (int x = 0; x < width; x++)
+                    {
+                        const uint8_t label = here[x] && strong[size_t(parent[index + size_t(x)])] ? c_edge_label : 0;
+                        dst[x] = label;
+                        edges += label != 0;
+                    }
+                }
+                edge_counts[band] = edges;
+            }, threads);
+
+            for (size_t band = 0; band < bands; band++)
+            {
+                out.peak_count += peak_counts[band];
+                out.edge_count += edge_counts[band];
+            }
+        }
+
+        uint8_t m_low;
+        uint8_t m_high;
+        unsigned m_threads;
+    };
+}
+
+#endif /* edge_pipeline_hpp */
@@ -0,0 +1,142 @@
+//
+//  frame_pool.hpp
+//  svl
+//
+//  Size class pool of 64 byte aligned image buffers.
+//
+//  Frames of the same size are created and dropped at a high rate ( per frame copies, crops, scratch images ).
+//  A released buffer is kept on the free list of its size class and handed out again to the next request of
+//  that class, instead of going back to the system allocator.
+//
+
+#ifndef frame_pool_hpp
+#define frame_pool_hpp
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace svl
+{
+    class frame_pool
+    {
+    public:
+        static const size_t c_alignment = 64;
+        static const size_t c_default_capacity = size_t(256) << 20;
+
+        // Never destroyed, so buffers released during static destruction still find their pool
+        static frame_pool& instance ()
+        {
+            static frame_pool* pool = new frame_pool;
+            return *pool;
+        }
+
+        /*
+         * Size class of bytes: multiples of the alignment up to 4K, then 8 classes per power of two.
+         * At most 1/8 of a buffer is unused.
+         */
+        static size_t size_class (size_t bytes)
+        {
+            bytes = round_up(bytes ? bytes : 1, c_alignment);
+            if (bytes <= 4096) return bytes;
+            size_t pow2 = 4096;
+            while (pow2 <= bytes / 2) pow2 *= 2;
+            return round_up(bytes, pow2 / 8);
+        }
+
+        /*
+         * c_alignment aligned buffer of at least bytes. The buffer goes back to the pool when the last
+         * reference is released. Throws std::bad_alloc.
+         */
+        std::shared_ptr<uint8_t> acquire (size_t bytes)
+        {
+            const size_t cls = size_class(bytes);
+            uint8_t* block = nullptr;
+            {
+                std::lock_guard<std::mutex> lock (m_mutex);
+                auto found = m_free.find(cls);
+                if (found != m_free.end() && ! found->second.empty())
+                {
+                    block = found->second.back();
+                    found->second.pop_back();
+                    m_cached -= cls;
+                    m_hits++;
+                }
+                else
+                    m_misses++;
+            }
+            if (block == nullptr)
+            {
+                void* mem = nullptr;
+                if (posix_memalign(&mem, c_alignment, cls) != 0) throw std::bad_alloc ();
+                block = static_cast<uint8_t*>(mem);
+            }
+            frame_pool* pool = this;
+            return std::shared_ptr<uint8_t> (block, [pool, cls] (uint8_t* ptr) { pool->release(ptr, cls); });
+        }
+
+        // Frees cached buffers until no more than keep bytes are cached
+        void trim (size_t keep = 0)
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            for (auto it = m_free.begin(); it != m_free.end() && m_cached > keep; ++it)
+            {
+                while (! it->second.empty() && m_cached > keep)
+                {
+                    std::free(it->second.back());
+                    it->second.pop_back();
+                    m_cached -= it->first;
+                }
+            }
+        }
+
+        // Bytes kept for reuse beyond capacity are returned to the system
+        void set_capacity (size_t bytes)
+        {
+            {
+                std::lock_guard<std::mutex> lock (m_mutex);
+                m_capacity = bytes;
+            }
+            trim(bytes);
+        }
+
+        size_t capacity () const { std::lock_guard<std::mutex> lock (m_mutex); return m_capacity; }
+        size_t cached_bytes () const { std::lock_guard<std::mutex> lock (m_mutex); return m_cached; }
+        size_t hits () const { std::lock_guard<std::mutex> lock (m_mutex); return m_hits; }
+        size_t misses () const { std::lock_guard<std::mutex> lock (m_mutex); return m_misses; }
+
+    private:
+        frame_pool () : m_capacity (c_default_capacity), m_cached (0), m_hits (0), m_misses (0) {}
+        frame_pool (const frame_pool&) = delete;
+        frame_pool& operator= (const frame_pool&) = delete;
+
+        static size_t round_up (size_t value, size_t step) { return ((value + step - 1) / step) * step; }
+
+        void release (uint8_t* block, size_t cls)
+        {
+            {
+                std::lock_guard<std::mutex> lock (m_mutex);
+                if (m_cached + cls <= m_capacity)
+                {
+                    m_free[cls].push_back(block);
+                    m_cached += cls;
+                    return;
+                }
+            }
+            std::free(block);
+        }
+
+        mutable std::mutex m_mutex;
+        std::map<size_t, std::vector<uint8_t*>> m_free;
+        size_t m_capacity;
+        size_t m_cached;
+        size_t m_hits;
+        size_t m_misses;
+    };
+}
+
+#endif /* frame_pool_hpp */
@@ -0,0 +1,51 @@
+//
+//  frame_threads.hpp
+//  svl
+//
+//  Runs a per frame function over a serie of frames on a pool of threads.
+//  Engines that split their work by frame, frame pair, tile or band use these instead of their own pools.
+//
+
+#ifndef frame_threads_hpp
+#define frame_threads_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace svl
+{
+    // Calls fn(index, scratch) for index in [0, count) on up to threads threads, 0 for one per core, with one
+    // default constructed S per thread. A thread reuses its scratch for all the frames it processes.
+    // Frames are handed out one at a time, so uneven frame costs balance out.
+    template <typename S, typename F>
+    void for_each_frame_scratch (size_t count, F&& fn, unsigned threads = 0)
+    {
+        if (count == 0) return;
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        std::atomic<size_t> next (0);
+        auto worker = [&](){
+            S scratch;
+            for (size_t index = next++; index < count; index = next++)
+                fn(index, scratch);
+        };
+        unsigned nthreads = static_cast<unsigned>(std::min(size_t(threads), count));
+        std::vector<std::thread> pool;
+        for (unsigned tt = 1; tt < nthreads; tt++)
+            pool.emplace_back(worker);
+        worker();
+        std::for_each(pool.begin(), pool.end(), std::mem_fn(&std::thread::join));
+    }
+
+    // As for_each_frame_scratch, calling fn(index)
+    template <typename F>
+    void for_each_frame (size_t count, F&& fn, unsigned threads = 0)
+    {
+        struct no_scratch {};
+        for_each_frame_scratch<no_scratch>(count, [&fn](size_t index, no_scratch&){ fn(index); }, threads);
+    }
+}
+
+#endif /* frame_threads_hpp */
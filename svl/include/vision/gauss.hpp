@@ -1,4 +1,13 @@
+#ifndef __GAUSS__
+#define __GAUSS__
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
 #include "vision/roiWindow.h"
+#include "vision/frame_threads.hpp"
 
 
 
@@ -204,3 +213,290 @@ void Gauss3by3(const roiWindow<P> & src, roiWindow<P> & destination)
 }
 
 
+
+/////////////// Gaussian Smoothing of any sigma  ///////////////////////////////
+
+//
+// 8 bit, 16 bit and float images. Computed in float, rounded and clamped to the pixel type.
+// Pixels beyond the edges replicate the edge pixels. Rows are filtered in place, columns
+// a row at a time over strips of columns, so the inner loops run over contiguous pixels.
+//
+// GaussSeparable  FIR kernel of radius ceil(3 sigma). Cost grows with sigma
+// GaussRecursive  Deriche 4th order recursive filter. Cost does not depend on sigma. Within 0.1% of the peak
+//                 of the Gaussian. sigma >= 0.5
+//
+// dest is allocated, from the frame pool, if it is not bound or is not the size of src.
+// src and dest may be the same window.
+//
+
+enum gauss_method
+{
+    gauss_separable = 0,
+    gauss_recursive = 1
+};
+
+namespace svl
+{
+    namespace gauss_detail
+    {
+        // Columns per strip in column passes
+        static const int c_strip = 64;
+
+        template <typename T>
+        inline typename std::enable_if<std::is_integral<T>::value, T>::type to_pixel (float v)
+        {
+            if (v <= 0.0f) return T(0);
+            if (v >= float(std::numeric_limits<T>::max())) return std::numeric_limits<T>::max();
+            return T(v + 0.5f);
+        }
+
+        template <typename T>
+        inline typename std::enable_if<! std::is_integral<T>::value, T>::type to_pixel (float v)
+        {
+            return T(v);
+        }
+
+        template <typename P>
+        void ensure_like (const roiWindow<P>& src, roiWindow<P>& dest)
+        {
+            if (dest.isBound() && dest.width() == src.width() && dest.height() == src.height()) return;
+            dest = roiWindow<P>(src.width(), src.height(), align_every_row, pooled_allocation);
+        }
+
+        template <typename P>
+        void load (const roiWindow<P>& src, std::vector<float>& buf)
+        {
+            const int32_t w = src.width();
+            buf.resize(size_t(w) * src.height());
+            for (int32_t row = 0; row < src.height(); row++)
+                std::copy(src.rowPointer(row), src.rowPointer(row) + w, buf.begin() + size_t(row) * w);
+        }
+
+        template <typename P>
+        void store (const std::vector<float>& buf, roiWindow<P>& dest)
+        {
+            typedef typename PixelType<P>::pixel_t pixel_t;
+            const int32_t w = dest.width();
+            for (int32_t row = 0; row < dest.height(); row++)
+            {
+                const float* in = buf.data() + size_t(row) * w;
+                pixel_t* out = dest.rowPointer(row);
+                for (int32_t col = 0; col < w; col++)
+                    out[col] = to_pixel<pixel_t>(in[col]);
+            }
+        }
+
+        // Center tap followed by taps 1 .. radius, summing to 1 over both sides
+        inline std::vector<float> kernel (float sigma)
+        {
+            const int radius = std::max(1, int(std::ceil(3.0f * sigma)));
+            std::vector<float> taps (radius + 1);
+            double sum = 0;
+            for (int i = 0; i <= radius; i++)
+            {
+                taps[i] = float(std::exp(-0.5 * double(i) * i / (double(sigma) * sigma)));
+                sum += i ? 2.0 * taps[i] : taps[i];
+            }
+            for (auto& t : taps) t = float(t / sum);
+            return taps;
+        }
+
+        inline void separable (std::vector<float>& buf, int32_t w, int32_t h, const std::vector<float>& taps)
+        {
+            const int r = int(taps.size()) - 1;
+
+            // Rows: through an edge replicated copy of the row
+            std::vector<float> padded (w + 2 * r);
+            for (int32_t row = 0; row < h; row++)
+            {
+                float* line = buf.data() + size_t(row) * w;
+                std::fill(padded.begin(), padded.begin() + r, line[0]);
+                std::copy(line, line + w, padded.begin() + r);
+                std::fill(padded.begin() + r + w, padded.end(), line[w - 1]);
+                const float* pc = padded.data() + r;
+                for (int32_t x = 0; x < w; x++) line[x] = taps[0] * pc[x];
+                for (int i = 1; i <= r; i++)
+                {
+                    const float t = taps[i];
+                    const float* left = pc - i;
+                    const float* right = pc + i;
+                    for (int32_t x = 0; x < w; x++) line[x] += t * (left[x] + right[x]);
+                }
+            }
+
+            // Columns: each output row accumulates 2r + 1 input rows, a strip of columns at a time
+            std::vector<float> out (size_t(w) * h);
+            auto in_row = [&](int32_t y){ return buf.data() + size_t(std::min(h - 1, std::max(0, y))) * w; };
+            for (int32_t x0 = 0; x0 < w; x0 += c_strip)
+            {
+                const int32_t x1 = std::min(w, x0 + c_strip);
+                for (int32_t row = 0; row < h; row++)
+                {
+                    float* acc = out.data() + size_t(row) * w;
+                    const float* center = in_row(row);
+                    for (int32_t x = x0; x < x1; x++) acc[x] = taps[0] * center[x];
+                    for (int i = 1; i <= r; i++)
+                    {
+                        const float t = taps[i];
+                        const float* above = in_row(row - i);
+                        const float* below = in_row(row + i);
+                        for (int32_t x = x0; x < x1; x++) acc[x] += t * (above[x] + below[x]);
+                    }
+                }
+            }
+            buf.swap(out);
+        }
+
+        /*
+         * Deriche: Recursively implementing the Gaussian and its derivatives. INRIA RR-1893 (1993)
+         * 4th order causal and anti causal filters, summed. Coefficients are normalized to unit gain and kept in
+         * double: with large sigmas the poles near 1 amplify coefficient rounding.
+         */
+        struct recursive_coefficients
+        {
+            explicit recursive_coefficients (float sigma)
+            {
+                const double s = std::max(0.5, double(sigma));
+                const double a0 = 1.680, a1 = 3.735, b0 = 1.783, w0 = 0.6318;
+                const double c0 = -0.6803, c1 = -0.2598, b1 = 1.723, w1 = 1.997;
+                const double cw0 = std::cos(w0 / s), sw0 = std::sin(w0 / s), cw1 = std::cos(w1 / s), sw1 = std::sin(w1 / s);
+                const double e0 = std::exp(-b0 / s), e1 = std::exp(-b1 / s);
+                n0 = a0 + c0;
+                n1 = e1 * (c1 * sw1 - (c0 + 2 * a0) * cw1) + e0 * (a1 * sw0 - (2 * c0 + a0) * cw0);
+                n2 = 2 * e0 * e1 * ((a0 + c0) * cw1 * cw0 - a1 * cw1 * sw0 - c1 * cw0 * sw1) + c0 * e0 * e0 + a0 * e1 * e1;
+                n3 = e1 * e0 * e0 * (c1 * sw1 - c0 * cw1) + e0 * e1 * e1 * (a1 * sw0 - a0 * cw0);
+                d1 = -2 * e1 * cw1 - 2 * e0 * cw0;
+                d2 = 4 * cw1 * cw0 * e0 * e1 + e1 * e1 + e0 * e0;
+                d3 = -2 * cw0 * e0 * e1 * e1 - 2 * cw1 * e1 * e0 * e0;
+                d4 = e0 * e0 * e1 * e1;
+                m1 = n1 - d1 * n0;
+                m2 = n2 - d2 * n0;
+                m3 = n3 - d3 * n0;
+                m4 = -d4 * n0;
+                const double poles = 1 + d1 + d2 + d3 + d4;
+                const double gain = (n0 + n1 + n2 + n3 + m1 + m2 + m3 + m4) / poles;
+                n0 /= gain; n1 /= gain; n2 /= gain; n3 /= gain;
+                m1 /= gain; m2 /= gain; m3 /= gain; m4 /= gain;
+                // Responses to a constant unit signal, the state beyond the edges
+                causal_edge = (n0 + n1 + n2 + n3) / poles;
+                anti_causal_edge = (m1 + m2 + m3 + m4) / poles;
+            }
+            double n0, n1, n2, n3;     // causal
+            double m1, m2, m3, m4;     // anti causal
+            double d1, d2, d3, d4;     // both
+            double causal_edge, anti_causal_edge;
+        };
+
+        inline void recursive_line (float* line, int32_t n, const recursive_coefficients& c, std::vector<float>& scratch)
+        {
+            scratch.assign(line, line + n);
+            const float* x = scratch.data();
+            double x1 = x[0], x2 = x1, x3 = x1;
+            double y1 = c.causal_edge * x[0], y2 = y1, y3 = y1, y4 = y1;
+            for (int32_t i = 0; i < n; i++)
+            {
+                const double y0 = c.n0 * x[i] + c.n1 * x1 + c.n2 * x2 + c.n3 * x3 - c.d1 * y1 - c.d2 * y2 - c.d3 * y3 - c.d4 * y4;
+                line[i] = float(y0);
+                x3 = x2; x2 = x1; x1 = x[i];
+                y4 = y3; y3 = y2; y2 = y1; y1 = y0;
+            }
+            double x4 = x[n - 1];
+            x1 = x2 = x3 = x4;
+            y1 = y2 = y3 = y4 = c.anti_causal_edge * x[n - 1];
+            for (int32_t i = n - 1; i >= 0; i--)
+            {
+                const double y0 = c.m1 * x1 + c.m2 * x2 + c.m3 * x3 + c.m4 * x4 - c.d1 * y1 - c.d2 * y2 - c.d3 * y3 - c.d4 * y4;
+                line[i] += float(y0);
+                x4 = x3; x3 = x2; x2 = x1; x1 = x[i];
+                y4 = y3; y3 = y2; y2 = y1; y1 = y0;
+            }
+        }
+
+        inline void recursive (std::vector<float>& buf, int32_t w, int32_t h, float sigma)
+        {
+            const recursive_coefficients c (sigma);
+            std::vector<float> scratch;
+            for (int32_t row = 0; row < h; row++)
+                recursive_line(buf.data() + size_t(row) * w, w, c, scratch);
+
+            // Columns: the same recursions down and up the rows, over a strip of columns at a time.
+            // Anti causal rows are kept in a ring of 5 strip rows
+            std::vector<float> out (size_t(w) * h);
+            std::vector<float> top (w), bottom (w), ring (5 * c_strip);
+            for (int32_t x = 0; x < w; x++)
+            {
+                top[x] = float(c.causal_edge * buf[x]);
+                bottom[x] = float(c.anti_causal_edge * buf[size_t(h - 1) * w + x]);
+            }
+            auto x_row = [&](int32_t y){ return buf.data() + size_t(std::min(h - 1, std::max(0, y))) * w; };
+            auto y_row = [&](int32_t y){ return y < 0 ? top.data() : out.data() + size_t(y) * w; };
+            for (int32_t x0 = 0; x0 < w; x0 += c_strip)
+            {
+                const int32_t sw = std::min(w - x0, int32_t(c_strip));
+                for (int32_t row = 0; row < h; row++)
+                {
+                    const float *x0r = x_row(row) + x0, *x1r = x_row(row - 1) + x0, *x2r = x_row(row - 2) + x0, *x3r = x_row(row - 3) + x0;
+                    const float *y1r = y_row(row - 1) + x0, *y2r = y_row(row - 2) + x0, *y3r = y_row(row - 3) + x0, *y4r = y_row(row - 4) + x0;
+                    float* y0r = y_row(row) + x0;
+                    for (int32_t x = 0; x < sw; x++)
+                        y0r[x] = float(c.n0 * x0r[x] + c.n1 * x1r[x] + c.n2 * x2r[x] + c.n3 * x3r[x]
+                                       - c.d1 * y1r[x] - c.d2 * y2r[x] - c.d3 * y3r[x] - c.d4 * y4r[x]);
+                }
+                auto a_row = [&](int32_t y){ return y >= h ? bottom.data() + x0 : ring.data() + (y % 5) * c_strip; };
+                for (int32_t row = h - 1; row >= 0; row--)
+                {
+                    const float *x1r = x_row(row + 1) + x0, *x2r = x_row(row + 2) + x0, *x3r = x_row(row + 3) + x0, *x4r = x_row(row + 4) + x0;
+                    const float *y1r = a_row(row + 1), *y2r = a_row(row + 2), *y3r = a_row(row + 3), *y4r = a_row(row + 4);
+                    float* y0r = a_row(row);
+                    float* result = y_row(row) + x0;
+                    for (int32_t x = 0; x < sw; x++)
+                    {
+                        y0r[x] = float(c.m1 * x1r[x] + c.m2 * x2r[x] + c.m3 * x3r[x] + c.m4 * x4r[x]
+                                       - c.d1 * y1r[x] - c.d2 * y2r[x] - c.d3 * y3r[x] - c.d4 * y4r[x]);
+                        result[x] += y0r[x];
+                    }
+                }
+            }
+            buf.swap(out);
+        }
+    }
+}
+
+template <typename P>
+void GaussSeparable (const roiWindow<P>& src, roiWindow<P>& dest, float sigma)
+{
+    assert(src.isBound() && sigma > 0.0f);
+    std::vector<float> buf;
+    svl::gauss_detail::load(src, buf);
+    svl::gauss_detail::separable(buf, src.width(), src.height(), svl::gauss_detail::kernel(sigma));
+    svl::gauss_detail::ensure_like(src, dest);
+    svl::gauss_detail::store(buf, dest);
+}
+
+template <typename P>
+void GaussRecursive (const roiWindow<P>& src, roiWindow<P>& dest, float sigma)
+{
+    assert(src.isBound() && sigma > 0.0f);
+    std::vector<float> buf;
+    svl::gauss_detail::load(src, buf);
+    svl::gauss_detail::recursive(buf, src.width(), src.height(), sigma);
+    svl::gauss_detail::ensure_like(src, dest);
+    svl::gauss_detail::store(buf, dest);
+}
+
+/*
+ * Gaussian smoothing of every frame of a serie, frames spread over threads ( 0 for one per core ).
+ * dests is resized to the serie. Frames that are not bound or not the size of their source are allocated.
+ */
+template <typename P>
+void GaussSerie (const std::vector<roiWindow<P>>& serie, std::vector<roiWindow<P>>& dests, float sigma,
+                 gauss_method method = gauss_recursive, unsigned threads = 0)
+{
+    dests.resize(serie.size());
+    svl::for_each_frame(serie.size(), [&](size_t ff){
+        if (method == gauss_recursive) GaussRecursive(serie[ff], dests[ff], sigma);
+        else GaussSeparable(serie[ff], dests[ff], sigma);
+    }, threads);
+}
+
+#endif
@@ -1,4 +1,11 @@
+#ifndef __GMORPH__
+#define __GMORPH__
+
+#include <algorithm>
+#include <limits>
+#include <vector>
 #include "vision/roiWindow.h"
+#include "vision/frame_threads.hpp"
 
  
 
@@ -101,3 +108,163 @@ void PixelMax3by3(const roiWindow<P>& srcImg, roiWindow<P>& dstImg)
 }
 
 
+
+//////// Min && Max over any rectangle /////////////
+
+//
+// van Herk / Gil-Werman: 3 comparisons per pixel in each direction, whatever the rectangle size.
+// The rectangle is width x height, anchored at ( width / 2, height / 2 ) as in OpenCV. Only image
+// pixels take part, as in OpenCV's erode / dilate with the default border.
+// Rows are filtered into a scratch image, then columns a row at a time over strips of columns.
+//
+// dest is allocated, from the frame pool, if it is not bound or is not the size of src.
+// src and dest may be the same window.
+//
+
+namespace svl
+{
+    namespace morph_detail
+    {
+        static const int c_strip = 64;
+
+        template <typename T>
+        struct min_op
+        {
+            static T neutral () { return std::numeric_limits<T>::max(); }
+            T operator() (T a, T b) const { return b < a ? b : a; }
+        };
+
+        template <typename T>
+        struct max_op
+        {
+            static T neutral () { return std::numeric_limits<T>::lowest(); }
+            T operator() (T a, T b) const { return b > a ? b : a; }
+        };
+
+        /*
+         * out[x] = op of in[x - k/2 .. x - k/2 + k - 1]. The line is padded with neutral values and cut in
+         * blocks of k. g runs op forward within each block, h backward. A window spans at most two blocks,
+         * so it is the op of h at its first sample and g at its last.
+         */
+        template <typename T, typename Op>
+        void line (const T* in, T* out, int32_t n, int k, std::vector<T>& g, std::vector<T>& h, Op op)
+        {
+            if (k <= 1)
+            {
+                std::copy(in, in + n, out);
+                return;
+            }
+            const int32_t left = k / 2;
+            const int32_t m = n + k - 1;
+            g.resize(m);
+            h.resize(m);
+            auto padded = [&](int32_t j){ int32_t i = j - left; return (i >= 0 && i < n) ? in[i] : Op::neutral(); };
+            for (int32_t j = 0; j < m; j++)
+                g[j] = (j % k) ? op(g[j - 1], padded(j)) : padded(j);
+            for (int32_t j = m - 1; j >= 0; j--)
+                h[j] = (j == m - 1 || ((j + 1) % k) == 0) ? padded(j) : op(h[j + 1], padded(j));
+            for (int32_t x = 0; x < n; x++)
+                out[x] = op(h[x], g[x + k - 1]);
+        }
+
+        template <typename P, typename Op>
+        void rectangle (const roiWindow<P>& src, roiWindow<P>& dest, int width, int height, Op op)
+        {
+            typedef typename PixelType<P>::pixel_t pixel_t;
+            assert(src.isBound() && width > 0 && height > 0);
+            const int32_t w = src.width();
+            const int32_t ht = src.height();
+
+            // Rows
+            std::vector<pixel_t> rows (size_t(w) * ht);
+            std::vector<pixel_t> g, h;
+            for (int32_t row = 0; row < ht; row++)
+                line(src.rowPointer(row), rows.data() + size_t(row) * w, w, width, g, h, op);
+
+            if (! (dest.isBound() && dest.width() == w && dest.height() == ht))
+                dest = roiWindow<P>(w, ht, align_every_row, pooled_allocation);
+
+            // Columns, the same scheme with rows in place of pixels
+            const int32_t k = height;
+            if (k <= 1)
+            {
+                for (int32_t row = 0; row < ht; row++)
+                    std::copy(rows.begin() + size_t(row) * w, rows.begin() + size_t(row + 1) * w, dest.rowPointer(row));
+                return;
+            }
+            const int32_t above = k / 2;
+            const int32_t m = ht + k - 1;
+            const std::vector<pixel_t> neutral (w, Op::neutral());
+            auto padded = [&](int32_t j){ int32_t i = j - above; return (i >= 0 && i < ht) ? rows.data() + size_t(i) * w : neutral.data(); };
+            g.resize(size_t(m) * c_strip);
+            h.resize(size_t(m) * c_strip);
+            for (int32_t x0 = 0; x0 < w; x0 += c_strip)
+            {
+                const int32_t sw = std::min(w - x0, int32_t(c_strip));
+                for (int32_t j = 0; j < m; j++)
+                {
+                    const pixel_t* a = padded(j) + x0;
+                    pixel_t* gj = g.data() + size_t(j) * c_strip;
+                    if (j % k)
+                    {
+                        const pixel_t* gp = gj - c_strip;
+                        for (int32_t x = 0; x < sw; x++) gj[x] = op(gp[x], a[x]);
+                    }
+                    else
+                        std::copy(a, a + sw, gj);
+                }
+                for (int32_t j = m - 1; j >= 0; j--)
+                {
+                    const pixel_t* a = padded(j) + x0;
+                    pixel_t* hj = h.data() + size_t(j) * c_strip;
+                    if (j == m - 1 || ((j + 1) % k) == 0)
+                        std::copy(a, a + sw, hj);
+                    else
+                    {
+                        const pixel_t* hn = hj + c_strip;
+                        for (int32_t x = 0; x < sw; x++) hj[x] = op(hn[x], a[x]);
+                    }
+                }
+                for (int32_t row = 0; row < ht; row++)
+                {
+                    const pixel_t* hr = h.data() + size_t(row) * c_strip;
+                    const pixel_t* gr = g.data() + size_t(row + k - 1) * c_strip;
+                    pixel_t* out = dest.rowPointer(row) + x0;
+                    for (int32_t x = 0; x < sw; x++) out[x] = op(hr[x], gr[x]);
+                }
+            }
+        }
+    }
+}
+
+template <class P>
+void PixelMin (const roiWindow<P>& src, roiWindow<P>& dest, int width, int height)
+{
+    svl::morph_detail::rectangle(src, dest, width, height, svl::morph_detail::min_op<typename PixelType<P>::pixel_t>());
+}
+
+template <class P>
+void PixelMax (const roiWindow<P>& src, roiWindow<P>& dest, int width, int height)
+{
+    svl::morph_detail::rectangle(src, dest, width, height, svl::morph_detail::max_op<typename PixelType<P>::pixel_t>());
+}
+
+/*
+ * Min / Max of every frame of a serie, frames spread over threads ( 0 for one per core ).
+ * dests is resized to the serie. Frames that are not bound or not the size of their source are allocated.
+ */
+template <class P>
+void PixelMinSerie (const std::vector<roiWindow<P>>& serie, std::vector<roiWindow<P>>& dests, int width, int height, unsigned threads = 0)
+{
+    dests.resize(serie.size());
+    svl::for_each_frame(serie.size(), [&](size_t ff){ PixelMin(serie[ff], dests[ff], width, height); }, threads);
+}
+
+template <class P>
+void PixelMaxSerie (const std::vector<roiWindow<P>>& serie, std::vector<roiWindow<P>>& dests, int width, int height, unsigned threads = 0)
+{
+    dests.resize(serie.size());
+    svl::for_each_frame(serie.size(), [&](size_t ff){ PixelMax(serie[ff], dests[ff], width, height); }, threads);
+}
+
+#endif
@@ -0,0 +1,277 @@
+//
+//  graph_segmenter.hpp
+//  svl
+//
+//  Felzenszwalb - Huttenlocher graph segmentation on an 8 connected pixel grid.
+//
+//  Edge weights are computed in parallel over bands of rows, each band writing to its own, precomputed, range
+//  of the edge list so the list is in the same order as a serial pass. Weights are non negative floats, whose
+//  bit patterns order like the values, and are sorted with a stable LSD radix sort of 3 11 bit digits.
+//  Merging runs over the sorted edges on a disjoint set forest with union by rank and path halving. Labels
+//  are read back in parallel once the forest no longer changes.
+//
+
+#ifndef graph_segmenter_hpp
+#define graph_segmenter_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "vision/frame_threads.hpp"
+
+namespace svl
+{
+    /*
+     disjointSet
+     Union by rank, path halving. size() and link() take roots
+     */
+    class disjointSet
+    {
+    public:
+        explicit disjointSet (int elements = 0) { reset(elements); }
+
+        void reset (int elements)
+        {
+            m_parent.resize(size_t(elements));
+            for (int ii = 0; ii < elements; ii++) m_parent[size_t(ii)] = ii;
+            m_rank.assign(size_t(elements), 0);
+            m_size.assign(size_t(elements), 1);
+            m_sets = elements;
+        }
+
+        int find (int x)
+        {
+            while (m_parent[size_t(x)] != x)
+            {
+                m_parent[size_t(x)] = m_parent[size_t(m_parent[size_t(x)])];
+                x = m_parent[size_t(x)];
+            }
+            return x;
+        }
+
+        // Without path compression, safe to call concurrently while no thread modifies the forest
+        int root (int x) const
+        {
+            while (m_parent[size_t(x)] != x) x = m_parent[size_t(x)];
+            return x;
+        }
+
+        // Joins the sets of roots a and b, returns the root of the union
+        int link (int a, int b)
+        {
+            if (m_rank[size_t(a)] < m_rank[size_t(b)]) std::swap(a, b);
+            if (m_rank[size_t(a)] == m_rank[size_t(b)]) m_rank[size_t(a)]++;
+            m_parent[size_t(b)] = a;
+            m_size[size_t(a)] += m_size[size_t(b)];
+            m_sets--;
+            return a;
+        }
+
+        int size (int root) const { return m_size[size_t(root)]; }
+        int sets () const { return m_sets; }
+
+    private:
+        std::vector<int> m_parent;
+        std::vector<uint8_t> m_rank;
+        std::vector<int> m_size;
+        int m_sets;
+    };
+
+    class graphSegmenter
+    {
+    public:
+        // euclidean: distance over all channels
+        // cyclic: distance of the first channel on a 256 cycle, as ssSegmenter
+        enum class weight { euclidean, cyclic };
+
+        struct edge
+        {
+            float w;
+            int a, b;
+        };
+
+        /*
+         c: threshold constant, larger values prefer larger components
+         min_size: components smaller than this are merged with a neighbour afterwards
+         threads: 0 for one per core
+         */
+        graphSegmenter (float c, int min_size, weight measure = weight::euclidean, unsigned threads = 0) :
+        m_c (c), m_min_size (min_size), m_measure (measure), m_threads (threads), m_width (0), m_height (0) {}
+
+        /*
+         Segments channels, single channel CV_32F images of one size.
+         Returns false if channels are missing or do not match
+         */
+        bool process (const std::vector<cv::Mat>& channels)
+        {
+            m_labels = cv::Mat ();
+            if (channels.empty() || channels[0].empty()) return false;
+            for (const auto& cc : channels)
+                if (cc.type() != CV_32FC1 || cc.size() != channels[0].size()) return false;
+            m_width = channels[0].cols;
+            m_height = channels[0].rows;
+
+            compute_edges(channels);
+            radix_sort(m_edges, m_sorted);
+            segment();
+            label();
+            return true;
+        }
+
+        const cv::Mat& labels () const { return m_labels; } // CV_32S, a root pixel index per component
+        int components () const { return m_forest.sets(); }
+        int width () const { return m_width; }
+        int height () const { return m_height; }
+        const std::vector<edge>& edges () const { return m_edges; } // in non decreasing weight order
+
+        // Stable sort of edges on weight, scratch is used as the other buffer
+        static void radix_sort (std::vector<edge>& edges, std::vector<edge>& scratch)
+        {
+            const int c_bits = 11;
+            const int c_passes = (32 + c_bits - 1) / c_bits;
+            const size_t c_buckets = size_t(1) << c_bits;
+            scratch.resize(edges.size());
+
+            // Counts of all digits in one read of the edges
+            std::vector<size_t> offsets (c_buckets * c_passes, 0);
+            for (const auto& ee : edges)
+                for (int pass = 0; pass < c_passes; pass++)
+                    offsets[pass * c_buckets + digit(ee.w, pass * c_bits)]++;
+
+            for (int pass = 0; pass < c_passes; pass++)
+            {
+                size_t* first = &offsets[pass * c_buckets];
+                // Every edge in one bucket: already in order on this digit
+                if (std::find(first, first + c_buckets, edges.size()) != first + c_buckets) continue;
+                size_t sum = 0;
+                for (size_t bb = 0; bb < c_buckets; bb++) { const size_t count = first[bb]; first[bb] = sum; sum += count; }
+                for (const auto& ee : edges) scratch[first[digit(ee.w, pass * c_bits)]++] = ee;
+                edges.swap(scratch);
+            }
+        }
+
+    private:
+        static size_t digit (float w, int shift)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &w, sizeof(bits));
+            return (bits >> shift) & 0x7FF;
+        }
+
+        // Edges of row y: right, down, down right, up right of each pixel, as ssSegmenter
+        int row_edges (int y) const
+        {
+            const int ww = m_width;
+            return (ww - 1) + (y < m_height - 1 ? 2 * ww - 1 : 0) + (y > 0 ? ww - 1 : 0);
+        }
+
+        float distance (const std::vector<const float*>& row1, int x1, const std::vector<const float*>& row2, int x2) const
+        {
+            if (m_measure == weight::cyclic)
+            {
+                float c1 = row1[0][x1];
+                if (c1 < 0) c1 += 255.0f;
+                float c2 = row2[0][x2];
+                if (c2 < 0) c2 += 255.0f;
+                c2 = c1 - c2;
+                if (c2 < 0) c2 += 255.0f;
+                return std::sqrt(std::fmod(c2, 256.0f));
+            }
+            float sum = 0.0f;
+            for (size_t cc = 0; cc < row1.size(); cc++)
+            {
+                const float d = row1[cc][x1] - row2[cc][x2];
+                sum += d * d;
+            }
+            return std::sqrt(sum);
+        }
+
+        void compute_edges (const std::vector<cv::Mat>& channels)
+        {
+            const int ww = m_width, hh = m_height;
+            std::vector<size_t> first (size_t(hh) + 1, 0);
+            for (int y = 0; y < hh; y++) first[size_t(y) + 1] = first[size_t(y)] + size_t(row_edges(y));
+            m_edges.resize(first.back());
+
+            const int c_band_rows = 16;
+            const size_t bands = size_t((hh + c_band_rows - 1) / c_band_rows);
+            for_each_frame(bands, [&](size_t band){
+                std::vector<const float*> above (channels.size()), here (channels.size()), below (channels.size());
+                const int y0 = static_cast<int>(band) * c_band_rows;
+                for (int y = y0; y < std::min(hh, y0 + c_band_rows); y++)
+                {
+                    for (size_t cc = 0; cc < channels.size(); cc++)
+                    {
+                        here[cc] = channels[cc].ptr<float>(y);
+                        above[cc] = y > 0 ? channels[cc].ptr<float>(y - 1) : nullptr;
+                        below[cc] = y < hh - 1 ? channels[cc].ptr<float>(y + 1) : nullptr;
+                    }
+                    edge* out = &m_edges[first[size_t(y)]];
+                    const int index = y * ww;
+                    for (int x = 0; x < ww; x++)
+                    {
+                        if (x < ww - 1)
+                            *out++ = edge{distance(here, x, here, x + 1), index + x, index + x + 1};
+                        if (y < hh - 1)
+                            *out++ = edge{distance(here, x, below, x), index + x, index + ww + x};
+                        if (x < ww - 1 && y < hh - 1)
+                            *out++ = edge{distance(here, x, below, x + 1), index + x, index + ww + x + 1};
+                        if (x < ww - 1 && y > 0)
+                            *out++ = edge{distance(here, x, above, x + 1), index + x, index - ww + x + 1};
+                    }
+                }
+            }, m_threads);
+        }
+
+        void segment ()
+        {
+            const int vertices = m_width * m_height;
+            m_forest.reset(vertices);
+            std::vector<float> threshold (size_t(vertices), m_c);
+            for (const auto& ee : m_edges)
+            {
+                int a = m_forest.find(ee.a);
+                int b = m_forest.find(ee.b);
+                if (a != b && ee.w <= threshold[size_t(a)] && ee.w <= threshold[size_t(b)])
+                {
+                    a = m_forest.link(a, b);
+                    threshold[size_t(a)] = ee.w + m_c / m_forest.size(a);
+                }
+            }
+            // Small components join their cheapest neighbour
+            for (const auto& ee : m_edges)
+            {
+                const int a = m_forest.find(ee.a);
+                const int b = m_forest.find(ee.b);
+                if (a != b && (m_forest.size(a) < m_min_size || m_forest.size(b) < m_min_size))
+                    m_forest.link(a, b);
+            }
+        }
+
+        void label ()
+        {
+            const int ww = m_width;
+            m_labels = cv::Mat(m_height, m_width, CV_32SC1);
+            const disjointSet& forest = m_forest;
+            for_each_frame(size_t(m_height), [&](size_t row){
+                int32_t* out = m_labels.ptr<int32_t>(int(row));
+                const int index = int(row) * ww;
+                for (int x = 0; x < ww; x++) out[x] = forest.root(index + x);
+            }, m_threads);
+        }
+
+        float m_c;
+        int m_min_size;
+        weight m_measure;
+        unsigned m_threads;
+        int m_width, m_height;
+        std::vector<edge> m_edges, m_sorted;
+        disjointSet m_forest;
+        cv::Mat m_labels;
+    };
+}
+
+#endif /* graph_segmenter_hpp */
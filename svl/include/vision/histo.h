@@ -36,9 +36,10 @@ public:
     static double median (const roiWindow<P> & image);
     
     template <typename P>
-    void from_image(const roiWindow<P> & image);
+    void from_image(const roiWindow<P> & image, unsigned threads = 0);
     /*
     requires an allocated image. Supports 8bit and 16bit images only
+    effect   Multi bank histogram ( svl::histogramEngine ), split across threads for large images
     
   */
     histoStats(const cv::Mat& histogram);
@@ -169,8 +170,7 @@ private:
     void computeMoments();               // compute mean,sDev,var,energry
     void computeSS();                    // compute sum squared
 
-    template<typename P>
-    void init (const std::array<uint32_t, PixelBinSize<P>::bins>&);
+    void init (std::vector<uint32_t>&);
     
     vector<uint32_t> histogram_; // histogram given at construction
 
@@ -0,0 +1,169 @@
+//
+//  histogram_engine.hpp
+//  svl
+//
+//  Multi bank histograms of 8 and 16 bit images.
+//
+//  Neighbouring pixels often have the same value ( flat microscopy backgrounds ). Incrementing one counter
+//  for each of them makes every increment wait for the store of the previous one. Consecutive pixels are
+//  instead counted in interleaved sub histograms, banks, that are summed at the end.
+//  16 bit data is binned by its significant bits: a 12 bit camera fills 4096 bins, or fewer if asked for.
+//  Large frames are split in bands of rows across threads; a serie is split by frame.
+//
+
+#ifndef histogram_engine_hpp
+#define histogram_engine_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "vision/roiWindow.h"
+#include "vision/frame_threads.hpp"
+
+namespace svl
+{
+    class histogramEngine
+    {
+    public:
+        // Frames with fewer pixels are not split across threads
+        static const int64_t c_parallel_pixels = int64_t(1) << 20;
+
+        /*
+         depth_bits: significant bits of the pixel values, 0 for the pixel width. Larger values count in the last bin
+         bin_bits: log2 of the number of bins, at most depth_bits, 0 for depth_bits
+         threads: 0 for one per core
+         */
+        explicit histogramEngine (unsigned depth_bits = 0, unsigned bin_bits = 0, unsigned threads = 0) :
+        m_depth_bits (depth_bits), m_bin_bits (bin_bits), m_threads (threads) {}
+
+        template <typename P>
+        unsigned depth_bits () const
+        {
+            const unsigned width = 8 * sizeof(typename PixelType<P>::pixel_t);
+            return m_depth_bits == 0 ? width : std::min(m_depth_bits, width);
+        }
+
+        template <typename P>
+        unsigned bin_bits () const
+        {
+            return m_bin_bits == 0 ? depth_bits<P>() : std::min(m_bin_bits, depth_bits<P>());
+        }
+
+        template <typename P>
+        size_t bins () const { return size_t(1) << bin_bits<P>(); }
+
+        // Histogram of image in hist, resized to bins()
+        template <typename P>
+        void compute (const roiWindow<P>& image, std::vector<uint32_t>& hist) const
+        {
+            const size_t nbins = bins<P>();
+            hist.assign(nbins, 0);
+            if (! image.isBound()) return;
+            const int height = image.height();
+            const int64_t pixels = int64_t(image.width()) * height;
+            const unsigned threads = m_threads ? m_threads : std::max(1u, std::thread::hardware_concurrency());
+            if (threads == 1 || pixels < c_parallel_pixels)
+            {
+                std::vector<uint32_t> banks;
+                accumulate(image, 0, height, banks, hist);
+                return;
+            }
+
+            const int bands = int(std::min<int64_t>(int64_t(threads), height));
+            std::vector<std::vector<uint32_t>> partials (size_t(bands), std::vector<uint32_t> (nbins, 0));
+            for_each_frame_scratch<std::vector<uint32_t>>(size_t(bands), [&](size_t band, std::vector<uint32_t>& banks){
+                accumulate(image, int(band) * height / bands, int(band + 1) * height / bands, banks, partials[band]);
+            }, threads);
+            for (const auto& partial : partials)
+                for (size_t bin = 0; bin < nbins; bin++) hist[bin] += partial[bin];
+        }
+
+        // Histogram of image in hist on the calling thread, with caller owned scratch banks reused across calls
+        template <typename P>
+        void compute (const roiWindow<P>& image, std::vector<uint32_t>& hist, std::vector<uint32_t>& banks) const
+        {
+            hist.assign(bins<P>(), 0);
+            if (image.isBound()) accumulate(image, 0, image.height(), banks, hist);
+        }
+
+        // Histograms of frames, all frames in parallel
+        template <typename P>
+        void compute (const std::vector<roiWindow<P>>& frames, std::vector<std::vector<uint32_t>>& hists) const
+        {
+            hists.assign(frames.size(), std::vector<uint32_t> (bins<P>(), 0));
+            for_each_frame_scratch<std::vector<uint32_t>>(frames.size(), [&](size_t index, std::vector<uint32_t>& banks){
+                if (frames[index].isBound())
+                    accumulate(frames[index], 0, frames[index].height(), banks, hists[index]);
+            }, m_threads);
+        }
+
+    private:
+        // Adds rows [first, last) of image to hist. banks is scratch
+        template <typename P>
+        void accumulate (const roiWindow<P>& image, int first, int last, std::vector<uint32_t>& banks,
+                         std::vector<uint32_t>& hist) const
+        {
+            typedef typename PixelType<P>::pixel_t pixel_t;
+            const size_t nbins = bins<P>();
+            // 8 banks of 8 bit bins fit in L1, 4 for larger histograms
+            const int nbanks = nbins <= 256 ? 8 : 4;
+            banks.assign(nbins * size_t(nbanks), 0);
+            const unsigned shift = depth_bits<P>() - bin_bits<P>();
+            const uint32_t top = uint32_t(nbins - 1);
+            const bool identity = shift == 0 && depth_bits<P>() == 8 * sizeof(pixel_t);
+            const int width = image.width();
+
+            for (int row = first; row < last; row++)
+            {
+                const pixel_t* src = image.rowPointer(row);
+                if (identity)
+                    count_row(src, width, nbanks, nbins, banks.data(), [](uint32_t v) { return v; });
+                else
+                    count_row(src, width, nbanks, nbins, banks.data(), [shift, top](uint32_t v) { return std::min(v >> shift, top); });
+            }
+            for (int bank = 0; bank < nbanks; bank++)
+            {
+                const uint32_t* counts = banks.data() + size_t(bank) * nbins;
+                for (size_t bin = 0; bin < nbins; bin++) hist[bin] += counts[bin];
+            }
+        }
+
+        template <typename T, typename B>
+        static void count_row (const T* src, int width, int nbanks, size_t nbins, uint32_t* banks, B bin_of)
+        {
+            int col = 0;
+            if (nbanks == 8)
+            {
+                for (; col + 8 <= width; col += 8)
+                {
+                    banks[bin_of(src[col])]++;
+                    banks[nbins + bin_of(src[col + 1])]++;
+                    banks[2 * nbins + bin_of(src[col + 2])]++;
+                    banks[3 * nbins + bin_of(src[col + 3])]++;
+                    banks[4 * nbins + bin_of(src[col + 4])]++;
+                    banks[5 * nbins + bin_of(src[col + 5])]++;
+                    banks[6 * nbins + bin_of(src[col + 6])]++;
+                    banks[7 * nbins + bin_of(src[col + 7])]++;
+                }
+            }
+            else
+            {
+                for (; col + 4 <= width; col += 4)
+                {
+                    banks[bin_of(src[col])]++;
+                    banks[nbins + bin_of(src[col + 1])]++;
+                    banks[2 * nbins + bin_of(src[col + 2])]++;
+                    banks[3 * nbins + bin_of(src[col + 3])]++;
+                }
+            }
+            for (; col < width; col++) banks[bin_of(src[col])]++;
+        }
+
+        unsigned m_depth_bits;
+        unsigned m_bin_bits;
+        unsigned m_threads;
+    };
+}
+
+#endif /* histogram_engine_hpp */
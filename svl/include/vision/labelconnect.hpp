@@ -11,36 +11,53 @@
 
 #include <stdio.h>
 #include <map>
+#include <vector>
 
 #include "roiWindow.h"
 #include "core/rectangle.h"
+#include "core/pair.hpp"
 
 using namespace svl;
 
+/*
+ labelConnect
+ 8 connected components of the non zero pixels of src. Labels are 1 to regions(), in raster order of each
+ component's first pixel; background is 0.
+ Labeling, areas, bounding boxes and moments take one pass over the image, in parallel over strips of rows.
+ */
 template<typename P>
 class labelConnect
 {
 public:
     typedef P32S::value_type bin_type;
     typedef std::map<bin_type,iRect> label_bbox_map_t;
-    labelConnect (const roiWindow<P>& src);
+    
+    // Area, bounding box and raw moments of a region
+    struct region_t {
+        region_t () : area (0), first (-1), sx (0), sy (0), sxx (0), syy (0), sxy (0) {}
+        int64_t area;
+        int64_t first; // raster index of first pixel
+        iRect bbox;
+        int64_t sx, sy, sxx, syy, sxy;
+        dPair centroid () const { return area ? dPair(double(sx) / area, double(sy) / area) : dPair(); }
+    };
+    
+    // threads: strips labeled concurrently, 0 for one per core
+    labelConnect (const roiWindow<P>& src, unsigned threads = 0);
     bool run ();
     const roiWindow<P32S>& label () const;
     uint32_t regions () const;
     const label_bbox_map_t& label_bbox_map () const;
+    const std::vector<region_t>& region_stats () const; // indexed by label, 0 is unused
 private:
     
     void get_components ();
-    void get_rects ();
     roiWindow<P> src_shallow_;
-    roiWindow<P32S> buffer_;
     roiWindow<P32S> label_;
-    std::vector<iRect> rois_;
-    std::vector<bin_type> amm_;
+    unsigned threads_;
     bin_type regions_;
-    bin_type icomponent_;
     label_bbox_map_t label2roi_;
-    void add_to_associative (bin_type, bin_type);
+    std::vector<region_t> stats_;
 };
 
 //
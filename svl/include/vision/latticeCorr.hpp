@@ -0,0 +1,304 @@
+//
+//  latticeCorr.hpp
+//
+//
+//  Created by Arman Garakani on 4/14/17.
+//
+//
+
+#ifndef latticeCorr_hpp
+#define latticeCorr_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <vector>
+#include "core/pair.hpp"
+#include "core/rectangle.h"
+#include "roiWindow.h"
+#include "rowfunc.h"
+#include "vision/frame_threads.hpp"
+
+namespace svl
+{
+    /* latticeSimilarity - Self-similarity of every tile of a lattice over a serie of frames
+     *
+     * Each tile gets its own self-similarity matrix and similarity rank ( entropy ) signal, as if a
+     * self_similarity_producer had been run on the tile windows. The whole frame is computed along with
+     * the tiles.
+     *
+     * Tiles are tile sized, step apart. When the frame is not a multiple of step, a last column / row of
+     * tiles is aligned with the right / bottom edge ( as rfLatticeCorrelate did ).
+     *
+     * All tile moments come from integral images: per frame sums and sums of squares, and per frame pair
+     * sum of products. One integral image of a pair is shared by all tiles, so overlapping tiles do not
+     * cost extra pixel passes. Frames, pairs and tile signals are processed in parallel.
+     *
+     * Memory: frames x frames / 2 x ( tiles + 1 ) floats for the tile matrices.
+     */
+    class latticeSimilarity
+    {
+    public:
+        typedef roiWindow<P8U> image_t;
+        typedef std::deque<double> signal_t;
+        typedef std::deque<std::deque<double> > matrix_t;
+
+        latticeSimilarity (const iPair& tile = iPair(16, 16), const iPair& step = iPair(8, 8), unsigned threads = 0, double tiny = 1e-10)
+        : m_tile (tile), m_step (step), m_tiny (tiny), m_frames (0)
+        {
+            m_threads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        /* lattice_dimensions - Number of tile columns and rows for an image size */
+        static iPair lattice_dimensions (const iPair& image, const iPair& tile, const iPair& step)
+        {
+            if (tile.x() <= 0 || tile.y() <= 0 || step.x() <= 0 || step.y() <= 0) return iPair(0, 0);
+            if (tile.x() > image.x() || tile.y() > image.y()) return iPair(0, 0);
+            return iPair((image.x() - tile.x() + step.x() - 1) / step.x() + 1,
+                         (image.y() - tile.y() + step.y() - 1) / step.y() + 1);
+        }
+
+        /* fill - Computes all tile matrices and signals for frames. All frames must be the same size.
+         * Returns false if there are fewer than 2 frames, sizes differ or no tile fits.
+         */
+        bool fill (const std::vector<image_t>& frames)
+        {
+            clear();
+            if (frames.size() < 2) return false;
+            const iPair isize (frames[0].width(), frames[0].height());
+            for (const auto& frame : frames)
+                if (! frame.isBound() || frame.width() != isize.x() || frame.height() != isize.y()) return false;
+            m_lattice = lattice_dimensions(isize, m_tile, m_step);
+            if (m_lattice.x() == 0 || m_lattice.y() == 0) return false;
+
+            for (int32_t row = 0; row < m_lattice.y(); row++)
+            {
+                int32_t ty = std::min(row * m_step.y(), isize.y() - m_tile.y());
+                for (int32_t col = 0; col < m_lattice.x(); col++)
+                {
+                    int32_t tx = std::min(col * m_step.x(), isize.x() - m_tile.x());
+                    m_tiles.emplace_back(tx, ty, m_tile.x(), m_tile.y());
+                }
+            }
+            // The whole frame is the last region
+            m_regions = m_tiles;
+            m_regions.emplace_back(0, 0, isize.x(), isize.y());
+
+            const size_t nr = m_regions.size();
+            const size_t nf = frames.size();
+            m_frames = nf;
+
+            // Per frame region sums and sums of squares
+            m_si.assign(nf * nr, 0);
+            m_sii.assign(nf * nr, 0);
+            // One scratch integral per thread
+            for_each_frame_scratch<std::vector<uint64_t>>(nf, [&](size_t ff, std::vector<uint64_t>& integral){
+                integrate(frames[ff], frames[ff], integral);
+                for (size_t rr = 0; rr < nr; rr++){
+                    m_sii[ff * nr + rr] = box_sum(integral, isize.x(), m_regions[rr]);
+                }
+                integrate(frames[ff], integral);
+                for (size_t rr = 0; rr < nr; rr++){
+                    m_si[ff * nr + rr] = box_sum(integral, isize.x(), m_regions[rr]);
+                }
+            }, m_threads);
+
+            // Per pair region correlations
+            const size_t np = (nf * (nf - 1)) / 2;
+            m_scores.assign(np * nr, 0.0f);
+            for_each_frame_scratch<std::vector<uint64_t>>(np, [&](size_t pp, std::vector<uint64_t>& integral){
+                size_t ii, jj;
+                pair_of(pp, nf, ii, jj);
+                integrate(frames[ii], frames[jj], integral);
+                for (size_t rr = 0; rr < nr; rr++){
+                    CorrelationParts cp (m_tiny);
+                    CorrelationParts::sumproduct_t sim = box_sum(integral, isize.x(), m_regions[rr]);
+                    CorrelationParts::sumproduct_t sii = m_sii[ii * nr + rr], smm = m_sii[jj * nr + rr];
+                    CorrelationParts::sumproduct_t si = m_si[ii * nr + rr], sm = m_si[jj * nr + rr];
+                    cp.n(m_regions[rr].width() * m_regions[rr].height());
+                    cp.accumulate(sim, sii, smm, si, sm);
+                    m_scores[pp * nr + rr] = static_cast<float>(cp.compute());
+                }
+            }, m_threads);
+
+            // Per region similarity rank signals
+            m_entropies.assign(nr, signal_t());
+            for_each_frame(nr, [&](size_t rr){
+                matrix_t matrix;
+                region_matrix(rr, matrix);
+                matrix_entropies(matrix, m_entropies[rr]);
+            }, m_threads);
+            return true;
+        }
+
+        void clear ()
+        {
+            m_lattice = iPair(0, 0);
+            m_frames = 0;
+            m_tiles.clear();
+            m_regions.clear();
+            m_si.clear();
+            m_sii.clear();
+            m_scores.clear();
+            m_entropies.clear();
+        }
+
+        /* Accessors
+         * lattice() is columns, rows. Tiles are in row major order.
+         */
+        const iPair& lattice () const { return m_lattice; }
+        const iPair& tile_size () const { return m_tile; }
+        const iPair& step () const { return m_step; }
+        size_t frames () const { return m_frames; }
+        const std::vector<iRect>& tiles () const { return m_tiles; }
+
+        const signal_t& tile_entropies (int32_t col, int32_t row) const { return m_entropies[tile_index(col, row)]; }
+
+        /* entropies - Similarity rank signal of the whole frame */
+        const signal_t& entropies () const { return m_entropies.back(); }
+
+        /* tileSelfSimilarityMatrix - Self-similarity matrix of a tile, 1 + tiny on the diagonal */
+        void tileSelfSimilarityMatrix (int32_t col, int32_t row, matrix_t& matrix) const { region_matrix(tile_index(col, row), matrix); }
+
+        /* entropy_map - Rows of tiles. Standard deviation of each tile's similarity rank signal.
+         * Tiles whose content changes over the serie stand out; static tiles are near 0.
+         */
+        std::vector<std::vector<double> > entropy_map () const
+        {
+            std::vector<std::vector<double> > map (m_lattice.y(), std::vector<double>(m_lattice.x(), 0.0));
+            for (int32_t row = 0; row < m_lattice.y(); row++)
+                for (int32_t col = 0; col < m_lattice.x(); col++)
+                {
+                    const signal_t& signal = tile_entropies(col, row);
+                    if (signal.empty()) continue;
+                    double mean = 0.0, sq = 0.0;
+                    for (auto val : signal) mean += val;
+                    mean /= signal.size();
+                    for (auto val : signal) sq += (val - mean) * (val - mean);
+                    map[row][col] = std::sqrt(sq / signal.size());
+                }
+            return map;
+        }
+
+        /* matrix_entropies - Similarity rank of each frame from a self-similarity matrix.
+         * Same normalization as self_similarity_producer.
+         */
+        static void matrix_entropies (const matrix_t& matrix, signal_t& signal)
+        {
+            const size_t msz = matrix.size();
+            signal.assign(msz, 0.0);
+            if (msz < 2) return;
+            std::vector<double> sums (msz);
+            for (size_t i = 0; i < msz; i++) sums[i] = matrix[i][i];
+            for (size_t i = 0; i < msz - 1; i++)
+                for (size_t j = i + 1; j < msz; j++)
+                {
+                    sums[i] += matrix[i][j];
+                    sums[j] += matrix[i][j];
+                }
+            auto shannon = [](double r) { return -1.0 * r * log2(r); };
+            const double log2MSz = log2(double(msz));
+            for (size_t i = 0; i < msz; i++)
+            {
+                for (size_t j = i; j < msz; j++)
+                {
+                    signal[i] += shannon(matrix[i][j] / sums[i]);
+                    if (i != j) signal[j] += shannon(matrix[i][j] / sums[j]);
+                }
+                signal[i] = signal[i] / log2MSz;
+            }
+        }
+
+    private:
+        size_t tile_index (int32_t col, int32_t row) const
+        {
+            assert(col >= 0 && col < m_lattice.x() && row >= 0 && row < m_lattice.y());
+            return size_t(row) * m_lattice.x() + col;
+        }
+
+        // Index of pair i < j in row major upper triangle order
+        static void pair_of (size_t pp, size_t nf, size_t& ii, size_t& jj)
+        {
+            ii = 0;
+            while (pp >= nf - 1 - ii) { pp -= nf - 1 - ii; ii++; }
+            jj = ii + 1 + pp;
+        }
+
+        void region_matrix (size_t rr, matrix_t& matrix) const
+        {
+            const size_t nr = m_regions.size();
+            matrix.assign(m_frames, std::deque<double>(m_frames, 0.0));
+            size_t pp = 0;
+            for (size_t i = 0; i < m_frames; i++)
+            {
+                matrix[i][i] = 1.0 + m_tiny;
+                for (size_t j = i + 1; j < m_frames; j++, pp++)
+                    matrix[i][j] = matrix[j][i] = m_scores[pp * nr + rr];
+            }
+        }
+
+        // Integral image of a, ( width + 1 ) x ( height + 1 ), first row and column 0
+        static void integrate (const image_t& a, std::vector<uint64_t>& integral)
+        {
+            const int32_t width = a.width(), height = a.height();
+            integral.assign(size_t(width + 1) * (height + 1), 0);
+            for (int32_t y = 0; y < height; y++)
+            {
+                const uint8_t* pa = a.rowPointer(y);
+                const uint64_t* above = &integral[size_t(y) * (width + 1)];
+                uint64_t* cur = &integral[size_t(y + 1) * (width + 1)];
+                uint64_t run = 0;
+                for (int32_t x = 0; x < width; x++)
+                {
+                    run += pa[x];
+                    cur[x + 1] = above[x + 1] + run;
+                }
+            }
+        }
+
+        // Integral image of the product a * b
+        static void integrate (const image_t& a, const image_t& b, std::vector<uint64_t>& integral)
+        {
+            const int32_t width = a.width(), height = a.height();
+            integral.assign(size_t(width + 1) * (height + 1), 0);
+            for (int32_t y = 0; y < height; y++)
+            {
+                const uint8_t* pa = a.rowPointer(y);
+                const uint8_t* pb = b.rowPointer(y);
+                const uint64_t* above = &integral[size_t(y) * (width + 1)];
+                uint64_t* cur = &integral[size_t(y + 1) * (width + 1)];
+                uint64_t run = 0;
+                for (int32_t x = 0; x < width; x++)
+                {
+                    run += uint32_t(pa[x]) * pb[x];
+                    cur[x + 1] = above[x + 1] + run;
+                }
+            }
+        }
+
+        static uint64_t box_sum (const std::vector<uint64_t>& integral, int32_t width, const iRect& box)
+        {
+            const size_t stride = width + 1;
+            const size_t x0 = box.ul().x(), y0 = box.ul().y();
+            const size_t x1 = x0 + box.width(), y1 = y0 + box.height();
+            return integral[y1 * stride + x1] + integral[y0 * stride + x0] - integral[y0 * stride + x1] - integral[y1 * stride + x0];
+        }
+
+        iPair m_tile;
+        iPair m_step;
+        unsigned m_threads;
+        double m_tiny;
+        iPair m_lattice;
+        size_t m_frames;
+        std::vector<iRect> m_tiles;
+        std::vector<iRect> m_regions;
+        std::vector<uint64_t> m_si;
+        std::vector<uint64_t> m_sii;
+        std::vector<float> m_scores;
+        std::vector<signal_t> m_entropies;
+    };
+}
+
+#endif /* latticeCorr_hpp */
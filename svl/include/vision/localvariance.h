@@ -8,7 +8,10 @@
 #ifndef irec_framework_localvariance_h
 #define irec_framework_localvariance_h
 
+#include <vector>
 #include "opencv2/opencv.hpp"
+#include "vision/roiWindow.h"
+#include "core/pair.hpp"
 
 
 
@@ -55,6 +58,59 @@ namespace svl
         void convert_or_not (const cv::Mat&) const;
 
     };
+
+    /*!
+     Local Variance of 8 or 16 bit frames, a frame at a time or a serie of frames in parallel.
+
+     Variance is the sample variance of the window centred at each pixel ( anchor at window / 2 ), clipped to
+     the image, so every pixel gets a value. Sums and sums of squares come from one fused pass building 64 bit
+     integral images, so results are exact before the final division.
+     Output is float, or 8 bit normalized to the frame's min and max variance as cv::normalize NORM_MINMAX.
+     Outputs that are not bound or not the size of their frame are allocated.
+
+     Holds no state besides its parameters and is safe to share across threads. Integral buffers belong to the
+     calling thread, and in the serie entry points to each worker thread, and are reused across frames.
+     */
+    class localVarianceEngine
+    {
+    public:
+        // threads: for serie entry points, 0 for one per core
+        explicit localVarianceEngine (const iPair& window, unsigned threads = 0);
+
+        const iPair& window () const { return m_window; }
+        unsigned threads () const { return m_threads; }
+
+        // false if window is less than 1 in either side or image is not bound
+        template<typename P>
+        bool process (const roiWindow<P>& image, roiWindow<P32F>& variance) const;
+        template<typename P>
+        bool process (const roiWindow<P>& image, roiWindow<P8U>& normalized) const;
+
+        // Frames [first, last) of serie. results is resized to last - first
+        template<typename P>
+        bool process (const std::vector<roiWindow<P>>& serie, size_t first, size_t last, std::vector<roiWindow<P32F>>& results) const;
+        template<typename P>
+        bool process (const std::vector<roiWindow<P>>& serie, size_t first, size_t last, std::vector<roiWindow<P8U>>& results) const;
+
+        // Per thread buffers
+        struct scratch_t
+        {
+            std::vector<uint64_t> sum;
+            std::vector<uint64_t> sumsq;
+            std::vector<float> variance;
+        };
+
+    private:
+        template<typename P>
+        bool compute (const roiWindow<P>& image, scratch_t& scratch, float& vmin, float& vmax) const;
+        template<typename P, typename R>
+        bool process_frame (const roiWindow<P>& image, scratch_t& scratch, R& result) const;
+        template<typename P, typename R>
+        bool process_serie (const std::vector<roiWindow<P>>& serie, size_t first, size_t last, std::vector<R>& results) const;
+
+        iPair m_window;
+        unsigned m_threads;
+    };
     
 }
 
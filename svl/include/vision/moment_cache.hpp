@@ -0,0 +1,144 @@
+//
+//  moment_cache.hpp
+//  svl
+//
+//  Per frame / per ROI first and second moments ( count, sum, sum of squares ).
+//
+//  Normalized correlation of a pair needs both images' moments and their cross product sum.
+//  Only the cross product depends on the pair, so moments are computed once per image window and
+//  looked up for every pair it takes part in.
+//
+
+#ifndef moment_cache_hpp
+#define moment_cache_hpp
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include "roiWindow.h"
+#include "rowfunc.h"
+
+namespace svl
+{
+    struct imageMoments
+    {
+        typedef CorrelationParts::sumproduct_t sumproduct_t;
+        imageMoments () : n(0), s(0), ss(0) {}
+        uint32_t n;
+        sumproduct_t s;
+        sumproduct_t ss;
+    };
+
+    template <typename P>
+    imageMoments moments (const roiWindow<P>& image)
+    {
+        typedef typename PixelType<P>::pixel_t pixel_t;
+        imageMoments out;
+        out.n = image.width() * image.height();
+        for (int32_t row = 0; row < image.height(); row++)
+        {
+            const pixel_t* pel = image.rowPointer(row);
+            uint64_t s = 0, ss = 0;
+            for (const pixel_t* end = pel + image.width(); pel < end; ++pel)
+            {
+                const uint64_t v = *pel;
+                s += v;
+                ss += v * v;
+            }
+            out.s += s;
+            out.ss += ss;
+        }
+        return out;
+    }
+
+    /* momentCache - Moments keyed by frame buffer and window bounds.
+     *
+     * Entries hold a weak reference to the frame buffer. An entry whose buffer has been released is
+     * never returned, so a new buffer allocated at a recycled address is recomputed. Pixels of a cached
+     * window are assumed not to change; call invalidate() if they do. Thread safe.
+     */
+    class momentCache
+    {
+    public:
+        momentCache () : m_hits (0), m_misses (0) {}
+
+        template <typename P>
+        imageMoments get (const roiWindow<P>& image)
+        {
+            const key_t key = key_of(image);
+            {
+                std::lock_guard<std::mutex> lock (m_mutex);
+                auto found = m_entries.find(key);
+                if (found != m_entries.end())
+                {
+                    if (! found->second.buffer.expired())
+                    {
+                        m_hits++;
+                        return found->second.moments;
+                    }
+                    m_entries.erase(found);
+                }
+            }
+            entry_t entry;
+            entry.buffer = image.frameBuf();
+            entry.moments = moments(image);
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_misses++;
+            if ((m_misses % c_sweep_interval) == 0) sweep();
+            m_entries[key] = entry;
+            return entry.moments;
+        }
+
+        template <typename P>
+        void invalidate (const roiWindow<P>& image)
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_entries.erase(key_of(image));
+        }
+
+        void clear ()
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_entries.clear();
+        }
+
+        size_t size () const { std::lock_guard<std::mutex> lock (m_mutex); return m_entries.size(); }
+        size_t hits () const { std::lock_guard<std::mutex> lock (m_mutex); return m_hits; }
+        size_t misses () const { std::lock_guard<std::mutex> lock (m_mutex); return m_misses; }
+
+    private:
+        static const size_t c_sweep_interval = 1024;
+
+        // buffer address, x, y, width, height, bytes per pixel
+        typedef std::tuple<const void*, int32_t, int32_t, int32_t, int32_t, size_t> key_t;
+
+        struct entry_t
+        {
+            std::weak_ptr<void> buffer;
+            imageMoments moments;
+        };
+
+        template <typename P>
+        static key_t key_of (const roiWindow<P>& image)
+        {
+            return key_t(image.frameBuf().get(), image.x(), image.y(), image.width(), image.height(),
+                         sizeof(typename PixelType<P>::pixel_t));
+        }
+
+        // Drops entries whose frame buffers are gone
+        void sweep ()
+        {
+            for (auto it = m_entries.begin(); it != m_entries.end();)
+                it = it->second.buffer.expired() ? m_entries.erase(it) : std::next(it);
+        }
+
+        mutable std::mutex m_mutex;
+        std::map<key_t, entry_t> m_entries;
+        size_t m_hits;
+        size_t m_misses;
+    };
+}
+
+#endif /* moment_cache_hpp */
@@ -124,8 +124,28 @@ namespace svl
     // Example    cvMatRefroiP8U(ang, aim, CV_8UC1);
     #define cvMatRefroiP8U(a,b,cvType) cv::Mat b ((a).height(),(a).width(), cvType,(a).pelPointer(0,0), size_t((a).rowUpdate()))
 
+    // Copies into pooled frames
     void cpCvMatToRoiWindow8U (const cv::Mat& m, roiWindow<P8U>& r);
     void cpCvMatToRoiWindow16U (const cv::Mat& m, roiWindow<P16U>& r);
+
+    // Shares m's pixels, no copy. The roiWindow holds a reference on m's buffer. If m does not own its
+    // pixels ( constructed on user data ), they must outlive the roiWindow.
+    // An 8 bit Mat on an svl root ( cvMatShare or svlMatAllocator ) gives a window on that same root.
+    roiWindow<P8U> adoptCvMat8U (const cv::Mat& m);
+    roiWindow<P16U> adoptCvMat16U (const cv::Mat& m);
+
+    // cv::Mat header on roiWindow pixels, no copy. Same as cvMatRefroiP8U, valid while the roiWindow's frame is.
+    cv::Mat cvMatView (const roiWindow<P8U>& r);
+    cv::Mat cvMatView (const roiWindow<P16U>& r);
+
+    // cv::Mat on roiWindow pixels, no copy. The Mat and its copies hold a reference on the roiWindow's frame,
+    // so it can outlive the roiWindow.
+    cv::Mat cvMatShare (const roiWindow<P8U>& r);
+    cv::Mat cvMatShare (const roiWindow<P16U>& r);
+
+    // cv::MatAllocator drawing from pooled svl roots. Mats created with it have 64 byte aligned rows and can be
+    // adopted as roiWindows without copy. Set as a Mat's allocator before create, or as OpenCV's default.
+    cv::MatAllocator* svlMatAllocator ();
     
     double correlation (cv::Mat &image_1, cv::Mat &image_2);
     double correlation_ocv(const roiWindow<P8U>& i, const roiWindow<P8U>& m);
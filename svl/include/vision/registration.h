@@ -7,6 +7,7 @@
 #include "core/fit.hpp"
 #include "vision/ipUtils.h"
 #include "vision/rowfunc.h"
+#include "vision/moment_cache.hpp"
 #include <vector>
 #include <queue>
 #include <bitset>
@@ -82,6 +83,14 @@ namespace Correlation
 {
 template <typename P>
 void point(const roiWindow<P> & moving, const roiWindow<P> & fixed, CorrelationParts & res);
+// Moments of both windows come from cache, only the cross product is computed
+template <typename P>
+void point(const roiWindow<P> & moving, const roiWindow<P> & fixed, CorrelationParts & res, momentCache & cache);
+// Moments of moving are given, fixed's moments and the cross product are computed in one pass
+template <typename P>
+void point(const roiWindow<P> & moving, const roiWindow<P> & fixed, CorrelationParts & res, const imageMoments & movingMoments);
+template <typename P>
+CorrelationParts::sumproduct_t cross(const roiWindow<P> & moving, const roiWindow<P> & fixed);
 template <typename P>
 bool area_translation(const roiWindow<P> & moving, const roiWindow<P> & fixed, spaceResult& );
 template <typename P>
@@ -13,6 +13,7 @@
 #include "core/rectangle.h"
 #include <assert.h>
 #include "pixel_traits.h"
+#include "frame_pool.hpp"
 #include "core/core.hpp"
 
 
@@ -28,6 +29,13 @@ enum image_memory_alignment_policy
     align_first_row = 1
 };
 
+// Where root gets its pixel storage. Pooled storage is frame_pool::c_alignment aligned and reused across frames of the same size
+enum image_memory_allocation_policy
+{
+    heap_allocation = 0,
+    pooled_allocation = 1
+};
+
 
 template <typename T>
 class root
@@ -38,21 +46,50 @@ public:
 
     // Constructors
     root(image_memory_alignment_policy imap = align_every_row, int alignment_bytes = 8)
-        : m_align(alignment_bytes), m_channels  (T::components()),_bayer_type(NoneBayer), m_align_policy(imap)
+        : m_align(alignment_bytes), m_storage(nullptr), m_channels  (T::components()), m_image_data(nullptr), _bayer_type(NoneBayer), m_align_policy(imap), m_alloc_policy(heap_allocation)
     {
         
     }
 
-    root(int32_t width, int32_t height, image_memory_alignment_policy imap = align_every_row, int alignment_bytes = 8)
-        :  m_align(alignment_bytes),  m_channels  (T::components()) ,  _bayer_type(NoneBayer),  m_align_policy(imap)
+    root(int32_t width, int32_t height, image_memory_alignment_policy imap = align_every_row, int alignment_bytes = 8,
+         image_memory_allocation_policy alloc = heap_allocation)
+        :  m_align(alignment_bytes),  m_channels  (T::components()) ,  _bayer_type(NoneBayer),  m_align_policy(imap), m_alloc_policy(alloc)
     {
         setup_native(width, height);
     }
 
+    /* Adopts pixels without copying. owner keeps them alive for the life of this root, e.g. a cv::Mat header
+     * sharing the pixels. Row update in bytes
+     */
+    root(uint8_t * pixels, int32_t rowUpdateBytes, int32_t awidth, int32_t aheight, std::shared_ptr<void> owner)
+        :   m_channels  (T::components()),  _bayer_type(NoneBayer), m_alloc_policy(heap_allocation)
+    {
+        assert(aheight > 0);
+        assert(awidth > 0);
+        assert(pixels);
+        assert(rowUpdateBytes >= awidth * int32_t(T::bytes()));
+
+        m_width = awidth;
+        m_height = aheight;
+        m_bounds = iRect(0, 0, awidth, aheight);
+        m_rowbytes = rowUpdateBytes;
+        m_pad = rowUpdateBytes - awidth * T::bytes();
+        m_align_policy = m_pad ? align_every_row : align_first_row;
+
+        // Largest power of two, up to 256, both the first row and the row update are aligned to
+        m_align = 1;
+        while (m_align < 256 && ((intptr_t)pixels % (2 * m_align)) == 0 && (rowUpdateBytes % (2 * m_align)) == 0)
+            m_align *= 2;
+
+        m_block = std::shared_ptr<uint8_t>(owner, pixels);
+        m_storage = pixels;
+        m_image_data = pixels;
+    }
+
 
     /* Row update for SRC pixels, not DEST frame */
     root(uint8_t * rawPixels, int32_t RowUpdateBytes, int32_t awidth, int32_t aheight, image_memory_alignment_policy imap = align_every_row, int alignment_bytes = 8)
-        :   m_align(alignment_bytes),  m_channels  (T::components()),  _bayer_type(NoneBayer), m_align_policy(imap)
+        :   m_align(alignment_bytes),  m_channels  (T::components()),  _bayer_type(NoneBayer), m_align_policy(imap), m_alloc_policy(heap_allocation)
     {
         assert(aheight > 0);
         assert(awidth > 0);
@@ -76,11 +113,6 @@ public:
 
     virtual ~root()
     {
-        if (m_storage)
-        {
-            delete [] m_storage;
-            m_storage = nullptr;
-        }
     }
     
     bayer_type bayerType() { return _bayer_type; }
@@ -145,6 +177,7 @@ public:
     inline int32_t alignment() const { return m_align; }
     inline int32_t pad () const { return m_pad; }
     inline image_memory_alignment_policy alignment_policy() { return m_align_policy; }
+    inline image_memory_allocation_policy allocation_policy() const { return m_alloc_policy; }
     inline int64_t timestamp() const { return m_timestamp; };
 
 
@@ -194,6 +227,7 @@ protected:
     int32_t m_align;
     int64_t m_timestamp; // Creation time stamp
     uint8_t * m_storage;
+    std::shared_ptr<uint8_t> m_block; // owns m_storage
     iRect m_bounds;
     int32_t m_depth;
     int32_t m_channels;
@@ -205,11 +239,14 @@ protected:
     bayer_type _bayer_type;
 
     image_memory_alignment_policy m_align_policy;
+    image_memory_allocation_policy m_alloc_policy;
 
     void setup_native(int32_t width, int32_t height)
     {
         assert(height > 0);
         assert(width > 0);
+        if (m_alloc_policy == pooled_allocation)
+            m_align = std::max(m_align, int32_t(frame_pool::c_alignment));
         assert(m_align == 16 || m_align == 32 || m_align == 64 || m_align == 8 || m_align == 128 || m_align == 256);
 
         m_width = width;
@@ -229,7 +266,11 @@ protected:
         m_rowbytes = rowBytes + (m_align_policy == align_every_row ? m_pad : 0);
         int size = m_rowbytes * height + m_align - 1;
 
-        m_storage = new uint8_t[size];
+        if (m_alloc_policy == pooled_allocation)
+            m_block = frame_pool::instance().acquire(size_t(m_rowbytes) * height + (m_align > int32_t(frame_pool::c_alignment) ? m_align - 1 : 0));
+        else
+            m_block = std::shared_ptr<uint8_t>(new uint8_t[size], std::default_delete<uint8_t[]>());
+        m_storage = m_block.get();
         auto startPtr = m_storage;
         while ((intptr_t)startPtr % m_align)
             startPtr++;
@@ -99,9 +99,10 @@ public:
         }
     }
 
-    roiWindow(int w, int h, image_memory_alignment_policy im = image_memory_alignment_policy::align_every_row)
+    roiWindow(int w, int h, image_memory_alignment_policy im = image_memory_alignment_policy::align_every_row,
+              image_memory_allocation_policy alloc = image_memory_allocation_policy::heap_allocation)
     {
-        m_frame_buf = sharedRoot_t (new root<T>(w, h, im));
+        m_frame_buf = sharedRoot_t (new root<T>(w, h, im, 8, alloc));
         m_bounds = iRect(0, 0, w, h);
     }
 
@@ -249,6 +249,7 @@ private:
     double shannon (double r) const { return (-1.0 * r * log2 (r)); }
     
     similarity_fn_t               _corr_fn;
+    momentCache                   _moments; // Used by the default similarity function
     progress_fn_t                 _progress_fn;
     
     /* Masking related information
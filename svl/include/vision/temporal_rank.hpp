@@ -0,0 +1,149 @@
+//
+//  temporal_rank.hpp
+//  svl
+//
+//  Temporal rank ( median, min, max, ... ) filter over a volume of frames.
+//
+//  Each output pixel is a rank of the same pixel in the window of frames centred on its frame. Frames past
+//  either end of the serie repeat the end frame. Medians of 3, 5 and 7 frames use branch free min / max
+//  selection networks, other ranks a min / max sorting network, all over whole rows.
+//
+//  The volume is cut in bands of rows, one band per task. A band walks the serie front to back, so the rows of
+//  the frames in the sliding window are read from memory once and reused by every output frame they fall in.
+//
+
+#ifndef temporal_rank_hpp
+#define temporal_rank_hpp
+
+#include <algorithm>
+#include <vector>
+#include "vision/roiWindow.h"
+#include "vision/frame_threads.hpp"
+
+namespace svl
+{
+    class temporalRankFilter
+    {
+    public:
+        static const unsigned c_max_window = 15;
+        static const int c_band_rows = 16;
+
+        /*
+         window: odd number of frames, 1 to c_max_window. 1 copies the serie
+         rank: 0 for the minimum to window - 1 for the maximum, -1 for the median
+         threads: 0 for one per core
+         */
+        explicit temporalRankFilter (unsigned window = 3, int rank = -1, unsigned threads = 0) :
+        m_window (window), m_rank (rank < 0 ? int(window / 2) : rank), m_threads (threads) {}
+
+        bool isValid () const {
+            return (m_window % 2) == 1 && m_window <= c_max_window && m_rank >= 0 && m_rank < int(m_window);
+        }
+        unsigned window () const { return m_window; }
+        int rank () const { return m_rank; }
+        unsigned threads () const { return m_threads; }
+
+        /*
+         Filters src in to dst. dst frames are new pooled frames the size of src's.
+         Returns false if the filter is not valid or src frames differ in size
+         */
+        template <typename P>
+        bool process (const std::vector<roiWindow<P>>& src, std::vector<roiWindow<P>>& dst) const
+        {
+            typedef typename PixelType<P>::pixel_t pixel_t;
+            if (! isValid()) return false;
+            dst.clear();
+            if (src.empty()) return true;
+            const int width = src[0].width();
+            const int height = src[0].height();
+            for (const auto& frame : src)
+                if (! frame.isBound() || frame.width() != width || frame.height() != height) return false;
+
+            dst.reserve(src.size());
+            for (size_t ff = 0; ff < src.size(); ff++)
+                dst.emplace_back(width, height, image_memory_alignment_policy::align_every_row,
+                                 image_memory_allocation_policy::pooled_allocation);
+
+            const int frames = static_cast<int>(src.size());
+            const int half = static_cast<int>(m_window / 2);
+            const size_t bands = size_t((height + c_band_rows - 1) / c_band_rows);
+            for_each_frame(bands, [&](size_t band){
+                const int first = static_cast<int>(band) * c_band_rows;
+                const int last = std::min(height, first + c_band_rows);
+                const pixel_t* rows[c_max_window];
+                for (int ff = 0; ff < frames; ff++)
+                    for (int row = first; row < last; row++)
+                    {
+                        for (int ww = 0; ww < int(m_window); ww++)
+                            rows[ww] = src[size_t(std::max(0, std::min(frames - 1, ff - half + ww)))].rowPointer(row);
+                        filter_row(rows, dst[size_t(ff)].rowPointer(row), width);
+                    }
+            }, m_threads);
+            return true;
+        }
+
+    private:
+        template <typename T>
+        static void sort2 (T& a, T& b) { const T lo = std::min(a, b); b = std::max(a, b); a = lo; }
+
+        template <typename T>
+        static T median3 (T a, T b, T c) { return std::max(std::min(a, b), std::min(std::max(a, b), c)); }
+
+        template <typename T>
+        void filter_row (const T* const* rows, T* out, int width) const
+        {
+            const bool median = m_rank == int(m_window / 2);
+            if (m_window == 1)
+                std::copy(rows[0], rows[0] + width, out);
+            else if (median && m_window == 3)
+            {
+                const T* a = rows[0]; const T* b = rows[1]; const T* c = rows[2];
+                for (int col = 0; col < width; col++)
+                    out[col] = median3(a[col], b[col], c[col]);
+            }
+            else if (median && m_window == 5)
+            {
+                const T* a = rows[0]; const T* b = rows[1]; const T* c = rows[2]; const T* d = rows[3]; const T* e = rows[4];
+                for (int col = 0; col < width; col++)
+                {
+                    const T lo = std::max(std::min(a[col], b[col]), std::min(c[col], d[col]));
+                    const T hi = std::min(std::max(a[col], b[col]), std::max(c[col], d[col]));
+                    out[col] = median3(lo, hi, e[col]);
+                }
+            }
+            else if (median && m_window == 7)
+            {
+                for (int col = 0; col < width; col++)
+                {
+                    T p0 = rows[0][col], p1 = rows[1][col], p2 = rows[2][col], p3 = rows[3][col];
+                    T p4 = rows[4][col], p5 = rows[5][col], p6 = rows[6][col];
+                    sort2(p0, p5); sort2(p0, p3); sort2(p1, p6); sort2(p2, p4);
+                    sort2(p0, p1); sort2(p3, p5); sort2(p2, p6); sort2(p2, p3);
+                    sort2(p3, p6); sort2(p4, p5); sort2(p1, p4); sort2(p1, p3);
+                    sort2(p3, p4);
+                    out[col] = p3;
+                }
+            }
+            else
+            {
+                // Odd even transposition sort of the window, then pick the rank
+                const int n = int(m_window);
+                T v[c_max_window];
+                for (int col = 0; col < width; col++)
+                {
+                    for (int ww = 0; ww < n; ww++) v[ww] = rows[ww][col];
+                    for (int pass = 0; pass < n; pass++)
+                        for (int ww = pass & 1; ww + 1 < n; ww += 2)
+                            sort2(v[ww], v[ww + 1]);
+                    out[col] = v[m_rank];
+                }
+            }
+        }
+
+        unsigned m_window;
+        int m_rank;
+        unsigned m_threads;
+    };
+}
+
+#endif /* temporal_rank_hpp */
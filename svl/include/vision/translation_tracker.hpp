@@ -0,0 +1,211 @@
+//
+//  translation_tracker.hpp
+//  svl
+//
+//  Coarse to fine, sub pixel template tracking between consecutive frames.
+//
+//  The template is first matched over the whole search image at the coarsest level of a Gaussian pyramid.
+//  Each finer level only searches a few pixels around twice the peak of the level above. At full resolution
+//  the peak is refined to sub pixel with a quadratic fit to the peak and its neighbours.
+//  Frame pairs of a serie are independent and are tracked in parallel.
+//
+
+#ifndef translation_tracker_hpp
+#define translation_tracker_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "opencv2/imgproc.hpp"
+#include "core/vector2d.hpp"
+#include "vision/frame_threads.hpp"
+
+namespace svl
+{
+    class translationTracker
+    {
+    public:
+        struct peak {
+            peak () : valid (false), score (0.0f) {}
+            bool valid;
+            float score;
+            fVector_2d location; // top left of the matched template, in image pixels
+        };
+
+        /*
+         threads: frame pairs tracked concurrently, 0 for one per core
+         min_template: pyramid levels are added while the template stays at least this wide and tall
+         method: cv::matchTemplate method, one where the best match is the maximum
+         */
+        explicit translationTracker (unsigned threads = 0, int min_template = 8, int method = cv::TM_CCORR_NORMED) :
+        m_threads (threads), m_min_template (std::max(3, min_template)), m_method (method) {}
+
+        // Best match of templ in image
+        peak locate (const cv::Mat& image, const cv::Mat& templ) const
+        {
+            peak out;
+            if (image.empty() || templ.empty() || image.type() != templ.type() ||
+                templ.cols > image.cols || templ.rows > image.rows)
+                return out;
+
+            std::vector<cv::Mat> images (1, image), templs (1, templ);
+            while (templs.back().cols / 2 >= m_min_template && templs.back().rows / 2 >= m_min_template)
+            {
+                cv::Mat si, st;
+                cv::pyrDown(images.back(), si);
+                cv::pyrDown(templs.back(), st);
+                images.push_back(si);
+                templs.push_back(st);
+            }
+
+            cv::Mat score;
+            cv::Point loc;
+            double best;
+            cv::matchTemplate(images.back(), templs.back(), score, m_method);
+            cv::minMaxLoc(score, nullptr, &best, nullptr, &loc);
+
+            cv::Rect area (0, 0, score.cols, score.rows);
+            for (int level = int(images.size()) - 2; level >= 0; level--)
+            {
+                area = search(images[level], templs[level], cv::Point(2 * loc.x, 2 * loc.y), score, loc, best);
+                // A peak on an edge of the searched area that is not an edge of the image may not be the maximum
+                for (int moves = 0; moves < c_max_moves && ! interior(area, loc, images[level], templs[level]); moves++)
+                    area = search(images[level], templs[level], loc, score, loc, best);
+            }
+
+            const fVector_2d offset = subpixel(score, cv::Point(loc.x - area.x, loc.y - area.y));
+            out.valid = true;
+            out.score = static_cast<float>(best);
+            out.location = fVector_2d(loc.x + offset.x(), loc.y + offset.y());
+            return out;
+        }
+
+        /*
+         length
+         Affine cell window pair: the left and the centre thirds of minus, both at mid height, are tracked in the
+         left and right halves of plus. Returns the distance between the two matches, or -1 if either fails
+         */
+        float length (const cv::Mat& minus, const cv::Mat& plus) const
+        {
+            const int tw = minus.cols / 3;
+            const int th = minus.rows / 3;
+            const int cw = (minus.cols - tw) / 2;
+            const int ch = (minus.rows - th) / 2;
+            const int half = plus.cols / 2;
+            if (tw < 1 || th < 1 || half < tw || plus.rows < th) return -1.0f;
+
+            const cv::Mat left (minus, cv::Rect(0, ch, tw, th));
+            const cv::Mat right (minus, cv::Rect(cw, ch, tw, th));
+            peak lp = locate(cv::Mat(plus, cv::Rect(0, 0, half, plus.rows)), left);
+            peak rp = locate(cv::Mat(plus, cv::Rect(half, 0, half, plus.rows)), right);
+            if (! lp.valid || ! rp.valid) return -1.0f;
+            const fVector_2d rv (rp.location.x() + half, rp.location.y());
+            return static_cast<float>(lp.location.distance(rv));
+        }
+
+        /*
+         lengths
+         length of every window against the one before it, all pairs tracked in parallel.
+         The first window has no predecessor and gets the value of the second
+         */
+        std::vector<float> lengths (const std::vector<cv::Mat>& windows) const
+        {
+            std::vector<float> out (windows.size());
+            if (windows.empty()) return out;
+            if (windows.size() == 1)
+            {
+                out[0] = length(windows[0], windows[0]);
+                return out;
+            }
+            for_each_frame(windows.size() - 1, [&](size_t index){
+                out[index + 1] = length(windows[index + 1], windows[index]);
+            }, m_threads);
+            out[0] = out[1];
+            return out;
+        }
+
+        unsigned threads () const { return m_threads; }
+        int min_template () const { return m_min_template; }
+
+    private:
+        static const int c_radius = 2;
+        static const int c_max_moves = 4;
+
+        /*
+         Matches templ at positions within c_radius of center. Sets score to the scores over the
+         returned area of positions, and loc and best to its maximum
+         */
+        cv::Rect search (const cv::Mat& image, const cv::Mat& templ, cv::Point center,
+                         cv::Mat& score, cv::Point& loc, double& best) const
+        {
+            const int xmax = image.cols - templ.cols;
+            const int ymax = image.rows - templ.rows;
+            const int x0 = std::max(0, std::min(xmax, center.x - c_radius));
+            const int y0 = std::max(0, std::min(ymax, center.y - c_radius));
+            const int x1 = std::max(0, std::min(xmax, center.x + c_radius));
+            const int y1 = std::max(0, std::min(ymax, center.y + c_radius));
+            const cv::Rect area (x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+            const cv::Mat roi (image, cv::Rect(x0, y0, area.width + templ.cols - 1, area.height + templ.rows - 1));
+            cv::matchTemplate(roi, templ, score, m_method);
+            cv::minMaxLoc(score, nullptr, &best, nullptr, &loc);
+            loc.x += x0;
+            loc.y += y0;
+            return area;
+        }
+
+        // True if loc is not on an edge of area, or only on edges that are also edges of the positions in image
+        static bool interior (const cv::Rect& area, const cv::Point& loc, const cv::Mat& image, const cv::Mat& templ)
+        {
+            const int xmax = image.cols - templ.cols;
+            const int ymax = image.rows - templ.rows;
+            if (loc.x == area.x && loc.x > 0) return false;
+            if (loc.y == area.y && loc.y > 0) return false;
+            if (loc.x == area.x + area.width - 1 && loc.x < xmax) return false;
+            if (loc.y == area.y + area.height - 1 && loc.y < ymax) return false;
+            return true;
+        }
+
+        /*
+         Sub pixel offset of the maximum of score at at. With all 8 neighbours, the vertex of the quadratic
+         surface through them, cross term included. Otherwise, or if that vertex is not a maximum within half
+         a pixel, the vertices of the parabolas along each axis that has both neighbours
+         */
+        static fVector_2d subpixel (const cv::Mat& score, const cv::Point& at)
+        {
+            auto f = [&](int dx, int dy){ return score.at<float>(at.y + dy, at.x + dx); };
+            const bool has_x = at.x > 0 && at.x + 1 < score.cols;
+            const bool has_y = at.y > 0 && at.y + 1 < score.rows;
+            if (has_x && has_y)
+            {
+                const float gx = 0.5f * (f(1, 0) - f(-1, 0));
+                const float gy = 0.5f * (f(0, 1) - f(0, -1));
+                const float hxx = f(1, 0) - 2.0f * f(0, 0) + f(-1, 0);
+                const float hyy = f(0, 1) - 2.0f * f(0, 0) + f(0, -1);
+                const float hxy = 0.25f * (f(1, 1) - f(1, -1) - f(-1, 1) + f(-1, -1));
+                const float det = hxx * hyy - hxy * hxy;
+                if (hxx < 0.0f && det > 0.0f)
+                {
+                    const float ox = (hxy * gy - hyy * gx) / det;
+                    const float oy = (hxy * gx - hxx * gy) / det;
+                    if (std::abs(ox) <= 0.5f && std::abs(oy) <= 0.5f) return fVector_2d(ox, oy);
+                }
+            }
+            return fVector_2d(has_x ? vertex(f(-1, 0), f(0, 0), f(1, 0)) : 0.0f,
+                              has_y ? vertex(f(0, -1), f(0, 0), f(0, 1)) : 0.0f);
+        }
+
+        // Offset of the vertex of the parabola through ( -1, a ) ( 0, b ) ( 1, c ), within half a pixel
+        static float vertex (float a, float b, float c)
+        {
+            const float curvature = a - 2.0f * b + c;
+            if (curvature >= 0.0f) return 0.0f;
+            return std::max(-0.5f, std::min(0.5f, 0.5f * (a - c) / curvature));
+        }
+
+        unsigned m_threads;
+        int m_min_template;
+        int m_method;
+    };
+}
+
+#endif /* translation_tracker_hpp */
@@ -3,6 +3,7 @@
 #pragma GCC diagnostic ignored "-Wcomma"
 
 #include "vision/histo.h"
+#include "vision/histogram_engine.hpp"
 #include <limits>
 #include <array>
 #include <vector>
@@ -347,50 +348,20 @@ void histoStats::clear()
 }
 
 template <typename P>
-void histoStats::from_image(const roiWindow<P> & src)
+void histoStats::from_image(const roiWindow<P> & src, unsigned threads)
 {
-    typedef typename PixelType<P>::pixel_ptr_t ptr_t;
-    std::array<uint32_t,PixelBinSize<P>::bins> ahist;
-    ahist.fill (0);
-    
-    uint32_t lastRow = src.height() - 1, row = 0;
-    const uint32_t opsPerLoop = 8;
-    uint32_t unrollCnt = src.width() / opsPerLoop;
-    uint32_t unrollRem = src.width() % opsPerLoop;
-    
-    for (; row <= lastRow; row++)
-    {
-        ptr_t pixelPtr = src.rowPointer(row);
-        
-        for (uint32_t touchCount = 0; touchCount < unrollCnt; touchCount++)
-        {
-            ahist[*pixelPtr++]++;
-            ahist[*pixelPtr++]++;
-            ahist[*pixelPtr++]++;
-            ahist[*pixelPtr++]++;
-            ahist[*pixelPtr++]++;
-            ahist[*pixelPtr++]++;
-            ahist[*pixelPtr++]++;
-            ahist[*pixelPtr++]++;
-        }
-        
-        for (uint32_t touchCount = 0; touchCount < unrollRem; touchCount++)
-            ahist[*pixelPtr++]++;
-    }
-
-    init<P>(ahist);
-
+    std::vector<uint32_t> hist;
+    svl::histogramEngine (0, 0, threads).compute(src, hist);
+    init(hist);
 }
 
-template<typename P>
-void  histoStats::init (const std::array<uint32_t, PixelBinSize<P>::bins>& ah)
+void histoStats::init (std::vector<uint32_t>& hist)
 {
     std::lock_guard <std::mutex> lock(m_mutex);
     clear ();
     valid_bins_.resize(0);
-    bins_ = static_cast<uint32_t>(ah.size());
-    histogram_.resize(bins_);
-    std::copy(ah.begin(), ah.end(), histogram_.begin());
+    bins_ = static_cast<uint32_t>(hist.size());
+    histogram_.swap(hist);
     computeNsamp();
     computeInverseCum(0);
     
@@ -414,8 +385,10 @@ double histoStats::median(const roiWindow<P> & src)
 }
 
 
-template void histoStats::from_image<P8U>(const roiWindow<P8U> & src);
-template void histoStats::init <P8U>(const std::array<uint32_t, PixelBinSize<P8U>::bins>&);
+template void histoStats::from_image<P8U>(const roiWindow<P8U> & src, unsigned);
+template void histoStats::from_image<P16U>(const roiWindow<P16U> & src, unsigned);
 template double histoStats::mean<P8U> (const roiWindow<P8U> & src);
+template double histoStats::mean<P16U> (const roiWindow<P16U> & src);
 template double histoStats::median<P8U> (const roiWindow<P8U> & src);
+template double histoStats::median<P16U> (const roiWindow<P16U> & src);
 
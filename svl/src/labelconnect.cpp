@@ -8,9 +8,12 @@
 
 #include "vision/labelconnect.hpp"
 
-#include "core/singleton.hpp"
 #include "core/stl_utils.hpp"
 #include "core/pair.hpp"
+#include "vision/frame_threads.hpp"
+#include <algorithm>
+#include <limits>
+#include <thread>
 
 using namespace svl;
 
@@ -18,80 +21,90 @@ using namespace svl;
 //----------------------------------------------------------------------------
 // Connected component labeling.
 //
-// The 1D connected components of each row are labeled first.  The labels
-// of row-adjacent components are merged by using an associative memory
-// scheme.  The associative memory is stored as an array that initially
-// represents the identity permutation M = {0,1,2,...}.  Each association of
-// i and j is represented by applying the transposition (i,j) to the array.
-// That is, M[i] and M[j] are swapped.  After all associations have been
-// applied during the merge step, the array has cycles that represent the
-// connected components.  A relabeling is done to give a consecutive set of
-// positive component labels.
+// Block based: the image is covered by 2x2 blocks. All foreground pixels of a
+// block are 8 connected to each other, so blocks are labeled instead of
+// pixels. Block X is connected to its previously visited neighbours
 //
-// For example:
+//     P Q R        pixels of X:  a b
+//     S X                        c d
 //
-//     Image       Rows labeled
-//     00100100    00100200
-//     00110100    00330400
-//     00011000    00055000
-//     01000100    06000700
-//     01000000    08000000
+// when ( with x the pixel to the left of, above, ... the named pixel )
+//     P: a and above left of a
+//     Q: a or b, and above a or above b
+//     R: b and above right of b
+//     S: a or c, and left of a or left of c
 //
-// Initially, the associated memory is M[i] = i for 0 <= i <= 8.  Background
-// label is 0 and never changes.
-// 1. Pass through second row.
-//    a. 3 is associated with 1, M = {0,3,2,1,4,5,6,7,8}
-//    b. 4 is associated with 2, M = {0,3,4,1,2,5,6,7,8}
-// 2. Pass through third row.
-//    a. 5 is associated with 3, M = {0,3,4,5,2,1,6,7,8}.  Note that
-//       M[5] = 5 and M[3] = 1 have been swapped, not a problem since
-//       1 and 3 are already "equivalent labels".
-//    b. 5 is associated with 4, M = {0,3,4,5,1,2,6,7,8}
-// 3. Pass through fourth row.
-//    a. 7 is associated with 5, M = {0,3,4,5,1,7,6,2,8}
-// 4. Pass through fifth row.
-//    a. 8 is associated with 6, M = {0,3,4,5,1,7,8,2,6}
+// Equivalent block labels are merged on a union find forest that always keeps
+// the smaller label as the root, with path compression.
 //
-// The M array has two cycles.  Cycle 1 is
-//   M[1] = 3, M[3] = 5, M[5] = 7, M[7] = 2, M[2] = 4, M[4] = 1
-// and cycle 2 is
-//   M[6] = 8, M[8] = 6
-// The image is relabeled by replacing each pixel value with the index of
-// the cycle containing it.  The result for this example is
-//     00100100
-//     00110100
-//     00011000
-//     02000100
-//     02000000
+// The image is cut in strips of block rows. Each strip is labeled on its own
+// thread, from its own range of provisional labels, and accumulates area,
+// bounding box and moments per provisional label. Strips are then merged on
+// their borders, roots are numbered in raster order of their first pixel, and
+// the pixel labels are written, again in parallel.
 //----------------------------------------------------------------------------
 
-
-class u8s32LUT
+namespace
 {
-public:
-    u8s32LUT ()
+    // Smaller label is the root
+    inline int32_t find_root (std::vector<int32_t>& parent, int32_t x)
     {
-        lut_.resize(256, 1);
-        lut_[0] = 0;
+        int32_t root = x;
+        while (parent[root] != root) root = parent[root];
+        while (parent[x] != root)
+        {
+            const int32_t next = parent[x];
+            parent[x] = root;
+            x = next;
+        }
+        return root;
     }
-
-    void map (uint8_t* src, int32_t* loc)
+    
+    inline int32_t unite (std::vector<int32_t>& parent, int32_t a, int32_t b)
     {
-        *loc = lut_[*src];
+        a = find_root(parent, a);
+        b = find_root(parent, b);
+        if (a == b) return a;
+        if (b < a) std::swap(a, b);
+        parent[b] = a;
+        return a;
     }
     
-    const std::vector<int32_t>& lut () const { return lut_; }
-    
-private:
-    std::vector<int32_t> lut_;
-};
-
-SINGLETONPTR(u8s32LUT);
-
+    // Area, bounds, first pixel and moments of the pixels of a provisional label
+    struct accumulator
+    {
+        accumulator () : area (0), first (std::numeric_limits<int64_t>::max()), x0 (std::numeric_limits<int32_t>::max()),
+        y0 (std::numeric_limits<int32_t>::max()), x1 (-1), y1 (-1), sx (0), sy (0), sxx (0), syy (0), sxy (0) {}
+        
+        void add (int32_t x, int32_t y, int64_t index)
+        {
+            area++;
+            first = std::min(first, index);
+            x0 = std::min(x0, x); x1 = std::max(x1, x);
+            y0 = std::min(y0, y); y1 = std::max(y1, y);
+            sx += x; sy += y;
+            sxx += int64_t(x) * x; syy += int64_t(y) * y; sxy += int64_t(x) * y;
+        }
+        
+        void add (const accumulator& other)
+        {
+            area += other.area;
+            first = std::min(first, other.first);
+            x0 = std::min(x0, other.x0); x1 = std::max(x1, other.x1);
+            y0 = std::min(y0, other.y0); y1 = std::max(y1, other.y1);
+            sx += other.sx; sy += other.sy;
+            sxx += other.sxx; syy += other.syy; sxy += other.sxy;
+        }
+        
+        int64_t area, first;
+        int32_t x0, y0, x1, y1;
+        int64_t sx, sy, sxx, syy, sxy;
+    };
+}
 
 
 template<typename P>
-labelConnect<P>::labelConnect(const roiWindow<P>& src)
+labelConnect<P>::labelConnect(const roiWindow<P>& src, unsigned threads) : threads_ (threads), regions_ (0)
 {
     src_shallow_ = src;
 }
@@ -99,6 +112,9 @@ labelConnect<P>::labelConnect(const roiWindow<P>& src)
 template<typename P>
 const typename labelConnect<P>::label_bbox_map_t& labelConnect<P>::label_bbox_map () const { return label2roi_; }
 
+template<typename P>
+const std::vector<typename labelConnect<P>::region_t>& labelConnect<P>::region_stats () const { return stats_; }
+
 template<typename P>
 const roiWindow<P32S>& labelConnect<P>::label () const { return label_; }
 
@@ -112,206 +128,146 @@ bool labelConnect<P>::run () { get_components(); return true; }
 template<typename P>
 void labelConnect<P>::get_components ()
 {
-    // Create a temporary copy of image to store intermediate information
-    // during component labeling.  The original image is embedded in an
-    // image with two more rows and two more columns so that the image
-    // boundary pixels are properly handled.
-    // To prevent duplicate clears, when src is 32 bit we are assuming that it is 2 pixels
-    // larger already. This is a hack to be cleanly handled
+    typedef typename PixelType<P>::pixel_t pixel_t;
+    const int width = src_shallow_.width();
+    const int height = src_shallow_.height();
+    regions_ = 0;
+    label2roi_.clear();
+    stats_.assign(1, region_t());
+    if (width <= 0 || height <= 0) return;
+    label_ = roiWindow<P32S> (width, height);
     
-   
-    const std::vector<int32_t>& lut = instance()->lut();
+    const int bw = (width + 1) / 2;
+    const int bh = (height + 1) / 2;
+    const unsigned threads = threads_ ? threads_ : std::max(1u, std::thread::hardware_concurrency());
+    const int strip_rows = std::max(8, int((bh + 4 * threads - 1) / (4 * threads)));
+    const int strips = (bh + strip_rows - 1) / strip_rows;
+    const int32_t strip_labels = strip_rows * bw;
     
-    buffer_ = roiWindow<P32S> (src_shallow_.width()+2,src_shallow_.height()+2);
-    buffer_.setBorder(1,0);
-    label_ = roiWindow<P32S> (buffer_.frameBuf(), 1, 1, src_shallow_.width(),src_shallow_.height());
+    // Block labels. Provisional labels of strip ss run from 1 + ss * strip_labels to before used[ss]
+    std::vector<int32_t> blocks (size_t(bw) * bh);
+    std::vector<int32_t> parent (size_t(strips) * strip_labels + 1);
+    std::vector<int32_t> used (strips);
+    std::vector<std::vector<accumulator>> accumulators (strips);
     
-    for (auto iY = 0; iY < src_shallow_.height(); ++iY)
-        {
-            const uint8_t *row = src_shallow_.rowPointer (iY);
-            int32_t *brow = (int32_t *) label_.rowPointer (iY);
-            for (auto iX = 0; iX < src_shallow_.width(); ++iX)
-            {
-                *brow++ = lut[*row++];
-            }
-        }
-
-    // label connected components in 1D array
-    icomponent_ = 0;
+    auto row_of = [&](int y) -> const pixel_t* { return y >= 0 && y < height ? src_shallow_.rowPointer(y) : nullptr; };
+    auto at = [width](const pixel_t* row, int x) { return row != nullptr && x >= 0 && x < width && row[x] != pixel_t(0); };
     
-    for (auto iY = 1; iY < buffer_.height() - 1; ++iY)
-    {
-        // Next row, second column
-        int32_t *brow = (int32_t *) buffer_.rowPointer (iY);
-        ++brow;
-        
-        // Label runs with an incrementing component number
-        for (auto iX = 1; iX < buffer_.width() - 1; ++iX)
+    // Connects block ( by, bx ) to blocks P, Q, R of the block row above. Returns the joined label
+    auto above = [&](int by, int bx, int32_t label, const pixel_t* up, const pixel_t* r0) {
+        const int x = 2 * bx;
+        const bool a = at(r0, x), b = at(r0, x + 1);
+        const int32_t* prev = &blocks[size_t(by - 1) * bw];
+        if (a && at(up, x - 1))
+            label = label ? unite(parent, label, prev[bx - 1]) : prev[bx - 1];
+        if ((a || b) && (at(up, x) || at(up, x + 1)))
+            label = label ? unite(parent, label, prev[bx]) : prev[bx];
+        if (b && at(up, x + 2))
+            label = label ? unite(parent, label, prev[bx + 1]) : prev[bx + 1];
+        return label;
+    };
+    
+    svl::for_each_frame(size_t(strips), [&](size_t ss){
+        const int first = int(ss) * strip_rows;
+        const int last = std::min(bh, first + strip_rows);
+        const int32_t base = 1 + int32_t(ss) * strip_labels;
+        int32_t next = base;
+        auto& acc = accumulators[ss];
+        for (int by = first; by < last; by++)
         {
-            if (brow[iX])
+            const int y = 2 * by;
+            const pixel_t* up = row_of(y - 1);
+            const pixel_t* r0 = row_of(y);
+            const pixel_t* r1 = row_of(y + 1);
+            int32_t* row = &blocks[size_t(by) * bw];
+            for (int bx = 0; bx < bw; bx++)
             {
-                ++icomponent_;
-                while ((iX < (buffer_.width() - 1)) && brow[iX])
+                const int x = 2 * bx;
+                const bool a = at(r0, x), b = at(r0, x + 1), c = at(r1, x), d = at(r1, x + 1);
+                if (! (a || b || c || d)) { row[bx] = 0; continue; }
+                int32_t label = 0;
+                if ((a || c) && (at(r0, x - 1) || at(r1, x - 1)))
+                    label = row[bx - 1];
+                if (by > first)
+                    label = above(by, bx, label, up, r0);
+                if (label == 0)
                 {
-                    brow[iX] = icomponent_;
-                    ++iX;
+                    label = next++;
+                    parent[label] = label;
+                    acc.emplace_back();
                 }
+                row[bx] = label;
+                
+                accumulator& la = acc[size_t(label - base)];
+                const int64_t index = int64_t(y) * width + x;
+                if (a) la.add(x, y, index);
+                if (b) la.add(x + 1, y, index + 1);
+                if (c) la.add(x, y + 1, index + width);
+                if (d) la.add(x + 1, y + 1, index + width + 1);
             }
         }
-    }
+        used[ss] = next;
+    }, threads);
     
-    // If there are no non zero pels
-    // Labled component image is not assigned a real one
-    if ( icomponent_ == 0 )
+    // Merge strips on their borders
+    for (int ss = 1; ss < strips; ss++)
     {
-        regions_ = 0;
-        return;
+        const int by = ss * strip_rows;
+        const int32_t* row = &blocks[size_t(by) * bw];
+        const pixel_t* up = row_of(2 * by - 1);
+        const pixel_t* r0 = row_of(2 * by);
+        for (int bx = 0; bx < bw; bx++)
+            if (row[bx]) above(by, bx, row[bx], up, r0);
     }
     
-    // associative memory for merging
-    amm_.resize(icomponent_+1);
-    for (int32_t i = 0; i < icomponent_ + 1; ++i)
-        amm_[i] = i;
-    
-    // Merge equivalent components.  Pixel (x,y) has previous neighbors
-    // (x-1,y-1), (x,y-1), (x+1,y-1), and (x-1,y) [4 of 8 pixels visited
-    // before (x,y) is visited, get component labels from them].
-    
-    const int32_t rup = buffer_.rowUpdate () / buffer_.bytes();		// rup in ints;
-    
-    for (auto iY = 1; iY < buffer_.height()-1; ++iY)
-    {
-        int32_t *brow = (int32_t *) buffer_.rowPointer (iY);
-        ++brow;
-        
-        for (auto iX = 1; iX < buffer_.width()-1; ++iX)
+    // Fold provisional labels in to their roots
+    auto acc_of = [&](int32_t label) -> accumulator& {
+        const int ss = (label - 1) / strip_labels;
+        return accumulators[ss][size_t(label - 1 - ss * strip_labels)];
+    };
+    std::vector<int32_t> roots;
+    for (int ss = 0; ss < strips; ss++)
+        for (int32_t label = 1 + int32_t(ss) * strip_labels; label < used[ss]; label++)
         {
-            const int32_t iValue = *brow++; // at +1 after this
-            if ( iValue > 0 )
-            {
-                add_to_associative(iValue, brow [-rup - 2]); // brow[-rup - 2]
-                add_to_associative(iValue, brow [-rup - 1]); // brow [-rup - 1]
-                add_to_associative(iValue, brow [-rup]); // brow [-rup]
-                add_to_associative(iValue, brow [rup - 2]); // brow [rup - 2]
-            }
+            const int32_t root = find_root(parent, label);
+            if (root == label)
+                roots.push_back(label);
+            else
+                acc_of(root).add(acc_of(label));
         }
-    }
     
-    // replace each cycle of equivalent labels by a single label
-    regions_ = 0;
-    for (auto i = 1; i <= icomponent_; ++i)
+    // Number roots in raster order of their first pixel. Final labels are kept negated in the parent slots
+    std::sort(roots.begin(), roots.end(), [&](int32_t r0, int32_t r1){ return acc_of(r0).first < acc_of(r1).first; });
+    regions_ = static_cast<bin_type>(roots.size());
+    stats_.resize(roots.size() + 1);
+    for (size_t rr = 0; rr < roots.size(); rr++)
     {
-        if ( i <= amm_[i] )
-        {
-            regions_++;
-            uint32_t iCurrent = i;
-            while ( amm_[iCurrent] != i )
-            {
-                const uint32_t iNext = amm_[iCurrent];
-                amm_[iCurrent] = regions_;
-                iCurrent = iNext;
-            }
-            amm_[iCurrent] = regions_;
-        }
+        const accumulator& ra = acc_of(roots[rr]);
+        region_t& region = stats_[rr + 1];
+        region.area = ra.area;
+        region.first = ra.first;
+        region.bbox = iRect(ra.x0, ra.y0, ra.x1 - ra.x0 + 1, ra.y1 - ra.y0 + 1);
+        region.sx = ra.sx; region.sy = ra.sy;
+        region.sxx = ra.sxx; region.syy = ra.syy; region.sxy = ra.sxy;
+        label2roi_[bin_type(rr + 1)] = region.bbox;
+        parent[roots[rr]] = -int32_t(rr + 1);
     }
+    for (int ss = 0; ss < strips; ss++)
+        for (int32_t label = 1 + int32_t(ss) * strip_labels; label < used[ss]; label++)
+            if (parent[label] > 0) parent[label] = parent[parent[label]];
     
-    // pack a relabeled image in smaller size output
-    // create a rcWindow at 1,1 and label according to the associative memory TBD
-    
-    for (auto iY = 0; iY < label_.height(); ++iY)
-    {
-        int32_t* brow = (int32_t *) label_.rowPointer (iY);
-        
-        for (auto iX = 0; iX < label_.width(); ++iX, ++brow)
+    svl::for_each_frame(size_t(strips), [&](size_t ss){
+        const int first = 2 * int(ss) * strip_rows;
+        const int last = std::min(height, first + 2 * strip_rows);
+        for (int y = first; y < last; y++)
         {
-            *brow = amm_[*brow]; // *brow++ here appears to be a compiler bug
+            const int32_t* row = &blocks[size_t(y / 2) * bw];
+            const pixel_t* src = src_shallow_.rowPointer(y);
+            int32_t* out = label_.rowPointer(y);
+            for (int x = 0; x < width; x++)
+                out[x] = src[x] != pixel_t(0) ? -parent[size_t(row[x / 2])] : 0;
         }
-    }
-}
-
-
-template<typename P>
-void labelConnect<P>::get_rects ()
-{
-    int nLabels = regions_;
-    
-    // Regardless of label is a window or not, lower right should be initialized to zero
-    const int height = static_cast<int>( label_.height() );
-    const int width = static_cast<int>( label_.width() );
-    iPair zeropair (0,0);
-    std::vector<iPair> lrp (nLabels+1,zeropair);
-    std::vector<iPair> ulp (nLabels+1,label_.size());
-    
-    /*
-     * The following computes the min containing rectangle for
-     * the connected region. That is for the integer top left position
-     * of the most top left (lowest x and lowest y) pixel position in the runs and
-     * the most bottom right (highest x and highest y) pixel position in
-     * the runs.
-     * The integer bounding box is at upper left x and y and has width and height
-     * of lower - upper + 1.
-     */
-    
-    for (auto j = 0; j < height; ++j)
-    {
-        int32_t* pSrc = (int32_t*) label_.rowPointer(j);
-        for (auto i=0; i < width; ++i, ++pSrc)
-        {
-            const int32_t l = *pSrc;
-            // label 0 is background. Currently we do not do any thing with that
-            // Note: first rect is at index 1 to avoid computing l-1 inside the inner loop
-            if (l)
-            {
-                // Update min enclosing rectangle
-                if (i < ulp[l].x())
-                    ulp[l].x() = i;
-                if (j < ulp[l].y())
-                    ulp[l].y() = j;
-                
-                if (i > lrp[l].x())
-                    lrp[l].x() = i;
-                if (j > lrp[l].y())
-                    lrp[l].y() = j;
-            }
-        }
-    }
-  
-    
-    // Construct map of rects
-    for (auto l = 1; l <= nLabels; ++l )
-    {
-        /* The integer bounding box is at upper left x and y and has width and height
-         * of lower - upper + 1.
-         * We use the rectangle ctor for passing the position and width and height
-         */
-        iRect r(ulp[l].x(), ulp[l].y(), lrp[l].x() - ulp[l].x() + 1, lrp[l].y() - ulp[l].y() + 1);
-
-        label2roi_[l] = r;
-    }
-    
-}
-
-
-template<typename P>
-void labelConnect<P>::add_to_associative (int32_t i0, int32_t i1)
-{
-    
-    if ( i1 == 0 )
-        return;
-    
-    int32_t iSearch = i1;
-    do
-    {
-        iSearch = amm_[iSearch];
-    }
-    while ( iSearch != i1 && iSearch != i0 );
-    
-    if ( iSearch == i1 )
-    {
-        uint32_t iSave = amm_[i0];
-        amm_[i0] = amm_[i1];
-        amm_[i1] = iSave;
-    }
+    }, threads);
 }
 
 
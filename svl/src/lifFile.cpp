@@ -16,6 +16,11 @@
 #include <algorithm>
 #include <numeric>
 #include <sstream>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <boost/filesystem.hpp>
 
 namespace  {
     
@@ -38,24 +43,173 @@ namespace  {
     {
         return make_shared_ifstream(new std::ifstream(filename, std::ifstream::in | std::ifstream::binary));
     }
+    
+    // TimeStampList payloads shorter than this are kept in the XML and decoded with the header
+    const size_t c_min_deferred_chars = 4096;
+    
+    /** @brief decode space separated hexadecimal timestamps in [begin, end) filling at most out.size() */
+    void decode_hex_timestamps(const char* begin, const char* end, std::vector<unsigned long long>& out)
+    {
+        size_t count = 0;
+        const char* cur = begin;
+        while (cur < end && count < out.size())
+        {
+            while (cur < end && std::isspace(static_cast<unsigned char>(*cur))) cur++;
+            if (cur == end) break;
+            char* next = nullptr;
+            unsigned long long value = std::strtoull(cur, &next, 16);
+            if (next == cur) break;
+            out[count++] = value;
+            cur = next;
+        }
+    }
+    
+    /**
+     @brief remove large TimeStampList payloads from the narrowed XML header, in place.
+     Each payload is replaced by "#n" where n indexes the TimeStampBlock recording where
+     the payload is in the file. base is the file position of the first UTF-16 character.
+     */
+    void defer_timestamp_lists(std::string& xml, unsigned long long base, std::vector<lifIO::TimeStampBlock>& deferred)
+    {
+        static const std::string open_tag = "<TimeStampList";
+        static const std::string close_tag = "</TimeStampList>";
+        size_t read = 0, write = 0;
+        auto move_to = [&xml, &read, &write](size_t end){
+            if (write != read) std::copy(xml.begin() + read, xml.begin() + end, xml.begin() + write);
+            write += end - read;
+            read = end;
+        };
+        
+        while (true)
+        {
+            size_t tag = xml.find(open_tag, read);
+            if (tag == std::string::npos) break;
+            size_t tag_end = xml.find('>', tag);
+            if (tag_end == std::string::npos) break;
+            size_t text_begin = tag_end + 1;
+            char after = xml[tag + open_tag.size()];
+            if (xml[tag_end - 1] == '/' || ! (std::isspace(static_cast<unsigned char>(after)) || after == '>'))
+            {
+                move_to(text_begin);
+                continue;
+            }
+            size_t text_end = xml.find('<', text_begin);
+            if (text_end == std::string::npos) break;
+            // Old style lists have child elements and no text
+            if (text_end - text_begin < c_min_deferred_chars || xml.compare(text_end, close_tag.size(), close_tag) != 0)
+            {
+                move_to(text_end);
+                continue;
+            }
+            move_to(text_begin);
+            std::string marker = "#" + std::to_string(deferred.size());
+            deferred.push_back({base + 2 * text_begin, text_end - text_begin});
+            std::copy(marker.begin(), marker.end(), xml.begin() + write);
+            write += marker.size();
+            read = text_end;
+        }
+        move_to(xml.size());
+        xml.resize(write);
+    }
+}
+
+namespace lifIO
+{
+    /**
+     \brief Sidecar index of a lif file.
+     Stores what LifReader builds from the XML header and the memory block scan: serie names, dimensions,
+     channels, scanner settings, the location of deferred timestamps and memory block offsets.
+     It is tied to the size and modification time of the lif file.
+     */
+    class LifIndex
+    {
+    public:
+        static bool load(LifReader& reader);
+        static bool save(const LifReader& reader);
+        
+    private:
+        static const char* magic() { return "VISLIFX1"; }
+        static const uint32_t c_version = 1;
+        
+        template<typename T>
+        static void put(std::ostream& out, const T& value) { out.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+        static void put(std::ostream& out, const std::string& value)
+        {
+            put<uint64_t>(out, value.size());
+            out.write(value.data(), value.size());
+        }
+        
+        template<typename T>
+        static bool get(std::istream& in, T& value) { return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T))); }
+        static bool get(std::istream& in, std::string& value)
+        {
+            uint64_t size = 0;
+            if (! get(in, size) || size > (uint64_t(1) << 24)) return false;
+            value.resize(size);
+            return bool(in.read(&value[0], size));
+        }
+        
+        static void putSerie(std::ostream& out, const LifSerie& serie);
+        static std::unique_ptr<LifSerieHeader> getSerie(std::istream& in, const std::string& filename,
+                                                         unsigned long long& offset, unsigned long long& memorySize);
+        static int64_t modification_time(const std::string& filename);
+    };
 }
 
 using namespace std;
 
 
-/** @brief LifSerieHeader constructor  */
-lifIO::LifSerieHeader::LifSerieHeader(TiXmlElement *root) : name(root->Attribute("Name")), rootElement(root)
+/** @brief LifSerieHeader constructor
+    @param filename lif file holding the payloads listed in deferred
+    @param deferred TimeStampList payloads removed from the XML by the header scan
+ */
+lifIO::LifSerieHeader::LifSerieHeader(TiXmlElement *root, const std::string& filename, const std::vector<TimeStampBlock>* deferred) :
+    name(root->Attribute("Name")), rootElement(root)
 {
     //XML parsing
     TiXmlNode *elementImage = rootElement->FirstChild("Data")->FirstChild("Image");
     // If Image element found
     if (elementImage)
-        parseImage(elementImage);
+        parseImage(elementImage, filename, deferred);
     
     m_cached_frame_duration.first = false;
     return;
 }
 
+/** @brief empty header, filled by LifIndex  */
+lifIO::LifSerieHeader::LifSerieHeader() : rootElement(nullptr)
+{
+    m_cached_frame_duration.first = false;
+}
+
+/** @brief get the time stamps, decoding them from the file on first call if they were deferred  */
+const std::vector<lifIO::LifSerieHeader::timestamp_t>& lifIO::LifSerieHeader::getTimestamps() const
+{
+    if (! m_lazy_timestamps) return timeStamps;
+    
+    lazy_timestamps& lazy = *m_lazy_timestamps;
+    std::call_once(lazy.once, [&lazy](){
+        lazy.values.resize(lazy.count);
+        std::ifstream file(lazy.path, std::ifstream::in | std::ifstream::binary);
+        if (! file.is_open()) return;
+        std::vector<char> wide(lazy.block.chars * 2);
+        file.seekg(static_cast<streamoff>(lazy.block.offset), ios::beg);
+        if (! file.read(wide.data(), wide.size())) return;
+        // UTF-16 to ASCII in place, as is done for the header
+        for (size_t p = 0; p < lazy.block.chars; ++p)
+            wide[p] = wide[2*p];
+        decode_hex_timestamps(wide.data(), wide.data() + lazy.block.chars, lazy.values);
+        lazy.decoded = true;
+    });
+    return lazy.values;
+}
+
+/** @brief true once the time stamps are in memory, i.e. they were not deferred or getTimestamps decoded them  */
+bool lifIO::LifSerieHeader::timestampsDecoded() const
+{
+    return ! m_lazy_timestamps || m_lazy_timestamps->decoded;
+}
+
 
 /** \brief get the real size of a pixel (in meters) in the dimension d */
 double lifIO::LifSerieHeader::getVoxelSize(const size_t d) const
@@ -128,7 +282,7 @@ double lifIO::LifSerieHeader::getZXratio() const
 
 
 /** @brief parse the "Image" node of the XML header  */
-void lifIO::LifSerieHeader::parseImage(TiXmlNode *elementImage)
+void lifIO::LifSerieHeader::parseImage(TiXmlNode *elementImage, const std::string& filename, const std::vector<TimeStampBlock>* deferred)
 {
     TiXmlNode *elementImageDescription = elementImage->FirstChild("ImageDescription");
     if (elementImageDescription)
@@ -136,7 +290,7 @@ void lifIO::LifSerieHeader::parseImage(TiXmlNode *elementImage)
     // Parse time stamps even if there aren't any, then add empty
     // Unsigned Long Long to timestamps vector
     TiXmlNode *elementTimeStampList = elementImage->FirstChild("TimeStampList");
-    parseTimeStampList(elementTimeStampList);
+    parseTimeStampList(elementTimeStampList, filename, deferred);
     // Parse Hardware Setting List even if there aren't
     TiXmlNode *elementHardwareSettingList = 0;
     TiXmlNode *child = 0;
@@ -174,8 +328,10 @@ void lifIO::LifSerieHeader::parseImageDescription(TiXmlNode *elementImageDescrip
 	}
 }
 
-/** @brief parse the "TimeStampList" node of the XML header  */
-void lifIO::LifSerieHeader::parseTimeStampList(TiXmlNode *elementTimeStampList)
+/** @brief parse the "TimeStampList" node of the XML header
+    Payloads deferred by the header scan are only located here and decoded by getTimestamps
+ */
+void lifIO::LifSerieHeader::parseTimeStampList(TiXmlNode *elementTimeStampList, const std::string& filename, const std::vector<TimeStampBlock>* deferred)
 {
     if (elementTimeStampList)
     {
@@ -183,15 +339,24 @@ void lifIO::LifSerieHeader::parseTimeStampList(TiXmlNode *elementTimeStampList)
         //new way to store timestamps
         if (elementTimeStampList->ToElement()->Attribute("NumberOfTimeStamps", &NumberOfTimeStamps) != 0 && NumberOfTimeStamps != 0)
         {
-            this->timeStamps.resize(NumberOfTimeStamps);
             //timestamps are stored in the text of the node as 16bits hexadecimal separated by spaces
-            //transform this node text in a stream
-            std::istringstream in(elementTimeStampList->ToElement()->GetText());
+            const char* text = elementTimeStampList->ToElement()->GetText();
+            if (text == nullptr) return;
+            if (text[0] == '#' && deferred != nullptr)
+            {
+                size_t index = std::strtoul(text + 1, nullptr, 10);
+                if (index < deferred->size())
+                {
+                    m_lazy_timestamps = std::make_shared<lazy_timestamps>();
+                    m_lazy_timestamps->path = filename;
+                    m_lazy_timestamps->block = (*deferred)[index];
+                    m_lazy_timestamps->count = NumberOfTimeStamps;
+                }
+                return;
+            }
             //convert each number from hex to unsigned long long and fill in the timestamp vector
-            copy(
-                std::istream_iterator<unsigned long long>(in >> std::hex),
-                std::istream_iterator<unsigned long long>(),
-                this->timeStamps.begin());
+            this->timeStamps.resize(NumberOfTimeStamps);
+            decode_hex_timestamps(text, text + std::strlen(text), this->timeStamps);
         }
         
         //old way to store time stamps
@@ -267,15 +432,13 @@ float lifIO::LifSerieHeader::frame_duration_ms() const
 
 /** @brief LifSerie constructor  */
 lifIO::LifSerie::LifSerie(LifSerieHeader serie, const std::string &filename,
-                          unsigned long long offset, unsigned long long memorySize) : LifSerieHeader(serie)
+                          unsigned long long offset, unsigned long long memorySize) : LifSerieHeader(serie), filename(filename)
 {
-    fileRef = make_shared_ifstream(filename.c_str());
-    if(! fileRef || !fileRef->is_open())
+    boost::system::error_code ec;
+    auto size = boost::filesystem::file_size(filename, ec);
+    if(ec)
         throw invalid_argument(("No such file as "+filename).c_str());
-
-    //get size of the file
-    fileRef->seekg(0,ios::end);
-    fileSize = fileRef->tellg();
+    fileSize = static_cast<streamoff>(size);
 
     //check the validity of the offset and memorysize parameters
     if(offset >= (unsigned long long)fileSize)
@@ -287,6 +450,17 @@ lifIO::LifSerie::LifSerie(LifSerieHeader serie, const std::string &filename,
     this->memorySize = memorySize;
 }
 
+/** @brief the serie's file stream, opened on first use  */
+std::ifstream& lifIO::LifSerie::stream() const
+{
+    std::call_once(fileOnce, [this](){
+        fileRef = make_shared_ifstream(filename);
+        if(! fileRef->is_open())
+            throw invalid_argument(("No such file as "+filename).c_str());
+    });
+    return *fileRef;
+}
+
 
 
 /**
@@ -297,8 +471,8 @@ void lifIO::LifSerie::fill3DBuffer(void* buffer, size_t t) const
 {
     char *pos = static_cast<char*>(buffer);
     unsigned long int frameDataSize = getNbPixelsInOneTimeStep()*channels.size();
-    fileRef->seekg(getOffset(t) ,ios::beg);
-    fileRef->read(pos,frameDataSize);
+    stream().seekg(getOffset(t) ,ios::beg);
+    stream().read(pos,frameDataSize);
 }
 
 /**
@@ -309,8 +483,8 @@ void lifIO::LifSerie::fill2DBuffer(void* buffer, size_t t, size_t z) const
 {
     char *pos = static_cast<char*>(buffer);
     unsigned long int sliceDataSize = getNbPixelsInOneSlice()*channels.size();
-    fileRef->seekg(getOffset(t) + z *  sliceDataSize, ios::beg);
-    fileRef->read(pos, sliceDataSize);
+    stream().seekg(getOffset(t) + z *  sliceDataSize, ios::beg);
+    stream().read(pos, sliceDataSize);
 }
 
 /** @brief return an iterator to the begining of the data of time step t
@@ -318,8 +492,8 @@ void lifIO::LifSerie::fill2DBuffer(void* buffer, size_t t, size_t z) const
 */
 istreambuf_iterator<char> lifIO::LifSerie::begin(size_t t)
 {
-    fileRef->seekg(getOffset(t));
-    return istreambuf_iterator<char>(*fileRef);
+    stream().seekg(getOffset(t));
+    return istreambuf_iterator<char>(stream());
 }
 
 
@@ -359,8 +533,15 @@ unsigned long long lifIO::LifSerie::getOffset(size_t t) const
 
 
 
+/** @brief LifHeader from a header whose large TimeStampList payloads were left in the file  */
+lifIO::LifHeader::LifHeader(std::string &header, const std::string& filename, const std::vector<TimeStampBlock>& deferred)
+{
+    this->m_xmldoc.Parse(header.c_str(),0);
+    parseHeader(filename, &deferred);
+}
+
 /** @brief parse the XML header  */
-void lifIO::LifHeader::parseHeader()
+void lifIO::LifHeader::parseHeader(const std::string& filename, const std::vector<TimeStampBlock>* deferred)
 {
     m_xmldoc.RootElement()->QueryIntAttribute("Version", &lifVersion);
 
@@ -379,15 +560,16 @@ void lifIO::LifHeader::parseHeader()
         //have to remove some nodes also named "Element" introduced in later versions of LIF
         std::string elname(serieNode->ToElement()->Attribute("Name"));
         if (elname == "BleachPointROISet") continue;
-        m_series.push_back(std::make_unique<LifSerieHeader>(serieNode->ToElement()));
+        m_series.push_back(std::make_unique<LifSerieHeader>(serieNode->ToElement(), filename, deferred));
     }
 }
 
 
 
 /** \brief Constructor from lif file name
+    @param use_index build series from the sidecar index when it is current, write it otherwise
  */
-lifIO::LifReader::LifReader(const string &filename)
+lifIO::LifReader::LifReader(const string &filename, bool use_index) : m_Valid(false), m_lif_file_size(0), m_from_index(false)
 {
     const int MemBlockCode = 0x70, TestCode = 0x2a;
     char lifChar;
@@ -397,7 +579,7 @@ lifIO::LifReader::LifReader(const string &filename)
     
     m_fileRef = make_shared_ifstream(filename);
     ok = (m_fileRef &&  m_fileRef->is_open());
-    if (! m_fileRef){
+    if (! ok){
         m_Valid = false;
         return;
     }
@@ -406,6 +588,13 @@ lifIO::LifReader::LifReader(const string &filename)
     m_fileRef->seekg(0,ios::end);
     m_lif_file_size = m_fileRef->tellg();
     m_fileRef->seekg(0,ios::beg);
+    
+    if (use_index && LifIndex::load(*this)){
+        m_Valid = true;
+        m_from_index = true;
+        return;
+    }
+    
     char buffer[4];
 
     m_fileRef->read(buffer,4);
@@ -427,18 +616,11 @@ lifIO::LifReader::LifReader(const string &filename)
     if (! m_Valid) return;
     
     unsigned int xmlChars = readUnsignedInt();
-    xmlChars*=2;
 
-    // Read and parse xml header
-    string xmlString;
-    xmlString.reserve(xmlChars/2);
-    {
-        std::shared_ptr<char> xmlHeader (new char[xmlChars]);
-        m_fileRef->read(xmlHeader.get(),xmlChars);
-        for(unsigned int p=0;p<xmlChars/2;++p)
-            xmlString.push_back(xmlHeader.get()[2*p]);
-    }
-    m_header = std::shared_ptr<LifHeader>(new LifHeader(xmlString));
+    // Read and parse xml header, leaving large time stamp lists in the file
+    std::vector<TimeStampBlock> deferred;
+    string xmlString = readXmlHeader(xmlChars, deferred);
+    m_header = std::shared_ptr<LifHeader>(new LifHeader(xmlString, filename, deferred));
     size_t s = 0;
     while (m_fileRef->tellg() < m_lif_file_size)
     {
@@ -493,6 +675,32 @@ lifIO::LifReader::LifReader(const string &filename)
             m_fileRef->seekg(static_cast<streampos>(memorySize),ios::cur);
         }
     }
+    
+    if (m_Valid && use_index)
+        LifIndex::save(*this);
+}
+
+/**
+ \brief read the UTF-16 XML header in chunks narrowing it to ASCII.
+ TimeStampList payloads large enough to matter are left in the file, see defer_timestamp_lists
+ */
+std::string lifIO::LifReader::readXmlHeader(unsigned int xmlChars, std::vector<TimeStampBlock>& deferred)
+{
+    const unsigned int chunkChars = 1 << 20;
+    unsigned long long base = static_cast<unsigned long long>(m_fileRef->tellg());
+    string xmlString;
+    xmlString.reserve(xmlChars);
+    std::vector<char> chunk (2 * std::min(chunkChars, xmlChars));
+    for (unsigned int done = 0; done < xmlChars && *m_fileRef; )
+    {
+        unsigned int count = std::min(chunkChars, xmlChars - done);
+        m_fileRef->read(chunk.data(), 2 * count);
+        for(unsigned int p=0;p<count;++p)
+            xmlString.push_back(chunk[2*p]);
+        done += count;
+    }
+    defer_timestamp_lists(xmlString, base, deferred);
+    return xmlString;
 }
 
 /** \brief read an int form file advancing the cursor*/
@@ -524,6 +732,185 @@ void lifIO::LifReader::close_file()
         m_fileRef->close();
 }
 
+/** \brief modification time of a file, 0 if not available */
+int64_t lifIO::LifIndex::modification_time(const std::string& filename)
+{
+    boost::system::error_code ec;
+    std::time_t mt = boost::filesystem::last_write_time(filename, ec);
+    return ec ? 0 : static_cast<int64_t>(mt);
+}
+
+/** \brief write one serie's header and memory block */
+void lifIO::LifIndex::putSerie(std::ostream& out, const LifSerie& serie)
+{
+    put(out, serie.name);
+    put<uint64_t>(out, serie.dimensions.size());
+    for (const auto& dd : serie.dimensions)
+    {
+        const DimensionData& d = dd.second;
+        put(out, d.dimID); put(out, d.numberOfElements); put(out, d.origin); put(out, d.length);
+        put(out, d.unit); put(out, d.bytesInc); put(out, d.bitInc);
+    }
+    put<uint64_t>(out, serie.channels.size());
+    for (const auto& c : serie.channels)
+    {
+        put(out, c.dataType); put(out, c.channelTag); put(out, c.resolution); put(out, c.nameOfMeasuredQuantity);
+        put(out, c.minimum); put(out, c.maximum); put(out, c.unit); put(out, c.LUTName);
+        put<uint8_t>(out, c.isLUTInverted); put(out, c.bytesInc); put(out, c.bitInc);
+    }
+    put<uint64_t>(out, serie.scannerSettings.size());
+    for (const auto& ss : serie.scannerSettings)
+    {
+        const ScannerSettingRecord& r = ss.second;
+        put(out, r.identifier); put(out, r.unit); put(out, r.description); put(out, r.data);
+        put(out, r.variant); put(out, r.variantType);
+    }
+    // Time stamps: either where they are in the file or, for short lists, the values
+    put<uint8_t>(out, serie.m_lazy_timestamps ? 1 : 0);
+    if (serie.m_lazy_timestamps)
+    {
+        put(out, serie.m_lazy_timestamps->block.offset);
+        put(out, serie.m_lazy_timestamps->block.chars);
+        put<uint64_t>(out, serie.m_lazy_timestamps->count);
+    }
+    else
+    {
+        put<uint64_t>(out, serie.timeStamps.size());
+        out.write(reinterpret_cast<const char*>(serie.timeStamps.data()), serie.timeStamps.size() * sizeof(LifSerieHeader::timestamp_t));
+    }
+    put(out, serie.offset);
+    put(out, serie.memorySize);
+}
+
+/** \brief read one serie's header and memory block */
+std::unique_ptr<lifIO::LifSerieHeader> lifIO::LifIndex::getSerie(std::istream& in, const std::string& filename,
+                                                                  unsigned long long& offset, unsigned long long& memorySize)
+{
+    std::unique_ptr<LifSerieHeader> serie (new LifSerieHeader());
+    uint64_t count = 0;
+    if (! get(in, serie->name) || ! get(in, count)) return nullptr;
+    for (uint64_t dd = 0; dd < count; dd++)
+    {
+        DimensionData d;
+        if (! (get(in, d.dimID) && get(in, d.numberOfElements) && get(in, d.origin) && get(in, d.length) &&
+               get(in, d.unit) && get(in, d.bytesInc) && get(in, d.bitInc))) return nullptr;
+        serie->dimensions.insert(make_pair(d.getName(), d));
+    }
+    if (! get(in, count)) return nullptr;
+    for (uint64_t cc = 0; cc < count; cc++)
+    {
+        ChannelData c;
+        uint8_t inverted = 0;
+        if (! (get(in, c.dataType) && get(in, c.channelTag) && get(in, c.resolution) && get(in, c.nameOfMeasuredQuantity) &&
+               get(in, c.minimum) && get(in, c.maximum) && get(in, c.unit) && get(in, c.LUTName) &&
+               get(in, inverted) && get(in, c.bytesInc) && get(in, c.bitInc))) return nullptr;
+        c.isLUTInverted = inverted != 0;
+        serie->channels.push_back(c);
+    }
+    if (! get(in, count)) return nullptr;
+    for (uint64_t ss = 0; ss < count; ss++)
+    {
+        ScannerSettingRecord r;
+        if (! (get(in, r.identifier) && get(in, r.unit) && get(in, r.description) && get(in, r.data) &&
+               get(in, r.variant) && get(in, r.variantType))) return nullptr;
+        serie->scannerSettings.insert(make_pair(r.identifier, r));
+    }
+    uint8_t lazy = 0;
+    if (! get(in, lazy)) return nullptr;
+    if (lazy)
+    {
+        serie->m_lazy_timestamps = std::make_shared<LifSerieHeader::lazy_timestamps>();
+        uint64_t stamps = 0;
+        if (! (get(in, serie->m_lazy_timestamps->block.offset) && get(in, serie->m_lazy_timestamps->block.chars) &&
+               get(in, stamps))) return nullptr;
+        serie->m_lazy_timestamps->path = filename;
+        serie->m_lazy_timestamps->count = stamps;
+    }
+    else
+    {
+        if (! get(in, count) || count > (uint64_t(1) << 32)) return nullptr;
+        serie->timeStamps.resize(count);
+        if (! in.read(reinterpret_cast<char*>(serie->timeStamps.data()), count * sizeof(LifSerieHeader::timestamp_t))) return nullptr;
+    }
+    if (! (get(in, offset) && get(in, memorySize))) return nullptr;
+    return serie;
+}
+
+/** \brief build header and series of reader from its sidecar index. Returns false if the index is missing or stale */
+bool lifIO::LifIndex::load(LifReader& reader)
+{
+    std::ifstream in(LifReader::index_path(reader.m_path), std::ifstream::in | std::ifstream::binary);
+    if (! in.is_open()) return false;
+    
+    char mg[8];
+    uint32_t version = 0;
+    uint64_t file_size = 0, series = 0;
+    int64_t mtime = 0;
+    if (! in.read(mg, sizeof(mg)) || std::memcmp(mg, magic(), sizeof(mg)) != 0) return false;
+    if (! get(in, version) || version != c_version) return false;
+    if (! get(in, file_size) || file_size != reader.m_lif_file_size) return false;
+    if (! get(in, mtime) || mtime != modification_time(reader.m_path)) return false;
+    
+    std::shared_ptr<LifHeader> header (new LifHeader());
+    if (! (get(in, header->name) && get(in, header->lifVersion) && get(in, series))) return false;
+    
+    std::vector<std::unique_ptr<LifSerie>> lifSeries;
+    for (uint64_t s = 0; s < series; s++)
+    {
+        unsigned long long offset = 0, memorySize = 0;
+        auto serie = getSerie(in, reader.m_path, offset, memorySize);
+        if (! serie) return false;
+        try
+        {
+            lifSeries.push_back(std::make_unique<LifSerie>(*serie, reader.m_path, offset, memorySize));
+        }
+        catch (const std::invalid_argument&)
+        {
+            return false;
+        }
+        header->m_series.push_back(std::move(serie));
+    }
+    
+    reader.m_header = header;
+    reader.m_series = std::move(lifSeries);
+    return true;
+}
+
+/** \brief write the sidecar index of reader next to the lif file. Written to a temporary file and renamed in place */
+bool lifIO::LifIndex::save(const LifReader& reader)
+{
+    namespace bfs = boost::filesystem;
+    boost::system::error_code ec;
+    bfs::path index_path (LifReader::index_path(reader.m_path));
+    bfs::path temp_path = index_path;
+    temp_path += bfs::unique_path(".%%%%-%%%%.tmp", ec);
+    if (ec) return false;
+    
+    bool ok = false;
+    {
+        std::ofstream out (temp_path.string(), std::ios::binary | std::ios::trunc);
+        if (! out) return false;
+        out.write(magic(), 8);
+        put<uint32_t>(out, uint32_t(c_version));
+        put<uint64_t>(out, reader.m_lif_file_size);
+        put(out, modification_time(reader.m_path));
+        put(out, reader.getName());
+        put(out, reader.getVersion());
+        put<uint64_t>(out, reader.m_series.size());
+        for (const auto& serie : reader.m_series)
+            putSerie(out, *serie);
+        out.flush();
+        ok = bool(out);
+    }
+    if (ok)
+    {
+        bfs::rename(temp_path, index_path, ec);
+        ok = ! ec;
+    }
+    if (! ok) bfs::remove(temp_path, ec);
+    return ok;
+}
+
 /** \brief constructor from XML  */
 lifIO::ChannelData::ChannelData(TiXmlElement *element)
 {
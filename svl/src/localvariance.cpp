@@ -9,7 +9,10 @@
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-but-set-variable"
 #include "vision/localvariance.h"
+#include "vision/frame_threads.hpp"
 #include <opencv2/imgproc/imgproc.hpp>  // cvtColor
+#include <algorithm>
+#include <limits>
 using namespace cv;
 
 
@@ -150,6 +153,167 @@ namespace svl
         return true;
     }
     
+    
+    /*
+     localVarianceEngine
+     */
+    
+    localVarianceEngine::localVarianceEngine (const iPair& window, unsigned threads) :
+    m_window (window), m_threads (threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    {
+    }
+    
+    template<typename P>
+    bool localVarianceEngine::compute (const roiWindow<P>& image, scratch_t& scratch, float& vmin, float& vmax) const
+    {
+        typedef typename PixelType<P>::pixel_t pixel_t;
+        if (m_window.x() < 1 || m_window.y() < 1 || ! image.isBound()) return false;
+        
+        const int32_t width = image.width();
+        const int32_t height = image.height();
+        const size_t stride = size_t(width) + 1;
+        
+        // Fused integral images, 1 bigger in each dimension. Row 0 and column 0 are 0
+        scratch.sum.resize(stride * (height + 1));
+        scratch.sumsq.resize(stride * (height + 1));
+        std::fill(scratch.sum.begin(), scratch.sum.begin() + stride, 0);
+        std::fill(scratch.sumsq.begin(), scratch.sumsq.begin() + stride, 0);
+        for (int32_t row = 0; row < height; row++)
+        {
+            const pixel_t* pel = image.rowPointer(row);
+            const uint64_t* s_above = scratch.sum.data() + size_t(row) * stride;
+            const uint64_t* ss_above = scratch.sumsq.data() + size_t(row) * stride;
+            uint64_t* s_row = scratch.sum.data() + size_t(row + 1) * stride;
+            uint64_t* ss_row = scratch.sumsq.data() + size_t(row + 1) * stride;
+            uint64_t s = 0, ss = 0;
+            s_row[0] = ss_row[0] = 0;
+            for (int32_t col = 0; col < width; col++)
+            {
+                const uint64_t v = pel[col];
+                s += v;
+                ss += v * v;
+                s_row[col + 1] = s_above[col + 1] + s;
+                ss_row[col + 1] = ss_above[col + 1] + ss;
+            }
+        }
+        
+        // Window centred at each pixel, clipped to the image
+        const int32_t left = m_window.x() / 2;
+        const int32_t top = m_window.y() / 2;
+        scratch.variance.resize(size_t(width) * height);
+        vmin = std::numeric_limits<float>::max();
+        vmax = std::numeric_limits<float>::lowest();
+        for (int32_t row = 0; row < height; row++)
+        {
+            const int32_t y0 = std::max(0, row - top);
+            const int32_t y1 = std::min(height, row - top + m_window.y());
+            const uint64_t* s0 = scratch.sum.data() + size_t(y0) * stride;
+            const uint64_t* s1 = scratch.sum.data() + size_t(y1) * stride;
+            const uint64_t* ss0 = scratch.sumsq.data() + size_t(y0) * stride;
+            const uint64_t* ss1 = scratch.sumsq.data() + size_t(y1) * stride;
+            float* out = scratch.variance.data() + size_t(row) * width;
+            for (int32_t col = 0; col < width; col++)
+            {
+                const int32_t x0 = std::max(0, col - left);
+                const int32_t x1 = std::min(width, col - left + m_window.x());
+                const uint64_t n = uint64_t(x1 - x0) * uint64_t(y1 - y0);
+                const uint64_t s = s1[x1] - s1[x0] - s0[x1] + s0[x0];
+                const uint64_t ss = ss1[x1] - ss1[x0] - ss0[x1] + ss0[x0];
+                // n SS - S S is exact and not negative
+                const float var = n > 1 ? float(double(n * ss - s * s) / double(n * (n - 1))) : 0.0f;
+                out[col] = var;
+                vmin = std::min(vmin, var);
+                vmax = std::max(vmax, var);
+            }
+        }
+        return true;
+    }
+    
+    namespace
+    {
+        bool same_size (const roiWindow<P32F>& a, int32_t width, int32_t height) { return a.isBound() && a.width() == width && a.height() == height; }
+        bool same_size (const roiWindow<P8U>& a, int32_t width, int32_t height) { return a.isBound() && a.width() == width && a.height() == height; }
+        
+        void write_result (const localVarianceEngine::scratch_t& scratch, float, float, roiWindow<P32F>& variance)
+        {
+            const size_t width = variance.width();
+            for (int32_t row = 0; row < variance.height(); row++)
+                std::copy(scratch.variance.begin() + row * width, scratch.variance.begin() + (row + 1) * width, variance.rowPointer(row));
+        }
+        
+        // As cv::normalize NORM_MINMAX to [0, 255]
+        void write_result (const localVarianceEngine::scratch_t& scratch, float vmin, float vmax, roiWindow<P8U>& normalized)
+        {
+            const float scale = vmax > vmin ? 255.0f / (vmax - vmin) : 0.0f;
+            for (int32_t row = 0; row < normalized.height(); row++)
+            {
+                const float* in = scratch.variance.data() + size_t(row) * normalized.width();
+                uint8_t* out = normalized.rowPointer(row);
+                for (int32_t col = 0; col < normalized.width(); col++)
+                    out[col] = uint8_t(std::min(255.0f, (in[col] - vmin) * scale + 0.5f));
+            }
+        }
+    }
+    
+    template<typename P, typename R>
+    bool localVarianceEngine::process_frame (const roiWindow<P>& image, scratch_t& scratch, R& result) const
+    {
+        float vmin, vmax;
+        if (! compute(image, scratch, vmin, vmax)) return false;
+        if (! same_size(result, image.width(), image.height()))
+            result = R(image.width(), image.height(), align_every_row, pooled_allocation);
+        write_result(scratch, vmin, vmax, result);
+        return true;
+    }
+    
+    template<typename P>
+    bool localVarianceEngine::process (const roiWindow<P>& image, roiWindow<P32F>& variance) const
+    {
+        scratch_t scratch;
+        return process_frame(image, scratch, variance);
+    }
+    
+    template<typename P>
+    bool localVarianceEngine::process (const roiWindow<P>& image, roiWindow<P8U>& normalized) const
+    {
+        scratch_t scratch;
+        return process_frame(image, scratch, normalized);
+    }
+    
+    template<typename P, typename R>
+    bool localVarianceEngine::process_serie (const std::vector<roiWindow<P>>& serie, size_t first, size_t last, std::vector<R>& results) const
+    {
+        last = std::min(last, serie.size());
+        if (first > last) return false;
+        results.resize(last - first);
+        std::atomic<bool> ok (true);
+        for_each_frame_scratch<scratch_t>(last - first, [&](size_t ff, scratch_t& scratch){
+            if (! process_frame(serie[first + ff], scratch, results[ff])) ok = false;
+        }, m_threads);
+        return ok;
+    }
+    
+    template<typename P>
+    bool localVarianceEngine::process (const std::vector<roiWindow<P>>& serie, size_t first, size_t last, std::vector<roiWindow<P32F>>& results) const
+    {
+        return process_serie(serie, first, last, results);
+    }
+    
+    template<typename P>
+    bool localVarianceEngine::process (const std::vector<roiWindow<P>>& serie, size_t first, size_t last, std::vector<roiWindow<P8U>>& results) const
+    {
+        return process_serie(serie, first, last, results);
+    }
+    
+    template bool localVarianceEngine::process (const roiWindow<P8U>&, roiWindow<P32F>&) const;
+    template bool localVarianceEngine::process (const roiWindow<P16U>&, roiWindow<P32F>&) const;
+    template bool localVarianceEngine::process (const roiWindow<P8U>&, roiWindow<P8U>&) const;
+    template bool localVarianceEngine::process (const roiWindow<P16U>&, roiWindow<P8U>&) const;
+    template bool localVarianceEngine::process (const std::vector<roiWindow<P8U>>&, size_t, size_t, std::vector<roiWindow<P32F>>&) const;
+    template bool localVarianceEngine::process (const std::vector<roiWindow<P16U>>&, size_t, size_t, std::vector<roiWindow<P32F>>&) const;
+    template bool localVarianceEngine::process (const std::vector<roiWindow<P8U>>&, size_t, size_t, std::vector<roiWindow<P8U>>&) const;
+    template bool localVarianceEngine::process (const std::vector<roiWindow<P16U>>&, size_t, size_t, std::vector<roiWindow<P8U>>&) const;
+    
 }
 
 
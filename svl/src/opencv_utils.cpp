@@ -303,28 +303,163 @@ namespace svl
     
     void cpCvMatToRoiWindow8U (const cv::Mat& m, roiWindow<P8U>& r){
         assert(m.type() == CV_8U);
-        auto rowPointer = [] (void* data, size_t step, int32_t row ) { return reinterpret_cast<void*>( reinterpret_cast<uint8_t*>(data) + row * step ); };
         unsigned cols = m.cols;
         unsigned rows = m.rows;
-        roiWindow<P8U> rw(cols,rows);
+        roiWindow<P8U> rw(cols,rows, image_memory_alignment_policy::align_every_row, image_memory_allocation_policy::pooled_allocation);
         for (auto row = 0; row < rows; row++) {
-            std::memcpy(rw.rowPointer(row), rowPointer(m.data, m.step, row), cols);
+            std::memcpy(rw.rowPointer(row), m.ptr<uint8_t>(row), cols);
         }
         r = rw;
     }
     
     void cpCvMatToRoiWindow16U (const cv::Mat& m, roiWindow<P16U>& r){
         assert(m.type() == CV_16U);
-        auto rowPointer = [] (void* data, size_t step, int32_t row ) { return reinterpret_cast<void*>( reinterpret_cast<uint16_t*>(data) + row * step ); };
         unsigned cols = m.cols;
         unsigned rows = m.rows;
-        roiWindow<P16U> rw(cols,rows);
+        roiWindow<P16U> rw(cols,rows, image_memory_alignment_policy::align_every_row, image_memory_allocation_policy::pooled_allocation);
         for (auto row = 0; row < rows; row++) {
-            std::memcpy(rw.rowPointer(row), rowPointer(m.data, m.step, row), cols);
+            std::memcpy(rw.rowPointer(row), m.ptr<uint16_t>(row), cols * sizeof(uint16_t));
         }
         r = rw;
     }
     
+    namespace
+    {
+        // UMatData handle of Mats whose pixels are held by svl
+        struct rootHandle
+        {
+            std::shared_ptr<root<P8U>> r8; // set if the pixels are a root<P8U>
+            std::shared_ptr<void> keeper;
+        };
+        
+        class rootMatAllocator : public cv::MatAllocator
+        {
+        public:
+            UMatData* allocate (int dims, const int* sizes, int type, void* data0, size_t* step,
+                                cv::AccessFlag, cv::UMatUsageFlags) const override {
+                const size_t esz = CV_ELEM_SIZE(type);
+                UMatData* u = new UMatData(this);
+                if (data0 == nullptr && dims == 2 && sizes[0] > 0 && sizes[1] > 0){
+                    // Rows of a 2D Mat are the rows of a root
+                    std::shared_ptr<root<P8U>> rr (new root<P8U>(int32_t(sizes[1] * esz), sizes[0], align_every_row, 8, pooled_allocation));
+                    if (step){
+                        step[1] = esz;
+                        step[0] = size_t(rr->rowUpdate());
+                    }
+                    u->data = u->origdata = const_cast<uchar*>(rr->alignedPixelData());
+                    u->size = size_t(rr->rowUpdate()) * sizes[0];
+                    u->handle = new rootHandle {rr, rr};
+                    return u;
+                }
+                size_t total = esz;
+                for (int i = dims - 1; i >= 0; i--){
+                    if (step){
+                        if (data0 && step[i] != CV_AUTOSTEP) total = step[i];
+                        else step[i] = total;
+                    }
+                    total *= sizes[i];
+                }
+                if (data0){
+                    u->data = u->origdata = static_cast<uchar*>(data0);
+                    u->flags |= UMatData::USER_ALLOCATED;
+                }
+                else{
+                    std::shared_ptr<uint8_t> block = frame_pool::instance().acquire(total);
+                    u->data = u->origdata = block.get();
+                    u->handle = new rootHandle {nullptr, block};
+                }
+                u->size = total;
+                return u;
+            }
+            
+            bool allocate (UMatData* u, cv::AccessFlag, cv::UMatUsageFlags) const override {
+                return u != nullptr;
+            }
+            
+            void deallocate (UMatData* u) const override {
+                if (u == nullptr) return;
+                CV_Assert(u->urefcount == 0 && u->refcount == 0);
+                delete static_cast<rootHandle*>(u->handle);
+                delete u;
+            }
+        };
+        
+        const rootHandle* handle_of (const cv::Mat& m){
+            if (m.u == nullptr || m.u->currAllocator != svlMatAllocator()) return nullptr;
+            return static_cast<const rootHandle*>(m.u->handle);
+        }
+        
+        template<typename P>
+        roiWindow<P> adoptCvMat (const cv::Mat& m){
+            if (m.empty()) return roiWindow<P>();
+            // A copy of the header holds a reference on the buffer
+            std::shared_ptr<cv::Mat> owner = std::make_shared<cv::Mat>(m);
+            typename roiWindow<P>::sharedRoot_t root_ptr (new root<P>(owner->data, int32_t(owner->step[0]), owner->cols, owner->rows, owner));
+            return roiWindow<P>(root_ptr);
+        }
+        
+        template<typename P>
+        cv::Mat cvMatShare (const roiWindow<P>& r, int cvType){
+            if (! r.isBound()) return cv::Mat();
+            const auto& frame = r.frameBuf();
+            rootHandle* handle = new rootHandle {nullptr, frame};
+            UMatData* u = new UMatData(svlMatAllocator());
+            u->data = u->origdata = const_cast<uchar*>(frame->alignedPixelData());
+            u->size = size_t(frame->rowUpdate()) * frame->height();
+            u->handle = handle;
+            cv::Mat m (r.height(), r.width(), cvType, r.pelPointer(0,0), size_t(r.rowUpdate()));
+            // m owns the only reference on u. Releasing the last Mat on it releases the frame
+            u->refcount = 1;
+            m.u = u;
+            return m;
+        }
+    }
+    
+    cv::MatAllocator* svlMatAllocator (){
+        static rootMatAllocator* allocator = new rootMatAllocator;
+        return allocator;
+    }
+    
+    roiWindow<P8U> adoptCvMat8U (const cv::Mat& m){
+        assert(m.type() == CV_8U);
+        const rootHandle* handle = handle_of(m);
+        if (handle && handle->r8 && ! m.empty()){
+            const auto& rr = handle->r8;
+            ptrdiff_t offset = m.data - rr->alignedPixelData();
+            if (offset >= 0 && m.step[0] == size_t(rr->rowUpdate())){
+                roiWindow<P8U> shared (rr, int32_t(offset % rr->rowUpdate()), int32_t(offset / rr->rowUpdate()), m.cols, m.rows);
+                if (shared.isBound()) return shared;
+            }
+        }
+        return adoptCvMat<P8U>(m);
+    }
+    
+    roiWindow<P16U> adoptCvMat16U (const cv::Mat& m){
+        assert(m.type() == CV_16U);
+        return adoptCvMat<P16U>(m);
+    }
+    
+    cv::Mat cvMatShare (const roiWindow<P8U>& r){
+        cv::Mat m = cvMatShare(r, CV_8UC1);
+        // adoptCvMat8U of m returns a window on r's frame
+        if (m.u) static_cast<rootHandle*>(m.u->handle)->r8 = r.frameBuf();
+        return m;
+    }
+    
+    cv::Mat cvMatShare (const roiWindow<P16U>& r){
+        return cvMatShare(r, CV_16UC1);
+    }
+    
+    cv::Mat cvMatView (const roiWindow<P8U>& r){
+        if (! r.isBound()) return cv::Mat();
+        return cv::Mat (r.height(), r.width(), CV_8UC1, r.pelPointer(0,0), size_t(r.rowUpdate()));
+    }
+    
+    cv::Mat cvMatView (const roiWindow<P16U>& r){
+        if (! r.isBound()) return cv::Mat();
+        return cv::Mat (r.height(), r.width(), CV_16UC1, r.pelPointer(0,0), size_t(r.rowUpdate()));
+    }
+    
     
     //Function used to perform the complex DFT of a grayscale image
     //Input:  image
@@ -200,6 +200,76 @@ void Correlation::point(const roiWindow<P> & moving, const roiWindow<P> & fixed,
 }
 
 
+namespace
+{
+    // Sum of moving x fixed. If fixedMoments is not null, fixed's sum and sum of squares as well
+    template <typename P>
+    CorrelationParts::sumproduct_t cross_rows(const roiWindow<P> & moving, const roiWindow<P> & fixed, imageMoments * fixedMoments)
+    {
+        typedef typename PixelType<P>::pixel_t pixel_t;
+        assert(moving.size() == fixed.size());
+        CorrelationParts::sumproduct_t sim = 0;
+        for (int32_t row = 0; row < fixed.height(); row++)
+        {
+            const pixel_t * pi = moving.rowPointer(row);
+            const pixel_t * pm = fixed.rowPointer(row);
+            const pixel_t * end = pm + fixed.width();
+            uint64_t rsim = 0;
+            if (fixedMoments == nullptr)
+            {
+                for (; pm < end; ++pi, ++pm)
+                    rsim += uint64_t(*pi) * *pm;
+            }
+            else
+            {
+                uint64_t rs = 0, rss = 0;
+                for (; pm < end; ++pi, ++pm)
+                {
+                    const uint64_t m = *pm;
+                    rsim += *pi * m;
+                    rs += m;
+                    rss += m * m;
+                }
+                fixedMoments->s += rs;
+                fixedMoments->ss += rss;
+            }
+            sim += rsim;
+        }
+        if (fixedMoments) fixedMoments->n = fixed.width() * fixed.height();
+        return sim;
+    }
+
+    void compose(const imageMoments & mi, const imageMoments & mm, CorrelationParts::sumproduct_t sim, CorrelationParts & res)
+    {
+        CorrelationParts::sumproduct_t sii = mi.ss, smm = mm.ss, si = mi.s, sm = mm.s;
+        res.clear();
+        res.n(mi.n);
+        res.accumulate(sim, sii, smm, si, sm);
+        res.compute();
+    }
+}
+
+template <typename P>
+CorrelationParts::sumproduct_t Correlation::cross(const roiWindow<P> & moving, const roiWindow<P> & fixed)
+{
+    return cross_rows(moving, fixed, nullptr);
+}
+
+template <typename P>
+void Correlation::point(const roiWindow<P> & moving, const roiWindow<P> & fixed, CorrelationParts & res, momentCache & cache)
+{
+    compose(cache.get(moving), cache.get(fixed), cross_rows(moving, fixed, nullptr), res);
+}
+
+template <typename P>
+void Correlation::point(const roiWindow<P> & moving, const roiWindow<P> & fixed, CorrelationParts & res, const imageMoments & movingMoments)
+{
+    imageMoments fixedMoments;
+    auto sim = cross_rows(moving, fixed, &fixedMoments);
+    compose(movingMoments, fixedMoments, sim, res);
+}
+
+
 template <typename P>
 bool Correlation::area_translation(const roiWindow<P> & moving, const roiWindow<P> & fixed, spaceResult& sres)
 {
@@ -210,6 +280,9 @@ bool Correlation::area_translation(const roiWindow<P> & moving, const roiWindow<
                             moving.height() - fixed.height() + 1);
     roiWindow<P32F> cspace(searchSpace.x(), searchSpace.y());
     cspace.set(0);
+    
+    // The model's moments are the same at every position
+    const imageMoments fixedMoments = moments(fixed);
 
     uint32_t curRow = 0;
     do
@@ -220,7 +293,7 @@ bool Correlation::area_translation(const roiWindow<P> & moving, const roiWindow<
             // rcCorrelationWindow for the model
             roiWindow<P> movingWin(moving, curCol, curRow, fixed.width(), fixed.height());
 
-            Correlation::point(fixed, movingWin, cp);
+            Correlation::point(fixed, movingWin, cp, fixedMoments);
             const float r = cp.r();
             cspace.setPixel(curCol, curRow, r);
         } while (++curCol && curCol < searchSpace.x());
@@ -283,6 +356,9 @@ bool Correlation::autoCorrelation(const roiWindow<P> & fixed, const uint32_t hal
 
 
 template void Correlation::point(const roiWindow<P8U> & moving, const roiWindow<P8U> & fixed, CorrelationParts & res);
+template void Correlation::point(const roiWindow<P8U> & moving, const roiWindow<P8U> & fixed, CorrelationParts & res, momentCache & cache);
+template void Correlation::point(const roiWindow<P8U> & moving, const roiWindow<P8U> & fixed, CorrelationParts & res, const imageMoments & movingMoments);
+template CorrelationParts::sumproduct_t Correlation::cross(const roiWindow<P8U> & moving, const roiWindow<P8U> & fixed);
 
 template bool Correlation::area_translation(const roiWindow<P8U> & moving, const roiWindow<P8U> & fixed, spaceResult& );
 
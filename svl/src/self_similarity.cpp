@@ -30,6 +30,14 @@ namespace defaultMatchers
         return cp.r();
     }
     
+    // Frame moments are computed once per frame and shared by all its pairs
+    double norm_correlate_cached(const roiWindow<P8U>& i, const roiWindow<P8U>& m, momentCache& moments)
+    {
+        CorrelationParts cp;
+        Correlation::point(i, m, cp, moments);
+        return cp.r();
+    }
+    
 }
 
 namespace anonymous
@@ -83,7 +91,7 @@ template<typename P>
 self_similarity_producer<P>::self_similarity_producer() : _matrixSz (0), _maskValid(false), _cacheSz (0),
 _depth (P::depth()),  _notify(NULL), _finished(true), _tiny(1e-10)
 {
-    _corr_fn = std::bind(&defaultMatchers::norm_correlate, std::placeholders::_1, std::placeholders::_2);
+    _corr_fn = std::bind(&defaultMatchers::norm_correlate_cached, std::placeholders::_1, std::placeholders::_2, std::ref(_moments));
     
 }
 
@@ -100,7 +108,7 @@ _notify(notify), _finished(true),
 _tiny(tiny)
 {
     
-    _corr_fn = (simFunc) ? simFunc : std::bind(&defaultMatchers::norm_correlate, std::placeholders::_1, std::placeholders::_2);
+    _corr_fn = (simFunc) ? simFunc : std::bind(&defaultMatchers::norm_correlate_cached, std::placeholders::_1, std::placeholders::_2, std::ref(_moments));
     
     _depth = P::depth();
     _log2MSz = log2(_matrixSz);
@@ -446,6 +454,7 @@ bool self_similarity_producer<P>::internalUpdate(image_t& nextImage, deque<image
      * removed.
      */
     if (tWin.size() == _matrixSz) {
+        _moments.invalidate(tWin.front());
         tWin.pop_front();
         shiftSMatrix();
     }
@@ -2,6 +2,9 @@
 #include <iostream>
 #include "gtest/gtest.h"
 #include <memory>
+#include <fstream>
+#include <sstream>
+#include <map>
 #include "boost/filesystem.hpp"
 #include "vision/histo.h"
 #include "vision/drawUtils.hpp"
@@ -28,6 +31,14 @@
 #include "vision/roiMultiWindow.h"
 #include "vision/sample.hpp"
 #include "vision/opencv_utils.hpp"
+#include "vision/latticeCorr.hpp"
+#include "vision/self_similarity.h"
+#include "vision/translation_tracker.hpp"
+#include "vision/temporal_rank.hpp"
+#include "vision/graph_segmenter.hpp"
+#include "vision/histogram_engine.hpp"
+#include "vision/edge_pipeline.hpp"
+#include "vision/correlation1d.hpp"
 
 
 using namespace svl;
@@ -267,6 +278,98 @@ TEST (ut_lifFile, triple_channel)
 
 }
 
+/*
+ * Writes a minimal version 2 lif: one 16 x 8, 8 bit, single channel serie per entry of timesteps.
+ * Frame t of serie s is filled with ( s + t ) & 0xff.
+ */
+static void write_lif (const std::string& path, const std::vector<int>& timesteps, std::vector<std::vector<unsigned long long>>& stamps)
+{
+    const int width = 16, height = 8;
+    auto put16 = [](std::ofstream& out, const std::string& str){ for (char c : str) { out.put(c); out.put(0); } };
+    auto put32 = [](std::ofstream& out, uint32_t v){ out.write(reinterpret_cast<const char*>(&v), 4); };
+    
+    std::ostringstream xml;
+    xml << "<LMSDataContainerHeader Version=\"2\"><Element Name=\"synthetic\"><Children>";
+    stamps.assign(timesteps.size(), {});
+    for (auto s = 0; s < timesteps.size(); s++){
+        xml << "<Element Name=\"Series" << s << "\"><Data><Image><ImageDescription><Channels>";
+        xml << "<ChannelDescription DataType=\"0\" ChannelTag=\"0\" Resolution=\"8\" NameOfMeasuredQuantity=\"\" Min=\"0\" Max=\"255\" Unit=\"\" LUTName=\"Gray\" IsLUTInverted=\"0\" BytesInc=\"0\" BitInc=\"0\"/>";
+        xml << "</Channels><Dimensions>";
+        xml << "<DimensionDescription DimID=\"1\" NumberOfElements=\"" << width << "\" Origin=\"0\" Length=\"1\" Unit=\"m\" BytesInc=\"1\" BitInc=\"0\"/>";
+        xml << "<DimensionDescription DimID=\"2\" NumberOfElements=\"" << height << "\" Origin=\"0\" Length=\"1\" Unit=\"m\" BytesInc=\"" << width << "\" BitInc=\"0\"/>";
+        xml << "<DimensionDescription DimID=\"4\" NumberOfElements=\"" << timesteps[s] << "\" Origin=\"0\" Length=\"1\" Unit=\"s\" BytesInc=\"" << width * height << "\" BitInc=\"0\"/>";
+        xml << "</Dimensions></ImageDescription><TimeStampList NumberOfTimeStamps=\"" << timesteps[s] << "\">";
+        for (auto t = 0; t < timesteps[s]; t++){
+            stamps[s].push_back(0x1d5000000000000ULL + 330000ULL * t + s);
+            xml << std::hex << stamps[s].back() << std::dec << " ";
+        }
+        xml << "</TimeStampList><Attachment Name=\"HardwareSettingList\"><HardwareSetting><ScannerSetting>";
+        xml << "<ScannerSettingRecord Identifier=\"dblVoxelX\" Unit=\"m\" Description=\"\" Data=\"0\" Variant=\"2.5e-7\" VariantType=\"5\"/>";
+        xml << "</ScannerSetting></HardwareSetting></Attachment></Image></Data></Element>";
+    }
+    xml << "</Children></Element></LMSDataContainerHeader>";
+    
+    std::ofstream out (path, std::ios::binary | std::ios::trunc);
+    put32(out, 0x70); put32(out, 0); out.put(0x2a);
+    put32(out, static_cast<uint32_t>(xml.str().size())); put16(out, xml.str());
+    for (auto s = 0; s < timesteps.size(); s++){
+        uint64_t memorySize = uint64_t(width) * height * timesteps[s];
+        put32(out, 0x70); put32(out, 0); out.put(0x2a);
+        out.write(reinterpret_cast<const char*>(&memorySize), 8); out.put(0x2a);
+        std::string desc = "MemBlock_" + std::to_string(s);
+        put32(out, static_cast<uint32_t>(desc.size())); put16(out, desc);
+        for (auto t = 0; t < timesteps[s]; t++)
+            for (auto p = 0; p < width * height; p++) out.put(char((s + t) & 0xff));
+    }
+}
+
+TEST (ut_lifFile, lazy_indexed)
+{
+    auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ut_lif_%%%%%%.lif");
+    std::vector<int> timesteps {2000, 5, 1200};
+    std::vector<std::vector<unsigned long long>> stamps;
+    write_lif(path.string(), timesteps, stamps);
+    
+    // First open scans the header and writes the index, second one only reads the index.
+    // Scanning with use_index off must give the same series
+    for (auto pass = 0; pass < 3; pass++){
+        auto lif = lifIO::LifReader::create(path.string(), pass > 0);
+        EXPECT_TRUE(lif->isValid());
+        EXPECT_EQ(pass == 2, lif->fromIndex());
+        EXPECT_EQ(pass > 0, boost::filesystem::exists(lifIO::LifReader::index_path(path.string())));
+        EXPECT_EQ(lif->getName(), "synthetic");
+        EXPECT_EQ(2, lif->getVersion());
+        EXPECT_EQ(timesteps.size(), lif->getNbSeries());
+        for (auto s = 0; s < lif->getNbSeries(); s++){
+            const lifIO::LifSerie& se = lif->getSerie(s);
+            EXPECT_EQ("Series" + std::to_string(s), se.getName());
+            EXPECT_EQ(timesteps[s], se.getNbTimeSteps());
+            EXPECT_EQ(16, se.getSpatialDimensions()[0]);
+            EXPECT_EQ(8, se.getSpatialDimensions()[1]);
+            EXPECT_EQ(1, se.getChannels().size());
+            EXPECT_NEAR(2.5e-7, se.getVoxelSize(0), 1e-12);
+            // Opening, from the header or the index, leaves long timestamp lists in the file
+            EXPECT_EQ(timesteps[s] < 100, se.timestampsDecoded());
+            EXPECT_TRUE(se.getTimestamps() == stamps[s]);
+            EXPECT_TRUE(se.timestampsDecoded());
+            
+            roiWindow<P8U> slice (16, 8);
+            se.fill2DBuffer(slice.rowPointer(0), timesteps[s] - 1);
+            EXPECT_EQ((s + timesteps[s] - 1) & 0xff, slice.getPixel(7, 3));
+        }
+    }
+    
+    // A changed file invalidates the index
+    write_lif(path.string(), {3}, stamps);
+    auto lif = lifIO::LifReader::create(path.string());
+    EXPECT_FALSE(lif->fromIndex());
+    EXPECT_EQ(1, lif->getNbSeries());
+    
+    boost::system::error_code ec;
+    boost::filesystem::remove(lifIO::LifReader::index_path(path.string()), ec);
+    boost::filesystem::remove(path, ec);
+}
+
 TEST(basicU8, gradient)
 {
     
@@ -527,6 +630,220 @@ TEST(basicU8, localvar)
     
 }
 
+TEST(basicU8, localvar_engine)
+{
+    const int w = 37, h = 29;
+    const iPair window (5, 3);
+    std::vector<roiWindow<P8U>> frames;
+    std::vector<roiWindow<P16U>> frames16;
+    uint32_t state = 5;
+    for (int ff = 0; ff < 6; ff++)
+    {
+        roiWindow<P8U> frame (w, h);
+        roiWindow<P16U> frame16 (w, h);
+        for (int row = 0; row < h; row++)
+            for (int col = 0; col < w; col++)
+            {
+                state = state * 1664525u + 1013904223u;
+                frame.rowPointer(row)[col] = uint8_t(state >> 24);
+                frame16.rowPointer(row)[col] = uint16_t(state >> 16);
+            }
+        frames.push_back(frame);
+        frames16.push_back(frame16);
+    }
+    
+    // Sample variance of the centred window, clipped to the image
+    auto reference = [&](const auto& image, int col, int row){
+        double s = 0, ss = 0;
+        int n = 0;
+        for (int y = std::max(0, row - window.y() / 2); y < std::min(h, row - window.y() / 2 + window.y()); y++)
+            for (int x = std::max(0, col - window.x() / 2); x < std::min(w, col - window.x() / 2 + window.x()); x++, n++)
+            {
+                const double v = image.rowPointer(y)[x];
+                s += v;
+                ss += v * v;
+            }
+        return (n * ss - s * s) / (n * (n - 1.0));
+    };
+    
+    localVarianceEngine engine (window, 3);
+    std::vector<roiWindow<P32F>> variances, variances16;
+    std::vector<roiWindow<P8U>> normalized;
+    EXPECT_TRUE(engine.process(frames, 1, 5, variances));
+    EXPECT_TRUE(engine.process(frames16, 0, frames16.size(), variances16));
+    EXPECT_TRUE(engine.process(frames, 0, frames.size(), normalized));
+    ASSERT_EQ(4, variances.size());
+    ASSERT_EQ(6, variances16.size());
+    for (int ff = 0; ff < 4; ff++)
+        for (int row = 0; row < h; row++)
+            for (int col = 0; col < w; col++)
+            {
+                const double expected = reference(frames[ff + 1], col, row);
+                EXPECT_NEAR(expected, variances[ff].rowPointer(row)[col], 1e-5 * expected + 1e-3);
+                const double expected16 = reference(frames16[ff], col, row);
+                EXPECT_NEAR(expected16, variances16[ff].rowPointer(row)[col], 1e-5 * expected16);
+            }
+    
+    // Normalized output spans 0 to 255 and matches the single frame entry point
+    roiWindow<P8U> one;
+    EXPECT_TRUE(engine.process(frames[2], one));
+    uint8_t lo = 255, hi = 0;
+    for (int row = 0; row < h; row++)
+    {
+        EXPECT_EQ(0, std::memcmp(one.rowPointer(row), normalized[2].rowPointer(row), w));
+        lo = std::min(lo, *std::min_element(one.rowPointer(row), one.rowPointer(row) + w));
+        hi = std::max(hi, *std::max_element(one.rowPointer(row), one.rowPointer(row) + w));
+    }
+    EXPECT_EQ(0, lo);
+    EXPECT_EQ(255, hi);
+    
+    localVarianceEngine empty (iPair(0, 3));
+    EXPECT_FALSE(empty.process(frames[0], one));
+}
+
+TEST(basicU8, temporal_rank)
+{
+    const int w = 41, h = 35, count = 9;
+    std::vector<roiWindow<P8U>> frames;
+    std::vector<roiWindow<P16U>> frames16;
+    uint32_t state = 11;
+    for (int ff = 0; ff < count; ff++)
+    {
+        roiWindow<P8U> frame (w, h);
+        roiWindow<P16U> frame16 (w, h);
+        for (int row = 0; row < h; row++)
+            for (int col = 0; col < w; col++)
+            {
+                state = state * 1664525u + 1013904223u;
+                frame.rowPointer(row)[col] = uint8_t(state >> 29); // few levels, many ties
+                frame16.rowPointer(row)[col] = uint16_t(state >> 16);
+            }
+        frames.push_back(frame);
+        frames16.push_back(frame16);
+    }
+    
+    // Rank of the pixel over the window of frames, end frames repeated
+    auto check = [&](const auto& src, const auto& dst, unsigned window, int rank){
+        const int half = int(window / 2);
+        ASSERT_EQ(src.size(), dst.size());
+        for (int ff = 0; ff < count; ff++)
+            for (int row = 0; row < h; row++)
+                for (int col = 0; col < w; col++)
+                {
+                    std::vector<int> values;
+                    for (int ww = -half; ww <= half; ww++)
+                        values.push_back(src[std::max(0, std::min(count - 1, ff + ww))].rowPointer(row)[col]);
+                    std::sort(values.begin(), values.end());
+                    ASSERT_EQ(values[rank], dst[ff].rowPointer(row)[col]);
+                }
+    };
+    
+    for (unsigned window : {1u, 3u, 5u, 7u, 9u})
+        for (int rank = 0; rank < int(window); rank++)
+        {
+            temporalRankFilter filter (window, rank, 3);
+            std::vector<roiWindow<P8U>> out;
+            std::vector<roiWindow<P16U>> out16;
+            EXPECT_TRUE(filter.process(frames, out));
+            EXPECT_TRUE(filter.process(frames16, out16));
+            check(frames, out, window, rank);
+            check(frames16, out16, window, rank);
+        }
+    
+    EXPECT_EQ(2, temporalRankFilter(5).rank());
+    std::vector<roiWindow<P8U>> out;
+    EXPECT_FALSE(temporalRankFilter(4).process(frames, out));
+    EXPECT_FALSE(temporalRankFilter(3, 3).process(frames, out));
+    frames.emplace_back(w + 1, h);
+    EXPECT_FALSE(temporalRankFilter(3).process(frames, out));
+}
+
+TEST(basic, graph_segmenter)
+{
+    const int w = 67, h = 51;
+    const float c = 40.0f;
+    const int min_size = 12;
+    
+    // Three piecewise flat channels with noise
+    std::vector<cv::Mat> channels;
+    uint32_t state = 3;
+    for (int cc = 0; cc < 3; cc++)
+    {
+        cv::Mat plane (h, w, CV_32FC1);
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+            {
+                state = state * 1664525u + 1013904223u;
+                const float level = (x < w / 3 ? 20.0f : 90.0f) + (y > h / 2 ? 60.0f * cc : 0.0f);
+                plane.at<float>(y, x) = level + float(state >> 29);
+            }
+        channels.push_back(plane);
+    }
+    
+    // Radix sort orders as a stable comparison sort
+    std::vector<graphSegmenter::edge> edges, scratch;
+    for (int ee = 0; ee < 5000; ee++)
+    {
+        state = state * 1664525u + 1013904223u;
+        edges.push_back({float(state >> 20) / 7.0f, ee, ee});
+    }
+    auto expected = edges;
+    std::stable_sort(expected.begin(), expected.end(), [](const graphSegmenter::edge& a, const graphSegmenter::edge& b){ return a.w < b.w; });
+    graphSegmenter::radix_sort(edges, scratch);
+    for (size_t ee = 0; ee < edges.size(); ee++)
+        EXPECT_EQ(expected[ee].a, edges[ee].a);
+    
+    graphSegmenter serial (c, min_size, graphSegmenter::weight::euclidean, 1);
+    graphSegmenter parallel (c, min_size, graphSegmenter::weight::euclidean, 4);
+    EXPECT_TRUE(serial.process(channels));
+    EXPECT_TRUE(parallel.process(channels));
+    EXPECT_EQ(serial.components(), parallel.components());
+    EXPECT_EQ(0, cv::countNonZero(serial.labels() != parallel.labels()));
+    EXPECT_EQ(size_t(4 * w * h - 3 * (w + h) + 2), parallel.edges().size());
+    
+    // Reference: comparison sorted edges merged on a plain forest
+    std::vector<int> parent (w * h), size (w * h, 1);
+    for (int ii = 0; ii < w * h; ii++) parent[ii] = ii;
+    auto find = [&](int x){ while (parent[x] != x) x = parent[x]; return x; };
+    std::vector<float> threshold (w * h, c);
+    for (const auto& ee : parallel.edges())
+    {
+        int a = find(ee.a), b = find(ee.b);
+        if (a != b && ee.w <= threshold[a] && ee.w <= threshold[b])
+        {
+            parent[b] = a;
+            size[a] += size[b];
+            threshold[a] = ee.w + c / size[a];
+        }
+    }
+    for (const auto& ee : parallel.edges())
+    {
+        int a = find(ee.a), b = find(ee.b);
+        if (a != b && (size[a] < min_size || size[b] < min_size))
+        {
+            parent[b] = a;
+            size[a] += size[b];
+        }
+    }
+    
+    // Same partition: labels map one to one
+    std::map<int, int> to_reference, from_reference;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            const int label = parallel.labels().at<int32_t>(y, x);
+            const int ref = find(y * w + x);
+            EXPECT_EQ(ref, to_reference.emplace(label, ref).first->second);
+            EXPECT_EQ(label, from_reference.emplace(ref, label).first->second);
+        }
+    EXPECT_EQ(size_t(parallel.components()), to_reference.size());
+    EXPECT_GE(parallel.components(), 4);
+    
+    EXPECT_FALSE(serial.process(std::vector<cv::Mat> ()));
+    channels.push_back(cv::Mat(h, w + 1, CV_32FC1));
+    EXPECT_FALSE(serial.process(channels));
+}
+
 
 TEST(synth, basic)
 {
@@ -656,6 +973,132 @@ TEST(basicgauss, edge)
     //    dst.print_pixel();
 }
 
+TEST(basicgauss, separable_recursive)
+{
+    const int w = 83, h = 61;
+    const float sigma = 3.0f;
+    
+    // Impulse response of the separable Gaussian is the sampled, normalized Gaussian
+    roiWindow<P32F> impulse (w, h);
+    for (int row = 0; row < h; row++)
+        std::fill(impulse.rowPointer(row), impulse.rowPointer(row) + w, 0.0f);
+    impulse.rowPointer(30)[40] = 1.0f;
+    roiWindow<P32F> fir, iir;
+    GaussSeparable(impulse, fir, sigma);
+    GaussRecursive(impulse, iir, sigma);
+    // The separable kernel is cut at 3 sigma, the recursive filter is not
+    double norm = 0, full_norm = 0;
+    for (int dy = -30; dy <= 30; dy++)
+        for (int dx = -30; dx <= 30; dx++)
+        {
+            const double g = std::exp(-0.5 * (dx * dx + dy * dy) / (sigma * sigma));
+            full_norm += g;
+            if (std::abs(dx) <= 9 && std::abs(dy) <= 9) norm += g;
+        }
+    double fir_sum = 0, iir_sum = 0;
+    for (int row = 0; row < h; row++)
+        for (int col = 0; col < w; col++)
+        {
+            const int dx = col - 40, dy = row - 30;
+            const double g = std::exp(-0.5 * (dx * dx + dy * dy) / (sigma * sigma));
+            const double cut = std::abs(dx) > 9 || std::abs(dy) > 9 ? 0.0 : g / norm;
+            EXPECT_NEAR(cut, fir.rowPointer(row)[col], 1e-6);
+            // Recursive filter is within 0.1% of the peak
+            EXPECT_NEAR(g / full_norm, iir.rowPointer(row)[col], 0.001 / full_norm);
+            fir_sum += fir.rowPointer(row)[col];
+            iir_sum += iir.rowPointer(row)[col];
+        }
+    EXPECT_NEAR(1.0, fir_sum, 1e-4);
+    EXPECT_NEAR(1.0, iir_sum, 1e-3);
+    
+    // Constant images are unchanged, edges included
+    roiWindow<P16U> flat (w, h);
+    for (int row = 0; row < h; row++)
+        std::fill(flat.rowPointer(row), flat.rowPointer(row) + w, uint16_t(1000));
+    roiWindow<P16U> smooth;
+    GaussRecursive(flat, smooth, 7.5f);
+    GaussSeparable(smooth, smooth, 1.5f);
+    for (int row = 0; row < h; row++)
+        for (int col = 0; col < w; col++)
+            EXPECT_EQ(1000, smooth.rowPointer(row)[col]);
+    
+    // Serie entry point gives the results of the single frame one
+    std::vector<roiWindow<P8U>> serie, smoothed;
+    for (int ff = 0; ff < 5; ff++)
+    {
+        roiWindow<P8U> frame (w, h);
+        for (int row = 0; row < h; row++)
+            for (int col = 0; col < w; col++)
+                frame.rowPointer(row)[col] = uint8_t((col * 7 + row * 13 + ff * 31) % 256);
+        serie.push_back(frame);
+    }
+    GaussSerie(serie, smoothed, 2.0f, gauss_separable, 3);
+    ASSERT_EQ(serie.size(), smoothed.size());
+    for (int ff = 0; ff < 5; ff++)
+    {
+        roiWindow<P8U> one;
+        GaussSeparable(serie[ff], one, 2.0f);
+        for (int row = 0; row < h; row++)
+            EXPECT_EQ(0, std::memcmp(one.rowPointer(row), smoothed[ff].rowPointer(row), w));
+    }
+}
+
+TEST(basicgauss, morphology_rectangle)
+{
+    const int w = 47, h = 39;
+    roiWindow<P8U> src (w, h);
+    roiWindow<P32F> fsrc (w, h);
+    uint32_t state = 17;
+    for (int row = 0; row < h; row++)
+        for (int col = 0; col < w; col++)
+        {
+            state = state * 1664525u + 1013904223u;
+            src.rowPointer(row)[col] = uint8_t(state >> 24);
+            fsrc.rowPointer(row)[col] = float(int(state >> 20) - 2048);
+        }
+    
+    // Same as the min / max over the rectangle clipped to the image
+    const int sizes[][2] = {{1, 1}, {3, 3}, {4, 1}, {1, 6}, {7, 5}, {15, 21}, {60, 2}};
+    for (const auto& size : sizes)
+    {
+        roiWindow<P8U> mins, maxs;
+        roiWindow<P32F> fmins;
+        PixelMin(src, mins, size[0], size[1]);
+        PixelMax(src, maxs, size[0], size[1]);
+        PixelMin(fsrc, fmins, size[0], size[1]);
+        for (int row = 0; row < h; row++)
+            for (int col = 0; col < w; col++)
+            {
+                uint8_t lo = 255, hi = 0;
+                float flo = std::numeric_limits<float>::max();
+                for (int y = row - size[1] / 2; y < row - size[1] / 2 + size[1]; y++)
+                    for (int x = col - size[0] / 2; x < col - size[0] / 2 + size[0]; x++)
+                    {
+                        if (x < 0 || y < 0 || x >= w || y >= h) continue;
+                        lo = std::min(lo, src.rowPointer(y)[x]);
+                        hi = std::max(hi, src.rowPointer(y)[x]);
+                        flo = std::min(flo, fsrc.rowPointer(y)[x]);
+                    }
+                EXPECT_EQ(lo, mins.rowPointer(row)[col]);
+                EXPECT_EQ(hi, maxs.rowPointer(row)[col]);
+                EXPECT_EQ(flo, fmins.rowPointer(row)[col]);
+            }
+    }
+    
+    // In place, and over a serie
+    std::vector<roiWindow<P8U>> serie (4, src), dilated;
+    PixelMaxSerie(serie, dilated, 5, 9, 2);
+    roiWindow<P8U> expected;
+    PixelMax(src, expected, 5, 9);
+    PixelMax(src, src, 5, 9);
+    for (const auto& frame : dilated)
+        for (int row = 0; row < h; row++)
+        {
+            EXPECT_EQ(0, std::memcmp(expected.rowPointer(row), frame.rowPointer(row), w));
+            EXPECT_EQ(0, std::memcmp(expected.rowPointer(row), src.rowPointer(row), w));
+        }
+}
+
 TEST(basicU8, labelConnect)
 {
     const char * frame[] =
@@ -712,6 +1155,149 @@ TEST(basicU8, labelConnect)
     
 }
 
+TEST(basicU8, labelConnect_blocks)
+{
+    // Odd sizes, random blobs
+    const int w = 203, h = 157;
+    roiWindow<P8U> pels (w, h);
+    uint32_t state = 9;
+    for (int row = 0; row < h; row++)
+        for (int col = 0; col < w; col++)
+        {
+            state = state * 1664525u + 1013904223u;
+            pels.rowPointer(row)[col] = (state >> 24) < 100 ? 255 : 0;
+        }
+    
+    // Reference: flood fill from each unlabeled pixel in raster order
+    std::vector<int32_t> expected (w * h, 0);
+    int32_t count = 0;
+    std::vector<std::pair<int, int>> stack;
+    for (int row = 0; row < h; row++)
+        for (int col = 0; col < w; col++)
+        {
+            if (! pels.rowPointer(row)[col] || expected[row * w + col]) continue;
+            expected[row * w + col] = ++count;
+            stack.emplace_back(col, row);
+            while (! stack.empty())
+            {
+                auto at = stack.back();
+                stack.pop_back();
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++)
+                    {
+                        const int x = at.first + dx, y = at.second + dy;
+                        if (x < 0 || y < 0 || x >= w || y >= h || ! pels.rowPointer(y)[x] || expected[y * w + x]) continue;
+                        expected[y * w + x] = count;
+                        stack.emplace_back(x, y);
+                    }
+            }
+        }
+    
+    for (unsigned threads : {1u, 3u, 8u})
+    {
+        labelConnect<P8U> lc (pels, threads);
+        lc.run();
+        ASSERT_EQ(uint32_t(count), lc.regions());
+        ASSERT_EQ(size_t(count), lc.label_bbox_map().size());
+        ASSERT_EQ(size_t(count + 1), lc.region_stats().size());
+        std::vector<labelConnect<P8U>::region_t> regions (count + 1);
+        for (int row = 0; row < h; row++)
+            for (int col = 0; col < w; col++)
+            {
+                const int32_t label = lc.label().rowPointer(row)[col];
+                ASSERT_EQ(expected[row * w + col], label);
+                if (! label) continue;
+                auto& rr = regions[label];
+                rr.area++;
+                rr.sx += col; rr.sy += row;
+                rr.sxx += col * col; rr.syy += row * row; rr.sxy += col * row;
+                rr.bbox = rr.area == 1 ? iRect(col, row, 1, 1) : iRect(std::min(col, rr.bbox.ul().x()), std::min(row, rr.bbox.ul().y()),
+                        std::max(col + 1, rr.bbox.lr().x()) - std::min(col, rr.bbox.ul().x()),
+                        std::max(row + 1, rr.bbox.lr().y()) - std::min(row, rr.bbox.ul().y()));
+            }
+        for (int label = 1; label <= count; label++)
+        {
+            const auto& got = lc.region_stats()[label];
+            EXPECT_EQ(regions[label].area, got.area);
+            EXPECT_EQ(regions[label].sx, got.sx);
+            EXPECT_EQ(regions[label].sy, got.sy);
+            EXPECT_EQ(regions[label].sxx, got.sxx);
+            EXPECT_EQ(regions[label].syy, got.syy);
+            EXPECT_EQ(regions[label].sxy, got.sxy);
+            EXPECT_TRUE(regions[label].bbox == got.bbox);
+            EXPECT_TRUE(regions[label].bbox == lc.label_bbox_map().at(label));
+        }
+    }
+    
+    roiWindow<P8U> empty (9, 4);
+    for (int row = 0; row < 4; row++) std::memset(empty.rowPointer(row), 0, 9);
+    labelConnect<P8U> none (empty);
+    none.run();
+    EXPECT_EQ(0u, none.regions());
+    EXPECT_TRUE(none.label_bbox_map().empty());
+}
+
+TEST(basic, histogram_engine)
+{
+    // Long runs of equal values, and a frame large enough to be split across threads
+    uint32_t state = 21;
+    auto fill = [&](auto& image, uint32_t range){
+        for (int row = 0; row < image.height(); row++)
+            for (int col = 0; col < image.width(); col++)
+            {
+                if (col % 16 == 0) state = state * 1664525u + 1013904223u;
+                image.rowPointer(row)[col] = (state >> 8) % range;
+            }
+    };
+    auto reference = [](const auto& image, unsigned shift, uint32_t top){
+        std::vector<uint32_t> hist (top + 1, 0);
+        for (int row = 0; row < image.height(); row++)
+            for (int col = 0; col < image.width(); col++)
+                hist[std::min(uint32_t(image.rowPointer(row)[col]) >> shift, top)]++;
+        return hist;
+    };
+    
+    roiWindow<P8U> small (37, 23), large (1100, 1000);
+    fill(small, 256);
+    fill(large, 256);
+    std::vector<uint32_t> hist;
+    histogramEngine engine (0, 0, 4);
+    EXPECT_EQ(size_t(256), engine.bins<P8U>());
+    engine.compute(small, hist);
+    EXPECT_TRUE(hist == reference(small, 0, 255));
+    engine.compute(large, hist);
+    EXPECT_TRUE(hist == reference(large, 0, 255));
+    
+    // 12 bit data in 256 bins, out of range values in the last bin
+    roiWindow<P16U> frame16 (301, 77);
+    fill(frame16, 5000);
+    histogramEngine engine12 (12, 8, 2);
+    EXPECT_EQ(size_t(256), engine12.bins<P16U>());
+    engine12.compute(frame16, hist);
+    EXPECT_TRUE(hist == reference(frame16, 4, 255));
+    EXPECT_GT(hist[255], 0);
+    
+    // Serie matches frame by frame
+    std::vector<roiWindow<P16U>> serie;
+    for (int ff = 0; ff < 5; ff++)
+    {
+        serie.emplace_back(64 + ff, 33);
+        fill(serie.back(), 4096);
+    }
+    std::vector<std::vector<uint32_t>> hists;
+    engine12.compute(serie, hists);
+    ASSERT_EQ(serie.size(), hists.size());
+    for (size_t ff = 0; ff < serie.size(); ff++)
+        EXPECT_TRUE(hists[ff] == reference(serie[ff], 4, 255));
+    
+    // Full depth 16 bit statistics
+    histoStats hs;
+    hs.from_image(frame16);
+    EXPECT_EQ(uint32_t(65536), hs.bins());
+    EXPECT_EQ(uint32_t(301 * 77), hs.n());
+    EXPECT_TRUE(hs.histogram() == reference(frame16, 0, 65535));
+}
+
 TEST(basicU8, histo)
 {
     
@@ -758,6 +1344,74 @@ TEST(basicU8, hyst)
     EXPECT_EQ(5, got);
 }
 
+TEST(basicU8, edge_pipeline)
+{
+    // Blocks, a slow ripple and some noise: edges in every direction, ties and short runs
+    auto make = [](int w, int h, uint32_t seed) {
+        roiWindow<P8U> pels(w, h);
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                double v = 128 + 60 * std::sin(x * 0.07) * std::cos(y * 0.05) + ((x / 23 + y / 17) % 2 ? 40 : -40)
+                + int((seed >> 24) % 9) - 4;
+                pels.rowPointer(y)[x] = uint8_t(std::max(0.0, std::min(255.0, v)));
+            }
+        return pels;
+    };
+
+    const int sizes[][2] = {{5, 5}, {64, 33}, {333, 257}};
+    for (const auto& size : sizes)
+    {
+        const int w = size[0], h = size[1];
+        roiWindow<P8U> pels = make(w, h, uint32_t(w + h));
+        roiWindow<P8U> mag(w, h), ang(w, h), peaks(w, h), hyst;
+        Gradient(pels, mag, ang);
+        const unsigned int pks = SpatialEdge(mag, ang, peaks, 4, false);
+        int32_t edges = 0;
+        hystheresisThreshold::U8(peaks, hyst, 4, 12, edges, 0);
+
+        for (unsigned threads : {1u, 4u})
+        {
+            svl::edgePipeline pipeline(4, 12, threads);
+            svl::edgePipeline::frame_edges fe;
+            pipeline.process(pels, fe);
+            EXPECT_EQ(pks, fe.peak_count);
+            EXPECT_EQ(uint32_t(edges), fe.edge_count);
+            int diffs = 0;
+            for (int y = 0; y < h; y++)
+                for (int x = 0; x < w; x++)
+                {
+                    diffs += mag.getPixel(x, y) != fe.magnitudes.getPixel(x, y);
+                    diffs += ang.getPixel(x, y) != fe.angles.getPixel(x, y);
+                    diffs += peaks.getPixel(x, y) != fe.peaks.getPixel(x, y);
+                    // U8 labels one pixel down and right of the peak
+                    if (x + 1 < w && y + 1 < h) diffs += hyst.getPixel(x + 1, y + 1) != fe.edges.getPixel(x, y);
+                }
+            EXPECT_EQ(0, diffs);
+        }
+    }
+
+    // A serie, frames in parallel, matches frame by frame
+    std::vector<roiWindow<P8U>> frames;
+    for (uint32_t ff = 0; ff < 6; ff++) frames.push_back(make(97, 71, ff));
+    svl::edgePipeline pipeline(4, 12, 3);
+    std::vector<svl::edgePipeline::frame_edges> serie;
+    pipeline.process(frames, serie);
+    EXPECT_EQ(frames.size(), serie.size());
+    for (size_t ff = 0; ff < frames.size(); ff++)
+    {
+        svl::edgePipeline::frame_edges fe;
+        pipeline.process(frames[ff], fe);
+        EXPECT_EQ(fe.peak_count, serie[ff].peak_count);
+        EXPECT_EQ(fe.edge_count, serie[ff].edge_count);
+        EXPECT_GT(fe.edge_count, 0);
+        for (int y = 0; y < fe.edges.height(); y++)
+            EXPECT_TRUE(std::equal(fe.edges.rowPointer(y), fe.edges.rowPointer(y) + fe.edges.width(),
+                                   serie[ff].edges.rowPointer(y)));
+    }
+}
+
 
 
 
@@ -787,6 +1441,74 @@ TEST(basic, corr16)
     EXPECT_EQ(cp.r(), 1);
 }
 
+TEST(basic, correlation1d_engine)
+{
+    // Reference: f1dNormalizedCorr / f1dCrossCorr of the overlap at each lag
+    auto reference = [](const std::vector<double>& sig, const std::vector<double>& mod, int lag, bool normalized) {
+        const int a0 = std::max(0, -lag), a1 = std::min(int(sig.size()), int(mod.size()) - lag);
+        if (a1 <= a0) return 0.0;
+        return normalized ? f1dNormalizedCorr(sig.begin() + a0, sig.begin() + a1, mod.begin() + a0 + lag, mod.begin() + a1 + lag)
+        : f1dCrossCorr(sig.begin() + a0, sig.begin() + a1, mod.begin() + a0 + lag, mod.begin() + a1 + lag);
+    };
+
+    const std::vector<int> lengths {1, 7, 64, 301};
+    for (auto n : lengths)
+        for (auto m : lengths)
+        {
+            std::vector<double> sig (static_cast<size_t>(n)), mod (static_cast<size_t>(m));
+            for (int ii = 0; ii < n; ii++) sig[size_t(ii)] = 100 + 5 * std::sin(ii * 0.1) + ((ii * 7919) % 13) * 0.1;
+            for (int ii = 0; ii < m; ii++) mod[size_t(ii)] = 100 + 5 * std::sin(ii * 0.1 + 0.3) + ((ii * 104729) % 11) * 0.1;
+            const int lo = -(n + 1), hi = m + 1;
+            for (auto normalized : {true, false})
+                for (auto how : {correlation1dEngine::method::direct, correlation1dEngine::method::fft})
+                {
+                    correlation1dEngine engine (normalized ? correlation1dEngine::measure::normalized : correlation1dEngine::measure::cross, how);
+                    std::vector<double> scores;
+                    engine.correlate(sig, mod, lo, hi, scores);
+                    EXPECT_EQ(size_t(hi - lo + 1), scores.size());
+                    for (int lag = lo; lag <= hi; lag++)
+                    {
+                        // r2 of 1 or 2 pairs is 0 or 1 up to rounding
+                        if (normalized && std::min(n, m - lag) - std::max(0, -lag) < 3) continue;
+                        const double expected = reference(sig, mod, lag, normalized);
+                        EXPECT_NEAR(expected, scores[size_t(lag - lo)], normalized ? 1e-9 : 1e-9 * std::fabs(expected) + 1e-9);
+                    }
+                }
+        }
+
+    // Automatic choice: few lags are summed directly, many by FFT
+    EXPECT_FALSE(correlation1dEngine::prefer_fft(1024, 1024, -4, 4));
+    EXPECT_TRUE(correlation1dEngine::prefer_fft(1024, 1024, -256, 256));
+
+    // A batch of shifted profiles aligns at the shifts, as f1dRegister
+    std::vector<std::vector<float>> signals, models;
+    for (int shift = -6; shift <= 6; shift += 3)
+    {
+        std::vector<float> sig (200), mod (200);
+        for (int ii = 0; ii < 200; ii++)
+        {
+            sig[size_t(ii)] = float(std::exp(-0.01 * (ii - 100) * (ii - 100)));
+            mod[size_t(ii)] = float(std::exp(-0.01 * (ii + shift - 100) * (ii + shift - 100)));
+        }
+        signals.push_back(sig);
+        models.push_back(mod);
+    }
+    correlation1dEngine engine;
+    std::vector<correlation1dEngine::alignment> alignments;
+    engine.align(signals, models, -20, 20, alignments);
+    EXPECT_EQ(signals.size(), alignments.size());
+    for (size_t pp = 0; pp < alignments.size(); pp++)
+    {
+        const int shift = -6 + 3 * int(pp);
+        // Overlaps differ on either side of the peak: the interpolation is off by a little
+        EXPECT_NEAR(double(-shift), alignments[pp].position, 1e-2);
+        EXPECT_NEAR(1.0, alignments[pp].peak, 1e-3);
+        double pose = 0;
+        const double position = f1dRegister(signals[pp].begin(), signals[pp].end(), models[pp].begin(), models[pp].end(), 20u, pose);
+        EXPECT_NEAR(position - 20, alignments[pp].position, 1e-9);
+    }
+}
+
 
 TEST(timing8, corr)
 {
@@ -832,6 +1554,245 @@ TEST(timing16, corr)
     std::cout << " Correlation: 1920 * 1080 * 16 bit " << endtime * scale << " millieseconds per " << std::endl;
 }
 
+TEST(basic, moment_cache)
+{
+    vector<roiWindow<P8U>> frames;
+    for (int i = 0; i < 6; i++)
+    {
+        roiWindow<P8U> frame (211, 97);
+        frame.randomFill(i);
+        frames.push_back(frame);
+    }
+    
+    // Same results as correlating every pair from scratch, for frames and windows in them
+    momentCache cache;
+    for (int i = 0; i < 6; i++)
+        for (int j = 0; j < 6; j++)
+        {
+            CorrelationParts ref, cached, given;
+            Correlation::point(frames[i], frames[j], ref);
+            Correlation::point(frames[i], frames[j], cached, cache);
+            Correlation::point(frames[i], frames[j], given, moments(frames[i]));
+            EXPECT_EQ(ref.r(), cached.r());
+            EXPECT_EQ(ref.Sim(), cached.Sim());
+            EXPECT_EQ(ref.r(), given.r());
+            roiWindow<P8U> wi (frames[i].frameBuf(), 13, 7, 50, 40);
+            roiWindow<P8U> wm (frames[j].frameBuf(), 20, 30, 50, 40);
+            Correlation::point(wi, wm, ref);
+            Correlation::point(wi, wm, cached, cache);
+            EXPECT_EQ(ref.r(), cached.r());
+        }
+    
+    // Moments computed once per frame and window
+    EXPECT_EQ(18, cache.size());
+    EXPECT_EQ(18, cache.misses());
+    EXPECT_EQ(6 * 6 * 4 - 18, cache.hits());
+    cache.invalidate(frames[0]);
+    EXPECT_EQ(17, cache.size());
+    
+    // Released frame buffers are not served
+    {
+        roiWindow<P8U> gone (10, 10);
+        gone.randomFill(99);
+        cache.get(gone);
+    }
+    roiWindow<P8U> fresh (10, 10);
+    fresh.randomFill(5);
+    EXPECT_EQ(moments(fresh).s, cache.get(fresh).s);
+}
+
+TEST(basic, frame_pool)
+{
+    EXPECT_EQ(64, frame_pool::size_class(1));
+    EXPECT_EQ(4096, frame_pool::size_class(4096));
+    EXPECT_EQ(4608, frame_pool::size_class(4097));
+    EXPECT_EQ(655360, frame_pool::size_class(640 * 1000));
+    
+    // Pooled rows are 64 byte aligned and rows are padded to a multiple of 64
+    const uint8_t* first = nullptr;
+    {
+        roiWindow<P8U> pooled (211, 97, image_memory_alignment_policy::align_every_row, image_memory_allocation_policy::pooled_allocation);
+        EXPECT_EQ(pooled_allocation, pooled.frameBuf()->allocation_policy());
+        EXPECT_EQ(256, pooled.rowUpdate());
+        for (int row = 0; row < pooled.height(); row++)
+            EXPECT_EQ(0, (intptr_t)pooled.rowPointer(row) % 64);
+        pooled.randomFill(3);
+        first = pooled.frameBuf()->alignedPixelData();
+    }
+    
+    // Released frame goes back to the pool and is handed out to the next frame of its size
+    auto hits = frame_pool::instance().hits();
+    roiWindow<P8U> again (211, 97, image_memory_alignment_policy::align_every_row, image_memory_allocation_policy::pooled_allocation);
+    EXPECT_EQ(hits + 1, frame_pool::instance().hits());
+    EXPECT_EQ(first, again.frameBuf()->alignedPixelData());
+    
+    // Heap allocation is unchanged
+    roiWindow<P8U> heap (211, 97);
+    EXPECT_EQ(heap_allocation, heap.frameBuf()->allocation_policy());
+    EXPECT_EQ(216, heap.rowUpdate());
+    
+    // Adopted pixels are shared, not copied, and kept alive by the root
+    std::shared_ptr<std::vector<uint8_t>> pixels = std::make_shared<std::vector<uint8_t>>(80 * 10, 7);
+    roiWindow<P8U> adopted (std::make_shared<root<P8U>>(pixels->data(), 80, 75, 10, pixels));
+    std::weak_ptr<std::vector<uint8_t>> watch = pixels;
+    pixels.reset();
+    EXPECT_FALSE(watch.expired());
+    EXPECT_EQ(75, adopted.width());
+    EXPECT_EQ(80, adopted.rowUpdate());
+    adopted.setPixel(3, 4, 9);
+    EXPECT_EQ(9, (*watch.lock())[4 * 80 + 3]);
+    adopted = roiWindow<P8U> ();
+    EXPECT_TRUE(watch.expired());
+}
+
+TEST(basic, cv_bridge)
+{
+    // roiWindow to cv::Mat and back shares one frame
+    roiWindow<P8U> frame (211, 97);
+    frame.randomFill(7);
+    std::weak_ptr<root<P8U>> watch = frame.frameBuf();
+    cv::Mat shared = cvMatShare(frame);
+    EXPECT_EQ(frame.pelPointer(0, 0), shared.data);
+    EXPECT_EQ(size_t(frame.rowUpdate()), shared.step[0]);
+    EXPECT_EQ(frame.getPixel(5, 9), shared.at<uint8_t>(9, 5));
+    roiWindow<P8U> back = adoptCvMat8U(shared);
+    EXPECT_TRUE(back == frame);
+    roiWindow<P8U> part = adoptCvMat8U(shared(cv::Rect(10, 20, 30, 40)));
+    EXPECT_TRUE(part.frameBuf() == frame.frameBuf());
+    EXPECT_EQ(10, part.x());
+    EXPECT_EQ(20, part.y());
+    
+    // The Mat keeps the frame alive after the windows are gone
+    frame = roiWindow<P8U> ();
+    back = roiWindow<P8U> ();
+    part = roiWindow<P8U> ();
+    EXPECT_FALSE(watch.expired());
+    cv::Mat copy = shared;
+    shared.release();
+    EXPECT_FALSE(watch.expired());
+    copy.release();
+    EXPECT_TRUE(watch.expired());
+    
+    // Mats from the svl allocator have aligned rows and are adopted without copy
+    cv::Mat pooled;
+    pooled.allocator = svlMatAllocator();
+    pooled.create(97, 211, CV_8U);
+    EXPECT_EQ(size_t(256), size_t(pooled.step[0]));
+    EXPECT_EQ(0, (intptr_t)pooled.data % 64);
+    pooled = 3;
+    roiWindow<P8U> rw = adoptCvMat8U(pooled);
+    EXPECT_EQ(pooled.data, rw.pelPointer(0, 0));
+    EXPECT_EQ(3, rw.getPixel(210, 96));
+    
+    // Mats on OpenCV buffers are adopted by reference
+    cv::Mat plain (40, 30, CV_8U, cv::Scalar(4));
+    roiWindow<P8U> adopted = adoptCvMat8U(plain);
+    plain.release();
+    EXPECT_EQ(4, adopted.getPixel(29, 39));
+}
+
+TEST(basic, translation_tracker)
+{
+    // Smooth texture sampled at a sub pixel offset
+    auto texture = [](int rows, int cols, double ox, double oy){
+        cv::Mat out (rows, cols, CV_32F);
+        for (int y = 0; y < rows; y++)
+            for (int x = 0; x < cols; x++){
+                double u = x + ox, v = y + oy;
+                out.at<float>(y, x) = float(100 + 30 * std::sin(0.31 * u + 0.2 * v) + 25 * std::cos(0.17 * u - 0.41 * v)
+                                            + 20 * std::sin(0.005 * u * v + 0.23 * v));
+            }
+        return out;
+    };
+    
+    translationTracker tracker (4);
+    cv::Mat image = texture(90, 120, 0, 0);
+    for (double fx : {0.0, 0.25, 0.5, 0.8})
+        for (double fy : {0.0, 0.3, 0.6}){
+            auto found = tracker.locate(image, texture(30, 40, 37 + fx, 22 + fy));
+            EXPECT_TRUE(found.valid);
+            EXPECT_NEAR(37 + fx, found.location.x(), 0.05);
+            EXPECT_NEAR(22 + fy, found.location.y(), 0.05);
+        }
+    EXPECT_FALSE(tracker.locate(texture(20, 20, 0, 0), texture(30, 10, 0, 0)).valid);
+    
+    // Parallel serie matches pair by pair tracking
+    std::vector<cv::Mat> windows;
+    for (int ww = 0; ww < 9; ww++)
+        windows.push_back(texture(60, 90, ww * 0.4, 0));
+    std::vector<float> lengths = tracker.lengths(windows);
+    EXPECT_EQ(windows.size(), lengths.size());
+    for (size_t ww = 1; ww < windows.size(); ww++)
+        EXPECT_EQ(tracker.length(windows[ww], windows[ww - 1]), lengths[ww]);
+    EXPECT_EQ(lengths[1], lengths[0]);
+    
+    // Shifted by ( 15, 3 ), the left third lands at the right end of the left half and the centre third at
+    // the start of the right half. Their distance is the distance of the thirds in minus, for odd widths too
+    for (int cols : {90, 91}){
+        cv::Mat minus = texture(60, cols, 0, 0);
+        cv::Mat plus = texture(60, cols, -15, -3);
+        EXPECT_NEAR((cols - cols / 3) / 2, tracker.length(minus, plus), 0.05);
+    }
+}
+
+TEST(basicU8, lattice_similarity)
+{
+    // Noise frames with a blob moving back and forth inside one region
+    const int width = 96, height = 64, frames = 12;
+    vector<roiWindow<P8U>> images;
+    for (int ff = 0; ff < frames; ff++)
+    {
+        roiWindow<P8U> img (width, height);
+        img.randomFill(17);
+        int bx = 8 + 4 * (ff % 4);
+        for (int y = 40; y < 52; y++)
+            for (int x = bx; x < bx + 8; x++)
+                img.setPixel(x, y, 250);
+        images.push_back(img);
+    }
+    
+    latticeSimilarity lattice (iPair(16, 16), iPair(12, 12), 3);
+    EXPECT_FALSE(lattice.fill(vector<roiWindow<P8U>>(1, images[0])));
+    EXPECT_TRUE(lattice.fill(images));
+    EXPECT_EQ(iPair(8, 5), lattice.lattice());
+    EXPECT_EQ(lattice.lattice(), latticeSimilarity::lattice_dimensions(iPair(width, height), iPair(16, 16), iPair(12, 12)));
+    EXPECT_EQ(40, lattice.tiles().size());
+    // Last column and row are aligned with the frame edges
+    EXPECT_EQ(width - 16, lattice.tiles()[7].ul().x());
+    EXPECT_EQ(height - 16, lattice.tiles()[39].ul().y());
+    
+    // Tile scores match correlating the tile windows
+    for (auto tt : {0, 13, 39})
+    {
+        const iRect& tile = lattice.tiles()[tt];
+        latticeSimilarity::matrix_t matrix;
+        lattice.tileSelfSimilarityMatrix(tt % 8, tt / 8, matrix);
+        for (auto pp : {std::make_pair(0, 1), std::make_pair(2, 9), std::make_pair(5, 11)})
+        {
+            roiWindow<P8U> wi (images[pp.first], tile.ul().x(), tile.ul().y(), tile.width(), tile.height());
+            roiWindow<P8U> wm (images[pp.second], tile.ul().x(), tile.ul().y(), tile.width(), tile.height());
+            CorrelationParts cp;
+            Correlation::point(wi, wm, cp);
+            EXPECT_NEAR(cp.r(), matrix[pp.first][pp.second], 1e-6);
+            EXPECT_EQ(matrix[pp.first][pp.second], matrix[pp.second][pp.first]);
+        }
+    }
+    
+    // Whole frame matches the self similarity producer
+    self_similarity_producer<P8U> sm ((uint32_t) images.size(), uint32_t(0));
+    EXPECT_TRUE(sm.fill(images));
+    deque<double> ent;
+    EXPECT_TRUE(sm.entropies(ent));
+    EXPECT_EQ(ent.size(), lattice.entropies().size());
+    for (auto ii = 0; ii < ent.size(); ii++)
+        EXPECT_NEAR(ent[ii], lattice.entropies()[ii], 1e-5);
+    
+    // Motion is localized to the tiles covering the blob's path
+    auto map = lattice.entropy_map();
+    EXPECT_GT(map[3][1], 0.01);
+    EXPECT_NEAR(0.0, map[0][6], 1e-6);
+}
+
 
 
 /***